@@ -0,0 +1,191 @@
+#include <benchmark/benchmark.h>
+
+#include <etfw/os/Fiber.hpp>
+#include <etfw/msg/BlockingMsgQueue.hpp>
+#include <etfw/svcs/App.hpp>
+#include <etfw/svcs/SvcCfg.hpp>
+
+#include <sys/resource.h>
+#include <atomic>
+#include <type_traits>
+
+namespace
+{
+
+constexpr size_t StackWords = 4096;
+alignas(16) Os::Fiber::Stack_t::Buf_t switch_stack[StackWords];
+
+void yield_forever(void*)
+{
+    while (true)
+    {
+        Os::Fiber::yield();
+    }
+}
+
+/// @brief Raw fiber switch cost. One iteration is a resume and a yield.
+void BM_FiberSwitch(benchmark::State& state)
+{
+    static Os::Fiber fiber;
+    static bool started = false;
+    if (!started)
+    {
+        fiber.init(Os::Fiber::Stack_t(switch_stack, StackWords), yield_forever, nullptr);
+        started = true;
+    }
+    for (auto _ : state)
+    {
+        fiber.resume();
+    }
+    state.counters["stack_used_B"] = static_cast<double>(fiber.stack_used());
+}
+
+BENCHMARK(BM_FiberSwitch);
+
+// ~~~~~~~~ Service ping-pong ~~~~~~~~
+
+/// Round trips measured per run
+constexpr uint64_t NumRoundTrips = 50000;
+constexpr Os::TimeMs_t WaitMs = 100;
+
+struct Link
+{
+    etfw::msg::BlockingMsgQueue<uint64_t, 8> Ping;
+    etfw::msg::BlockingMsgQueue<uint64_t, 8> Pong;
+};
+
+template <typename TRunnerCfg>
+struct EchoCfg : public etfw::SvcCfg<80, TRunnerCfg>
+{
+    static constexpr const char* NAME = "ECHO";
+};
+
+template <typename TRunnerCfg>
+struct InitiatorCfg : public etfw::SvcCfg<81, TRunnerCfg>
+{
+    static constexpr const char* NAME = "INITIATOR";
+};
+
+/// @brief Blocks on pings and sends each one back
+template <typename TRunnerCfg>
+class Echo : public etfw::App<Echo<TRunnerCfg>, EchoCfg<TRunnerCfg>>
+{
+    public:
+        using Base_t = etfw::App<Echo<TRunnerCfg>, EchoCfg<TRunnerCfg>>;
+        using Status = typename Base_t::Status;
+        using RunState = typename Base_t::RunState;
+
+        Echo(Link& link): link_(link) {}
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        RunState run_loop()
+        {
+            uint64_t seq = 0;
+            if (link_.Ping.front(seq, WaitMs))
+            {
+                link_.Pong.emplace(seq);
+            }
+            return RunState::OK;
+        }
+
+        inline const typename Base_t::Runner_t& runner_ext() const { return this->Runner; }
+
+    private:
+        Link& link_;
+};
+
+/// @brief Sends a ping and blocks on the reply, NumRoundTrips times
+template <typename TRunnerCfg>
+class Initiator : public etfw::App<Initiator<TRunnerCfg>, InitiatorCfg<TRunnerCfg>>
+{
+    public:
+        using Base_t = etfw::App<Initiator<TRunnerCfg>, InitiatorCfg<TRunnerCfg>>;
+        using Status = typename Base_t::Status;
+        using RunState = typename Base_t::RunState;
+
+        Initiator(Link& link): link_(link), done_(0) {}
+
+        Status app_init()
+        {
+            done_ = 0;
+            return Status::Code::OK;
+        }
+
+        Status app_cleanup() { return Status::Code::OK; }
+
+        RunState run_loop()
+        {
+            uint64_t reply = 0;
+            link_.Ping.emplace(done_.load(std::memory_order_relaxed));
+            if (link_.Pong.front(reply, WaitMs))
+            {
+                if (done_.fetch_add(1, std::memory_order_release) + 1 == NumRoundTrips)
+                {
+                    return RunState::DONE;
+                }
+            }
+            return RunState::OK;
+        }
+
+        inline bool done() const { return done_.load(std::memory_order_acquire) >= NumRoundTrips; }
+
+        inline const typename Base_t::Runner_t& runner_ext() const { return this->Runner; }
+
+    private:
+        Link& link_;
+        std::atomic<uint64_t> done_;
+};
+
+inline long context_switches()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+/// @brief Round trip cost between two services blocked on
+///     BlockingMsgQueue, each on the given runner
+template <typename TRunnerCfg>
+void BM_RunnerPingPong(benchmark::State& state)
+{
+    static Link link;
+    static Echo<TRunnerCfg> echo(link);
+    static Initiator<TRunnerCfg> initiator(link);
+
+    long switches = 0;
+    for (auto _ : state)
+    {
+        const long start = context_switches();
+        echo.init();
+        initiator.init();
+        echo.start();
+        initiator.start();
+        while (!initiator.done())
+        {
+            Os::Thread::delay(1);
+        }
+        switches += context_switches() - start;
+        echo.stop();
+    }
+
+    const double round_trips = static_cast<double>(state.iterations() * NumRoundTrips);
+    state.counters["ns/rtt"] = benchmark::Counter(round_trips,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["ctx_sw/rtt"] = static_cast<double>(switches) / round_trips;
+    if constexpr (std::is_base_of<etfw::iFiberRunnerExt,
+        typename Echo<TRunnerCfg>::Runner_t>::value)
+    {
+        state.counters["stack_used_B"] = static_cast<double>(std::max(
+            echo.runner_ext().stack_used(), initiator.runner_ext().stack_used()));
+    }
+}
+
+using ThreadRunner = etfw::ActiveSvcCfg<0, 8192>;
+using FiberRunner = etfw::FiberSvcCfg<4096>;
+
+BENCHMARK_TEMPLATE(BM_RunnerPingPong, ThreadRunner)->Iterations(1)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_RunnerPingPong, FiberRunner)->Iterations(1)->UseRealTime();
+
+}
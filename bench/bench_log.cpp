@@ -0,0 +1,316 @@
+#include <benchmark/benchmark.h>
+
+#include <etfw/svcs/log/AsyncLog.hpp>
+#include <etfw/svcs/log/BinLog.hpp>
+#include <etfw/svcs/log/FileLog.hpp>
+#include <etfw/svcs/App.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+
+using ConsoleLog = etfw::Logger<ConsoleLogPolicy>;
+using AsyncPolicy = etfw::AsyncLogPolicy<ConsoleLogPolicy>;
+using AsyncLog = etfw::Logger<AsyncPolicy>;
+using BinLog = etfw::Logger<etfw::BinLogPolicy>;
+using FileLogger = etfw::Logger<etfw::FileLogPolicy>;
+
+/// @brief Sends stdout to /dev/null while the benchmark loop runs, so
+///     the console sink pays for the write but the report stays readable
+class MuteStdout
+{
+    public:
+        MuteStdout()
+        {
+            std::fflush(stdout);
+            Saved = dup(STDOUT_FILENO);
+            const int null_fd = open("/dev/null", O_WRONLY);
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+
+        ~MuteStdout()
+        {
+            std::fflush(stdout);
+            dup2(Saved, STDOUT_FILENO);
+            close(Saved);
+        }
+
+    private:
+        int Saved;
+};
+
+/// @brief Log lines formatted and printed on the calling thread
+void BM_LogConsole(benchmark::State& state)
+{
+    MuteStdout* mute = (state.thread_index() == 0) ? new MuteStdout() : nullptr;
+    int i = 0;
+    for (auto _ : state)
+    {
+        ConsoleLog::log(etfw::LogLevel::INFO, "BENCH_LOG", "cycle %d took %u us, %s", i++, 125u, "ok");
+    }
+    delete mute;
+}
+
+BENCHMARK(BM_LogConsole)->Threads(1)->Threads(8)->UseRealTime();
+
+/// Records each thread logs between waits for the logger thread. The
+/// benchmark record is well under 128 bytes, so a batch fills at most half
+/// a ring.
+static constexpr int AsyncBatch = static_cast<int>(etfw::AsyncLog::RingSz / (2 * 128));
+
+/// @brief Log lines queued for the logger thread, which formats and
+///     prints them. Producers wait, untimed, for the logger thread after
+///     each batch, so the calls measured are queued, not dropped.
+void BM_LogAsync(benchmark::State& state)
+{
+    MuteStdout* mute = nullptr;
+    etfw::AsyncLog::Stats before = {};
+    if (state.thread_index() == 0)
+    {
+        mute = new MuteStdout();
+        before = AsyncPolicy::stats();
+    }
+    int i = 0;
+    for (auto _ : state)
+    {
+        AsyncLog::log(etfw::LogLevel::INFO, "BENCH_LOG", "cycle %d took %u us, %s", i++, 125u, "ok");
+        if ((i % AsyncBatch) == 0)
+        {
+            state.PauseTiming();
+            AsyncPolicy::flush();
+            state.ResumeTiming();
+        }
+    }
+    if (state.thread_index() == 0)
+    {
+        // Let the drop report through before stdout comes back
+        AsyncPolicy::flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * ETF_ASYNC_LOG_PERIOD_MS));
+        AsyncPolicy::flush();
+        const etfw::AsyncLog::Stats after = AsyncPolicy::stats();
+        state.counters["dropped"] = benchmark::Counter(
+            static_cast<double>(after.Dropped + after.NoRing - before.Dropped - before.NoRing));
+        delete mute;
+    }
+}
+
+BENCHMARK(BM_LogAsync)->Threads(1)->Threads(8)->UseRealTime();
+
+/// Records each thread logs between binary log flushes. The benchmark
+/// record is over 8 bytes, so a batch from every thread fits in the
+/// blocks the flusher hasn't written.
+static constexpr int BinaryBatch = static_cast<int>(
+    (etfw::BinLogFormat::BlockSz * (etfw::BinLog::NumBlocks - 1)) / (8 * 8 * 2));
+
+/// @brief Log records packed into binary log blocks and written to a
+///     file by the flusher thread, in place of formatted lines. Producers
+///     flush, untimed, after each batch, so the calls measured are
+///     queued, not dropped.
+void BM_LogBinary(benchmark::State& state)
+{
+    etfw::BinLog& file = etfw::BinLogPolicy::instance();
+    if (state.thread_index() == 0)
+    {
+        file.open("/tmp/etfw_bench_log.bin");
+    }
+    const etfw::BinLog::Stats before = file.stats();
+    int i = 0;
+    for (auto _ : state)
+    {
+        BinLog::log(etfw::LogLevel::INFO, "BENCH_LOG", "cycle %d took %u us, %s", i++, 125u, "ok");
+        if ((i % BinaryBatch) == 0)
+        {
+            state.PauseTiming();
+            file.flush();
+            state.ResumeTiming();
+        }
+    }
+    if (state.thread_index() == 0)
+    {
+        file.close();
+        const etfw::BinLog::Stats after = file.stats();
+        const uint64_t records = after.Records - before.Records;
+        state.counters["bytes_per_record"] = benchmark::Counter(
+            (records > 0) ? static_cast<double>(after.Bytes - before.Bytes) / records : 0.0);
+        state.counters["dropped"] = benchmark::Counter(
+            static_cast<double>(after.Dropped - before.Dropped));
+        std::remove("/tmp/etfw_bench_log.bin");
+    }
+}
+
+BENCHMARK(BM_LogBinary)->Threads(1)->Threads(8)->UseRealTime();
+
+/// @brief Per-call latencies of one benchmark thread. Keeps the last
+///     NumSamples.
+class Latencies
+{
+    public:
+        static constexpr size_t NumSamples = 1 << 20;
+
+        Latencies(): Samples(NumSamples), Count(0) {}
+
+        inline void add(const Os::TimeNs_t ns)
+        {
+            Samples[Count++ & (NumSamples - 1)] = static_cast<uint32_t>(ns);
+        }
+
+        /// @brief Report percentiles, averaged over the threads
+        void report(benchmark::State& state)
+        {
+            const size_t n = std::min(Count, NumSamples);
+            if (n == 0)
+            {
+                return;
+            }
+            Samples.resize(n);
+            std::sort(Samples.begin(), Samples.end());
+            const auto avg = benchmark::Counter::kAvgThreads;
+            state.counters["p50_ns"] = benchmark::Counter(Samples[n / 2], avg);
+            state.counters["p99_ns"] = benchmark::Counter(Samples[(n * 99) / 100], avg);
+            state.counters["p999_ns"] = benchmark::Counter(Samples[(n * 999) / 1000], avg);
+            state.counters["max_ns"] = benchmark::Counter(Samples[n - 1], avg);
+        }
+
+    private:
+        std::vector<uint32_t> Samples;
+        size_t Count;
+};
+
+static const char* const BenchLogPath = "/tmp/etfw_bench_log.log";
+
+void remove_bench_logs()
+{
+    std::remove(BenchLogPath);
+    for (int i = 1; i <= ETF_FILE_LOG_KEEP; i++)
+    {
+        std::remove((std::string(BenchLogPath) + "." + std::to_string(i)).c_str());
+    }
+}
+
+/// @brief Log lines staged in memory and written to a rotating file by
+///     the flusher thread, with periodic data syncs. Reports the MB/s
+///     written and the logging thread's latency per call.
+void BM_LogFile(benchmark::State& state)
+{
+    etfw::FileLog& file = etfw::FileLogPolicy::instance();
+    etfw::FileLog::Stats before = {};
+    if (state.thread_index() == 0)
+    {
+        remove_bench_logs();
+        etfw::FileLog::Config cfg;
+        cfg.Path = BenchLogPath;
+        file.open(cfg);
+        before = file.stats();
+    }
+    Latencies latencies;
+    int i = 0;
+    for (auto _ : state)
+    {
+        const Os::TimeNs_t start = Os::Clock::now_ns();
+        FileLogger::log(etfw::LogLevel::INFO, "BENCH_LOG", "cycle %d took %u us, %s", i++, 125u, "ok");
+        latencies.add(Os::Clock::now_ns() - start);
+    }
+    latencies.report(state);
+    if (state.thread_index() == 0)
+    {
+        file.close();
+        const etfw::FileLog::Stats after = file.stats();
+        state.SetBytesProcessed(static_cast<int64_t>(after.Bytes - before.Bytes));
+        state.counters["dropped"] = benchmark::Counter(
+            static_cast<double>(after.Dropped - before.Dropped));
+        state.counters["syncs"] = benchmark::Counter(static_cast<double>(after.Syncs - before.Syncs));
+        remove_bench_logs();
+    }
+}
+
+BENCHMARK(BM_LogFile)->Threads(1)->Threads(8)->UseRealTime();
+
+/// @brief Log lines written to the file one synchronous write at a time,
+///     the setup FileLog replaces
+void BM_LogFileSyncWrite(benchmark::State& state)
+{
+    remove_bench_logs();
+    Os::File file;
+    file.open(BenchLogPath, Os::File::OPEN_SYNC_WRITE, Os::File::OVERWRITE);
+    Latencies latencies;
+    int64_t bytes = 0;
+    int i = 0;
+    for (auto _ : state)
+    {
+        const Os::TimeNs_t start = Os::Clock::now_ns();
+        char msg[ETF_MAX_LOG_MSG_SZ];
+        std::snprintf(msg, sizeof(msg), "cycle %d took %u us, %s", i++, 125u, "ok");
+        char line[ETF_MAX_LOG_MSG_SZ + 48];
+        const int len = std::snprintf(line, sizeof(line), ETF_LOG_FMT "\n", "BENCH_LOG",
+            etfw::log_lvl_to_str(etfw::LogLevel::INFO), msg);
+        size_t sz = static_cast<size_t>(len);
+        file.write(reinterpret_cast<uint8_t*>(line), sz);
+        bytes += static_cast<int64_t>(sz);
+        latencies.add(Os::Clock::now_ns() - start);
+    }
+    latencies.report(state);
+    state.SetBytesProcessed(bytes);
+    file.close();
+    remove_bench_logs();
+}
+
+BENCHMARK(BM_LogFileSyncWrite)->UseRealTime();
+
+struct FilteredCfg : public etfw::SvcCfg<150, etfw::PassiveSvcCfg>
+{
+    static constexpr const char* NAME = "BENCH_FILTERED";
+    static constexpr etfw::LogLevel LOG_LEVEL = etfw::LogLevel::INFO;
+};
+
+class FilteredApp : public etfw::App<FilteredApp, FilteredCfg>
+{
+    public:
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        inline void cycle(const etfw::LogLevel level, const int i)
+        {
+            log(level, "cycle %d took %u us, %s", i, 125u, "ok");
+        }
+};
+
+/// @brief DEBUG call in an app whose Cfg builds in INFO and up
+void BM_LogCompiledOut(benchmark::State& state)
+{
+    static FilteredApp app;
+    int i = 0;
+    for (auto _ : state)
+    {
+        app.cycle(etfw::LogLevel::DEBUG, i++);
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK(BM_LogCompiledOut);
+
+/// @brief INFO call in an app whose runtime level is WARNING
+void BM_LogRuntimeOff(benchmark::State& state)
+{
+    static FilteredApp app;
+    app.set_log_level(etfw::LogLevel::WARNING);
+    int i = 0;
+    for (auto _ : state)
+    {
+        app.cycle(etfw::LogLevel::INFO, i++);
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK(BM_LogRuntimeOff);
+
+}
@@ -0,0 +1,108 @@
+#include <benchmark/benchmark.h>
+
+#include <etfw/msg/Broker.hpp>
+#include <etfw/msg/Pipe.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+using MsgId_t = etfw::msg::MsgId_t;
+
+/// Message routed to a single pipe
+constexpr MsgId_t TargetId = 0x10;
+
+/// Base of the IDs shared between pipes. Pipes draw their other
+/// subscriptions from a pool of 64 IDs starting here.
+constexpr MsgId_t NoiseIdBase = 0x1000;
+constexpr size_t NumNoiseIds = 64;
+
+class CountingPipe : public etfw::msg::iPipe
+{
+public:
+    void receive(const etl::imessage& msg) override
+    {
+        RxCount++;
+    }
+
+    size_t RxCount = 0;
+};
+
+/// @brief Pipes subscribed to range(1) IDs each. Pipe 0 also takes
+///     TargetId, so a TargetId message always has exactly one subscriber.
+std::vector<std::unique_ptr<CountingPipe>> make_pipes(const benchmark::State& state)
+{
+    const size_t num_pipes = static_cast<size_t>(state.range(0));
+    const size_t ids_per_pipe = static_cast<size_t>(state.range(1));
+    std::vector<std::unique_ptr<CountingPipe>> pipes;
+    for (size_t p = 0; p < num_pipes; p++)
+    {
+        pipes.emplace_back(new CountingPipe());
+        for (size_t k = 0; k < ids_per_pipe; k++)
+        {
+            pipes.back()->subscribe(NoiseIdBase + ((p + k) % NumNoiseIds));
+        }
+    }
+    pipes.front()->subscribe(TargetId);
+    return pipes;
+}
+
+// Baseline: scan every subscription for every message
+void BM_DispatchLinear(benchmark::State& state)
+{
+    auto pipes = make_pipes(state);
+    etl::message_broker broker;
+    for (auto& pipe: pipes)
+    {
+        broker.subscribe(pipe->subs());
+    }
+
+    etfw::msg::iBaseMsg msg(TargetId, sizeof(etfw::msg::iBaseMsg));
+    for (auto _ : state)
+    {
+        broker.receive(msg);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Broker with the message ID index
+void BM_DispatchIndexed(benchmark::State& state)
+{
+    auto pipes = make_pipes(state);
+    static etfw::msg::Broker broker;
+    for (auto& pipe: pipes)
+    {
+        broker.register_pipe(*pipe);
+    }
+
+    etfw::msg::iBaseMsg msg(TargetId, sizeof(etfw::msg::iBaseMsg));
+    for (auto _ : state)
+    {
+        broker.receive(msg);
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    for (auto& pipe: pipes)
+    {
+        broker.unregister_pipe(*pipe);
+    }
+}
+
+void DispatchArgs(benchmark::internal::Benchmark* bench)
+{
+    for (const int64_t pipes: {8, 32, 128, 256})
+    {
+        for (const int64_t ids: {1, 8, 64})
+        {
+            bench->Args({pipes, ids});
+        }
+    }
+    bench->ArgNames({"pipes", "ids"});
+}
+
+BENCHMARK(BM_DispatchLinear)->Apply(DispatchArgs);
+BENCHMARK(BM_DispatchIndexed)->Apply(DispatchArgs);
+
+}
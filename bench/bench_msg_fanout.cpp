@@ -0,0 +1,190 @@
+#include <benchmark/benchmark.h>
+
+#include <etfw/msg/Broker.hpp>
+#include <etfw/msg/Pipe.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using MsgId_t = etfw::msg::MsgId_t;
+
+/// Number of active apps each message is fanned out to
+constexpr size_t NumApps = 4;
+constexpr size_t QueueDepth = 64;
+
+/// @brief Large message of VSize bytes
+template <size_t VSize>
+struct LargeMsg : public etfw::msg::iBaseMsg
+{
+    static constexpr MsgId_t ID = 0x100 + VSize;
+    uint8_t Payload[VSize - sizeof(etfw::msg::iBaseMsg)];
+
+    LargeMsg():
+        iBaseMsg(ID, sizeof(LargeMsg)),
+        Payload{}
+    {}
+};
+
+/// @brief Active app message handler
+template <typename TMsg>
+struct Sink
+{
+    void handle(const etl::imessage& msg)
+    {
+        const auto& large = static_cast<const TMsg&>(msg);
+        benchmark::DoNotOptimize(large.Payload[sizeof(large.Payload) - 1]);
+        RxCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<size_t> RxCount{0};
+};
+
+/// @brief Copy delivery, as QueuedRouter used to do: the message is copied
+///     into the queue and copied out again by the app
+template <typename TMsg>
+class CopyPipe : public etfw::msg::iPipe
+{
+public:
+    CopyPipe(Sink<TMsg>& sink):
+        iPipe(1, {TMsg::ID}),
+        sink_(sink)
+    {}
+
+    void receive(const etl::imessage& msg) override
+    {
+        queue_.emplace(static_cast<const TMsg&>(msg));
+    }
+
+    bool process_msgs(const uint32_t t_ms)
+    {
+        if (queue_.front(msg_, t_ms))
+        {
+            sink_.handle(msg_);
+            while (queue_.front(msg_))
+            {
+                sink_.handle(msg_);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    inline bool full() const { return queue_.full(); }
+
+private:
+    Sink<TMsg>& sink_;
+    TMsg msg_;
+    etfw::msg::BlockingMsgQueue<TMsg, QueueDepth> queue_;
+};
+
+/// @brief Shared delivery. Only the buffer handle is queued.
+template <typename TMsg>
+using SharedPipe = etfw::msg::StaticQueuedPipe<Sink<TMsg>, QueueDepth, TMsg>;
+
+/// @brief Buffers for shared delivery. Holds the largest message.
+using SharedPool_t = etfw::msg::StaticMsgBufPool<
+    etfw::msg::SizeClass<4096, 2 * QueueDepth>>;
+
+template <typename TPipe, typename TMsg, typename TPublish>
+void run_fanout(benchmark::State& state, TPublish&& publish)
+{
+    std::unique_ptr<etfw::msg::Broker> broker(new etfw::msg::Broker());
+    std::vector<std::unique_ptr<Sink<TMsg>>> sinks;
+    std::vector<std::unique_ptr<TPipe>> pipes;
+    for (size_t i = 0; i < NumApps; i++)
+    {
+        sinks.emplace_back(new Sink<TMsg>());
+        pipes.emplace_back(new TPipe(*sinks.back()));
+        broker->register_pipe(*pipes.back());
+    }
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> apps;
+    for (auto& pipe: pipes)
+    {
+        TPipe* app_pipe = pipe.get();
+        apps.emplace_back([app_pipe, &done]()
+        {
+            while (!done.load(std::memory_order_relaxed))
+            {
+                app_pipe->process_msgs(1);
+            }
+        });
+    }
+
+    size_t sent = 0;
+    for (auto _ : state)
+    {
+        // Back pressure. Wait for the slowest app rather than drop.
+        for (auto& pipe: pipes)
+        {
+            while (pipe->full())
+            {
+                std::this_thread::yield();
+            }
+        }
+        publish(*broker);
+        sent++;
+    }
+
+    for (auto& sink: sinks)
+    {
+        while (sink->RxCount.load() < sent)
+        {
+            std::this_thread::yield();
+        }
+    }
+    done = true;
+    for (auto& app: apps)
+    {
+        app.join();
+    }
+    for (auto& pipe: pipes)
+    {
+        broker->unregister_pipe(*pipe);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(sent));
+    state.SetBytesProcessed(static_cast<int64_t>(sent * NumApps * sizeof(TMsg)));
+}
+
+template <size_t VSize>
+void BM_FanOutCopy(benchmark::State& state)
+{
+    using Msg_t = LargeMsg<VSize>;
+    const Msg_t msg;
+    run_fanout<CopyPipe<Msg_t>, Msg_t>(state, [&msg](etfw::msg::Broker& broker)
+    {
+        broker.receive(msg);
+    });
+}
+
+template <size_t VSize>
+void BM_FanOutShared(benchmark::State& state)
+{
+    using Msg_t = LargeMsg<VSize>;
+    static SharedPool_t pool;
+    run_fanout<SharedPipe<Msg_t>, Msg_t>(state, [](etfw::msg::Broker& broker)
+    {
+        etfw::msg::Buf* buf = nullptr;
+        while ((buf = pool.allocate<Msg_t>()) == nullptr)
+        {
+            std::this_thread::yield();
+        }
+        broker.receive(etfw::msg::SharedMsg(*buf));
+    });
+}
+
+BENCHMARK_TEMPLATE(BM_FanOutCopy, 1024)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FanOutCopy, 2048)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FanOutCopy, 4096)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FanOutShared, 1024)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FanOutShared, 2048)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FanOutShared, 4096)->UseRealTime();
+
+}
@@ -0,0 +1,76 @@
+#include <benchmark/benchmark.h>
+
+#include <etfw/msg/IdScan.hpp>
+#include <etfw/msg/MsgIdSet.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+/// Number of lookups cycled through per benchmark, half hits and half misses
+constexpr size_t NumQueries = 1024;
+
+struct IdFixture
+{
+    std::vector<uint32_t> Ids;
+    std::vector<uint32_t> Queries;
+};
+
+/// @brief Sorted, spread out telemetry-style IDs and a shuffled query mix
+IdFixture make_ids(const size_t num_ids)
+{
+    IdFixture fix;
+    std::mt19937 rng(1234);
+    for (size_t i = 0; i < num_ids; i++)
+    {
+        fix.Ids.push_back(0x1000 + static_cast<uint32_t>(i * 3));
+    }
+    for (size_t q = 0; q < NumQueries; q++)
+    {
+        const uint32_t hit = fix.Ids[rng() % num_ids];
+        fix.Queries.push_back(((q % 2) == 0) ? hit : hit + 1);
+    }
+    std::shuffle(fix.Queries.begin(), fix.Queries.end(), rng);
+    return fix;
+}
+
+template <typename TFunc>
+void run_lookups(benchmark::State& state, TFunc&& lookup)
+{
+    const IdFixture fix = make_ids(static_cast<size_t>(state.range(0)));
+    size_t q = 0;
+    for (auto _ : state)
+    {
+        const bool found = lookup(fix.Ids.data(), fix.Ids.size(), fix.Queries[q]);
+        benchmark::DoNotOptimize(found);
+        q = (q + 1) % NumQueries;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Previous subscription check: compare one ID at a time
+void BM_IdLookupScalar(benchmark::State& state)
+{
+    run_lookups(state, etfw::msg::id_scan_scalar);
+}
+
+void BM_IdLookupBinary(benchmark::State& state)
+{
+    run_lookups(state, etfw::msg::id_search);
+}
+
+// Kernel used by iPipe::accepts
+void BM_IdLookupVector(benchmark::State& state)
+{
+    state.SetLabel(etfw::msg::IdScanImpl);
+    run_lookups(state, etfw::msg::id_scan);
+}
+
+BENCHMARK(BM_IdLookupScalar)->Arg(4)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK(BM_IdLookupBinary)->Arg(4)->Arg(16)->Arg(64)->Arg(256);
+BENCHMARK(BM_IdLookupVector)->Arg(4)->Arg(16)->Arg(64)->Arg(256);
+
+}
@@ -0,0 +1,85 @@
+
+#include <benchmark/benchmark.h>
+
+#include <etfw/msg/Pool.hpp>
+
+namespace
+{
+
+using HeapPool = etfw::msg::MsgBufPool;
+using SlabPool = etfw::msg::DefaultMsgBufPool;
+using CachedPool = etfw::msg::CachedMsgBufPool<8,
+    etfw::msg::SizeClass<64, 160>,
+    etfw::msg::SizeClass<256, 160>>;
+
+// Allocate and immediately release a single buffer
+template <typename TPool>
+void BM_PoolAllocRelease(benchmark::State& state)
+{
+    static TPool pool;
+    const size_t msg_sz = static_cast<size_t>(state.range(0));
+    for (auto _ : state)
+    {
+        etfw::msg::Buf* buf = pool.allocate(msg_sz);
+        benchmark::DoNotOptimize(buf);
+        buf->release();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Keep a burst of buffers in flight before releasing them, like a
+// broker fanning out to queued pipes
+template <typename TPool>
+void BM_PoolAllocBurst(benchmark::State& state)
+{
+    static TPool pool;
+    constexpr size_t BurstSz = 32;
+    const size_t msg_sz = static_cast<size_t>(state.range(0));
+    etfw::msg::Buf* bufs[BurstSz];
+    for (auto _ : state)
+    {
+        for (auto& buf: bufs)
+        {
+            buf = pool.allocate(msg_sz);
+            benchmark::DoNotOptimize(buf);
+        }
+        for (auto& buf: bufs)
+        {
+            buf->release();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * BurstSz);
+}
+
+// Allocate and release from several threads sharing one pool
+template <typename TPool>
+void BM_PoolAllocReleaseMT(benchmark::State& state)
+{
+    static TPool pool;
+    const size_t msg_sz = static_cast<size_t>(state.range(0));
+    for (auto _ : state)
+    {
+        etfw::msg::Buf* buf = pool.allocate(msg_sz);
+        benchmark::DoNotOptimize(buf);
+        if (buf != nullptr)
+        {
+            buf->release();
+        }
+    }
+    // Benchmark threads are short-lived, give the cache back for the next run
+    pool.flush_thread_cache();
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_PoolAllocRelease, HeapPool)->Arg(48)->Arg(200)->Arg(1000);
+BENCHMARK_TEMPLATE(BM_PoolAllocRelease, SlabPool)->Arg(48)->Arg(200)->Arg(1000);
+BENCHMARK_TEMPLATE(BM_PoolAllocBurst, HeapPool)->Arg(48)->Arg(200);
+BENCHMARK_TEMPLATE(BM_PoolAllocBurst, SlabPool)->Arg(48)->Arg(200);
+BENCHMARK_TEMPLATE(BM_PoolAllocReleaseMT, HeapPool)->Arg(48)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PoolAllocReleaseMT, SlabPool)->Arg(48)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PoolAllocReleaseMT, CachedPool)->Arg(48)
+    ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->UseRealTime();
+
+}
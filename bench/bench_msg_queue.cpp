@@ -0,0 +1,147 @@
+#include <benchmark/benchmark.h>
+
+#include <etfw/msg/BlockingMsgQueue.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+
+constexpr size_t QueueDepth = 128;
+constexpr Os::TimeMs_t WaitMs = 100;
+
+/// @brief Previous queue behaviour: the semaphore counts items, so every
+///     push posts and every pop waits
+template <typename T, size_t QDepth>
+class CountingSemQueue
+{
+public:
+    CountingSemQueue():
+        SemCalls(0)
+    {
+        Sem.init();
+    }
+
+    bool emplace(const T& item)
+    {
+        if (queue_.emplace(item))
+        {
+            SemCalls.fetch_add(1, std::memory_order_relaxed);
+            Sem.give();
+            return true;
+        }
+        return false;
+    }
+
+    bool front(T& value)
+    {
+        SemCalls.fetch_add(1, std::memory_order_relaxed);
+        if (Sem.take() == Os::CountSem::Status::OP_OK)
+        {
+            return queue_.pop(value);
+        }
+        return false;
+    }
+
+    bool front(T& value, const Os::TimeMs_t timeout_ms)
+    {
+        SemCalls.fetch_add(1, std::memory_order_relaxed);
+        if (Sem.take(timeout_ms) == Os::CountSem::Status::OP_OK)
+        {
+            return queue_.pop(value);
+        }
+        return false;
+    }
+
+    inline bool empty() const { return queue_.empty(); }
+
+    inline size_t syscalls() const { return SemCalls.load(); }
+
+private:
+    Os::CountSem Sem;
+    etl::queue_spsc_atomic<T, QDepth, etl::memory_model::MEMORY_MODEL_SMALL> queue_;
+    std::atomic<size_t> SemCalls;
+};
+
+/// @brief Publisher sends bursts of range(0) messages, one at a time. The
+///     consumer thread sleeps on the queue between bursts.
+template <typename TQueue, typename TConsume>
+void run_bursts(benchmark::State& state, TQueue& queue, TConsume&& consume)
+{
+    const size_t burst = static_cast<size_t>(state.range(0));
+    std::atomic<bool> done{false};
+    std::atomic<size_t> consumed{0};
+    std::thread consumer([&]()
+    {
+        while (!done.load(std::memory_order_relaxed))
+        {
+            consumed.fetch_add(consume(queue), std::memory_order_release);
+        }
+    });
+
+    size_t sent = 0;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < burst; i++)
+        {
+            queue.emplace(static_cast<int>(i));
+        }
+        sent += burst;
+        while (consumed.load(std::memory_order_acquire) < sent)
+        {
+            std::this_thread::yield();
+        }
+    }
+    done = true;
+    queue.emplace(0);
+    consumer.join();
+
+    state.SetItemsProcessed(static_cast<int64_t>(sent));
+    state.counters["syscalls/msg"] = static_cast<double>(queue.syscalls()) /
+        static_cast<double>(sent);
+}
+
+// Before: front() per message
+void BM_QueuePerMsg(benchmark::State& state)
+{
+    CountingSemQueue<int, QueueDepth> queue;
+    run_bursts(state, queue, [](CountingSemQueue<int, QueueDepth>& q)
+    {
+        size_t count = 0;
+        int value = 0;
+        if (q.front(value, WaitMs))
+        {
+            count++;
+            while (!q.empty() && q.front(value))
+            {
+                count++;
+            }
+        }
+        return count;
+    });
+}
+
+// After: drain() per batch
+void BM_QueueDrain(benchmark::State& state)
+{
+    using Queue_t = etfw::msg::BlockingMsgQueue<int, QueueDepth>;
+    Queue_t queue;
+    run_bursts(state, queue, [](Queue_t& q)
+    {
+        int batch[MSG_QUEUE_DRAIN_BATCH];
+        size_t total = 0;
+        size_t count = q.drain(etl::span<int>(batch, MSG_QUEUE_DRAIN_BATCH), WaitMs);
+        while (count > 0)
+        {
+            total += count;
+            count = q.drain(etl::span<int>(batch, MSG_QUEUE_DRAIN_BATCH), 0);
+        }
+        return total;
+    });
+}
+
+BENCHMARK(BM_QueuePerMsg)->Arg(1)->Arg(16)->Arg(100)->UseRealTime();
+BENCHMARK(BM_QueueDrain)->Arg(1)->Arg(16)->Arg(100)->UseRealTime();
+
+}
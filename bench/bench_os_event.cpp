@@ -0,0 +1,160 @@
+#include <benchmark/benchmark.h>
+
+#include <etfw/msg/BlockingMsgQueue.hpp>
+#include <etfw/svcs/AppChild.hpp>
+#include <etfw/svcs/SvcCfg.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+
+/// Round trips measured per run
+constexpr size_t NumSamples = 20000;
+constexpr Os::TimeMs_t WaitMs = 100;
+constexpr uint64_t StopMarker = UINT64_MAX;
+
+struct EchoCfg : public etfw::ChildSvcCfg<20, 8192>
+{};
+
+struct InitiatorCfg : public etfw::ChildSvcCfg<20, 8192>
+{};
+
+inline uint64_t now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// @brief Queue pair between the two services
+template <typename TNotifier>
+struct Link
+{
+    using Queue_t = etfw::msg::BlockingMsgQueue<uint64_t, 8, TNotifier>;
+
+    Queue_t Ping;
+    Queue_t Pong;
+};
+
+/// @brief Sends every ping straight back
+template <typename TNotifier>
+class Echo : public etfw::AppChild<Echo<TNotifier>, EchoCfg>
+{
+    public:
+        using Base_t = etfw::AppChild<Echo<TNotifier>, EchoCfg>;
+        using RunState = typename Base_t::RunState;
+
+        Echo(Link<TNotifier>& link):
+            Base_t(1, "ECHO"),
+            link_(link)
+        {}
+
+        RunState run_loop()
+        {
+            uint64_t stamp = 0;
+            if (link_.Ping.front(stamp, WaitMs))
+            {
+                link_.Pong.emplace(stamp);
+                if (stamp == StopMarker)
+                {
+                    return RunState::DONE;
+                }
+            }
+            return RunState::OK;
+        }
+
+    private:
+        Link<TNotifier>& link_;
+};
+
+/// @brief Sends a ping, sleeps on the reply and records the round trip
+template <typename TNotifier>
+class Initiator : public etfw::AppChild<Initiator<TNotifier>, InitiatorCfg>
+{
+    public:
+        using Base_t = etfw::AppChild<Initiator<TNotifier>, InitiatorCfg>;
+        using RunState = typename Base_t::RunState;
+
+        Initiator(Link<TNotifier>& link):
+            Base_t(2, "INITIATOR"),
+            link_(link),
+            count_(0),
+            done_(false)
+        {}
+
+        RunState run_loop()
+        {
+            const uint64_t start = now_ns();
+            if (!round_trip(start))
+            {
+                return RunState::ERROR;
+            }
+            Samples[count_++] = now_ns() - start;
+
+            if (count_ == NumSamples)
+            {
+                round_trip(StopMarker);
+                done_.store(true, std::memory_order_release);
+                return RunState::DONE;
+            }
+            return RunState::OK;
+        }
+
+        inline bool done() const { return done_.load(std::memory_order_acquire); }
+
+        std::array<uint64_t, NumSamples> Samples;
+
+    private:
+        Link<TNotifier>& link_;
+        size_t count_;
+        std::atomic<bool> done_;
+
+        bool round_trip(const uint64_t stamp)
+        {
+            uint64_t reply = 0;
+            link_.Ping.emplace(stamp);
+            return link_.Pong.front(reply, WaitMs) && reply == stamp;
+        }
+};
+
+/// @brief Round trip latency between two active services blocked on
+///     BlockingMsgQueue with the given notifier
+template <typename TNotifier>
+void BM_PingPong(benchmark::State& state)
+{
+    static Link<TNotifier> link;
+    static Echo<TNotifier> echo(link);
+    static Initiator<TNotifier> initiator(link);
+
+    for (auto _ : state)
+    {
+        echo.init();
+        initiator.init();
+        echo.start();
+        initiator.start();
+        while (!initiator.done())
+        {
+            Os::Thread::delay(1);
+        }
+    }
+
+    auto& samples = initiator.Samples;
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](const double p)
+    {
+        return static_cast<double>(samples[static_cast<size_t>(p * (NumSamples - 1))]);
+    };
+    state.counters["p50_ns"] = percentile(0.50);
+    state.counters["p99_ns"] = percentile(0.99);
+    state.counters["p99.9_ns"] = percentile(0.999);
+    state.counters["syscalls/rtt"] = static_cast<double>(
+        link.Ping.syscalls() + link.Pong.syscalls()) / NumSamples;
+}
+
+BENCHMARK_TEMPLATE(BM_PingPong, Os::EventCount)->Iterations(1)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PingPong, etfw::msg::CountSemNotifier)->Iterations(1)->UseRealTime();
+
+}
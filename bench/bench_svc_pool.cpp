@@ -0,0 +1,142 @@
+#include <benchmark/benchmark.h>
+
+#include <etfw/msg/Router.hpp>
+#include <etfw/svcs/App.hpp>
+#include <etfw/svcs/SvcCfg.hpp>
+#include <etfw/svcs/SvcPool.hpp>
+
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+
+constexpr size_t NumApps = 64;
+/// Tokens passed around the ring at once
+constexpr size_t NumTokens = 8;
+constexpr uint32_t HopsPerToken = 50000;
+
+struct Token : public etl::message<1>
+{
+    uint32_t Hops;
+
+    Token(uint32_t hops): Hops(hops) {}
+};
+
+template <typename TRunnerCfg>
+struct HopCfg : public etfw::SvcCfg<60, TRunnerCfg>
+{
+    static constexpr const char* NAME = "HOP";
+};
+
+/// @brief Ring member. Passes each token on to the next app.
+template <typename TRunnerCfg>
+class Hop : public etfw::App<Hop<TRunnerCfg>, HopCfg<TRunnerCfg>>
+{
+    public:
+        using Base_t = etfw::App<Hop<TRunnerCfg>, HopCfg<TRunnerCfg>>;
+        using Status = typename Base_t::Status;
+        // A hop releases a token's copy only after passing the token on,
+        // so a preempted hop can hold one more copy than it has tokens
+        using Pipe_t = etfw::msg::QueuedRouter<Hop, 2 * NumTokens, Token>;
+
+        Hop():
+            Base_t(),
+            pipe_(*this),
+            sources_{&pipe_},
+            next_(nullptr)
+        {}
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 1);
+        }
+
+        void receive(const Token& token)
+        {
+            if (token.Hops > 0)
+            {
+                next_->pipe().receive(Token(token.Hops - 1));
+            }
+            else
+            {
+                Finished.fetch_add(1, std::memory_order_release);
+            }
+        }
+
+        inline void link(Hop& next) { next_ = &next; }
+        inline Pipe_t& pipe() { return pipe_; }
+
+        static std::atomic<size_t> Finished;
+
+    private:
+        Pipe_t pipe_;
+        etfw::msg::iEventSource* const sources_[1];
+        Hop* next_;
+};
+
+template <typename TRunnerCfg>
+std::atomic<size_t> Hop<TRunnerCfg>::Finished{0};
+
+inline long context_switches()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+/// @brief Token ring throughput of NumApps event-driven apps, each on
+///     the given runner
+template <typename TRunnerCfg>
+void BM_TokenRing(benchmark::State& state)
+{
+    using Hop_t = Hop<TRunnerCfg>;
+    static Hop_t ring[NumApps];
+
+    long switches = 0;
+    for (auto _ : state)
+    {
+        // Router queues take one producer. Queue the tokens before the
+        // ring starts so the hops are the only producers after that.
+        Hop_t::Finished = 0;
+        for (size_t i = 0; i < NumApps; i++)
+        {
+            ring[i].link(ring[(i + 1) % NumApps]);
+            ring[i].init();
+        }
+        for (size_t i = 0; i < NumTokens; i++)
+        {
+            ring[i * (NumApps / NumTokens)].pipe().receive(Token(HopsPerToken));
+        }
+
+        const long start = context_switches();
+        for (Hop_t& hop: ring)
+        {
+            hop.start();
+        }
+        while (Hop_t::Finished.load(std::memory_order_acquire) < NumTokens)
+        {
+            Os::Thread::delay(1);
+        }
+        switches += context_switches() - start;
+    }
+
+    for (Hop_t& hop: ring)
+    {
+        hop.stop();
+    }
+    const double hops = static_cast<double>(state.iterations()) * NumTokens * HopsPerToken;
+    state.counters["hops/s"] = benchmark::Counter(hops, benchmark::Counter::kIsRate);
+    state.counters["ctx_sw/hop"] = static_cast<double>(switches) / hops;
+}
+
+using ThreadPerApp = etfw::EventSvcCfg<0, 8192>;
+
+BENCHMARK_TEMPLATE(BM_TokenRing, ThreadPerApp)->Iterations(1)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_TokenRing, etfw::PooledSvcCfg)->Iterations(1)->UseRealTime();
+
+}
@@ -0,0 +1,79 @@
+#include <benchmark/benchmark.h>
+
+#include <etfw/svcs/SvcRegistry.hpp>
+#include <etl/vector.h>
+
+namespace
+{
+
+struct FakeSvc
+{
+    etfw::SvcId_t Id;
+
+    etfw::SvcId_t id() const { return Id; }
+};
+
+constexpr size_t NumSvcs = 128;
+
+/// Services with scattered IDs
+FakeSvc* make_svcs()
+{
+    static FakeSvc svcs[NumSvcs];
+    for (size_t i = 0; i < NumSvcs; i++)
+    {
+        svcs[i].Id = static_cast<etfw::SvcId_t>((i * 37) % 256);
+    }
+    return svcs;
+}
+
+/// @brief Lookup by scanning a vector, as the registries used to
+void BM_FindLinear(benchmark::State& state)
+{
+    static etl::vector<FakeSvc*, NumSvcs> svcs;
+    FakeSvc* storage = make_svcs();
+    svcs.clear();
+    for (size_t i = 0; i < NumSvcs; i++)
+    {
+        svcs.push_back(&storage[i]);
+    }
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        const etfw::SvcId_t id = storage[i++ % NumSvcs].Id;
+        FakeSvc* found = nullptr;
+        for (FakeSvc* svc: svcs)
+        {
+            if (svc->id() == id)
+            {
+                found = svc;
+                break;
+            }
+        }
+        benchmark::DoNotOptimize(found);
+    }
+}
+
+BENCHMARK(BM_FindLinear);
+
+/// @brief Lookup through the ID-indexed table
+void BM_FindIndexed(benchmark::State& state)
+{
+    static etfw::SvcTable<FakeSvc, NumSvcs> table;
+    FakeSvc* storage = make_svcs();
+    table.clear();
+    for (size_t i = 0; i < NumSvcs; i++)
+    {
+        table.insert(&storage[i]);
+    }
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(table.find(storage[i++ % NumSvcs].Id));
+    }
+}
+
+BENCHMARK(BM_FindIndexed);
+
+}
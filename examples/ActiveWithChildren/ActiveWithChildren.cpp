@@ -6,15 +6,15 @@
 
 static constexpr etfw::SvcId_t AppId = 1;
 static constexpr uint8_t AppPriority = 19;
-static constexpr size_t AppStackSz = 1024;
+static constexpr size_t AppStackSz = OS_THREAD_DEFAULT_STACK_SZ;
 
 static constexpr etfw::SvcId_t Child1Id = 1;
 static constexpr uint8_t Child1Priority = 22;
-static constexpr size_t Child1StackSz = 1024;
+static constexpr size_t Child1StackSz = OS_THREAD_DEFAULT_STACK_SZ;
 
 static constexpr etfw::SvcId_t Child2Id = 2;
 static constexpr uint8_t Child2Priority = 23;
-static constexpr size_t Child2StackSz = 1024;
+static constexpr size_t Child2StackSz = OS_THREAD_DEFAULT_STACK_SZ;
 
 
 struct AppCfg : public etfw::SvcCfg<AppId, etfw::ActiveSvcCfg<AppPriority, AppStackSz>>
@@ -78,7 +78,8 @@ class Child2 : public etfw::AppChild<Child2, Child2Cfg>
 
         Child2():
             Base_t(Child2Id, "CHILD_2"),
-            local_m_handler(*this)
+            local_m_handler(*this),
+            sources_{&local_m_handler}
         {}
 
         RunState run_loop()
@@ -87,6 +88,12 @@ class Child2 : public etfw::AppChild<Child2, Child2Cfg>
             return RunState::OK;
         }
 
+        /// @brief Lets a stop wake the blocked queue read
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 1);
+        }
+
         void receive(const LocalCmd& cmd)
         {
             log(etfw::LogLevel::INFO, "Got local command. Num = %d", cmd.Num);
@@ -99,6 +106,7 @@ class Child2 : public etfw::AppChild<Child2, Child2Cfg>
 
     private:
         etfw::msg::QueuedRouter<Child2, 2, LocalCmd> local_m_handler;
+        etfw::msg::iEventSource* const sources_[1];
 };
 
 class ExampleApp : public etfw::App<ExampleApp, AppCfg>
@@ -133,7 +141,8 @@ class ExampleApp : public etfw::App<ExampleApp, AppCfg>
 
         ExampleApp():
             Base_t(),
-            cmd_handler(*this)
+            cmd_handler(*this),
+            sources_{&cmd_handler}
         {}
 
         AppStatus app_init()
@@ -154,6 +163,12 @@ class ExampleApp : public etfw::App<ExampleApp, AppCfg>
             return RunState::OK;
         }
 
+        /// @brief Lets a stop wake the blocked queue read
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 1);
+        }
+
         AppStatus app_cleanup()
         {
             child1.cleanup();
@@ -195,6 +210,7 @@ class ExampleApp : public etfw::App<ExampleApp, AppCfg>
     private:
         etfw::msg::QueuedRouter<ExampleApp, 5,
             StartChildSvc, StopChildSvc, CommunicateWithChild> cmd_handler;
+        etfw::msg::iEventSource* const sources_[1];
         Child1 child1;
         Child2 child2;
 };
@@ -25,7 +25,8 @@ namespace app1
 
             App():
                 Base_t(),
-                cmd_pipe(*this)
+                cmd_pipe(*this),
+                sources_{&cmd_pipe}
             {}
 
             Status app_init()
@@ -47,6 +48,12 @@ namespace app1
                 return Status::Code::OK;
             }
 
+            /// @brief Lets a stop wake the blocked queue read
+            etfw::msg::EventSources_t event_sources() override
+            {
+                return etfw::msg::EventSources_t(sources_, 1);
+            }
+
             void receive(const msg::SayHello& cmd)
             {
                 log(etfw::LogLevel::INFO, "Hello!");
@@ -72,6 +79,7 @@ namespace app1
                 msg::SayHello,
                 msg::PrintThisString,
                 msg::ReturnResponse> cmd_pipe;
+            etfw::msg::iEventSource* const sources_[1];
             TlmHandler_t tlm_;
     };
 }
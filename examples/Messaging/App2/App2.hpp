@@ -13,6 +13,7 @@ namespace app2
         using Status = Base_t::Status;
         using RunState = Base_t::RunState;
         using WakeupPipe_t = etfw::msg::QueuedRouter<App, 1, WakeupMsg>;
+        using WakeupTimer_t = etfw::msg::PeriodicTimer<App>;
 
         static constexpr uint32_t WakeupTimeoutMs = 1500;
 
@@ -20,6 +21,9 @@ namespace app2
             Base_t(),
             fw_proxy_(*this),
             wakeup_pipe_(*this),
+            wakeup_timer_(*this, WakeupTimeoutMs),
+            sources_{&wakeup_pipe_, &wakeup_timer_},
+            woke_(false),
             msg_handler_(fw_proxy_)
         {}
 
@@ -29,16 +33,20 @@ namespace app2
             return Status::Code::OK;
         }
 
-        RunState run_loop()
+        /// @brief Runner sleeps on the wakeup pipe and the wakeup watchdog
+        etfw::msg::EventSources_t event_sources() override
         {
-            WakeupPipe_t::DequeueStat stat = wakeup_pipe_.receive_msgs(
-                WakeupTimeoutMs);
-            if (stat == WakeupPipe_t::DequeueStat::TIMEOUT)
+            return etfw::msg::EventSources_t(sources_, 2);
+        }
+
+        /// @brief Wakeup watchdog. Warns if no wakeup arrived last period.
+        void on_timer(const WakeupTimer_t& timer)
+        {
+            if (!woke_)
             {
                 log(etfw::LogLevel::WARNING, "Wakeup timeout");
             }
-            
-            return RunState::OK;
+            woke_ = false;
         }
 
         Status app_cleanup()
@@ -51,12 +59,16 @@ namespace app2
         void receive(const WakeupMsg& wakeup)
         {
             log(etfw::LogLevel::DEBUG, "Woke up");
+            woke_ = true;
             msg_handler_.process_commands();
         }
 
     private:
         AppFwProxy fw_proxy_;
         WakeupPipe_t wakeup_pipe_;
+        WakeupTimer_t wakeup_timer_;
+        etfw::msg::iEventSource* const sources_[2];
+        bool woke_;
         MsgHandler msg_handler_;
     };
 }
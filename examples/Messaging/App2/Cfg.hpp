@@ -9,8 +9,11 @@ namespace app2
 
     constexpr size_t CmdPipeDepth = 5;
 
-    struct Cfg : public ActiveAppCfg_t<AppId>
+    struct Cfg : public EventAppCfg_t<AppId>
     {
         static constexpr const char* NAME = "EX_APP_2";
+
+        /// Woken every cycle, so its DEBUG logging stays out of the build
+        static constexpr etfw::LogLevel LOG_LEVEL = etfw::LogLevel::INFO;
     };
 }
@@ -7,7 +7,7 @@
 
 namespace app2
 {
-    struct ChildCfg : public etfw::ChildSvcCfg<22, 1024>
+    struct ChildCfg : public etfw::ChildSvcCfg<22, 8192>
     {};
 
     class Child : public etfw::AppChild<Child, ChildCfg>
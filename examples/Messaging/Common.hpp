@@ -4,7 +4,11 @@
 #include "etfw/svcs/App.hpp"
 
 static constexpr uint8_t AppPriority = 19;
-static constexpr size_t AppStackSz = 1024;
+static constexpr size_t AppStackSz = OS_THREAD_DEFAULT_STACK_SZ;
 
 template <etfw::SvcId_t TAppId>
 using ActiveAppCfg_t = etfw::SvcCfg<TAppId, etfw::ActiveSvcCfg<AppPriority, AppStackSz>>;
+
+/// @brief Apps that only react to messages/timers. Task sleeps when idle.
+template <etfw::SvcId_t TAppId>
+using EventAppCfg_t = etfw::SvcCfg<TAppId, etfw::EventSvcCfg<AppPriority, AppStackSz>>;
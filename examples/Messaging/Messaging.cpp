@@ -18,7 +18,7 @@
 #include "App2/App2.hpp"
 #include "StatsMon/App.hpp"
 
-#include "MsgScheduler.hpp"
+#include <etfw/svcs/sched/SchedApp.hpp>
 
 #include <etfw/msg/Pool.hpp>
 
@@ -41,6 +41,14 @@ stats_mon::MsgTbl StatsMonMsgTbl{
     stats_mon::MsgTbl::Entry(app2::SpecialStatsMsg::ID),
 };
 
+// ~~~~~~~~~~~~~~~ Scheduler configuration ~~~~~~~~~~~~~~~
+
+static constexpr etfw::SvcId_t SchedId = 6;
+
+/// @brief 100 ms minor frames, 6 s major frame
+using SchedCfg = etfw::sched::SchedAppCfg<SchedId, 100000, 60>;
+using SchedApp = etfw::sched::SchedApp<SchedCfg>;
+
 #define APP2_WAKEUP         15   // 1.5 s
 #define STATS_MON_WAKEUP    2    // 200 ms
 
@@ -51,32 +59,31 @@ int main()
     app1::App app1;
     app2::App app2;
     stats_mon::App stats_mon_app(StatsMonMsgTbl);
-    MsgScheduler msg_scheduler{
-        {app2::WakeupMsg::ID, APP2_WAKEUP},
-        {stats_mon::WakeupMsg::ID, STATS_MON_WAKEUP},
-        {etfw::msg::telemetry_request<app1::AppId, app1::msg::GeneralStatsCode>::ID, APP1_GEN_STATS_PERIOD}
-        //MsgScheduler::Entry(etfw::msg::telemetry_request<app1::AppId, app1::msg::GeneralStatsCode>)
-    };
+    SchedApp::Tbl_t sched_tbl;
+    sched_tbl.add_periodic(app2::WakeupMsg::ID, APP2_WAKEUP);
+    sched_tbl.add_periodic(stats_mon::WakeupMsg::ID, STATS_MON_WAKEUP);
+    sched_tbl.add_periodic(etfw::msg::telemetry_request<app1::AppId,
+        app1::msg::GeneralStatsCode>::ID, APP1_GEN_STATS_PERIOD);
+    SchedApp sched_app(sched_tbl);
 
     printf("App1 init status: %s\n", app1.init().str());
     printf("App2 init status: %s\n", app2.init().str());
     printf("Stats mon app init status: %s\n", stats_mon_app.init().str());
+    printf("Scheduler init status: %s\n", sched_app.init().str());
 
     app1.start();
     app2.start();
     stats_mon_app.start();
+    sched_app.start();
 
-    int iters = 0;
+    usleep(3000000);
+    printf("\n\nUpdating tbl\n\n");
+    StatsMonMsgTbl.add_id(1);
 
     while (true)
     {
-        msg_scheduler.run();
-        iters++;
-        if (iters == 30)
-        {
-            printf("\n\nUpdating tbl\n\n");
-            StatsMonMsgTbl.add_id(1);
-        }
+        usleep(10000000);
+        sched_app.log_stats();
     }
 
     return 0;
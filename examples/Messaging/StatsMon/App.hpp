@@ -7,11 +7,6 @@
 
 namespace stats_mon
 {
-    struct Cfg : public ActiveAppCfg_t<AppId>
-    {
-        static constexpr const char* NAME = "STATS_MON";
-    };
-
     class App : public etfw::App<App, Cfg>
     {
     public:
@@ -19,6 +14,7 @@ namespace stats_mon
         using Base_t::Status;
         using Base_t::RunState;
         using WakeupPipe_t = etfw::msg::QueuedRouter<App, 1, WakeupMsg>;
+        using WakeupTimer_t = etfw::msg::PeriodicTimer<App>;
 
         static constexpr uint32_t WakeupTimeoutMs = 1500;
 
@@ -26,7 +22,10 @@ namespace stats_mon
             Base_t(),
             fw_proxy_(*this),
             stats_msg_handler_(fw_proxy_),
-            wakeup_pipe_(*this)
+            wakeup_pipe_(*this),
+            wakeup_timer_(*this, WakeupTimeoutMs),
+            sources_{&wakeup_pipe_, &wakeup_timer_},
+            woke_(false)
         {
             msg_tbl.add_observer(stats_msg_handler_);
         }
@@ -37,16 +36,20 @@ namespace stats_mon
             return Status::Code::OK;
         }
 
-        RunState run_loop()
+        /// @brief Runner sleeps on the wakeup pipe and the wakeup watchdog
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 2);
+        }
+
+        /// @brief Wakeup watchdog. Warns if no wakeup arrived last period.
+        void on_timer(const WakeupTimer_t& timer)
         {
-            WakeupPipe_t::DequeueStat stat = wakeup_pipe_.receive_msgs(
-                WakeupTimeoutMs
-            );
-            if (stat == WakeupPipe_t::DequeueStat::TIMEOUT)
+            if (!woke_)
             {
                 log(etfw::LogLevel::WARNING, "Wakeup timeout");
             }
-            return RunState::OK;
+            woke_ = false;
         }
 
         Status app_cleanup()
@@ -57,6 +60,7 @@ namespace stats_mon
         void receive(const WakeupMsg& wakeup)
         {
             log(etfw::LogLevel::DEBUG, "Woke up");
+            woke_ = true;
             stats_msg_handler_.process_stats_messages();
         }
 
@@ -64,5 +68,8 @@ namespace stats_mon
         AppFwProxy fw_proxy_;
         StatsHandler stats_msg_handler_;
         WakeupPipe_t wakeup_pipe_;
+        WakeupTimer_t wakeup_timer_;
+        etfw::msg::iEventSource* const sources_[2];
+        bool woke_;
     };
 }
@@ -8,4 +8,12 @@ namespace stats_mon
     constexpr etfw::SvcId_t AppId = 5;
     constexpr size_t CmdPipeDepth = 5;
     constexpr size_t StatsPipeDepth = 20;
+
+    struct Cfg : public EventAppCfg_t<AppId>
+    {
+        static constexpr const char* NAME = "STATS_MON";
+
+        /// Woken every cycle, so its DEBUG logging stays out of the build
+        static constexpr etfw::LogLevel LOG_LEVEL = etfw::LogLevel::INFO;
+    };
 }
@@ -8,11 +8,11 @@ static constexpr etfw::SvcId_t AppId = 1;
 
 static constexpr etfw::SvcId_t Child1Id = 1;
 static constexpr uint8_t Child1Priority = 22;
-static constexpr size_t Child1StackSz = 1024;
+static constexpr size_t Child1StackSz = OS_THREAD_DEFAULT_STACK_SZ;
 
 static constexpr etfw::SvcId_t Child2Id = 2;
 static constexpr uint8_t Child2Priority = 23;
-static constexpr size_t Child2StackSz = 1024;
+static constexpr size_t Child2StackSz = OS_THREAD_DEFAULT_STACK_SZ;
 
 /// @brief Passive application configuration
 struct AppCfg : public etfw::SvcCfg<AppId, etfw::PassiveSvcCfg>
@@ -3,11 +3,11 @@
 
 static constexpr etfw::SvcId_t App2Id = 2;
 static constexpr uint8_t App2Prior = 10;
-static constexpr size_t App2StackSz = 1024;
+static constexpr size_t App2StackSz = OS_THREAD_DEFAULT_STACK_SZ;
 
 static constexpr etfw::SvcId_t App4Id = 4;
 static constexpr uint8_t App4Prior = 13;
-static constexpr size_t App4StackSz = 1024;
+static constexpr size_t App4StackSz = OS_THREAD_DEFAULT_STACK_SZ;
 
 static constexpr etfw::SvcId_t App5Id = 5;
 
@@ -13,7 +13,7 @@
 /// @brief ExecApp task stack size. Left configureable to
 ///        account for differences between platforms
 #ifndef EXEC_APP_STACK_SZ
-#define EXEC_APP_STACK_SZ   2048
+#define EXEC_APP_STACK_SZ   OS_THREAD_DEFAULT_STACK_SZ
 #endif
 
 namespace etfw {
@@ -1,79 +1,322 @@
-
 #pragma once
 
 #include <etl/queue_spsc_atomic.h>
+#include <etl/span.h>
+#include <atomic>
+#include "os/Clock.hpp"
 #include "os/CountSem.hpp"
+#include "os/EventCount.hpp"
+#include "os/Mutex.hpp"
+#include "os/Task.hpp"
 #include "etfw_assert.hpp"
 
+/// Maximum number of messages a queued router/pipe dequeues at once
+#ifndef MSG_QUEUE_DRAIN_BATCH
+#define MSG_QUEUE_DRAIN_BATCH       16
+#endif
+
 namespace etfw {
 namespace msg {
 
-template <typename T, size_t QDepth>
+/// @brief Calls a blocking queue makes around its consumer's sleep
+/// @details Lets whatever runs the consumer account for time spent waiting
+///     for input without msg depending on it. The service runners install
+///     ExecStats::BlockedHooks, so a blocked receive isn't a stall.
+struct WaitHooks
+{
+    void* (*Begin)();           //< Sleep starting. Returns End's argument.
+    void (*End)(void* ctx);     //< Sleep over
+};
+
+/// @brief Get the hooks called around every BlockingMsgQueue sleep
+/// @return Hooks. Nullptr for none.
+inline std::atomic<const WaitHooks*>& wait_hooks()
+{
+    static std::atomic<const WaitHooks*> hooks{nullptr};
+    return hooks;
+}
+
+/// @brief Queue wakeup built on a POSIX counting semaphore
+/// @details Same interface as Os::EventCount. The consumer flags that it is
+///     about to sleep and only the producer that clears the flag posts, so
+///     each sleep gets exactly one post. For targets without an event count.
+class CountSemNotifier
+{
+    public:
+        using Key_t = bool;
+
+        CountSemNotifier():
+            Waiting(false),
+            SysCalls(0)
+        {
+            ETFW_ASSERT(Sem.init() == Os::CountSem::Status::OP_OK,
+                "Failed to initialize notifier semaphore");
+        }
+
+        inline Key_t prepare_wait()
+        {
+            Waiting.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return true;
+        }
+
+        void cancel_wait(const Key_t key)
+        {
+            (void)key;
+            // If a producer already claimed the flag its post is in flight.
+            // Consume it so the next wait isn't woken by it.
+            if (!Waiting.exchange(false))
+            {
+                SysCalls.fetch_add(1, std::memory_order_relaxed);
+                while (Sem.take() != Os::CountSem::Status::OP_OK)
+                {
+                    Os::Thread::yield();
+                }
+            }
+        }
+
+        bool wait(const Key_t key, const Os::TimeMs_t t_ms)
+        {
+            SysCalls.fetch_add(1, std::memory_order_relaxed);
+            if (Sem.take(t_ms) == Os::CountSem::Status::OP_OK)
+            {
+                // The waking producer cleared the flag
+                return true;
+            }
+            cancel_wait(key);
+            return false;
+        }
+
+        inline void notify()
+        {
+            // Order the enqueue before the check. Pairs with prepare_wait.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (Waiting.load(std::memory_order_relaxed) && Waiting.exchange(false))
+            {
+                SysCalls.fetch_add(1, std::memory_order_relaxed);
+                Sem.give();
+            }
+        }
+
+        inline size_t syscalls() const { return SysCalls.load(std::memory_order_relaxed); }
+
+    private:
+        Os::CountSem Sem;
+        std::atomic<bool> Waiting;      //< Consumer is asleep or about to sleep
+        std::atomic<size_t> SysCalls;   //< Semaphore give/take calls
+};
+
+/// @brief Multi producer, single consumer queue with a blocking consumer
+/// @details Producers serialize on a lock held only to write the ring, so
+///     any number of threads can queue. The consumer takes no lock. The
+///     notifier only puts the consumer to sleep and wakes it, it
+///     doesn't count items. A consumer that finds items in the ring takes
+///     them without a syscall, and a producer only makes a wake syscall if
+///     the consumer is asleep. Draining a burst of N messages therefore
+///     costs at most one sleep and one wake, not N of each.
+/// @tparam T Item type
+/// @tparam QDepth Maximum number of queued items
+/// @tparam TNotifier Wakeup mechanism. Os::EventCount or CountSemNotifier.
+template <typename T, size_t QDepth, typename TNotifier = Os::EventCount>
 class BlockingMsgQueue
 {
     static_assert(QDepth <= 255, "Max Q Depth exceeded");
 
     public:
-        /// @brief Default constructor
-        /// @details Will attempt to initialize internal semaphore
+        using Notifier_t = TNotifier;
+
         BlockingMsgQueue()
         {
-            ETFW_ASSERT(Sem.init() == Os::CountSem::Status::OP_OK,
-                "Failed to initialize queue semaphore");
+            const auto stat = ProducerLock.init();
+            ETFW_ASSERT(stat.success(), "Failed to initialize queue producer lock");
+            (void)stat;
         }
 
         template <typename ... Args>
         bool emplace(Args && ... args)
         {
-            if(_queue.emplace(args...))
+            ProducerLock.lock();
+            const bool queued = _queue.emplace(etl::forward<Args>(args)...);
+            ProducerLock.unlock();
+            if (queued)
             {
-                Sem.give();
-                return true;
+                notify();
             }
-            // Queue full
-            return false;
+            // False if the queue is full
+            return queued;
         }
 
         bool push(T& item)
         {
-            if (_queue.push(item))
+            ProducerLock.lock();
+            const bool queued = _queue.push(item);
+            ProducerLock.unlock();
+            if (queued)
             {
-                Sem.give();
-                return true;
+                notify();
             }
-            return false;
+            return queued;
         }
 
-        bool front(T& value)
+        /// @brief Move several items into the queue, waking the consumer once
+        /// @param items Items to queue. Queued items are moved from.
+        /// @return Number of items queued. Less than items.size() if the
+        ///     queue filled up.
+        size_t push_batch(etl::span<T> items)
         {
-            if (Sem.take() == Os::CountSem::Status::OP_OK)
+            size_t count = 0;
+            ProducerLock.lock();
+            while (count < items.size() && _queue.emplace(etl::move(items[count])))
             {
-                bool result = _queue.front(value);
-                ETFW_ASSERT(result, "Sem available but queue is empty");
-                _queue.pop();
-                return result;
+                count++;
             }
-            return false;
+            ProducerLock.unlock();
+            if (count > 0)
+            {
+                notify();
+            }
+            return count;
         }
 
+        /// @brief Take the next item without waiting
+        /// @param value Dequeued item
+        /// @return True if an item was dequeued
+        bool front(T& value)
+        {
+            return _queue.pop(value);
+        }
+
+        /// @brief Take the next item, waiting if the queue is empty
+        /// @param value Dequeued item
+        /// @param timeout_ms Time to wait for an item
+        /// @return True if an item was dequeued
         bool front(T& value, const Os::TimeMs_t timeout_ms)
         {
-            if (Sem.take(timeout_ms) == Os::CountSem::Status::OP_OK)
+            return drain(etl::span<T>(&value, 1), timeout_ms) == 1;
+        }
+
+        /// @brief Take every available item, up to items.size()
+        /// @details Waits only if the queue is empty
+        /// @param items Dequeued items
+        /// @param timeout_ms Time to wait for the first item
+        /// @return Number of items dequeued. 0 on timeout.
+        size_t drain(etl::span<T> items, const Os::TimeMs_t timeout_ms)
+        {
+            size_t count = read(items);
+            if (count == 0 && timeout_ms > 0 && !items.empty() && wait(timeout_ms))
             {
-                bool result = _queue.front(value);
-                ETFW_ASSERT(result, "Sem available but queue is empty");
-                _queue.pop();
-                return result;
+                count = read(items);
             }
-            return false;
+            return count;
         }
 
         inline bool full() const { return _queue.full(); }
 
+        inline bool empty() const { return _queue.empty(); }
+
+        /// @brief Make the consumer's current or next wait return early,
+        ///     empty-handed. A wake with nobody waiting is kept until the
+        ///     next wait, so it can't be lost to a consumer on its way to
+        ///     sleep.
+        inline void wake()
+        {
+            Woken.store(true);
+            Event.notify();
+        }
+
+        /// @brief Drop a wake no wait has seen, e.g. one left by a stop
+        ///     when the consumer wasn't receiving
+        inline void clear_wake() { Woken.store(false); }
+
+        /// @brief Get the number of sleep/wake syscalls made by this queue
+        inline size_t syscalls() const { return Event.syscalls(); }
+
+        /// @brief Also notify another event whenever an item is queued
+        /// @details Lets one thread sleep on several queues at once. The
+        ///     listener's waiter must check the queue after prepare_wait.
+        /// @param listener Event to notify. Nullptr to detach.
+        inline void attach(Os::EventCount* listener) { Listener.store(listener); }
+
     private:
-        Os::CountSem Sem;
-        etl::queue_spsc_atomic<T, 
+        TNotifier Event;
+        Os::Mutex ProducerLock;             //< Serializes writes to the ring
+        std::atomic<Os::EventCount*> Listener{nullptr};
+        std::atomic<bool> Woken{false};     //< Wake not yet seen by a wait
+        etl::queue_spsc_atomic<T,
             QDepth, etl::memory_model::MEMORY_MODEL_SMALL> _queue;
+
+        inline void notify()
+        {
+            Event.notify();
+            // Seq cst pairs with the store in attach
+            Os::EventCount* listener = Listener.load();
+            if (listener != nullptr)
+            {
+                listener->notify();
+            }
+        }
+
+        size_t read(etl::span<T> items)
+        {
+            size_t count = 0;
+            while (count < items.size() && _queue.pop(items[count]))
+            {
+                count++;
+            }
+            return count;
+        }
+
+        /// @brief Sleep until an item is queued
+        /// @details A notify for items already read can end a sleep with
+        ///     the queue empty, so sleeps again for what is left of the
+        ///     timeout.
+        /// @param timeout_ms Time to wait
+        /// @return True if the queue has items
+        bool wait(const Os::TimeMs_t timeout_ms)
+        {
+            const Os::TimeNs_t deadline_ns = Os::Clock::now_ns() +
+                (static_cast<Os::TimeNs_t>(timeout_ms) * Os::NsPerMs);
+            Os::TimeMs_t remaining_ms = timeout_ms;
+            while (true)
+            {
+                const auto key = Event.prepare_wait();
+                if (!_queue.empty())
+                {
+                    Event.cancel_wait(key);
+                    return true;
+                }
+                // Seq cst pairs with the store in wake
+                if (Woken.exchange(false))
+                {
+                    Event.cancel_wait(key);
+                    return false;
+                }
+                const WaitHooks* hooks = wait_hooks().load(std::memory_order_acquire);
+                void* const ctx = (hooks != nullptr) ? hooks->Begin() : nullptr;
+                Event.wait(key, remaining_ms);
+                if (hooks != nullptr)
+                {
+                    hooks->End(ctx);
+                }
+                // Consume only the wake that ended this wait, if any. A wake
+                // landing after it is kept for the next wait.
+                if (Woken.exchange(false))
+                {
+                    return false;
+                }
+                if (!_queue.empty())
+                {
+                    return true;
+                }
+                const Os::TimeNs_t now_ns = Os::Clock::now_ns();
+                if (now_ns >= deadline_ns)
+                {
+                    return false;
+                }
+                remaining_ms = static_cast<Os::TimeMs_t>(
+                    (deadline_ns - now_ns + Os::NsPerMs - 1) / Os::NsPerMs);
+            }
+        }
 };
 
 }
@@ -3,12 +3,28 @@
 
 #include <etl/message_broker.h>
 #include "Message.hpp"
+#include "MsgIdSet.hpp"
 #include "Pool.hpp"
 #include "Pipe.hpp"
+#include "SubscriberIndex.hpp"
 #include <os/Mutex.hpp>
+#include <atomic>
 
-#ifndef MSG_MAX_NUM_SUBSCRIPTIONS
-#define MSG_MAX_NUM_SUBSCRIPTIONS   64
+/// Maximum number of pipes/routers subscribed to a single broker
+#ifndef MSG_BROKER_MAX_PIPES
+#define MSG_BROKER_MAX_PIPES        256
+#endif
+
+/// Maximum number of distinct message IDs subscribed to on a single broker
+#ifndef MSG_BROKER_MAX_MSG_IDS
+#define MSG_BROKER_MAX_MSG_IDS      256
+#endif
+
+/// Number of subscription table snapshots per broker. Must be at least 3 for
+/// handlers to change subscriptions while a message is being routed, plus
+/// one for each further thread whose handlers may change them at once.
+#ifndef MSG_BROKER_NUM_SNAPSHOTS
+#define MSG_BROKER_NUM_SNAPSHOTS    3
 #endif
 
 namespace etfw::msg {
@@ -16,14 +32,14 @@ namespace etfw::msg {
     /// @brief Message type identifier
     using MsgId = etl::message_id_t;
 
-    /// @brief List of message IDs. TODO: needs to be static type
-    using MsgIdContainer = std::vector<MsgId>;
+    /// @brief Set of message IDs held by a subscription
+    using MsgIdContainer = MsgIdSet<MSG_MAX_NUM_SUBSCRIPTIONS>;
 
     /// @brief Broker subscription. Defines messages a router is subscribed to
-    class Subscription : public etl::message_broker::subscription
+    class Subscription : public iSubscription
     {
     public:
-        using Base_t = etl::message_broker::subscription;
+        using Base_t = iSubscription;
         using MsgSpan_t = etl::message_broker::message_id_span_t;
 
         /// @brief Construct a msg subscription with an initializer list
@@ -42,12 +58,25 @@ namespace etfw::msg {
         /// @param msg_ids Message IDs the router is subscribed to
         Subscription(
             etl::imessage_router& module,
-            MsgIdContainer &msg_ids
+            const MsgIdContainer &msg_ids
         ):
             Base_t(module),
             IdList(msg_ids)
         {}
 
+        /// @brief Construct a subscription from a compile-time ID set
+        /// @tparam ...TMsgs Message types in the set
+        /// @param module The router owning the subscription
+        /// @param msg_ids Message IDs the router is subscribed to
+        template <typename... TMsgs>
+        Subscription(
+            etl::imessage_router& module,
+            StaticMsgIdSet<TMsgs...> msg_ids
+        ):
+            Base_t(module),
+            IdList(msg_ids.data(), msg_ids.size())
+        {}
+
         /// @brief Construct empty subscription object
         /// @param pipe The pipe/router owning the subscription
         Subscription(
@@ -67,7 +96,7 @@ namespace etfw::msg {
         {
             static_assert((etl::is_base_of<iBaseMsg, TMsgs>::value && ...),
                 "Types must derive from iBaseMsg");
-            (IdList.emplace_back(static_cast<const iBaseMsg&>(TMsgs()).get_message_id()), ...);
+            (IdList.insert(static_cast<const iBaseMsg&>(TMsgs()).get_message_id()), ...);
         }
 
         template <typename... TMsgs>
@@ -79,7 +108,7 @@ namespace etfw::msg {
         {
             static_assert((etl::is_base_of<iBaseMsg, TMsgs>::value && ...),
                 "Types must derive from iBaseMsg");
-            (IdList.emplace_back(static_cast<const iBaseMsg&>(TMsgs()).get_message_id()), ...);
+            (IdList.insert(static_cast<const iBaseMsg&>(TMsgs()).get_message_id()), ...);
         }
 
         /// @brief Returns a view of the subscribed message IDs
@@ -89,60 +118,100 @@ namespace etfw::msg {
             return MsgSpan_t(IdList.begin(), IdList.end());
         }
 
+        /// @brief Add an ID to the subscription
+        /// @param id Message ID to subscribe to
+        /// @return True if subscribed. False if the subscription is full.
         bool subscribe(const MsgId id)
         {
-            IdList.push_back(id);
-            return true;
+            const size_t size = IdList.size();
+            const bool added = IdList.insert(id);
+            // Only a new ID changes the broker's index
+            if (IdList.size() != size)
+            {
+                notify_subscribe(id);
+            }
+            return added;
         }
 
+        /// @brief Remove an ID from the subscription
+        /// @param id Message ID to unsubscribe from
+        /// @return True if the ID was subscribed
         bool unsubscribe(const MsgId id)
         {
-            IdList.erase(std::remove(IdList.begin(), IdList.end(), id), IdList.end());
-            return true;
+            const bool removed = IdList.erase(id);
+            if (removed)
+            {
+                notify_unsubscribe(id);
+            }
+            return removed;
         }
 
-        bool is_subscribed(const MsgId id) const
+        inline bool is_subscribed(const MsgId id) const
         {
-            for (auto& id_: IdList)
-            {
-                if (id_ == id)
-                {
-                    return true;
-                }
-            }
-            return false;
+            return IdList.has(id);
         }
 
-        bool has(const MsgId id) const
+        inline bool has(const MsgId id) const
         {
-            for (auto& id_: IdList)
-            {
-                if (id_ == id)
-                {
-                    return true;
-                }
-            }
-            return false;
+            return IdList.has(id);
         }
 
+        /// @brief Get the subscribed message IDs
+        /// @return Sorted message ID set
+        inline const MsgIdContainer& ids() const { return IdList; }
+
     private:
-        /// TODO: replace with static container [MSG_MAX_NUM_SUBSCRIPTIONS]
         MsgIdContainer IdList;
     };
 
-    /// @brief Shared message alias
-    using SharedMsg = etl::shared_message;
-
     /// @brief Message broker class. Routes messages between pipes
-    class Broker : etl::message_broker
+    /// @details Subscriptions are indexed by message ID when they are
+    ///     registered, so routing a message costs the same no matter how
+    ///     many pipes or IDs are subscribed. Registered subscriptions
+    ///     notify the broker of later message ID changes.
+    ///
+    ///     The index is read-copy-update. Publishers route through the
+    ///     current snapshot without taking the broker lock. Subscription
+    ///     changes take the lock, copy the current snapshot into one no
+    ///     publisher is reading, edit the copy and swap it in. Removals
+    ///     then release the lock and wait for publishers still reading
+    ///     older snapshots, so a pipe will not be called once
+    ///     unregister_pipe returns (unless unregistered from a handler
+    ///     running on this broker). Those publishers' handlers may change
+    ///     subscriptions meanwhile.
+    ///
+    ///     Since publishers don't serialize, a synchronous pipe's handler
+    ///     runs on every publishing thread and can be called concurrently,
+    ///     and must be thread safe. Queued pipes and routers take messages
+    ///     from any number of publishers and hand them to one thread.
+    class Broker : etl::message_broker, iSubscriptionObserver
     {
     public:
         // Base class
         using Base_t = etl::message_broker;
 
+        /// @brief Message ID to subscriber index type
+        using Index_t = SubscriberIndex<MSG_BROKER_MAX_PIPES, MSG_BROKER_MAX_MSG_IDS>;
+
         /// TODO: un-expose these methods after refactor
-        using Base_t::receive;
-        using Base_t::subscribe;
+        /// @brief Route a message to its subscribers
+        /// @param msg Message to route
+        void receive(const etl::imessage& msg) override;
+
+        /// @brief Route a shared message to its subscribers
+        /// @param sm Message to route
+        void receive(etl::shared_message sm) override;
+
+        /// @brief Add or replace a router's subscription. The subscription
+        ///     reports later ID changes to this broker.
+        /// @note A subscription reports to the last broker it was
+        ///     subscribed to only
+        /// @param sub Subscription to add
+        void subscribe(iSubscription& sub);
+
+        /// @brief Remove a router's subscription
+        /// @param router Router to unsubscribe
+        void unsubscribe(etl::imessage_router& router);
 
         /// @brief Broker statistics
         struct Stats
@@ -243,8 +312,71 @@ namespace etfw::msg {
         void return_message_buf(Buf* buf);
 
     private:
-        MsgBufPool msg_pool_;
-        Os::Mutex lock_;
+        DefaultMsgBufPool msg_pool_;
+        Os::Mutex lock_;    //< Serializes subscription changes
         Stats stats_;
+        uint64_t gen_;      //< Last published snapshot generation. Locked.
+
+        /// @brief Subscription table snapshot
+        struct Snapshot
+        {
+            std::atomic<size_t> Readers;    //< Publishers routing through this snapshot
+            std::atomic<uint64_t> Gen;      //< Generation it was published as
+            Index_t Index;                  //< Subscription table
+
+            Snapshot(): Readers(0), Gen(0) {}
+        };
+
+        static_assert(MSG_BROKER_NUM_SNAPSHOTS >= 2,
+            "Broker needs at least two subscription snapshots");
+        Snapshot snapshots_[MSG_BROKER_NUM_SNAPSHOTS];
+        std::atomic<Snapshot*> current_;    //< Snapshot publishers route through
+
+        /// @brief Pin the current snapshot for reading
+        /// @return Pinned snapshot. Must be passed to release_snapshot.
+        Snapshot& acquire_snapshot();
+
+        /// @brief Unpin a snapshot
+        /// @param snap Snapshot returned by acquire_snapshot
+        void release_snapshot(Snapshot& snap);
+
+        /// @brief Apply a change to a copy of the subscription table and
+        ///     publish it. Must be called with the broker locked. May
+        ///     release the lock while every spare snapshot is being read.
+        /// @tparam TFunc Callable taking an Index_t& and returning a bool
+        /// @param func Change to apply
+        /// @param[out] gen Generation of the published snapshot
+        /// @return Result of func
+        template <typename TFunc>
+        bool update(TFunc&& func, uint64_t& gen);
+
+        /// @brief Grace period. Wait for publishers to release the
+        ///     snapshots published before a generation. Must be called
+        ///     with the broker unlocked: their handlers may take it.
+        /// @param gen Generation returned by update
+        void wait_readers(const uint64_t gen);
+
+        /// @brief Index a message ID added to a registered subscription
+        void on_subscribe(const etl::imessage_router& router,
+            const MsgId_t id) override;
+
+        /// @brief Drop a message ID removed from a registered subscription
+        void on_unsubscribe(const etl::imessage_router& router,
+            const MsgId_t id) override;
+
+        /// @brief Route a message through the current subscription snapshot
+        /// @tparam TMsg Message type. Either imessage or shared_message.
+        /// @param id Message ID
+        /// @param msg Message to route
+        template <typename TMsg>
+        void dispatch(const MsgId id, TMsg& msg)
+        {
+            Snapshot& snap = acquire_snapshot();
+            snap.Index.for_each(id, [&msg](etl::imessage_router& router)
+            {
+                router.receive(msg);
+            });
+            release_snapshot(snap);
+        }
     };
 }
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "os/Clock.hpp"
+#include "os/EventCount.hpp"
+#include <etl/span.h>
+
+namespace etfw {
+namespace msg {
+
+    /// @brief Input an event-driven runner can sleep on, e.g. a message
+    ///     queue or a timer
+    /// @details The runner attaches its event to each source, then loops:
+    ///     prepare a wait, dispatch every source, and sleep until the
+    ///     earliest deadline if no source had work. Sources notify the
+    ///     attached event when new work arrives.
+    class iEventSource
+    {
+        public:
+            virtual ~iEventSource() = default;
+
+            /// @brief Set the event to notify when work arrives
+            /// @param event Runner event. Nullptr to detach.
+            virtual void attach(Os::EventCount* event) = 0;
+
+            /// @brief Get the time the source next has work without a notify
+            /// @return Os::Clock time, or Os::TimeNsNever
+            virtual Os::TimeNs_t deadline_ns() const { return Os::TimeNsNever; }
+
+            /// @brief Handle pending work without blocking
+            /// @param now_ns Current Os::Clock time
+            /// @return True if any work was handled
+            virtual bool dispatch(const Os::TimeNs_t now_ns) = 0;
+
+            /// @brief Interrupt a receive blocked on the source, e.g. in
+            ///     process, so a stopping runner isn't held up by its
+            ///     timeout. Called by the runner's stop.
+            virtual void wake() {}
+
+            /// @brief Drop a wake the service never received, so it
+            ///     doesn't cut short the first receive after a restart.
+            ///     Called by the runner's start.
+            virtual void clear_wake() {}
+    };
+
+    /// @brief Periodic timer event source
+    /// @details Calls handler.on_timer(timer) every period, starting one
+    ///     period after the runner attaches. Periods missed because the
+    ///     runner was busy are skipped and counted rather than run late.
+    /// @tparam THandler Handler type
+    template <typename THandler>
+    class PeriodicTimer : public iEventSource
+    {
+        public:
+            PeriodicTimer(THandler& handler, const Os::TimeMs_t period_ms):
+                handler_(handler),
+                period_ns_(static_cast<Os::TimeNs_t>(period_ms) * Os::NsPerMs),
+                next_ns_(Os::TimeNsNever),
+                overruns_(0)
+            {}
+
+            void attach(Os::EventCount* event) override
+            {
+                next_ns_ = (event != nullptr) ?
+                    (Os::Clock::now_ns() + period_ns_) : Os::TimeNsNever;
+            }
+
+            Os::TimeNs_t deadline_ns() const override { return next_ns_; }
+
+            bool dispatch(const Os::TimeNs_t now_ns) override
+            {
+                if (now_ns < next_ns_)
+                {
+                    return false;
+                }
+
+                next_ns_ += period_ns_;
+                if (next_ns_ <= now_ns)
+                {
+                    const Os::TimeNs_t missed = ((now_ns - next_ns_) / period_ns_) + 1;
+                    overruns_ += static_cast<size_t>(missed);
+                    next_ns_ += missed * period_ns_;
+                }
+                handler_.on_timer(*this);
+                return true;
+            }
+
+            /// @brief Get the number of skipped periods
+            inline size_t overruns() const { return overruns_; }
+
+        private:
+            THandler& handler_;
+            const Os::TimeNs_t period_ns_;
+            Os::TimeNs_t next_ns_;      //< Next expiry. Runner thread only.
+            size_t overruns_;
+    };
+
+    /// @brief Event sources declared by a service
+    using EventSources_t = etl::span<iEventSource* const>;
+
+}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Vector kernel is picked from the target flags at build time. Define
+// MSG_ID_SCAN_SCALAR to force the portable loop.
+#if !defined(MSG_ID_SCAN_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define ETFW_MSG_ID_SCAN_AVX2
+#elif !defined(MSG_ID_SCAN_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define ETFW_MSG_ID_SCAN_SSE2
+#endif
+
+namespace etfw::msg
+{
+    /// @brief Name of the membership kernel selected at build time
+#if defined(ETFW_MSG_ID_SCAN_AVX2)
+    constexpr const char* IdScanImpl = "avx2";
+#elif defined(ETFW_MSG_ID_SCAN_SSE2)
+    constexpr const char* IdScanImpl = "sse2";
+#else
+    constexpr const char* IdScanImpl = "scalar";
+#endif
+
+    /// @brief Check if an ID is in a packed ID array, one ID at a time
+    /// @param ids Message IDs. Order does not matter.
+    /// @param sz Number of IDs
+    /// @param id Message ID to look for
+    /// @return True if id is in the array
+    inline bool id_scan_scalar(const uint32_t* ids, const size_t sz,
+        const uint32_t id)
+    {
+        for (size_t i = 0; i < sz; i++)
+        {
+            if (ids[i] == id)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Check if an ID is in a packed ID array
+    /// @details Compares 8 (AVX2) or 4 (SSE2) IDs per instruction. Fewer
+    ///     than 4 leftover IDs are checked with the scalar loop.
+    /// @param ids Message IDs. Order does not matter.
+    /// @param sz Number of IDs
+    /// @param id Message ID to look for
+    /// @return True if id is in the array
+    inline bool id_scan(const uint32_t* ids, const size_t sz, const uint32_t id)
+    {
+        size_t i = 0;
+#if defined(ETFW_MSG_ID_SCAN_AVX2)
+        const __m256i needle = _mm256_set1_epi32(static_cast<int>(id));
+        for (; (i + 16) <= sz; i += 16)
+        {
+            const __m256i lo = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(ids + i));
+            const __m256i hi = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(ids + i + 8));
+            const __m256i eq = _mm256_or_si256(
+                _mm256_cmpeq_epi32(lo, needle),
+                _mm256_cmpeq_epi32(hi, needle));
+            if (!_mm256_testz_si256(eq, eq))
+            {
+                return true;
+            }
+        }
+        if ((i + 8) <= sz)
+        {
+            const __m256i v = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(ids + i));
+            const __m256i eq = _mm256_cmpeq_epi32(v, needle);
+            if (!_mm256_testz_si256(eq, eq))
+            {
+                return true;
+            }
+            i += 8;
+        }
+#elif defined(ETFW_MSG_ID_SCAN_SSE2)
+        const __m128i needle = _mm_set1_epi32(static_cast<int>(id));
+        for (; (i + 8) <= sz; i += 8)
+        {
+            const __m128i lo = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(ids + i));
+            const __m128i hi = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(ids + i + 4));
+            const __m128i eq = _mm_or_si128(
+                _mm_cmpeq_epi32(lo, needle),
+                _mm_cmpeq_epi32(hi, needle));
+            if (_mm_movemask_epi8(eq) != 0)
+            {
+                return true;
+            }
+        }
+#endif
+#if defined(ETFW_MSG_ID_SCAN_AVX2) || defined(ETFW_MSG_ID_SCAN_SSE2)
+        if ((i + 4) <= sz)
+        {
+            const __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(ids + i));
+            const __m128i eq = _mm_cmpeq_epi32(v,
+                _mm_set1_epi32(static_cast<int>(id)));
+            if (_mm_movemask_epi8(eq) != 0)
+            {
+                return true;
+            }
+            i += 4;
+        }
+#endif
+        return id_scan_scalar(ids + i, sz - i, id);
+    }
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <etl/message.h>
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+#include "IdScan.hpp"
+#include "etfw_assert.hpp"
+
+/// Maximum number of message IDs held by a single subscription
+#ifndef MSG_MAX_NUM_SUBSCRIPTIONS
+#define MSG_MAX_NUM_SUBSCRIPTIONS   64
+#endif
+
+namespace etfw::msg
+{
+    /// @brief Find the first position in a sorted ID range not less than id
+    /// @param ids Sorted message IDs
+    /// @param sz Number of IDs
+    /// @param id Message ID to look for
+    /// @return Position of id, or where it would be inserted
+    constexpr size_t id_lower_bound(const etl::message_id_t* ids, const size_t sz,
+        const etl::message_id_t id)
+    {
+        size_t lo = 0;
+        size_t hi = sz;
+        while (lo < hi)
+        {
+            const size_t mid = lo + ((hi - lo) / 2);
+            if (ids[mid] < id)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    /// @brief Binary search a sorted ID range
+    /// @param ids Sorted message IDs
+    /// @param sz Number of IDs
+    /// @param id Message ID to look for
+    /// @return True if id is in the range
+    constexpr bool id_search(const etl::message_id_t* ids, const size_t sz,
+        const etl::message_id_t id)
+    {
+        const size_t pos = id_lower_bound(ids, sz, id);
+        return (pos < sz) && (ids[pos] == id);
+    }
+
+    /// @brief Fixed-capacity sorted set of message IDs
+    /// @details IDs are kept sorted in a contiguous array, so lookups are a
+    ///     binary search and the set never allocates.
+    /// @tparam VCapacity Maximum number of IDs
+    template <size_t VCapacity>
+    class MsgIdSet
+    {
+    public:
+        using Id_t = etl::message_id_t;
+        using const_iterator = const Id_t*;
+
+        static_assert(std::is_same<Id_t, uint32_t>::value,
+            "Membership check expects packed 32-bit message IDs");
+
+        /// @brief Maximum number of IDs in the set
+        static constexpr size_t Capacity = VCapacity;
+
+        /// @brief Construct an empty set
+        MsgIdSet():
+            ids_{},
+            size_(0)
+        {}
+
+        /// @brief Construct a set from a list of IDs. Duplicates are dropped.
+        /// @param ids Message IDs. Must fit within Capacity.
+        MsgIdSet(std::initializer_list<Id_t> ids):
+            MsgIdSet(ids.begin(), ids.size())
+        {}
+
+        /// @brief Construct a set from an ID array. Duplicates are dropped.
+        /// @param ids Message IDs. Need not be sorted.
+        /// @param sz Number of IDs. Must fit within Capacity.
+        MsgIdSet(const Id_t* ids, const size_t sz):
+            MsgIdSet()
+        {
+            for (size_t i = 0; i < sz; i++)
+            {
+                const bool added = insert(ids[i]);
+                ETFW_ASSERT(added,
+                    "Message ID set full. Increase MSG_MAX_NUM_SUBSCRIPTIONS");
+            }
+        }
+
+        /// @brief Add an ID
+        /// @param id Message ID
+        /// @return True if the ID is in the set. False if the set is full.
+        bool insert(const Id_t id)
+        {
+            const size_t pos = id_lower_bound(ids_, size_, id);
+            if (pos < size_ && ids_[pos] == id)
+            {
+                return true;
+            }
+            if (size_ == Capacity)
+            {
+                return false;
+            }
+            for (size_t i = size_; i > pos; i--)
+            {
+                ids_[i] = ids_[i - 1];
+            }
+            ids_[pos] = id;
+            size_++;
+            return true;
+        }
+
+        /// @brief Remove an ID
+        /// @param id Message ID
+        /// @return True if the ID was in the set
+        bool erase(const Id_t id)
+        {
+            const size_t pos = id_lower_bound(ids_, size_, id);
+            if (pos == size_ || ids_[pos] != id)
+            {
+                return false;
+            }
+            for (size_t i = pos + 1; i < size_; i++)
+            {
+                ids_[i - 1] = ids_[i];
+            }
+            size_--;
+            return true;
+        }
+
+        /// @brief Check if an ID is in the set
+        /// @details Vector scan of the packed IDs. For the set sizes a
+        ///     subscription holds this beats a branchy binary search.
+        /// @param id Message ID
+        /// @return True if present
+        inline bool has(const Id_t id) const
+        {
+            return id_scan(ids_, size_, id);
+        }
+
+        inline void clear() { size_ = 0; }
+
+        inline size_t size() const { return size_; }
+
+        inline bool empty() const { return size_ == 0; }
+
+        inline bool full() const { return size_ == Capacity; }
+
+        inline constexpr size_t capacity() const { return Capacity; }
+
+        inline const Id_t* data() const { return ids_; }
+
+        inline const_iterator begin() const { return ids_; }
+
+        inline const_iterator end() const { return ids_ + size_; }
+
+    private:
+        Id_t ids_[Capacity];
+        size_t size_;
+    };
+
+    /// @brief Fixed-size message ID array. Wrapped so it can be built and
+    ///     returned by constexpr functions.
+    /// @tparam VSize Number of IDs
+    template <size_t VSize>
+    struct MsgIdArray
+    {
+        etl::message_id_t Vals[(VSize > 0) ? VSize : 1];
+    };
+
+    /// @brief Sort a message ID array at compile time
+    /// @tparam VSize Number of IDs
+    /// @param ids IDs to sort
+    /// @return Sorted IDs
+    template <size_t VSize>
+    constexpr MsgIdArray<VSize> sort_ids(MsgIdArray<VSize> ids)
+    {
+        for (size_t i = 1; i < VSize; i++)
+        {
+            const etl::message_id_t id = ids.Vals[i];
+            size_t j = i;
+            while (j > 0 && ids.Vals[j - 1] > id)
+            {
+                ids.Vals[j] = ids.Vals[j - 1];
+                j--;
+            }
+            ids.Vals[j] = id;
+        }
+        return ids;
+    }
+
+    /// @brief Check a sorted message ID array has no duplicates
+    /// @tparam VSize Number of IDs
+    /// @param ids Sorted IDs
+    /// @return True if every ID is unique
+    template <size_t VSize>
+    constexpr bool unique_ids(const MsgIdArray<VSize>& ids)
+    {
+        for (size_t i = 1; i < VSize; i++)
+        {
+            if (ids.Vals[i] == ids.Vals[i - 1])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Compile-time sorted set of message IDs
+    /// @tparam ...TMsgs Message types. Each must have a static ID.
+    template <typename... TMsgs>
+    class StaticMsgIdSet
+    {
+    public:
+        using Id_t = etl::message_id_t;
+        using const_iterator = const Id_t*;
+
+        /// @brief Number of IDs in the set
+        static constexpr size_t Size = sizeof...(TMsgs);
+
+        /// @brief Sorted IDs
+        static constexpr MsgIdArray<Size> Ids =
+            sort_ids<Size>({ { static_cast<Id_t>(TMsgs::ID)... } });
+
+        static_assert(unique_ids(Ids), "Duplicate message IDs in static ID set");
+
+        /// @brief Check if an ID is in the set
+        /// @param id Message ID
+        /// @return True if present
+        static constexpr bool has(const Id_t id)
+        {
+            return id_search(Ids.Vals, Size, id);
+        }
+
+        static constexpr size_t size() { return Size; }
+
+        static constexpr const Id_t* data() { return Ids.Vals; }
+
+        static constexpr const_iterator begin() { return Ids.Vals; }
+
+        static constexpr const_iterator end() { return Ids.Vals + Size; }
+    };
+}
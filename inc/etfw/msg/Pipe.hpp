@@ -3,8 +3,12 @@
 
 #include "Subscription.hpp"
 #include "BlockingMsgQueue.hpp"
+#include "EventSource.hpp"
 #include "Pkt.hpp"
+#include "Pool.hpp"
 #include <etl/message_router.h>
+#include <algorithm>
+#include <atomic>
 
 namespace etfw::msg
 {
@@ -103,10 +107,23 @@ namespace etfw::msg
             subbed_msgs_(*this, TMsgs{}...)
         {}
 
+        /// @brief Construct pipe with custom ID and a compile-time msg
+        ///        subscription
+        /// @param id Pipe ID
+        /// @param msg_ids Message IDs to subscribe to
+        template <typename... TMsgs>
+        iPipe(PipeId_t id, StaticMsgIdSet<TMsgs...> msg_ids):
+            Base_t(id),
+            subbed_msgs_(*this, msg_ids)
+        {}
+
         /// @brief Subscribed messages
         Subscription_t subbed_msgs_;
     };
 
+    /// @brief Synchronous pipe. The handler runs on the publishing thread.
+    /// @details Broker publishers don't serialize, so the handler may be
+    ///          called from several threads at once.
     template <typename THandler>
     class Pipe : public iPipe
     {
@@ -132,33 +149,136 @@ namespace etfw::msg
             handler_.handle(msg);
         }
 
-    private:
+    protected:
+        /// @brief Construct pipe subscribed to a compile-time ID set
+        /// @param id Pipe ID
+        /// @param handler Message handler
+        /// @param msg_ids Message IDs to subscribe to
+        template <typename... TMsgs>
+        Pipe(PipeId_t id, THandler& handler, StaticMsgIdSet<TMsgs...> msg_ids):
+            Base_t(id, msg_ids),
+            handler_(handler)
+        {}
+
         THandler& handler_;
     };
 
-    /// @brief 
+    /// @brief Asynchronous pipe. Queues shared message handles for the
+    ///        handler's thread to process.
+    /// @details Messages routed by a Broker are held in a reference counted
+    ///          Buf. The pipe queues a handle to that buffer rather than a
+    ///          copy, so a message fanned out to several queued pipes is
+    ///          never copied and is returned to its pool once the last pipe
+    ///          has processed it. Messages not held in a shared buffer can't
+    ///          be queued by reference and are dropped.
     /// @tparam THandler The message handler class type 
     /// @tparam QueueDepth Maximum number of messages that can be queued
     ///         at one time.
     template <typename THandler, size_t QueueDepth>
-    class QueuedPipe : public Pipe<THandler>
+    class QueuedPipe : public Pipe<THandler>, public iEventSource
     {
     public:
-        using Base_t = iPipe;
+        using Base_t = Pipe<THandler>;
         using PipeId_t = typename Base_t::PipeId_t;
         using Base_t::accepts;
 
+        /// @brief Status of process_msgs. True if any message was processed.
+        using Stat = bool;
+
         QueuedPipe(THandler& handler):
-            Base_t(handler)
+            Base_t(handler),
+            dropped_(0)
         {}
 
         QueuedPipe(PipeId_t id, THandler& handler):
-            Base_t(id, handler)
+            Base_t(id, handler),
+            dropped_(0)
+        {}
+
+        /// @brief Queue a shared message
+        /// @param sm Shared message. Only the handle is queued.
+        void receive(etl::shared_message sm) override
+        {
+            if (accepts(sm.get_message()))
+            {
+                enqueue(etl::move(sm));
+            }
+        }
+
+        /// @brief Message sent without a shared buffer. Dropped.
+        /// @param msg Message
+        void receive(const etl::imessage& msg) override
+        {
+            if (accepts(msg))
+            {
+                drop();
+            }
+        }
+
+        /// @brief Process queued messages in the calling thread
+        /// @param t_ms Time to wait for the first message
+        /// @return True if any message was processed
+        Stat process_msgs(const uint32_t t_ms)
+        {
+            SharedMsg batch[BatchSz];
+            size_t count = queue_.drain(etl::span<SharedMsg>(batch, BatchSz), t_ms);
+            const Stat stat = (count > 0);
+            while (count > 0)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    this->handler_.handle(batch[i].get_message());
+                    batch[i] = SharedMsg();
+                }
+                count = queue_.drain(etl::span<SharedMsg>(batch, BatchSz), 0);
+            }
+            return stat;
+        }
+
+        void attach(Os::EventCount* event) override { queue_.attach(event); }
+
+        bool dispatch(const Os::TimeNs_t now_ns) override
+        {
+            (void)now_ns;
+            return process_msgs(0);
+        }
+
+        /// @brief Interrupt a blocked process_msgs
+        void wake() override { queue_.wake(); }
+
+        void clear_wake() override { queue_.clear_wake(); }
+
+        /// @brief Checks if the queue is full
+        inline bool full() const { return queue_.full(); }
+
+        /// @brief Get the number of accepted messages that were not queued
+        inline size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    protected:
+        template <typename... TMsgs>
+        QueuedPipe(PipeId_t id, THandler& handler, StaticMsgIdSet<TMsgs...> msg_ids):
+            Base_t(id, handler, msg_ids),
+            dropped_(0)
         {}
 
+        /// @brief Queue a message handle
+        /// @param sm Shared message. Released if the queue is full.
+        void enqueue(SharedMsg&& sm)
+        {
+            if (!queue_.emplace(etl::move(sm)))
+            {
+                drop();
+            }
+        }
+
+        inline void drop() { dropped_.fetch_add(1, std::memory_order_relaxed); }
+
     private:
-        /// TODO: change type to shared message
-        BlockingMsgQueue<void*, QueueDepth> queue_;
+        /// @brief Maximum number of messages dequeued at once
+        static constexpr size_t BatchSz = std::min<size_t>(QueueDepth, MSG_QUEUE_DRAIN_BATCH);
+
+        BlockingMsgQueue<SharedMsg, QueueDepth> queue_;
+        std::atomic<size_t> dropped_;   //< Accepted messages not queued
     };
 
     /// @brief Synchronous pipe with static message subscription.
@@ -169,83 +289,76 @@ namespace etfw::msg
     public:
         using Base_t = Pipe<THandler>;
         using PipeId_t = typename Base_t::PipeId_t;
+        using MsgIds_t = StaticMsgIdSet<TMsgs...>;
+        using Base_t::accepts;
         using Base_t::receive;
 
         StaticPipe(THandler& handler):
-            Base_t(handler)
+            Base_t(iPipe::DefaultPipeId, handler, MsgIds_t{})
         {}
 
         StaticPipe(PipeId_t id, THandler& handler):
-            Base_t(id, handler)
+            Base_t(id, handler, MsgIds_t{})
         {}
 
+        /// @brief Handle a subscribed message on the calling thread
+        /// @param msg Message
         void receive(const etl::imessage& msg) override
         {
-
+            if (accepts(msg))
+            {
+                this->handler_.handle(msg);
+            }
         }
-
-    private:
-        using This_t = StaticPipe<THandler, TMsgs...>;
     };
 
     /// @brief Queued pipe with static message subscription. Message
     ///        subscription is determined at compile time
-    /// @details The StaticQueuedPipe is used for receiving asynchronous messages
-    ///          copied directly into the pipe (i.e. no zero copy). This should
-    ///          be used for handling commands or status messages that will not
-    ///          change throughout the lifetime of the program that do not
-    ///          require high performance.
+    /// @details Shared messages are queued by reference like QueuedPipe.
+    ///          Messages sent without a shared buffer (e.g. a message
+    ///          object passed straight to receive) are copied into a buffer
+    ///          from the pipe's own pool first, so they can still be queued.
     template <typename THandler, size_t QueueDepth, typename... TMsgs>
     class StaticQueuedPipe : public QueuedPipe<THandler, QueueDepth>
     {
     public:
         using Base_t = QueuedPipe<THandler, QueueDepth>;
         using PipeId_t = typename Base_t::PipeId_t;
+        using MsgIds_t = StaticMsgIdSet<TMsgs...>;
         using Base_t::accepts;
+        using Base_t::receive;
 
         StaticQueuedPipe(THandler& handler):
-            Base_t(handler)
+            Base_t(iPipe::DefaultPipeId, handler, MsgIds_t{})
         {}
 
         StaticQueuedPipe(PipeId_t id, THandler& handler):
-            Base_t(id, handler)
+            Base_t(id, handler, MsgIds_t{})
         {}
 
+        /// @brief Copy a message into the pipe's pool and queue it
+        /// @param msg Message
         void receive(const etl::imessage& msg) override
         {
             if (accepts(msg))
             {
-                queue_.emplace(msg);
-            }
-        }
-
-        using Stat = bool;
-
-        Stat process_msgs(const uint32_t t_ms)
-        {
-            Stat stat = false;
-            message_packet pkt;
-            if (queue_.front(pkt, t_ms))
-            {
-                stat = true;
-                process_pkt(pkt);
-                while (queue_.front(pkt))
+                Buf* buf = copy_pool_.template allocate_copy<TMsgs...>(msg);
+                if (buf != nullptr)
                 {
-                    process_pkt(pkt);
+                    this->enqueue(SharedMsg(*buf));
+                }
+                else
+                {
+                    this->drop();
                 }
             }
-            return stat;
         }
 
     private:
-        using message_packet = etl::message_packet<TMsgs...>;
-        /// TODO: change type to shared message
-        BlockingMsgQueue<void*, QueueDepth> queue_;
+        /// @brief Largest message handled by the pipe
+        static constexpr size_t MaxMsgSz = std::max({sizeof(TMsgs)...});
 
-        inline void process_pkt(message_packet& pkt)
-        {
-            etl::imessage &msg = pkt.get();
-            Base_t::receive(msg);
-        }
+        /// @brief Holds copies of messages not sent in a shared buffer
+        StaticMsgBufPool<SizeClass<MaxMsgSz, QueueDepth>> copy_pool_;
     };
 }
@@ -138,5 +138,8 @@ namespace etfw::msg
         const size_t msg_sz_;
     };
 
+    /// @brief Shared message alias. Reference counted handle to a Buf.
+    using SharedMsg = etl::shared_message;
+
     
 }
@@ -5,32 +5,94 @@
 
 /// TODO: place in #ifdef guards to check if using stdlib
 #include <atomic>
+#include <cstddef>
 
 #include <os/Mutex.hpp>
 #include "Message.hpp"
 #include "Pkt.hpp"
 
+/// Number of blocks in the default pool's 64 byte size class
+#ifndef MSG_POOL_NUM_64B_BUFS
+#define MSG_POOL_NUM_64B_BUFS       40
+#endif
+
+/// Number of blocks in the default pool's 128 byte size class
+#ifndef MSG_POOL_NUM_128B_BUFS
+#define MSG_POOL_NUM_128B_BUFS      30
+#endif
+
+/// Number of blocks in the default pool's 256 byte size class
+#ifndef MSG_POOL_NUM_256B_BUFS
+#define MSG_POOL_NUM_256B_BUFS      20
+#endif
+
+/// Number of blocks in the default pool's 1024 byte size class
+#ifndef MSG_POOL_NUM_1024B_BUFS
+#define MSG_POOL_NUM_1024B_BUFS     10
+#endif
+
+/// Number of per-thread buffer caches in the default pool. 0 disables caching.
+#ifndef MSG_POOL_NUM_THREAD_CACHES
+#define MSG_POOL_NUM_THREAD_CACHES  0
+#endif
+
+/// Number of free blocks each thread cache holds per size class
+#ifndef MSG_POOL_MAGAZINE_SZ
+#define MSG_POOL_MAGAZINE_SZ        16
+#endif
+
+/// Number of cached pools a single thread can hold caches in at once
+#ifndef MSG_POOL_MAX_CACHED_POOLS
+#define MSG_POOL_MAX_CACHED_POOLS   4
+#endif
+
+/// Number of pools with thread caches that can exist at once. Pools past
+/// it run without caches.
+#ifndef MSG_POOL_MAX_CACHING_POOLS
+#define MSG_POOL_MAX_CACHING_POOLS  64
+#endif
+
 namespace etfw::msg
 {
     /// @brief Message buffer pool
+    /// @details The pool runs in one of two modes. In heap mode (constructed
+    ///     with an item limit only) every buffer is allocated from the global
+    ///     heap. In slab mode (see StaticMsgBufPool) buffers are served from
+    ///     fixed-size blocks reserved at construction and grouped into size
+    ///     classes, so allocation never calls malloc. Slab mode is lock-free:
+    ///     each size class keeps its free blocks on an index-based Treiber
+    ///     stack, so threads can allocate and release concurrently without
+    ///     taking the pool mutex. Heap mode still serializes on the mutex.
+    ///
+    ///     Slab pools can also keep per-thread caches (see CachedMsgBufPool).
+    ///     Each caching thread gets a magazine of free blocks per size class
+    ///     and refills or flushes it half a magazine at a time, so most
+    ///     allocations touch no shared cache lines.
     class MsgBufPool : public etl::ireference_counted_message_pool
     {
     public:
         using Buf_t = Buf;
 
+        /// @brief Statistics counter type. Updated from multiple threads.
+        using Counter_t = std::atomic<size_t>;
+
         /// @brief Message buffer pool statistics
         struct Stats
         {
             const size_t NumItems;  //< Number of items allocated in the pool
-            size_t ItemsInUse;      //< Items currently in use/unfreed
-            size_t WaterMark;       //< Highest number of items in use at once
-            size_t AllocCount;      //< Count of items successfully allocated
-            size_t ReleaseCount;    //< Count of items successfully released
+            Counter_t ItemsInUse;   //< Items currently in use/unfreed
+            Counter_t WaterMark;    //< Highest number of items in use at once
+            Counter_t AllocCount;   //< Count of items successfully allocated
+            Counter_t ReleaseCount; //< Count of items successfully released
 
             /// @brief Construct stats with NumItems set
             /// @param num_items Number of items in the pool
             Stats(size_t num_items);
 
+            /// @brief Copy constructor. Takes a snapshot of the counters.
+            /// @param other Stats to copy
+            Stats(const Stats& other);
+
             /// @brief Checks if any items are available to be allocated
             /// @return True if items can be allocated. False if the pool is
             ///     depleted.
@@ -53,11 +115,110 @@ namespace etfw::msg
             Stats operator--(int);
         };
 
+        /// @brief Free list link type. Holds the next free block index + 1,
+        ///     0 terminates the list.
+        using Link_t = std::atomic<uint32_t>;
+
+        /// @brief Slab of fixed-size blocks. One slab per size class.
+        /// @details Free blocks form a Treiber stack. The head packs an ABA
+        ///     tag (upper 32 bits) with the top block's index + 1 (lower 32
+        ///     bits). Links live outside the blocks so a stale pop never
+        ///     reads memory being written by a block's new owner.
+        struct Slab
+        {
+            uint8_t* const Mem;     //< Start of the slab's block storage
+            Link_t* const Links;    //< Free list links, one per block
+            const size_t MsgSz;     //< Largest message a block can hold
+            const size_t BlockSz;   //< Size of each block, Buf header included
+            std::atomic<uint64_t> FreeHead; //< Tagged free list head
+            Stats SlabStats;        //< Size class statistics
+
+            /// @brief Construct a slab over a pre-reserved memory region
+            /// @param mem Block storage. Must hold num_blocks * block size bytes
+            /// @param links Free list links. Must hold num_blocks entries.
+            /// @param msg_sz Largest message a block can hold
+            /// @param num_blocks Number of blocks in the slab
+            Slab(uint8_t* mem, Link_t* links, size_t msg_sz, size_t num_blocks);
+
+            /// @brief Pop a free block
+            /// @return Block. Nullptr if the slab is depleted.
+            void* pop();
+
+            /// @brief Push a block back onto the free list
+            /// @param block Block owned by this slab
+            void push(void* block);
+
+            /// @brief Checks if a buffer was carved out of this slab
+            /// @param buf Buffer to check
+            /// @return True if the buffer belongs to this slab
+            inline bool owns(const void* buf) const
+            {
+                const uint8_t* addr = static_cast<const uint8_t*>(buf);
+                return (addr >= Mem) &&
+                    (addr < (Mem + (BlockSz * SlabStats.NumItems)));
+            }
+        };
+
+        /// @brief Stack of free blocks from one size class, owned by a thread
+        struct Magazine
+        {
+            size_t Count;                         //< Number of cached blocks
+            void* Blocks[MSG_POOL_MAGAZINE_SZ];   //< Cached blocks, top last
+
+            Magazine(): Count(0), Blocks{} {}
+        };
+
+        /// @brief Per-thread cache. Claimed by a thread on its first
+        ///     allocation or release and kept until flush_thread_cache or
+        ///     the thread exits.
+        /// @details Counters are only written by the owning thread. Aligned
+        ///     to a cache line so neighbouring caches don't false-share.
+        struct alignas(64) ThreadCache
+        {
+            std::atomic<bool> Claimed;  //< Set while a thread owns the cache
+            Magazine* Mags;             //< One magazine per size class
+            Counter_t Hits;             //< Allocations served from a magazine
+            Counter_t Misses;           //< Allocations that went to the slabs
+            Counter_t Cached;           //< Blocks currently held in magazines
+
+            ThreadCache(): Claimed(false), Mags(nullptr), Hits(0), Misses(0), Cached(0) {}
+        };
+
+        /// @brief Thread cache statistics snapshot
+        struct CacheStats
+        {
+            size_t Hits;        //< Allocations served from a magazine
+            size_t Misses;      //< Allocations that went to the slabs
+            size_t Stranded;    //< Free blocks held in caches
+
+            /// @brief Calculates the cache hit rate
+            /// @return Ratio of allocations served from a magazine. 0 if
+            ///     nothing has been allocated.
+            inline float hit_rate() const
+            {
+                const size_t total = Hits + Misses;
+                return (total == 0) ? 0.0f :
+                    (static_cast<float>(Hits) / static_cast<float>(total));
+            }
+        };
+
+        /// @brief Calculates the block size required to hold a message
+        /// @param msg_sz Message size
+        /// @return Block size, Buf header included and padded to max alignment
+        static constexpr size_t block_size(const size_t msg_sz)
+        {
+            return (sizeof(Buf) + msg_sz + alignof(std::max_align_t) - 1) &
+                ~(alignof(std::max_align_t) - 1);
+        }
 
         /// TODO: need to construct with allocator or something, No max_items arg
         MsgBufPool();
         MsgBufPool(size_t max_items);
 
+        /// @brief Forgets the calling thread's cache of this pool. Caches
+        ///     held by other threads are not touched.
+        ~MsgBufPool();
+
         /// @brief Release from a reference counted message
         /// @param msg Message to release
         void release(const etl::ireference_counted_message& msg) override;
@@ -68,9 +229,51 @@ namespace etfw::msg
         void release(Buf* buf);
 
         /// @brief Get the pool statistics
+        /// @note Blocks held in thread caches count as in use. See
+        ///     items_in_use for the number held by users.
         /// @return Const reference to the pool statistics
         inline const Stats& stats() const { return stats_; }
 
+        /// @brief Get the number of items held by users, excluding free
+        ///     blocks stranded in thread caches
+        /// @return Number of items in use
+        size_t items_in_use() const;
+
+        /// @brief Get the number of per-thread caches
+        /// @return Number of caches. 0 if caching is disabled.
+        inline size_t num_thread_caches() const { return num_caches_; }
+
+        /// @brief Get the statistics of all thread caches combined
+        /// @return Cache statistics snapshot
+        CacheStats cache_stats() const;
+
+        /// @brief Get the statistics of a single thread cache
+        /// @param idx Cache index
+        /// @return Cache statistics snapshot. Zeroed if idx is invalid.
+        CacheStats thread_cache_stats(const size_t idx) const;
+
+        /// @brief Return the calling thread's cached blocks to the shared
+        ///     pool and give up its cache
+        /// @details Exiting threads do this for every pool they cache, so
+        ///     restarted runners find free caches. Call it to give a cache
+        ///     up early, e.g. from a thread done with the pool. The pool
+        ///     must not be destroyed while a caching thread is exiting.
+        void flush_thread_cache();
+
+        /// @brief Get the number of slabs/size classes
+        /// @return Number of size classes. 0 if running in heap mode.
+        inline size_t num_slabs() const { return num_slabs_; }
+
+        /// @brief Get the statistics of a single size class
+        /// @param idx Size class index. Size classes are sorted by size.
+        /// @return Size class statistics. Nullptr if idx is invalid.
+        const Stats* slab_stats(const size_t idx) const;
+
+        /// @brief Get the max message size of a size class
+        /// @param idx Size class index
+        /// @return Max message size. 0 if idx is invalid.
+        size_t slab_msg_size(const size_t idx) const;
+
         /// @brief Allocate and create message
         /// @tparam TMsg Message type
         /// @tparam ...TArgs TMsg constructor argument types
@@ -82,9 +285,7 @@ namespace etfw::msg
             Buf* ret = nullptr;
             const size_t total_sz = sizeof(Buf)+sizeof(TMsg);
 
-            lock();
             ret = static_cast<Buf*>(allocate_raw(total_sz, etl::alignment_of<Buf>::value));
-            unlock();
 
             if (ret != nullptr)
             {
@@ -105,9 +306,7 @@ namespace etfw::msg
             Buf* ret = nullptr;
             const size_t total_sz = sizeof(Buf)+sizeof(TMsg);
 
-            lock();
             ret = static_cast<Buf*>(allocate_raw(total_sz, etl::alignment_of<Buf>::value));
-            unlock();
 
             if (ret != nullptr)
             {
@@ -117,6 +316,22 @@ namespace etfw::msg
             return ret;
         }
 
+        /// @brief Allocate message buffer and copy a message whose type is
+        ///     only known at runtime
+        /// @tparam ...TMsgs Candidate message types, matched by ID
+        /// @param msg Message to copy
+        /// @return Allocated msg buffer. Nullptr if allocation failed or the
+        ///     message is none of TMsgs.
+        template <typename... TMsgs>
+        Buf* allocate_copy(const etl::imessage& msg)
+        {
+            const etl::message_id_t id = msg.get_message_id();
+            Buf* ret = nullptr;
+            (void)((id == TMsgs::ID &&
+                (ret = allocate<TMsgs>(static_cast<const TMsgs&>(msg)), true)) || ...);
+            return ret;
+        }
+
         /// @brief Allocate a raw message buf of bytes "sz".
         ///     User is responsible for copying the appropriate class
         ///     into the buffer. 
@@ -124,11 +339,77 @@ namespace etfw::msg
         /// @return Allocated msg buffer. Nullptr if allocation failed
         Buf* allocate(const size_t sz);
 
+    protected:
+        /// @brief Slab mode constructor. Used by StaticMsgBufPool.
+        /// @warning Slabs are not initialized until init_slabs is called
+        /// @param slabs Size class slabs, sorted by ascending block size
+        /// @param num_slabs Number of slabs
+        /// @param num_items Total number of blocks across all slabs
+        MsgBufPool(Slab* slabs, size_t num_slabs, size_t num_items);
+
+        /// @brief Builds each slab's free block list. Must be called once
+        ///     the slabs have been constructed, before the pool is shared.
+        void init_slabs();
+
+        /// @brief Enables per-thread caching. Must be called after
+        ///     init_slabs, before the pool is shared. Caching stays off
+        ///     if MSG_POOL_MAX_CACHING_POOLS pools already cache.
+        /// @param caches Thread caches
+        /// @param mags Magazines. Must hold num_caches * num_slabs entries.
+        /// @param num_caches Number of thread caches
+        void init_caches(ThreadCache* caches, Magazine* mags, size_t num_caches);
+
     private:
         Os::Mutex mut_;
         Stats stats_;
+        Slab* const slabs_;
+        const size_t num_slabs_;
+        ThreadCache* caches_;
+        size_t num_caches_;
+        uint32_t cache_id_;     //< Unique pool ID keying thread local lookups
+        uint32_t live_slot_;    //< Slot in the live caching pool table
+
+        /// @brief Get the calling thread's cache, claiming one on first use
+        /// @return Thread cache. Nullptr if caching is disabled or no cache
+        ///     is left for this thread.
+        ThreadCache* thread_cache();
+
+        /// @brief Pop a block from a slab's shared free list
+        /// @param slab Slab to allocate from
+        /// @return Block. Nullptr if the slab is depleted.
+        void* slab_pop(Slab& slab);
+
+        /// @brief Push a block back onto a slab's shared free list
+        /// @param slab Owning slab
+        /// @param block Block to free
+        void slab_push(Slab& slab, void* block);
+
+        /// @brief Pop a block from a thread cache, refilling its magazine
+        ///     from the slab when empty
+        /// @param cache Calling thread's cache
+        /// @param idx Size class index
+        /// @return Block. Nullptr if the size class is depleted.
+        void* cache_pop(ThreadCache& cache, const size_t idx);
+
+        /// @brief Push a block onto a thread cache, flushing half the
+        ///     magazine to the slab when full
+        /// @param cache Calling thread's cache
+        /// @param idx Size class index
+        /// @param block Block to free
+        void cache_push(ThreadCache& cache, const size_t idx, void* block);
+
+        /// @brief Find the slab owning a buffer
+        /// @param buf Buffer allocated from this pool
+        /// @return Owning slab. Nullptr if running in heap mode.
+        Slab* find_slab(const void* buf);
 
-        /// @brief Allocates the raw memory buffer
+        /// @brief Returns raw memory to the heap or its owning slab. Locks
+        ///     the pool in heap mode, lock-free in slab mode.
+        /// @param buf Buffer to free
+        void free_raw(void* buf);
+
+        /// @brief Allocates the raw memory buffer. Locks the pool in heap
+        ///     mode, lock-free in slab mode.
         /// @param[in] sz Size to allocate
         /// @param[in] alignment Buffer alignment
         /// @return Raw memory buffer. Null if pool is depleted
@@ -140,4 +421,140 @@ namespace etfw::msg
         /// @brief Unlock the pool. Must be called after allocation or release.
         void unlock() override;
     };
+
+    /// @brief Pool size class definition
+    /// @tparam VMsgSz Largest message size held by the size class
+    /// @tparam VNumBlocks Number of blocks reserved for the size class
+    template <size_t VMsgSz, size_t VNumBlocks>
+    struct SizeClass
+    {
+        static constexpr size_t MsgSz = VMsgSz;
+        static constexpr size_t NumBlocks = VNumBlocks;
+        static constexpr size_t BlockSz = MsgBufPool::block_size(VMsgSz);
+    };
+
+    /// @brief Slab-mode message buffer pool with statically reserved storage
+    /// @tparam ...TSizeClasses SizeClass types, sorted by ascending size.
+    ///     Allocations are served from the smallest size class with a free
+    ///     block large enough to hold the message.
+    template <typename... TSizeClasses>
+    class StaticMsgBufPool : public MsgBufPool
+    {
+        static_assert(sizeof...(TSizeClasses) > 0,
+            "Pool must have at least one size class");
+
+    public:
+        /// @brief Number of size classes
+        static constexpr size_t NumSlabs = sizeof...(TSizeClasses);
+
+        /// @brief Total number of blocks across all size classes
+        static constexpr size_t NumBlocks = (TSizeClasses::NumBlocks + ...);
+
+        /// @brief Total bytes reserved for blocks
+        static constexpr size_t StorageSz =
+            ((TSizeClasses::BlockSz * TSizeClasses::NumBlocks) + ...);
+
+        StaticMsgBufPool():
+            StaticMsgBufPool(etl::make_index_sequence<NumSlabs>{})
+        {}
+
+    private:
+        static constexpr size_t MsgSzs[NumSlabs] = { TSizeClasses::MsgSz... };
+        static constexpr size_t SlabSzs[NumSlabs] =
+            { (TSizeClasses::BlockSz * TSizeClasses::NumBlocks)... };
+        static constexpr size_t SlabNumBlocks[NumSlabs] =
+            { TSizeClasses::NumBlocks... };
+
+        static_assert(NumBlocks < UINT32_MAX,
+            "Too many blocks for 32-bit free list indices");
+
+        /// @brief Checks that size classes are sorted at compile time
+        static constexpr bool sorted()
+        {
+            for (size_t i = 1; i < NumSlabs; i++)
+            {
+                if (MsgSzs[i] <= MsgSzs[i-1])
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        static_assert(sorted(), "Size classes must be sorted by ascending size");
+
+        /// @brief Compile-time offset of a slab within the storage buffer
+        static constexpr size_t slab_offset(const size_t idx)
+        {
+            size_t offset = 0;
+            for (size_t i = 0; i < idx; i++)
+            {
+                offset += SlabSzs[i];
+            }
+            return offset;
+        }
+
+        /// @brief Compile-time offset of a slab's first free list link
+        static constexpr size_t link_offset(const size_t idx)
+        {
+            size_t offset = 0;
+            for (size_t i = 0; i < idx; i++)
+            {
+                offset += SlabNumBlocks[i];
+            }
+            return offset;
+        }
+
+        template <size_t... Idxs>
+        StaticMsgBufPool(etl::index_sequence<Idxs...>):
+            MsgBufPool(slabs_, NumSlabs, NumBlocks),
+            slabs_{ Slab(&storage_[slab_offset(Idxs)], &links_[link_offset(Idxs)],
+                MsgSzs[Idxs], SlabNumBlocks[Idxs])... }
+        {
+            init_slabs();
+        }
+
+        alignas(std::max_align_t) uint8_t storage_[StorageSz];
+        Link_t links_[NumBlocks];
+        Slab slabs_[NumSlabs];
+    };
+
+    /// @brief Slab-mode message buffer pool with per-thread caches
+    /// @details Up to VNumCaches threads get their own magazine of free
+    ///     blocks per size class. Further threads go straight to the slabs.
+    ///     Size classes should hold at least MSG_POOL_MAGAZINE_SZ blocks per
+    ///     caching thread, otherwise blocks stranded in one thread's cache
+    ///     can starve the others.
+    /// @tparam VNumCaches Number of thread caches
+    /// @tparam ...TSizeClasses SizeClass types, sorted by ascending size
+    template <size_t VNumCaches, typename... TSizeClasses>
+    class CachedMsgBufPool : public StaticMsgBufPool<TSizeClasses...>
+    {
+        static_assert(VNumCaches > 0, "Pool must have at least one cache");
+        using Base_t = StaticMsgBufPool<TSizeClasses...>;
+
+    public:
+        /// @brief Number of thread caches
+        static constexpr size_t NumCaches = VNumCaches;
+
+        CachedMsgBufPool()
+        {
+            this->init_caches(caches_, mags_, NumCaches);
+        }
+
+    private:
+        MsgBufPool::Magazine mags_[NumCaches * Base_t::NumSlabs];
+        MsgBufPool::ThreadCache caches_[NumCaches];
+    };
+
+    /// @brief Default pool used by the message broker
+#if MSG_POOL_NUM_THREAD_CACHES > 0
+    using DefaultMsgBufPool = CachedMsgBufPool<MSG_POOL_NUM_THREAD_CACHES,
+#else
+    using DefaultMsgBufPool = StaticMsgBufPool<
+#endif
+        SizeClass<64, MSG_POOL_NUM_64B_BUFS>,
+        SizeClass<128, MSG_POOL_NUM_128B_BUFS>,
+        SizeClass<256, MSG_POOL_NUM_256B_BUFS>,
+        SizeClass<1024, MSG_POOL_NUM_1024B_BUFS>
+    >;
 }
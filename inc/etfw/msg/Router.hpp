@@ -4,17 +4,21 @@
 #include <etl/message_router.h>
 #include "Broker.hpp"
 #include "BlockingMsgQueue.hpp"
+#include "EventSource.hpp"
 #include "Subscription.hpp"
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
 
 namespace etfw {
 namespace msg {
 
-    /// @brief Converts a type list of messages to a runtime message container
+    /// @brief Converts a type list of messages to a sorted message ID set
     /// @tparam ...TMsgs Message type list
-    /// @return Message container
+    /// @return Compile-time message ID set
     template <typename... TMsgs>
     constexpr auto to_msg_id_list() {
-        return MsgIdContainer{ TMsgs::ID... };
+        return StaticMsgIdSet<TMsgs...>{};
     }
 
     /// @brief Router/handler ID type
@@ -42,8 +46,7 @@ namespace msg {
         Router(THandler& component):
             Base_t(static_cast<etl::message_id_t>(component.ID)),
             Handler_(component),
-            IdList(to_msg_id_list<TMsgs...>()),
-            SubbedMsgs(*this, IdList)
+            SubbedMsgs(*this, to_msg_id_list<TMsgs...>())
         {}
 
         /// @brief Construct a router/pipe.
@@ -52,8 +55,7 @@ namespace msg {
         Router(THandler& component, RouterId_t rtr_id):
             Base_t(rtr_id),
             Handler_(component),
-            IdList(to_msg_id_list<TMsgs...>()),
-            SubbedMsgs(*this, IdList)
+            SubbedMsgs(*this, to_msg_id_list<TMsgs...>())
         {}
 
         /// @brief Get the router's subscribed messages
@@ -82,19 +84,39 @@ namespace msg {
     
     protected:
         THandler& Handler_;
-        MsgIdContainer IdList;
         Subscription SubbedMsgs;
     };
 
+    /// @brief Stands in for a queued router's copy pool when it has none
+    struct NoCopyPool
+    {
+        template <typename... TMsgs>
+        Buf* allocate_copy(const etl::imessage& msg)
+        {
+            (void)msg;
+            return nullptr;
+        }
+    };
+
     /**
      * @brief Queue-based message router/handler
+     * @details Messages routed by a Broker arrive in a reference counted
+     *  buffer and only the handle is queued, so fanning a message out to
+     *  several queued routers does not copy it. Messages passed straight to
+     *  receive are copied into a buffer from the router's own pool first,
+     *  if it has one. Messages that can't be copied or queued are dropped
+     *  and counted (see dropped).
+     *  An event-driven runner can sleep on the queue (see iEventSource).
      * 
      * @tparam THandler Service/component type
      * @tparam TMsgLimit Message limit/queue depth
+     * @tparam TCopyLimit Copies of directly received messages held at
+     *  once. 0 for no copy pool, when every message comes from a Broker.
      * @tparam TMsgs Message types
      */
-    template <typename THandler, size_t TMsgLimit, typename... TMsgs>
-    class QueuedRouter : public Router<THandler, TMsgLimit, TMsgs...>
+    template <typename THandler, size_t TMsgLimit, size_t TCopyLimit, typename... TMsgs>
+    class BasicQueuedRouter : public Router<THandler, TMsgLimit, TMsgs...>,
+        public iEventSource
     {
     public:
         using Base_t = Router<THandler, TMsgLimit, TMsgs...>;
@@ -106,67 +128,128 @@ namespace msg {
             TIMEOUT = 1,
         };
 
-        QueuedRouter(THandler& component):
+        BasicQueuedRouter(THandler& component):
             Base_t(component),
-            Enabled(true) {}
+            Enabled(true),
+            dropped_(0) {}
 
         void receive(const etl::imessage& msg) override
         {
             if (accepts(msg))
             {
-                queue.emplace(msg);
-                // TODO: send events
+                Buf* buf = copy_pool_.template allocate_copy<TMsgs...>(msg);
+                if (buf != nullptr)
+                {
+                    enqueue(SharedMsg(*buf));
+                }
+                else
+                {
+                    drop();
+                }
             }
         }
 
-        void process_msg_queue(const uint32_t time_ms)
+        void receive(etl::shared_message sm) override
         {
-            message_packet pkt;
-            if (queue.front(pkt, time_ms))
+            if (accepts(sm.get_message()))
             {
-                process_pkt(pkt);
-                while (queue.front(pkt))
-                {
-                    process_pkt(pkt);
-                }
+                enqueue(etl::move(sm));
             }
         }
 
+        void process_msg_queue(const uint32_t time_ms)
+        {
+            receive_msgs(time_ms);
+        }
+
+        /// @brief Process every queued message, waiting for the first one
+        /// @details Messages are dequeued in batches of up to BatchSz
+        /// @param time_ms Time to wait for a message
+        /// @return OK if any message was processed, TIMEOUT otherwise
         DequeueStat receive_msgs(const uint32_t time_ms)
         {
             DequeueStat status = DequeueStat::TIMEOUT;
-            message_packet pkt;
-            if (queue.front(pkt, time_ms))
+            SharedMsg batch[BatchSz];
+            size_t count = queue.drain(etl::span<SharedMsg>(batch, BatchSz), time_ms);
+            if (count > 0)
             {
                 // Queue not empty return OK
                 status = DequeueStat::OK;
-                process_pkt(pkt);
-                while (queue.front(pkt))
+                while (count > 0)
                 {
-                    process_pkt(pkt);
+                    process_batch(batch, count);
+                    count = queue.drain(etl::span<SharedMsg>(batch, BatchSz), 0);
                 }
             }
 
             return status;
         }
 
+        void attach(Os::EventCount* event) override { queue.attach(event); }
+
+        bool dispatch(const Os::TimeNs_t now_ns) override
+        {
+            (void)now_ns;
+            return receive_msgs(0) == DequeueStat::OK;
+        }
+
+        /// @brief Interrupt a blocked receive_msgs
+        void wake() override { queue.wake(); }
+
+        void clear_wake() override { queue.clear_wake(); }
+
         inline void enable(void) { Enabled = true; }
 
         inline void disable(void) { Enabled = false; }
 
         inline bool is_enabled(void) const { return Enabled; }
+
+        /// @brief Get the number of accepted messages that were not queued
+        inline size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
     
     private:
-        using message_packet = etl::message_packet<TMsgs...>;
-        BlockingMsgQueue<message_packet, TMsgLimit> queue;
+        /// @brief Largest message handled by the router
+        static constexpr size_t MaxMsgSz = std::max({sizeof(TMsgs)...});
+
+        /// @brief Maximum number of messages dequeued at once
+        static constexpr size_t BatchSz = std::min<size_t>(TMsgLimit, MSG_QUEUE_DRAIN_BATCH);
+
+        using CopyPool_t = std::conditional_t<(TCopyLimit > 0),
+            StaticMsgBufPool<SizeClass<MaxMsgSz, TCopyLimit>>, NoCopyPool>;
+
+        BlockingMsgQueue<SharedMsg, TMsgLimit> queue;
+        /// @brief Holds copies of messages not sent in a shared buffer
+        CopyPool_t copy_pool_;
         volatile bool Enabled;
+        std::atomic<size_t> dropped_;   //< Accepted messages not queued
+
+        /// @brief Queue a message handle
+        /// @param sm Shared message. Released if the queue is full.
+        inline void enqueue(SharedMsg&& sm)
+        {
+            if (!queue.emplace(etl::move(sm)))
+            {
+                drop();
+            }
+        }
+
+        inline void drop() { dropped_.fetch_add(1, std::memory_order_relaxed); }
 
-        inline void process_pkt(message_packet& pkt)
+        inline void process_batch(SharedMsg* batch, const size_t count)
         {
-            etl::imessage &msg = pkt.get();
-            Base_t::receive(msg);
+            for (size_t i = 0; i < count; i++)
+            {
+                Base_t::receive(batch[i].get_message());
+                // Return the buffer now rather than when the batch is reused
+                batch[i] = SharedMsg();
+            }
         }
     };
 
+    /// @brief Queued router with a copy pool as deep as its queue (see
+    ///     BasicQueuedRouter)
+    template <typename THandler, size_t TMsgLimit, typename... TMsgs>
+    using QueuedRouter = BasicQueuedRouter<THandler, TMsgLimit, TMsgLimit, TMsgs...>;
+
 }
 }
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <etl/message_broker.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace etfw::msg
+{
+    /// @brief Message ID to subscriber lookup table
+    /// @details Routers are assigned a slot on their first subscription.
+    ///     Each subscribed message ID maps to a bitset of router slots in an
+    ///     open-addressed hash table, so a dispatch is one hash probe plus a
+    ///     walk over the set bits, regardless of how many routers or IDs are
+    ///     registered. The table is updated on subscribe/unsubscribe only.
+    ///     Not thread safe, the owner is responsible for locking.
+    /// @tparam VMaxRouters Maximum number of subscribed routers
+    /// @tparam VMaxIds Maximum number of distinct subscribed message IDs
+    template <size_t VMaxRouters, size_t VMaxIds>
+    class SubscriberIndex
+    {
+        static_assert(VMaxRouters > 0, "Index must hold at least one router");
+        static_assert(VMaxIds > 0, "Index must hold at least one message ID");
+
+    public:
+        using Router_t = etl::imessage_router;
+        using Subscription_t = etl::message_broker::subscription;
+        using MsgId_t = etl::message_id_t;
+
+        static constexpr size_t MaxRouters = VMaxRouters;
+        static constexpr size_t MaxIds = VMaxIds;
+
+        SubscriberIndex():
+            routers_{},
+            slots_{},
+            num_routers_(0),
+            num_ids_(0)
+        {}
+
+        /// @brief Add a router's subscription, replacing any previous
+        ///     subscription held by the same router
+        /// @param sub Subscription to add
+        /// @return True on success. False if the router or ID table is
+        ///     full, in which case the router is left unsubscribed.
+        bool add(const Subscription_t& sub)
+        {
+            Router_t* router = sub.get_router();
+            remove(*router);
+
+            size_t idx = 0;
+            while (idx < MaxRouters && routers_[idx] != nullptr)
+            {
+                idx++;
+            }
+            if (idx == MaxRouters)
+            {
+                return false;
+            }
+            routers_[idx] = router;
+            num_routers_++;
+
+            for (const auto id: sub.message_id_list())
+            {
+                Slot* slot = insert(id);
+                if (slot == nullptr)
+                {
+                    remove(*router);
+                    return false;
+                }
+                slot->Routers[idx / WordBits] |= bit(idx);
+            }
+            return true;
+        }
+
+        /// @brief Subscribe an indexed router to one more message ID
+        /// @param router Router. Ignored if it has no subscription indexed.
+        /// @param id Message ID
+        /// @return False if the ID table is full
+        bool add(const Router_t& router, const MsgId_t id)
+        {
+            const size_t idx = find_router(router);
+            if (idx == MaxRouters)
+            {
+                return true;
+            }
+            Slot* slot = insert(id);
+            if (slot == nullptr)
+            {
+                return false;
+            }
+            slot->Routers[idx / WordBits] |= bit(idx);
+            return true;
+        }
+
+        /// @brief Unsubscribe an indexed router from a single message ID
+        /// @param router Router
+        /// @param id Message ID
+        void remove(const Router_t& router, const MsgId_t id)
+        {
+            const size_t idx = find_router(router);
+            if (idx == MaxRouters)
+            {
+                return;
+            }
+            size_t pos = 0;
+            if (find_pos(id, pos))
+            {
+                Slot& slot = slots_[pos];
+                slot.Routers[idx / WordBits] &= ~bit(idx);
+                if (empty(slot))
+                {
+                    erase(pos);
+                }
+            }
+        }
+
+        /// @brief Remove all of a router's subscriptions
+        /// @param router Router to remove
+        void remove(const Router_t& router)
+        {
+            const size_t idx = find_router(router);
+            if (idx == MaxRouters)
+            {
+                return;
+            }
+            routers_[idx] = nullptr;
+            num_routers_--;
+
+            size_t pos = 0;
+            while (pos < NumSlots)
+            {
+                Slot& slot = slots_[pos];
+                if (slot.Used)
+                {
+                    slot.Routers[idx / WordBits] &= ~bit(idx);
+                    if (empty(slot))
+                    {
+                        // Erasing shifts a later entry into pos, so check
+                        // pos again before moving on
+                        erase(pos);
+                        continue;
+                    }
+                }
+                pos++;
+            }
+        }
+
+        /// @brief Call a function on every router subscribed to a message ID
+        /// @tparam TFunc Callable taking a Router_t&
+        /// @param id Message ID
+        /// @param func Function to call
+        /// @return Number of routers visited
+        template <typename TFunc>
+        size_t for_each(const MsgId_t id, TFunc&& func) const
+        {
+            size_t pos = 0;
+            if (!find_pos(id, pos))
+            {
+                return 0;
+            }
+
+            // Copy the subscriber set first. Handlers may change
+            // subscriptions while the message is being routed.
+            uint64_t subs[NumWords];
+            for (size_t word = 0; word < NumWords; word++)
+            {
+                subs[word] = slots_[pos].Routers[word];
+            }
+
+            size_t count = 0;
+            for (size_t word = 0; word < NumWords; word++)
+            {
+                uint64_t bits = subs[word];
+                while (bits != 0)
+                {
+                    const size_t idx = (word * WordBits) +
+                        static_cast<size_t>(__builtin_ctzll(bits));
+                    bits &= (bits - 1);
+                    Router_t* router = routers_[idx];
+                    if (router != nullptr)
+                    {
+                        func(*router);
+                        count++;
+                    }
+                }
+            }
+            return count;
+        }
+
+        /// @brief Checks if a router is subscribed to a message ID
+        /// @param router Router to check
+        /// @param id Message ID
+        /// @return True if subscribed
+        bool is_subscribed(const Router_t& router, const MsgId_t id) const
+        {
+            const size_t idx = find_router(router);
+            size_t pos = 0;
+            if (idx != MaxRouters && find_pos(id, pos))
+            {
+                return (slots_[pos].Routers[idx / WordBits] & bit(idx)) != 0;
+            }
+            return false;
+        }
+
+        /// @brief Get the number of subscribed routers
+        inline size_t num_routers() const { return num_routers_; }
+
+        /// @brief Get the number of distinct subscribed message IDs
+        inline size_t num_ids() const { return num_ids_; }
+
+    private:
+        static constexpr size_t WordBits = 64;
+        static constexpr size_t NumWords = (MaxRouters + WordBits - 1) / WordBits;
+
+        /// @brief Smallest power of two holding at least twice MaxIds,
+        ///     keeping the load factor at or below 50%
+        static constexpr size_t num_slots()
+        {
+            size_t sz = 1;
+            while (sz < (2 * MaxIds))
+            {
+                sz <<= 1;
+            }
+            return sz;
+        }
+        static constexpr size_t NumSlots = num_slots();
+        static constexpr size_t SlotMask = NumSlots - 1;
+
+        /// @brief Hash table entry
+        struct Slot
+        {
+            bool Used;                  //< Slot holds a message ID
+            MsgId_t Id;                 //< Message ID
+            uint64_t Routers[NumWords]; //< Bitset of subscribed router slots
+        };
+
+        static constexpr uint64_t bit(const size_t idx)
+        {
+            return (1ull << (idx % WordBits));
+        }
+
+        /// @brief Fibonacci hash of a message ID to its home slot
+        static constexpr size_t home(const MsgId_t id)
+        {
+            return static_cast<size_t>(
+                (static_cast<uint64_t>(id) * 0x9E3779B97F4A7C15ull) >> 32) & SlotMask;
+        }
+
+        static bool empty(const Slot& slot)
+        {
+            for (const auto word: slot.Routers)
+            {
+                if (word != 0)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// @brief Find a router's slot
+        /// @return Router slot. MaxRouters if not indexed.
+        size_t find_router(const Router_t& router) const
+        {
+            size_t idx = 0;
+            while (idx < MaxRouters && routers_[idx] != &router)
+            {
+                idx++;
+            }
+            return idx;
+        }
+
+        /// @brief Find a message ID's hash table position
+        /// @param id Message ID
+        /// @param[out] pos Table position
+        /// @return True if the ID is in the table
+        bool find_pos(const MsgId_t id, size_t& pos) const
+        {
+            pos = home(id);
+            while (slots_[pos].Used)
+            {
+                if (slots_[pos].Id == id)
+                {
+                    return true;
+                }
+                pos = (pos + 1) & SlotMask;
+            }
+            return false;
+        }
+
+        Slot* insert(const MsgId_t id)
+        {
+            size_t pos = home(id);
+            while (slots_[pos].Used)
+            {
+                if (slots_[pos].Id == id)
+                {
+                    return &slots_[pos];
+                }
+                pos = (pos + 1) & SlotMask;
+            }
+            if (num_ids_ == MaxIds)
+            {
+                return nullptr;
+            }
+            slots_[pos] = Slot{true, id, {}};
+            num_ids_++;
+            return &slots_[pos];
+        }
+
+        /// @brief Backward-shift deletion. Keeps probe chains intact
+        ///     without tombstones.
+        void erase(size_t pos)
+        {
+            size_t next = (pos + 1) & SlotMask;
+            while (slots_[next].Used)
+            {
+                const size_t next_home = home(slots_[next].Id);
+                // Move the entry back if its home is not within (pos, next]
+                if (((next - next_home) & SlotMask) >= ((next - pos) & SlotMask))
+                {
+                    slots_[pos] = slots_[next];
+                    pos = next;
+                }
+                next = (next + 1) & SlotMask;
+            }
+            slots_[pos] = Slot{};
+            num_ids_--;
+        }
+
+        Router_t* routers_[MaxRouters];
+        Slot slots_[NumSlots];
+        size_t num_routers_;
+        size_t num_ids_;
+    };
+}
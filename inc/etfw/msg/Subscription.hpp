@@ -2,22 +2,87 @@
 #pragma once
 
 #include "Message.hpp"
+#include "MsgIdSet.hpp"
 #include <etl/message_broker.h>
 
 namespace etfw::msg
 {
-    /// @brief Message ID subscription class
-    class subscription : public etl::message_broker::subscription
+    /// @brief Notified when a registered subscription's message IDs change
+    class iSubscriptionObserver
+    {
+    public:
+        /// @brief Called after a router subscribes to a message ID
+        /// @param router Subscribed router
+        /// @param id Message ID
+        virtual void on_subscribe(const etl::imessage_router& router,
+            const MsgId_t id) = 0;
+
+        /// @brief Called after a router unsubscribes from a message ID
+        /// @param router Unsubscribed router
+        /// @param id Message ID
+        virtual void on_unsubscribe(const etl::imessage_router& router,
+            const MsgId_t id) = 0;
+
+    protected:
+        ~iSubscriptionObserver() = default;
+    };
+
+    /// @brief Subscription base class. Forwards message ID changes to the
+    ///     broker it was last subscribed to, so brokers can index
+    ///     subscriptions instead of scanning them on every message.
+    class iSubscription : public etl::message_broker::subscription
     {
     public:
         // Base class type
         using Base_t = etl::message_broker::subscription;
 
+        /// @brief Set the observer notified of message ID changes
+        /// @param observer Observer. Nullptr to detach.
+        inline void set_observer(iSubscriptionObserver* observer)
+        {
+            observer_ = observer;
+        }
+
+    protected:
+        /// @brief Construct subscription with no observer
+        /// @param router Router owning the subscription
+        iSubscription(etl::imessage_router& router):
+            Base_t(router),
+            observer_(nullptr)
+        {}
+
+        inline void notify_subscribe(const MsgId_t id)
+        {
+            if (observer_ != nullptr)
+            {
+                observer_->on_subscribe(*get_router(), id);
+            }
+        }
+
+        inline void notify_unsubscribe(const MsgId_t id)
+        {
+            if (observer_ != nullptr)
+            {
+                observer_->on_unsubscribe(*get_router(), id);
+            }
+        }
+
+    private:
+        iSubscriptionObserver* observer_;
+    };
+
+    /// @brief Message ID subscription class
+    class subscription : public iSubscription
+    {
+    public:
+        // Base class type
+        using Base_t = iSubscription;
+
         /// @brief Alias for message id span/view type
         using MsgSpan_t = etl::message_broker::message_id_span_t;
 
-        /// @brief List of message IDs. TODO: needs to be static type
-        using IdContainer_t = std::vector<MsgId_t>;
+        /// @brief Set of message IDs
+        using IdContainer_t = MsgIdSet<MSG_MAX_NUM_SUBSCRIPTIONS>;
 
         using Status = bool;
 
@@ -37,12 +102,25 @@ namespace etfw::msg
         /// @param msg_ids Message IDs the router is subscribed to
         subscription(
             etl::imessage_router& module,
-            IdContainer_t &msg_ids
+            const IdContainer_t &msg_ids
         ):
             Base_t(module),
             ids_(msg_ids)
         {}
 
+        /// @brief Construct a subscription from a compile-time ID set
+        /// @tparam ...TMsgs Message types in the set
+        /// @param module The router owning the subscription
+        /// @param msg_ids Message IDs the router is subscribed to
+        template <typename... TMsgs>
+        subscription(
+            etl::imessage_router& module,
+            StaticMsgIdSet<TMsgs...> msg_ids
+        ):
+            Base_t(module),
+            ids_(msg_ids.data(), msg_ids.size())
+        {}
+
         /// @brief Construct empty subscription object
         /// @param pipe The pipe/router owning the subscription
         subscription(
@@ -60,39 +138,44 @@ namespace etfw::msg
 
         /// @brief Add an ID to the subscription
         /// @param id Message ID to subscribe to
-        /// @return 
+        /// @return True if subscribed. False if the subscription is full.
         Status subscribe(const MsgId_t id)
         {
-            ids_.push_back(id);
-            return true;
+            const size_t size = ids_.size();
+            const bool added = ids_.insert(id);
+            // Only a new ID changes the broker's index
+            if (ids_.size() != size)
+            {
+                notify_subscribe(id);
+            }
+            return added;
         }
 
         /// @brief Remove an ID to the subscription
         /// @param id Message ID to unsubscribe from
-        /// @return 
+        /// @return True if the ID was subscribed
         Status unsubscribe(const MsgId_t id)
         {
-            ids_.erase(std::remove(
-                ids_.begin(), ids_.end(), id),
-                ids_.end());
-            return true;
+            const bool removed = ids_.erase(id);
+            if (removed)
+            {
+                notify_unsubscribe(id);
+            }
+            return removed;
         }
 
         /// @brief Check if a message id is in this subscription
         /// @param id Message id to check for
         /// @return True if subscribed, otherwise false
-        bool is_subscribed(const MsgId_t id) const
+        inline bool is_subscribed(const MsgId_t id) const
         {
-            for (auto& id_: ids_)
-            {
-                if (id_ == id)
-                {
-                    return true;
-                }
-            }
-            return false;
+            return ids_.has(id);
         }
 
+        /// @brief Get the subscribed message IDs
+        /// @return Sorted message ID set
+        inline const IdContainer_t& ids() const { return ids_; }
+
         /// @brief Check if a message id is in this subscription
         /// @param id Message id to check for
         /// @return True if subscribed, otherwise false
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "OsTypes.hpp"
+#include <cstdint>
+#include <ctime>
+#include <cerrno>
+
+namespace Os
+{
+    /// @brief Time in nanoseconds
+    using TimeNs_t = uint64_t;
+
+    /// @brief Time that never arrives. Used for "no deadline".
+    constexpr TimeNs_t TimeNsNever = UINT64_MAX;
+
+    constexpr TimeNs_t NsPerMs = 1000000ULL;
+    constexpr TimeNs_t NsPerSec = 1000000000ULL;
+
+    /// @brief Monotonic clock. Unaffected by changes to the system time.
+    struct Clock
+    {
+        /// @brief Get the current monotonic time
+        /// @return Nanoseconds since an arbitrary fixed point
+        static inline TimeNs_t now_ns(void)
+        {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return to_ns(ts);
+        }
+
+        /// @brief Get the CPU time used by the calling thread. Costlier
+        ///     than now_ns on most targets.
+        /// @return Nanoseconds of CPU time
+        static inline TimeNs_t thread_cpu_ns(void)
+        {
+            timespec ts;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return to_ns(ts);
+        }
+
+        /// @brief Sleep until an absolute monotonic time. Sleeping to
+        ///     absolute deadlines doesn't accumulate drift.
+        /// @param deadline_ns Time to wake at
+        static inline void sleep_until(const TimeNs_t deadline_ns)
+        {
+            const timespec deadline = to_timespec(deadline_ns);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                &deadline, nullptr) == EINTR)
+            {}
+        }
+
+        static inline TimeNs_t to_ns(const timespec& ts)
+        {
+            return (static_cast<TimeNs_t>(ts.tv_sec) * NsPerSec) +
+                static_cast<TimeNs_t>(ts.tv_nsec);
+        }
+
+        static inline timespec to_timespec(const TimeNs_t ns)
+        {
+            timespec ts;
+            ts.tv_sec = static_cast<time_t>(ns / NsPerSec);
+            ts.tv_nsec = static_cast<long>(ns % NsPerSec);
+            return ts;
+        }
+    };
+}
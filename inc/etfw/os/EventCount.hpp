@@ -0,0 +1,180 @@
+#pragma once
+
+#include "OsTypes.hpp"
+#include "Clock.hpp"
+#include "status.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+#ifndef __linux__
+#include <pthread.h>
+#endif
+
+/// Number of times a waiter polls for a notification before sleeping
+#ifndef OS_EVENT_SPIN_COUNT
+#define OS_EVENT_SPIN_COUNT     100
+#endif
+
+namespace Os
+{
+    /// @brief Event count. Lets threads sleep until another thread changes
+    ///     a condition, with no syscall on either side unless a waiter
+    ///     actually has to sleep.
+    /// @details Waiters call prepare_wait, check their condition, then call
+    ///     wait with the returned key if the condition isn't met (or
+    ///     cancel_wait if it is). Notifiers change the condition, then call
+    ///     notify. A notify after prepare_wait makes wait return
+    ///     immediately, so wakeups are never lost. notify only makes a
+    ///     syscall if a waiter is asleep.
+    ///
+    ///     Waiters poll OS_EVENT_SPIN_COUNT times before sleeping, except on
+    ///     single CPU systems where the notifier can't run meanwhile. Sleep
+    ///     deadlines use CLOCK_MONOTONIC, so they are unaffected by changes
+    ///     to the system time. Backed by a futex on Linux and a condition
+    ///     variable elsewhere.
+    ///
+    ///     A wait from inside a Fiber parks the fiber rather than the
+    ///     thread, so other fibers keep running. Only one fiber may wait
+    ///     on an event at a time, and the event must have no notify hook.
+    class EventCount
+    {
+    public:
+        /// @brief Event count return code trait
+        struct StatusTrait
+        {
+            /// @brief Return codes
+            enum class Code : int32_t
+            {
+                OK,
+                TIMEOUT,
+                OS_ERR,
+
+                COUNT
+            };
+
+            /// @brief Return code string representation
+            static constexpr StatusStr_t ErrStrLkup[] =
+            {
+                "Success",
+                "Wait timeout",
+                "OS wait/wake error"
+            };
+        };
+
+        /// @brief Return code type
+        using Status = EtfwStatus<StatusTrait>;
+
+        /// @brief Wait key returned by prepare_wait
+        using Key_t = uint32_t;
+
+        /// @brief Function called on every notify
+        struct NotifyHook
+        {
+            void (*Fn)(void* arg);
+            void* Arg;
+        };
+
+        EventCount();
+
+        ~EventCount();
+
+        EventCount(const EventCount&) = delete;
+        EventCount& operator=(const EventCount&) = delete;
+
+        /// @brief Start a wait. Must be followed by wait or cancel_wait.
+        /// @return Key to pass to wait
+        inline Key_t prepare_wait()
+        {
+            const Key_t key = epoch_.load(std::memory_order_acquire);
+            // Order the key read before the caller's condition check. Pairs
+            // with the epoch increment in notify.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return key;
+        }
+
+        /// @brief Abandon a prepared wait. The condition was already met.
+        /// @param key Key returned by prepare_wait
+        inline void cancel_wait(const Key_t key)
+        {
+            (void)key;
+        }
+
+        /// @brief Wait for a notify after prepare_wait returned key
+        /// @param key Key returned by prepare_wait
+        /// @param t_ms Milliseconds to wait
+        /// @return OK if notified, TIMEOUT if t_ms passed first
+        Status wait(const Key_t key, const TimeMs_t t_ms);
+
+        /// @brief Wait for a notify after prepare_wait returned key
+        /// @param key Key returned by prepare_wait
+        /// @param deadline_ns Clock::now_ns() time to give up at
+        /// @return OK if notified, TIMEOUT if the deadline passed first
+        Status wait_until(const Key_t key, const TimeNs_t deadline_ns);
+
+        /// @brief Wait forever for a notify after prepare_wait returned key
+        /// @param key Key returned by prepare_wait
+        /// @return OK if notified
+        Status wait(const Key_t key);
+
+        /// @brief Wake every waiter. Call after changing the condition.
+        inline void notify()
+        {
+            // The RMW orders the caller's condition change before the
+            // sleeper check
+            epoch_.fetch_add(1, std::memory_order_seq_cst);
+            const NotifyHook* hook = hook_.load(std::memory_order_seq_cst);
+            if (hook != nullptr)
+            {
+                hook->Fn(hook->Arg);
+            }
+            if (sleepers_.load(std::memory_order_seq_cst) != 0)
+            {
+                wake();
+            }
+        }
+
+        /// @brief Call a function on every notify, e.g. to schedule work
+        ///     for whoever owns the event instead of waking a waiter.
+        ///     A notify racing a change may still call the old hook, so
+        ///     hooks must tolerate spurious calls.
+        /// @param hook Hook to call. Must outlive its use. Nullptr to remove.
+        inline void set_notify_hook(const NotifyHook* hook)
+        {
+            hook_.store(hook, std::memory_order_seq_cst);
+        }
+
+        /// @brief Get the number of sleep/wake syscalls made
+        inline size_t syscalls() const { return syscalls_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint32_t> epoch_;       //< Notify count. Futex word on Linux.
+        std::atomic<uint32_t> sleepers_;    //< Waiters asleep or about to sleep
+        std::atomic<size_t> syscalls_;      //< Sleep/wake syscalls made
+        std::atomic<const NotifyHook*> hook_;   //< Called on notify
+
+#ifndef __linux__
+        MutexHandle_t mutex_;
+        pthread_cond_t cond_;
+#endif
+
+        /// @brief Poll for a notify before sleeping
+        /// @return True if notified
+        bool spin(const Key_t key) const;
+
+        /// @brief Sleep until notified or the deadline passes
+        /// @param key Key returned by prepare_wait
+        /// @param deadline CLOCK_MONOTONIC deadline. Nullptr to wait forever.
+        Status sleep(const Key_t key, const timespec* deadline);
+
+        /// @brief Wake sleeping waiters
+        void wake();
+
+        /// @brief Park the running fiber until notified or the deadline
+        ///     passes
+        /// @param key Key returned by prepare_wait
+        /// @param deadline_ns Clock::now_ns() time to give up at
+        Status fiber_wait(const Key_t key, const TimeNs_t deadline_ns);
+    };
+}
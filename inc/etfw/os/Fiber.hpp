@@ -0,0 +1,150 @@
+#pragma once
+
+#include "OsTypes.hpp"
+#include "Clock.hpp"
+#include "EventCount.hpp"
+#include "Task.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if !((defined(__x86_64__) || defined(__aarch64__)) && defined(__ELF__))
+#include <ucontext.h>
+#endif
+
+/// Word painted over fiber stacks to measure their high-water mark
+#ifndef OS_FIBER_STACK_CANARY
+#define OS_FIBER_STACK_CANARY   0xC5A3C5A3u
+#endif
+
+/// Number of stack words at the limit of a fiber stack that must stay
+/// painted. A fiber that touches them has overflowed, or nearly has. A
+/// frame larger than the guard that leaves part of itself unwritten (e.g.
+/// a local buffer only partly filled) can step over it unnoticed, so keep
+/// the guard wider than the largest such frame.
+#ifndef OS_FIBER_STACK_GUARD_WORDS
+#define OS_FIBER_STACK_GUARD_WORDS  64
+#endif
+
+namespace Os
+{
+    /// @brief Cooperative fiber running on a caller-provided stack
+    /// @details A fiber runs a routine on its own stack, inside the
+    ///     thread that resumes it, until the routine yields or returns.
+    ///     Switching saves only the callee-saved registers, so it costs
+    ///     a function call rather than a kernel context switch. Built
+    ///     with a hand-written switch on x86-64 and aarch64 ELF targets
+    ///     and ucontext elsewhere.
+    ///
+    ///     The stack is painted with OS_FIBER_STACK_CANARY on init, so
+    ///     stack_used reports the deepest the fiber has reached. There is
+    ///     no guard page: check stack_overflowed in tests and size the
+    ///     buffer for the worst case.
+    ///
+    ///     A fiber waiting on an EventCount parks (see park) instead of
+    ///     blocking its thread, so blocking queue reads yield to other
+    ///     fibers. Whoever resumes fibers must resume a parked fiber once
+    ///     notified() or its deadline passes.
+    class Fiber
+    {
+    public:
+        using Routine_t = void (*)(void* arg);
+        using Stack_t = Thread::Config::Stack;
+
+        /// @brief Fiber state
+        enum class State : uint8_t
+        {
+            IDLE,       //< Not initialized or routine returned
+            READY,      //< Runnable
+            PARKED,     //< Waiting for an unpark or its deadline
+        };
+
+        Fiber();
+
+        Fiber(const Fiber&) = delete;
+        Fiber& operator=(const Fiber&) = delete;
+
+        /// @brief Prepare the fiber to run routine(arg) on stack. The
+        ///     fiber must be idle.
+        /// @param stack Fiber stack. 16 byte aligned.
+        /// @param routine Routine to run
+        /// @param arg Routine argument
+        void init(Stack_t stack, Routine_t routine, void* arg);
+
+        /// @brief Run the fiber until it yields, parks or returns. Must
+        ///     not be called from a fiber.
+        void resume();
+
+        /// @brief Give up the CPU to whoever resumed the running fiber
+        static void yield();
+
+        /// @brief Park the running fiber until unparked
+        /// @param deadline_ns Clock::now_ns() time to give up at
+        /// @return True if unparked, false if the deadline passed
+        static bool park(const TimeNs_t deadline_ns);
+
+        /// @brief Make a parked fiber runnable. Any thread.
+        void unpark();
+
+        /// @brief Get the running fiber
+        /// @return Fiber. Nullptr outside fibers.
+        static Fiber* current();
+
+        /// @brief Call a function whenever the fiber is unparked, e.g. to
+        ///     wake the thread that resumes it
+        void set_wake_hook(const EventCount::NotifyHook* hook);
+
+        /// @brief Get the notify hook that unparks this fiber
+        inline const EventCount::NotifyHook& unpark_hook() const { return unpark_hook_; }
+
+        inline State state() const { return state_.load(std::memory_order_acquire); }
+
+        /// @brief Check if a parked fiber was unparked
+        inline bool notified() const { return notified_.load(std::memory_order_acquire); }
+
+        /// @brief Get the deadline of a parked fiber
+        inline TimeNs_t park_deadline() const { return park_deadline_; }
+
+        /// @brief Get the number of times the fiber was resumed
+        inline size_t switches() const { return switches_; }
+
+        /// @brief Get the stack size in bytes
+        inline size_t stack_bytes() const { return stack_words_ * sizeof(Stack_t::Buf_t); }
+
+        /// @brief Measure the most stack the fiber has used, from the
+        ///     canary left unpainted. Scans the stack.
+        /// @return High-water mark in bytes
+        size_t stack_used() const;
+
+        /// @brief Check if the fiber reached its stack guard words
+        bool stack_overflowed() const;
+
+    private:
+        Stack_t::BufPtr_t stack_;
+        size_t stack_words_;
+        Routine_t routine_;
+        void* arg_;
+        std::atomic<State> state_;
+        std::atomic<bool> notified_;        //< Unparked since the last park
+        TimeNs_t park_deadline_;
+        size_t switches_;
+        const EventCount::NotifyHook unpark_hook_;
+        std::atomic<const EventCount::NotifyHook*> wake_hook_;
+
+#if (defined(__x86_64__) || defined(__aarch64__)) && defined(__ELF__)
+        void* sp_;                          //< Saved fiber stack pointer
+        void* caller_sp_;                   //< Saved resumer stack pointer
+#else
+        ucontext_t ctx_;
+        ucontext_t caller_ctx_;
+#endif
+
+        /// @brief Fiber entry. Runs the routine and switches back for good.
+        static void entry(void* fiber);
+
+        /// @brief Switch from the fiber back to its resumer
+        void suspend();
+
+        static void on_unpark(void* fiber);
+    };
+}
@@ -106,6 +106,12 @@ namespace Os
 
             Status size(size_t &result);
 
+            /// @brief Wait until written data is on storage. File metadata
+            ///     that reading the data doesn't need, such as timestamps,
+            ///     may still be in flight.
+            /// @return Sync status
+            Status sync();
+
             Status position(size_t &result);
 
             Status calc_crc(uint32_t &crc);
@@ -2,12 +2,37 @@
 #pragma once
 
 #include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 #include <iostream>
 #include <cstring>
 #include "OsTypes.hpp"
 #include "../status.hpp"
 
+/// Scheduling policy of threads that don't pick one. Real-time policies
+/// (SCHED_FIFO, SCHED_RR) apply to threads with a non-zero priority.
+#ifndef OS_THREAD_SCHED_POLICY
+#define OS_THREAD_SCHED_POLICY  SCHED_OTHER
+#endif
+
+/// Largest minimum thread stack of the target, in bytes. Bounds
+/// Thread::min_stack_bytes() so static stacks can be sized at compile
+/// time. Kernels with 64K pages need 128K.
+#ifndef OS_THREAD_MIN_STACK_SZ
+#if defined(__aarch64__) || defined(__powerpc64__)
+#define OS_THREAD_MIN_STACK_SZ  (128 * 1024)
+#else
+#define OS_THREAD_MIN_STACK_SZ  (16 * 1024)
+#endif
+#endif
+
+/// Default service thread stack size, in 32-bit words. 32K, or the
+/// target's minimum if larger.
+#ifndef OS_THREAD_DEFAULT_STACK_SZ
+#define OS_THREAD_DEFAULT_STACK_SZ \
+    ((OS_THREAD_MIN_STACK_SZ > (32 * 1024)) ? (OS_THREAD_MIN_STACK_SZ / 4) : 8192)
+#endif
+
 namespace Os
 {
 
@@ -322,6 +347,8 @@ static inline GlobTaskStats_t GlobalTaskStats;
                     THREAD_CREATE_ERROR,
                     INVALID_STATE,
                     JOIN_ERROR,
+                    INVALID_AFFINITY_CFG,
+                    TIMEOUT,
 
                     COUNT
                 };
@@ -336,6 +363,8 @@ static inline GlobTaskStats_t GlobalTaskStats;
                     "Thread creation error",
                     "Invalid task state for operation",
                     "OS join operation failure",
+                    "Affinity mask has no usable CPU",
+                    "Timed out waiting for the thread",
                 };
             };
 
@@ -352,70 +381,131 @@ static inline GlobTaskStats_t GlobalTaskStats;
             using RoutineArg_t = void*;
             typedef void (*Routine_t)(RoutineArg_t);
 
+            /// @brief Thread configuration
+            /// @details The thread runs on StackBuf rather than an OS
+            ///     allocated stack. There is no guard page, so the buffer
+            ///     must cover the thread's worst case usage.
+            ///
+            ///     Threads use the time sharing scheduler unless Policy is
+            ///     SCHED_FIFO or SCHED_RR and Priority is non-zero. The
+            ///     priority is then clamped to the policy's range. If the
+            ///     process isn't allowed real-time scheduling the thread
+            ///     falls back to the creator's scheduling (see
+            ///     Thread::realtime()).
             struct Config
             {
                 using Priority_t = uint8_t;
 
+                /// @brief CPU affinity mask. Bit N allows CPU N. 0 allows
+                ///     every CPU.
+                using CpuMask_t = uint64_t;
+
                 struct Stack
                 {
                     using Buf_t = uint32_t;
                     using BufPtr_t = Buf_t*;
 
                     const BufPtr_t Buf;
-                    const size_t Sz;
+                    const size_t Sz;    //< Size in Buf_t words
 
                     Stack(BufPtr_t buf, size_t buf_sz):
                         Buf(buf),
                         Sz(buf_sz) {}
+
+                    inline size_t bytes() const { return Sz * sizeof(Buf_t); }
                 };
 
+                /// @brief Scheduling policy. SCHED_OTHER, SCHED_FIFO or
+                ///     SCHED_RR.
+                using Policy_t = int;
+
                 Stack StackBuf;
                 const Priority_t Priority;
                 const RoutineArg_t Arg;
                 const Routine_t Routine;
+                const CpuMask_t Affinity;
+                const Policy_t Policy;
 
                 Config(Stack stack,
                     Priority_t priority,
                     RoutineArg_t arg,
-                    Routine_t routine
+                    Routine_t routine,
+                    CpuMask_t affinity = 0,
+                    Policy_t policy = OS_THREAD_SCHED_POLICY
                 ):
                     StackBuf(stack),
                     Priority(priority),
                     Arg(arg),
-                    Routine(routine) {}
+                    Routine(routine),
+                    Affinity(affinity),
+                    Policy(policy) {}
                 
                 Config(Stack::BufPtr_t stack_buf,
                     size_t stack_buf_sz,
                     Priority_t priority,
                     RoutineArg_t arg,
-                    Routine_t routine
+                    Routine_t routine,
+                    CpuMask_t affinity = 0,
+                    Policy_t policy = OS_THREAD_SCHED_POLICY
                 ):
                     StackBuf(stack_buf, stack_buf_sz),
                     Priority(priority),
                     Arg(arg),
-                    Routine(routine) {}
+                    Routine(routine),
+                    Affinity(affinity),
+                    Policy(policy) {}
+
+                /// @brief Check if the config asks for real-time scheduling
+                inline bool realtime() const
+                {
+                    return (Priority != 0) &&
+                        (Policy == SCHED_FIFO || Policy == SCHED_RR);
+                }
             };
 
+            /// @brief Smallest stack a thread can be given, in bytes
+            static size_t min_stack_bytes(void);
+
             Thread();
 
             Status start(Config& cfg);
 
             Status join(void);
 
+            /// @brief Wait for the thread to exit, up to a timeout
+            /// @param timeout_ms Time to wait. 0 to check without waiting.
+            /// @return OK once joined. TIMEOUT if the thread is still running.
+            Status join(const TimeMs_t timeout_ms);
+
             Status stop(void);
 
             static inline void delay(const TimeMs_t ms) { usleep(ms*1000); }
 
+            static inline void yield(void) { sched_yield(); }
+
             inline State state(void) const { return state_; }
 
+            /// @brief Check if the last start applied the real-time priority
+            /// @return False if the thread uses time sharing scheduling,
+            ///     either by config or because real-time was refused
+            inline bool realtime(void) const { return realtime_; }
+
         private:
             pthread_t handle_;
             RoutineArg_t arg_;
             Routine_t routine_;
             volatile State state_;
+            bool joinable_;     //< Thread created and not yet joined
+            bool realtime_;     //< Real-time priority applied
 
             Status validate_config(Config& config);
 
+            /// @brief Create the OS thread
+            /// @param config Thread configuration
+            /// @param realtime Apply the real-time priority
+            /// @return 0 or the pthread error code
+            int create(const Config& config, const bool realtime);
+
             static void *runner(void *thread_obj);
     };
 
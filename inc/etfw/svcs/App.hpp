@@ -41,11 +41,20 @@ namespace etfw
 
             void subscribe(msg::Subscription& subscription);
 
-            /// @brief Formats and logs a service message. 
+            /// @brief Formats and logs a service message. Returns before
+            ///     formatting if the level is filtered out (see
+            ///     iSvc::log_enabled).
             /// @param level Log level
             /// @param format String/format to log.
             /// @param Args String format arguments
-            void log(const LogLevel level, const char* format, ...);
+            template <typename... TArgs>
+            inline void log(const LogLevel level, const char* format, TArgs... args)
+            {
+                if (app_.log_enabled(level))
+                {
+                    app_.log(level, format, args...);
+                }
+            }
 
         private:
             iApp& app_;
@@ -80,10 +89,40 @@ namespace etfw
         /// @return App children registry
         iSvc::iRegistry* children() override { return &Children; }
 
+        /// @brief Get the IDs of the apps whose init must succeed before
+        ///     this app's (see iExecutor::start_all)
+        /// @details With ETFW_BOOT_WORKERS above 1, start_all may run the
+        ///     app's init concurrently with other inits, on a boot thread
+        ///     with ETFW_BOOT_PRIORITY and ETFW_BOOT_STACK_SZ. Inits relying
+        ///     on the caller's thread, priority or stack must then list
+        ///     what they share as dependencies, or keep the default of 1.
+        /// @return App IDs. Empty if there are none.
+        virtual SvcIds_t init_deps() const { return {}; }
+
         /// @brief Sends a command message to all subscribed applications
         /// @param msg Message to send
         static void send_cmd(const etl::imessage& msg);
 
+        /// @brief Constructs a command message in a broker buffer and sends
+        ///     it. Queued pipes receive a handle to the buffer, not a copy.
+        /// @tparam TMsg Message type. Must derive from iBaseMsg.
+        /// @param ...args TMsg constructor arguments
+        template <typename TMsg, typename... TArgs>
+        static void send_cmd(TArgs&&... args)
+        {
+            CmdBroker.send<TMsg>(etl::forward<TArgs>(args)...);
+        }
+
+        /// @brief Constructs a status/telemetry message in a broker buffer
+        ///     and sends it to the subscribed applications
+        /// @tparam TMsg Message type. Must derive from iBaseMsg.
+        /// @param ...args TMsg constructor arguments
+        template <typename TMsg, typename... TArgs>
+        static void send_status(TArgs&&... args)
+        {
+            StatusBroker.send<TMsg>(etl::forward<TArgs>(args)...);
+        }
+
         // Provide access to proxy class
         friend class AppFwProxy;
 
@@ -113,7 +152,7 @@ namespace etfw
         /// @param handler The message router to subscribe
         /// @param msg_ids Run-time/dynamic container of command IDs
         static void subscribe_cmd(etl::imessage_router& handler,
-            msg::MsgIdContainer &msg_ids);
+            const msg::MsgIdContainer &msg_ids);
 
         /// @brief Subscribes a message router to a set of status messages
         /// @param msgs Subscription class containing the router and status messages
@@ -129,7 +168,7 @@ namespace etfw
         /// @param handler The message router to subscribe
         /// @param msg_ids Run-time/dynamic container of status message IDs
         static void subscribe_status(etl::imessage_router& handler,
-            msg::MsgIdContainer &msg_ids);
+            const msg::MsgIdContainer &msg_ids);
 
     private:
         /// @brief Child app registry
@@ -158,16 +197,41 @@ namespace etfw
 
         static constexpr SvcId_t ID = Cfg::ID;
 
+        /// @brief Init dependencies (see SvcDeps)
+        using InitDeps_t = typename svc_init_deps<Cfg>::type;
+
+        /// @brief Lowest log level built into the app (see svc_log_level)
+        static constexpr LogLevel LOG_LEVEL = svc_log_level<Cfg>::value;
+
         App():
             iApp(Cfg::ID, Cfg::NAME),
             Runner(this)
-        {}
+        {
+            Runner.exec_stats().set_budget(
+                static_cast<Os::TimeNs_t>(svc_exec_budget_us<Cfg>::value) * 1000,
+                static_cast<Os::TimeNs_t>(svc_exec_stall_ms<Cfg>::value) * Os::NsPerMs);
+            set_build_log_level(LOG_LEVEL);
+            set_log_level(LOG_LEVEL);
+        }
 
         iSvcRunner* runner(void) override { return &Runner; }
+
+        SvcIds_t init_deps() const override
+        {
+            return SvcIds_t(InitDeps_t::IDS, InitDeps_t::COUNT);
+        }
         
         RunState process(void) override
         {
-            return static_cast<Derived*>(this)->run_loop();
+            if constexpr (has_run_loop<Derived>::value)
+            {
+                return static_cast<Derived*>(this)->run_loop();
+            }
+            else
+            {
+                // Event-driven apps only handle their event sources
+                return RunState::OK;
+            }
         }
 
         Status init_(void) override
@@ -201,6 +265,28 @@ namespace etfw
     
     protected:
         Runner_t Runner;
+
+        /// @brief Formats and logs a service message. Calls below
+        ///     LOG_LEVEL compile to nothing. Calls below the runtime level
+        ///     (see iSvc::set_log_level) return before formatting.
+        /// @param level Log level
+        /// @param format String/format to log.
+        /// @param Args String format arguments
+        template <typename... TArgs>
+        inline void log(const LogLevel level, const char* format, TArgs... args)
+        {
+            if (level >= LOG_LEVEL && log_enabled(level))
+            {
+                iSvc::log(level, format, args...);
+            }
+        }
+
+        /// @brief Formats and logs an INFO service message (see log)
+        template <typename... TArgs>
+        inline void log(const char* format, TArgs... args)
+        {
+            log(LogLevel::INFO, format, args...);
+        }
     };
 
 }
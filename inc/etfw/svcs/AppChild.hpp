@@ -2,6 +2,7 @@
 #pragma once
 
 #include "Runner.hpp"
+#include "CommonTraits.hpp"
 
 #include "etl/type_traits.h"
 
@@ -42,11 +43,19 @@ namespace etfw
             Runner(this)
         {}
 
-        iSvcRunner* runner(void) override { return nullptr; }
+        iSvcRunner* runner(void) override { return &Runner; }
         
         RunState process(void) override
         {
-            return static_cast<Derived*>(this)->run_loop();
+            if constexpr (has_run_loop<Derived>::value)
+            {
+                return static_cast<Derived*>(this)->run_loop();
+            }
+            else
+            {
+                // Event-driven children only handle their event sources
+                return RunState::OK;
+            }
         }
 
         /// @brief Private initialization method. Calls derived init method
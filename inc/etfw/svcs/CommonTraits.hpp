@@ -11,4 +11,12 @@ namespace etfw
     {
         static constexpr bool value = (std::is_base_of_v<Base, Ts> && ...);
     };
+
+    /// @brief Detects a run_loop() method. Event-driven services may omit it.
+    template <typename, typename = std::void_t<>>
+    struct has_run_loop : std::false_type {};
+
+    template <typename T>
+    struct has_run_loop<T, std::void_t<decltype(std::declval<T>().run_loop())>>
+        : std::true_type {};
 }
@@ -0,0 +1,240 @@
+#pragma once
+
+#include "os/Clock.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Set to 0 to compile out per-service execution time accounting
+#ifndef ETFW_EXEC_STATS
+#define ETFW_EXEC_STATS     1
+#endif
+
+namespace etfw {
+
+    namespace msg
+    {
+        struct WaitHooks;
+    }
+
+    /// @brief Execution time accounting of one service
+    /// @details The runner brackets each service cycle (its process call,
+    ///     and for event-driven runners the event source dispatch before
+    ///     it) with begin and end. Each cycle's thread CPU time and
+    ///     monotonic wall time are accumulated, and the CPU time is added
+    ///     to a log-linear histogram (4 buckets per power of two) for
+    ///     percentiles.
+    ///
+    ///     CPU time is what the service burned. Wall time also counts
+    ///     time blocked or preempted inside the cycle. Fiber services
+    ///     share their scheduler thread, so their CPU time includes other
+    ///     fibers that ran while they were parked.
+    ///
+    ///     Reading the thread CPU clock is a system call, so each cycle
+    ///     reads it once: a cycle starts from the reading that ended the
+    ///     previous cycle on the same thread, since a blocked thread uses
+    ///     no CPU. Runner overhead between cycles is counted in the next
+    ///     one. Runners call resync after running service code outside a
+    ///     cycle, so it isn't counted. Pool workers run a different
+    ///     service each step, so they resync before every cycle rather
+    ///     than charge pool overhead to the next service.
+    ///
+    ///     A cycle using more CPU than the budget is an overrun. A cycle
+    ///     still running after the stall timeout is stalled (see
+    ///     stalled). Both are off when 0. Time blocked waiting for input
+    ///     inside a cycle (see Blocked), e.g. an active service's
+    ///     receive, doesn't count toward the stall timeout.
+    ///
+    ///     Only the runner thread records. Any thread may read: counters
+    ///     are relaxed atomics, so a reader sees each one whole but not
+    ///     necessarily all from the same cycle.
+    class ExecStats
+    {
+        public:
+            /// @brief Number of histogram buckets. Covers up to 2^48 ns.
+            static constexpr size_t NumBuckets = 188;
+
+            /// @brief Cycle start time
+            struct Mark
+            {
+                Os::TimeNs_t WallNs;
+                Os::TimeNs_t CpuNs;
+            };
+
+            /// @brief Scope in which the calling thread's running cycle
+            ///     waits for input and can't stall. The stall timeout
+            ///     restarts when the scope ends. No effect outside a cycle.
+            class Blocked
+            {
+                public:
+                    inline Blocked():
+                        Stats(static_cast<ExecStats*>(block()))
+                    {}
+
+                    inline ~Blocked() { unblock(Stats); }
+
+                    Blocked(const Blocked&) = delete;
+                    Blocked& operator=(const Blocked&) = delete;
+
+                private:
+                    ExecStats* const Stats;     //< Nullptr outside a cycle
+            };
+
+            /// @brief Queue wait hooks that run each BlockingMsgQueue sleep
+            ///     as a Blocked scope. Installed by the runners.
+            static const msg::WaitHooks BlockedHooks;
+
+            ExecStats();
+
+            /// @brief Copy a snapshot of other's counters
+            ExecStats(const ExecStats& other);
+
+            ExecStats& operator=(const ExecStats&) = delete;
+
+            /// @brief Set the service's time budget
+            /// @param budget_ns CPU time allowed per cycle. 0 for none.
+            /// @param stall_ns Wall time after which a running cycle is
+            ///     stalled. 0 for none.
+            void set_budget(const Os::TimeNs_t budget_ns, const Os::TimeNs_t stall_ns);
+
+            /// @brief Start a cycle. Runner thread.
+            inline Mark begin()
+            {
+#if ETFW_EXEC_STATS
+                const Mark mark = {Os::Clock::now_ns(),
+                    (ThreadCpuNs != 0) ? ThreadCpuNs : Os::Clock::thread_cpu_ns()};
+                CycleStartNs.store(mark.WallNs, std::memory_order_relaxed);
+                Current = this;
+                return mark;
+#else
+                return {0, 0};
+#endif
+            }
+
+            /// @brief End the cycle started at mark. Runner thread.
+            inline void end(const Mark& mark)
+            {
+#if ETFW_EXEC_STATS
+                const Os::TimeNs_t cpu = Os::Clock::thread_cpu_ns();
+                record(cpu - mark.CpuNs, Os::Clock::now_ns() - mark.WallNs);
+                CycleStartNs.store(0, std::memory_order_relaxed);
+                ThreadCpuNs = cpu;
+                Current = nullptr;
+#else
+                (void)mark;
+#endif
+            }
+
+            /// @brief Make the next cycle on the calling thread read the
+            ///     CPU clock when it begins
+            static inline void resync() { ThreadCpuNs = 0; }
+
+            /// @brief Account for one cycle. Runner thread.
+            /// @param cpu_ns Cycle CPU time
+            /// @param wall_ns Cycle wall time
+            void record(const Os::TimeNs_t cpu_ns, const Os::TimeNs_t wall_ns);
+
+            /// @brief Get the number of cycles completed
+            inline uint64_t cycles() const { return Cycles.load(std::memory_order_relaxed); }
+
+            /// @brief Get the CPU time used by every cycle
+            inline Os::TimeNs_t cpu_total_ns() const { return CpuTotalNs.load(std::memory_order_relaxed); }
+
+            /// @brief Get the wall time spent in every cycle
+            inline Os::TimeNs_t wall_total_ns() const { return WallTotalNs.load(std::memory_order_relaxed); }
+
+            /// @brief Get the most CPU time used by one cycle
+            inline Os::TimeNs_t cpu_max_ns() const { return CpuMaxNs.load(std::memory_order_relaxed); }
+
+            /// @brief Get the least CPU time used by one cycle
+            inline Os::TimeNs_t cpu_min_ns() const { return CpuMinNs.load(std::memory_order_relaxed); }
+
+            /// @brief Get the number of cycles over the CPU budget
+            inline uint64_t overruns() const { return Overruns.load(std::memory_order_relaxed); }
+
+            /// @brief Get the CPU time budget per cycle. 0 if none.
+            inline Os::TimeNs_t budget_ns() const { return BudgetNs.load(std::memory_order_relaxed); }
+
+            /// @brief Get the stall timeout. 0 if none.
+            inline Os::TimeNs_t stall_ns() const { return StallNs.load(std::memory_order_relaxed); }
+
+            /// @brief Get the start time of the running cycle
+            /// @return Os::Clock time. 0 between cycles.
+            inline Os::TimeNs_t cycle_start_ns() const { return CycleStartNs.load(std::memory_order_relaxed); }
+
+            /// @brief Check if the running cycle passed the stall timeout
+            /// @param now_ns Current Os::Clock time
+            bool stalled(const Os::TimeNs_t now_ns) const;
+
+            /// @brief Take the most CPU time used by one cycle since the
+            ///     last call, and start a new window. One reader only.
+            Os::TimeNs_t take_window_max_ns();
+
+            /// @brief Take the least CPU time used by one cycle since the
+            ///     last call, and start a new window. One reader only.
+            /// @return Minimum. Os::TimeNsNever if no cycle completed.
+            Os::TimeNs_t take_window_min_ns();
+
+            /// @brief Copy the CPU time histogram
+            /// @param[out] counts NumBuckets cycle counts
+            void histogram(uint32_t* counts) const;
+
+            /// @brief Get the histogram bucket of a CPU time
+            static size_t bucket(const Os::TimeNs_t ns);
+
+            /// @brief Get the largest CPU time in a histogram bucket
+            static Os::TimeNs_t bucket_max_ns(const size_t bucket);
+
+            /// @brief Estimate a percentile from a histogram
+            /// @param counts NumBuckets cycle counts
+            /// @param pct Percentile, 0 to 100
+            /// @return Upper bound of the bucket holding the percentile. 0
+            ///     if the histogram is empty.
+            static Os::TimeNs_t percentile_ns(const uint32_t* counts, const uint32_t pct);
+
+        private:
+            std::atomic<uint64_t> Cycles;
+            std::atomic<Os::TimeNs_t> CpuTotalNs;
+            std::atomic<Os::TimeNs_t> WallTotalNs;
+            std::atomic<Os::TimeNs_t> CpuMinNs;
+            std::atomic<Os::TimeNs_t> CpuMaxNs;
+            std::atomic<Os::TimeNs_t> WindowMinNs;  //< Reset by the reader
+            std::atomic<Os::TimeNs_t> WindowMaxNs;  //< Reset by the reader
+            std::atomic<uint64_t> Overruns;
+            std::atomic<Os::TimeNs_t> BudgetNs;
+            std::atomic<Os::TimeNs_t> StallNs;
+            std::atomic<Os::TimeNs_t> CycleStartNs; //< 0 between cycles
+            std::atomic<uint32_t> Hist[NumBuckets]; //< CPU time histogram
+
+            /// CPU clock at the end of the calling thread's last cycle. 0
+            /// if it must be read again.
+            static inline thread_local Os::TimeNs_t ThreadCpuNs = 0;
+
+            /// Cycle running on the calling thread. Nullptr between cycles.
+            static inline thread_local ExecStats* Current = nullptr;
+
+            /// @brief Start a Blocked scope
+            /// @return Running cycle, for unblock. Nullptr outside a cycle.
+            static inline void* block()
+            {
+                ExecStats* stats = Current;
+                if (stats != nullptr)
+                {
+                    stats->CycleStartNs.store(0, std::memory_order_relaxed);
+                }
+                return stats;
+            }
+
+            /// @brief End a Blocked scope
+            /// @param stats Return value of block
+            static inline void unblock(void* stats)
+            {
+                if (stats != nullptr)
+                {
+                    static_cast<ExecStats*>(stats)->CycleStartNs.store(
+                        Os::Clock::now_ns(), std::memory_order_relaxed);
+                }
+            }
+    };
+
+}
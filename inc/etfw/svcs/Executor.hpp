@@ -13,7 +13,25 @@
 #include "../status.hpp"
 #include "SvcTypes.hpp"
 #include "App.hpp"
-#include "etl/list.h"
+#include "SvcRegistry.hpp"
+
+/// Number of threads start_all runs app inits on, counting the caller.
+/// 1 runs them one at a time on the caller. Above 1, independent inits
+/// run concurrently, on boot threads with ETFW_BOOT_PRIORITY and
+/// ETFW_BOOT_STACK_SZ rather than the caller's.
+#ifndef ETFW_BOOT_WORKERS
+#define ETFW_BOOT_WORKERS   1
+#endif
+
+/// Boot thread stack size, in 32-bit words. App inits run on it.
+#ifndef ETFW_BOOT_STACK_SZ
+#define ETFW_BOOT_STACK_SZ  OS_THREAD_DEFAULT_STACK_SZ
+#endif
+
+/// Boot thread priority. Applies under a real-time OS_THREAD_SCHED_POLICY.
+#ifndef ETFW_BOOT_PRIORITY
+#define ETFW_BOOT_PRIORITY  0
+#endif
 
 namespace etfw
 {
@@ -32,6 +50,9 @@ namespace etfw
                     UNKNOWN_ID,
                     INITIALIZATION_ERR,
                     START_FAILURE,
+                    STOP_TIMEOUT,
+                    DEPENDENCY_ERR,
+                    STOP_FAILURE,
 
                     COUNT
                 };
@@ -45,7 +66,10 @@ namespace etfw
                     "Service is already running",
                     "Requested id is unregistered",
                     "Svc initialization error",
-                    "Service start failure"
+                    "Service start failure",
+                    "Service did not stop in time",
+                    "Init dependency unregistered, failed or cyclic",
+                    "Service stop failure"
                 };
             };
 
@@ -63,9 +87,16 @@ namespace etfw
             };
             
 
+            /// @brief Boot durations of one app in the last start_all
+            struct BootTimes
+            {
+                Os::TimeNs_t InitNs;    //< Init duration. 0 if not run.
+                Os::TimeNs_t StartNs;   //< Start duration. 0 if not run.
+            };
+
             using Status = EtfwStatus<ExecutorStatusTrait>;
             using Node_t = iApp*;
-            using iAppContainer = etl::ilist<Node_t>;
+            using iAppContainer = iSvcTable<iApp>;
 
             /// @brief Registers an application. The executor will manage all registered applications.
             /// @param app Application to register
@@ -75,19 +106,60 @@ namespace etfw
             Status register_app(iApp* app);
 
             /// @brief Initializes and starts all registered apps.
-            /// @details This method will initialize and start all registered apps. If an app
-            ///          is already initialized, it skip initialization and immediately try to
-            ///          start the app. Likewise, if an app has already been started, the start
-            ///          sequence is skipped. If app initialization or start fails, an error
-            ///          message will be logged, and the next app in the is processed.
-            /// @return Operation status. Always successful.
-            /// @retval Status::Code::OK
+            /// @details Apps are initialized in dependency order (see
+            ///          iApp::init_deps): an app's init runs once the inits of
+            ///          the apps it depends on succeed. Inits run on the
+            ///          caller, unless ETFW_BOOT_WORKERS is above 1: then
+            ///          independent inits run concurrently on up to that many
+            ///          threads, the caller included, and an init may run on
+            ///          a boot thread. Apps are then started one at a time on
+            ///          the caller, each after the apps it depends on.
+            ///
+            ///          Initialized or started apps skip that step. An app
+            ///          whose init or start fails is logged and skipped, along
+            ///          with the apps depending on it. So are apps depending
+            ///          on an unregistered app or on a dependency cycle. Each
+            ///          app's init and start durations are logged and kept
+            ///          (see boot_times). Executors boot one at a time.
+            /// @return Operation status
+            /// @retval Status::Code::OK Every app started
+            /// @retval Status::Code::INITIALIZATION_ERR An app init failed
+            /// @retval Status::Code::START_FAILURE An app start failed
+            /// @retval Status::Code::DEPENDENCY_ERR An app was skipped for
+            ///     its dependencies
             Status start_all();
 
+            /// @brief Get an app's boot durations in the last start_all.
+            ///     Waits for a start_all in progress, so must not be called
+            ///     from an app's init or start.
+            /// @param id App ID
+            /// @param[out] times Init and start durations
+            /// @return False if the app wasn't registered at the time
+            bool boot_times(const SvcId_t id, BootTimes& times) const;
+
             Status start(const SvcId_t app_id);
 
+            /// @brief Stops all started apps and waits for them to finish
+            /// @details Apps stop in reverse init dependency order (see
+            ///     iApp::init_deps): an app is asked to stop once every app
+            ///     depending on it has finished. Apps that don't depend on
+            ///     each other stop in parallel. Apps on a dependency cycle,
+            ///     or depending on an app that didn't stop in time, are
+            ///     stopped last, together. Each app's shutdown latency is
+            ///     logged (see iSvcRunner::stop_latency_ns).
+            /// @return Operation status
+            /// @retval Status::Code::OK Every app stopped
+            /// @retval Status::Code::STOP_TIMEOUT An app was still running
+            ///     ETFW_STOP_TIMEOUT_MS after the stop
             Status stop_all();
 
+            /// @brief Stops a started app. Doesn't wait for it to finish.
+            /// @param app_id App ID
+            /// @return Operation status
+            /// @retval Status::Code::OK The app was asked to stop, or
+            ///     wasn't running
+            /// @retval Status::Code::UNKNOWN_ID No app has the ID
+            /// @retval Status::Code::STOP_FAILURE The app's stop failed
             Status stop(const SvcId_t app_id);
 
             Status run() { return start_all(); }
@@ -95,23 +167,73 @@ namespace etfw
             Status exit() { return stop_all(); }
 
         protected:
-            iExecutor(iAppContainer& apps, const size_t max_num_apps):
+            /// @brief Boot progress of one app
+            enum class BootState : uint8_t
+            {
+                WAITING,        //< Waiting on dependency inits
+                READY,          //< Queued for init
+                INITIALIZED,
+                STARTED,
+                FAILED
+            };
+
+            /// @brief Boot record of one app. start_all scratch space.
+            struct BootRecord
+            {
+                iApp* App;
+                BootTimes Times;
+                BootState State;
+                Status::Code Err;   //< Why the app failed
+                size_t Waiting;     //< Dependency inits still to succeed
+                size_t Ready;       //< Record queued in this ready slot
+            };
+
+            iExecutor(iAppContainer& apps, BootRecord* boot):
                 Apps(apps),
-                ContainerSize(max_num_apps)
+                Boot(boot),
+                NumBooted(0)
             {}
             ~iExecutor() = default;
         
         private:
-            iAppContainer& Apps;
-            const size_t ContainerSize;
+            struct BootQueue;
 
-            Node_t find(const SvcId_t id);
+            iAppContainer& Apps;        //< Indexed by app ID
+            BootRecord* const Boot;     //< One record per app slot
+            size_t NumBooted;           //< Records of the last start_all
 
-            bool is_registered(const SvcId_t id);
+            inline Node_t find(const SvcId_t id) { return Apps.find(id); }
 
-            bool is_registered(const iApp& app);
+            inline bool is_registered(const SvcId_t id) { return Apps.contains(id); }
+
+            inline bool is_registered(const iApp& app) { return Apps.contains(app.id()); }
 
             Status start_svc(iApp* app);
+
+            /// @brief Check if an app still running, or stopping, depends
+            ///     on an app
+            bool has_running_dependent(const SvcId_t id) const;
+
+            /// @brief Find the boot record of an app
+            /// @return Record index. NumBooted if there is none.
+            size_t boot_find(const SvcId_t id) const;
+
+            /// @brief Init queued apps until none are queued or running
+            void boot_init(BootQueue& queue);
+
+            /// @brief Boot thread routine
+            static void boot_thread(void* queue);
+
+            /// @brief Settle an app's init, then queue or fail the apps
+            ///     waiting on it. Queue lock held.
+            /// @param idx Record index
+            /// @param state INITIALIZED or FAILED
+            /// @param err Failure reason
+            void boot_resolve(BootQueue& queue, const size_t idx,
+                const BootState state, const Status::Code err = Status::Code::OK);
+
+            /// @brief Start initialized apps in dependency order
+            void boot_start();
     };
 
     template <size_t MAX_NUM_APPS>
@@ -121,11 +243,56 @@ namespace etfw
             using Base_t = iExecutor;
 
             Executor():
-                Base_t(Apps, MAX_NUM_APPS)
+                Base_t(Apps, Boot)
             {}
 
         private:
-            etl::list<Base_t::Node_t, MAX_NUM_APPS> Apps;
+            SvcTable<iApp, MAX_NUM_APPS> Apps;
+            Base_t::BootRecord Boot[MAX_NUM_APPS];
+    };
+
+    /// @brief Checks at compile time that app init dependencies form no
+    ///     cycle. Dependencies on apps outside the set are ignored.
+    /// @tparam ...TApps App types, each with ID and InitDeps_t
+    template <typename... TApps>
+    struct init_deps_acyclic
+    {
+        private:
+            static constexpr size_t N = sizeof...(TApps);
+
+            /// @brief Remove apps whose dependencies in the set are all
+            ///     removed, until none is left or none can be
+            static constexpr bool check()
+            {
+                constexpr SvcId_t ids[N + 1] = {TApps::ID..., 0};
+                constexpr bool (*depends_on[N + 1])(SvcId_t) =
+                    {&TApps::InitDeps_t::contains..., nullptr};
+                bool removed[N + 1] = {};
+                size_t num_removed = 0;
+                bool progress = true;
+                while (progress)
+                {
+                    progress = false;
+                    for (size_t i = 0; i < N; i++)
+                    {
+                        bool ready = !removed[i];
+                        for (size_t j = 0; ready && j < N; j++)
+                        {
+                            ready = removed[j] || !depends_on[i](ids[j]);
+                        }
+                        if (ready)
+                        {
+                            removed[i] = true;
+                            num_removed++;
+                            progress = true;
+                        }
+                    }
+                }
+                return num_removed == N;
+            }
+
+        public:
+            static constexpr bool value = check();
     };
 
     /// @brief Static storage and run-time manager for applications.
@@ -137,6 +304,8 @@ namespace etfw
     class AppExecutor : public Executor<sizeof...(TApps)>
     {
         static_assert(all_derived_from<iApp, TApps...>::value);
+        static_assert(init_deps_acyclic<TApps...>::value,
+            "App init dependencies form a cycle");
 
         public:
             using AppVariant_t = etl::variant<TApps...>;
@@ -162,14 +331,14 @@ namespace etfw
             AppStorage_t AppStorage;
 
             /// @brief Constructs and returns an application in place
+            /// @details Returned as a prvalue, so it is built directly in
+            ///     its storage slot. Apps are never copied or moved.
             /// @tparam T 
             /// @return 
             template <typename T>
             static AppVariant_t construct_var_in_place()
             {
-                AppVariant_t var;
-                var.template emplace<T>();  // construct in-place
-                return var;
+                return AppVariant_t(etl::in_place_type_t<T>());
             }
 
             /// @brief Compile-time app storage builder
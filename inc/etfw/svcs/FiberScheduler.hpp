@@ -0,0 +1,84 @@
+#pragma once
+
+#include "os/EventCount.hpp"
+#include "os/Fiber.hpp"
+#include "os/Mutex.hpp"
+#include "os/Task.hpp"
+#include <atomic>
+#include <cstddef>
+
+/// Maximum number of fibers the scheduler thread runs
+#ifndef FIBER_SCHED_MAX_FIBERS
+#define FIBER_SCHED_MAX_FIBERS  256
+#endif
+
+/// Scheduler thread stack size, in 32-bit words. Fibers run on their own
+/// stacks, so this only covers the scheduling loop.
+#ifndef FIBER_SCHED_STACK_SZ
+#define FIBER_SCHED_STACK_SZ    OS_THREAD_DEFAULT_STACK_SZ
+#endif
+
+/// Scheduler thread priority. Applies under a real-time OS_THREAD_SCHED_POLICY.
+#ifndef FIBER_SCHED_PRIORITY
+#define FIBER_SCHED_PRIORITY    0
+#endif
+
+namespace etfw {
+
+    /// @brief Runs fiber services (see FiberRunner) on one OS thread
+    /// @details Fibers are resumed round robin. A ready fiber runs until
+    ///     it yields or parks. A parked fiber is resumed once it is
+    ///     unparked or its deadline passes. When every fiber is parked
+    ///     the thread sleeps until the earliest deadline or an unpark.
+    ///
+    ///     The thread is started by the first fiber service to start and
+    ///     runs until the scheduler is destroyed.
+    class FiberScheduler
+    {
+        public:
+            static constexpr size_t MaxFibers = FIBER_SCHED_MAX_FIBERS;
+
+            /// @brief Get the shared scheduler
+            static FiberScheduler& instance();
+
+            /// @brief Stops and joins the scheduler thread
+            ~FiberScheduler();
+
+            /// @brief Add a fiber. Done once per fiber.
+            void add(Os::Fiber& fiber);
+
+            /// @brief Start the scheduler thread if it isn't running
+            /// @return False if the thread failed to start
+            bool start();
+
+            /// @brief Wake the scheduler after a fiber became ready. Any thread.
+            inline void notify() { idle_.notify(); }
+
+            /// @brief Get the number of fiber switches made
+            inline size_t switches() const { return switches_.load(std::memory_order_relaxed); }
+
+            /// @brief Get the number of times the scheduler went idle
+            inline size_t sleeps() const { return sleeps_.load(std::memory_order_relaxed); }
+
+        private:
+            Os::Thread thread_;
+            Os::EventCount idle_;           //< Scheduler sleeps here
+            const Os::EventCount::NotifyHook wake_hook_;
+            Os::Mutex lock_;                //< Guards adds and startup
+            Os::Fiber* fibers_[MaxFibers];
+            std::atomic<size_t> num_fibers_;
+            std::atomic<size_t> switches_;
+            std::atomic<size_t> sleeps_;
+            std::atomic<bool> running_;
+            alignas(16) Os::Thread::Config::Stack::Buf_t stack_[FIBER_SCHED_STACK_SZ];
+
+            FiberScheduler();
+
+            /// @brief Scheduler thread routine
+            static void thread_main(void* sched);
+
+            /// @brief Fiber wake hook. Wakes the scheduler.
+            static void on_wake(void* sched);
+    };
+
+}
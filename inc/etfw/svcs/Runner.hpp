@@ -2,16 +2,22 @@
 #pragma once
 
 #include "os/Task.hpp"
+#include "os/EventCount.hpp"
+#include "os/Fiber.hpp"
 #include "etfw_assert.hpp"
 #include "iSvc.hpp"
+#include "ExecStats.hpp"
+#include <atomic>
 
-/// Time to wait between checking if child tasks have exited
-#ifndef ETFW_TASK_CLEANUP_DELAY
-#define ETFW_TASK_CLEANUP_DELAY     1000
+/// Time a stop waits for the runners it stopped to finish
+#ifndef ETFW_STOP_TIMEOUT_MS
+#define ETFW_STOP_TIMEOUT_MS        1000
 #endif
 
 namespace etfw {
 
+    class SvcPool;
+
     class iSvcRunner
     {
         public:
@@ -46,14 +52,22 @@ namespace etfw {
 
             virtual RunStatus stop() = 0;
 
-            inline State_t state() const { return State; }
+            inline State_t state() const { return State.load(std::memory_order_acquire); }
 
             inline iSvc* svc() { return Svc; }
 
+            /// @brief Get the service's execution time accounting
+            inline const ExecStats& exec_stats() const { return Exec; }
+
+            /// @brief Get the service's execution time accounting, e.g.
+            ///     to set its budget
+            inline ExecStats& exec_stats() { return Exec; }
+
             inline bool is_active(void) const
             {
-                return ((State == State_t::STARTING) || 
-                        (State == State_t::ACTIVE));
+                const State_t state = State.load(std::memory_order_acquire);
+                return ((state == State_t::STARTING) ||
+                        (state == State_t::ACTIVE));
             }
 
             inline bool is_stopped(void) const
@@ -61,17 +75,83 @@ namespace etfw {
                 return (!is_active());
             }
 
-            void stop_children();
+            /// @brief Check if the runner is done running the service:
+            ///     never started, stopped, exited or failed
+            inline bool is_finished(void) const
+            {
+                // Acquire pairs with the release in finish, so the
+                // service's last writes are seen once it reads finished
+                const State_t state = State.load(std::memory_order_acquire);
+                return ((state == State_t::CREATED) ||
+                        (state == State_t::INITIALIZED) ||
+                        (state == State_t::STOPPED) ||
+                        (state == State_t::EXITED) ||
+                        (state == State_t::ERROR));
+            }
+
+            /// @brief Wait for the runner to finish, e.g. after stop
+            /// @param deadline_ns Os::Clock time to give up at
+            /// @return True if the runner finished in time
+            virtual bool wait_finished(const Os::TimeNs_t deadline_ns);
+
+            /// @brief Get the time the last stop took, from the request
+            ///     to the runner finishing
+            /// @return Nanoseconds. 0 until a stop has finished.
+            inline Os::TimeNs_t stop_latency_ns() const { return StopLatencyNs; }
+
+            /// @brief Get the Os::Clock time of the last stop request. 0 if none.
+            inline Os::TimeNs_t stop_requested_ns() const { return StopRequestNs; }
+
+            /// @brief Stop the service's children
+            /// @details Every child is asked to stop before any is waited
+            ///     for, so they stop in parallel.
+            /// @param wait Wait up to ETFW_STOP_TIMEOUT_MS for the children
+            ///     to finish. Runners sharing their thread with others
+            ///     (pooled, fiber) must not wait.
+            void stop_children(const bool wait);
 
         protected:
             iSvc* Svc;
-            State_t State;
-
-            /// @brief Interface to Svc logger.
+            std::atomic<State_t> State;     //< Read by other threads, e.g. stop and wait_finished
+            ExecStats Exec;             //< Recorded around each service cycle
+            Os::TimeNs_t StopRequestNs; //< Time of the last stop request
+            Os::TimeNs_t StopLatencyNs; //< Duration of the last stop
+
+            /// @brief Move a starting or active service to STOP_REQUESTED
+            ///     and wake it out of any receive blocked on its event
+            ///     sources
+            /// @return False if the service wasn't starting or active
+            bool request_stop();
+
+            /// @brief Move to a final state (STOPPED, EXITED or ERROR) and
+            ///     wake the threads waiting for the runner to finish
+            void finish(const State_t state);
+
+            /// @brief Drop wakes left on the service's event sources by
+            ///     the last stop. Called by start.
+            void clear_wakes();
+
+            /// @brief Interface to Svc logger. Returns before formatting if
+            ///     the level is filtered out (see iSvc::log_enabled).
             /// @param level Log severity level
             /// @param format String to format and write
             /// @param Args String format arguments
-            void log(const LogLevel level, const char* format, ...);
+            template <typename... TArgs>
+            inline void log(const LogLevel level, const char* format, TArgs... args)
+            {
+                if (Svc != nullptr && Svc->log_enabled(level))
+                {
+                    Svc->log(level, format, args...);
+                }
+            }
+
+        private:
+            /// @brief Notified whenever any runner finishes
+            /// @details Runners finish rarely, so one event for all of them
+            ///     costs a waiter only the odd wake meant for another
+            ///     runner, and keeps wait state out of every runner.
+            ///     Waiters recheck their own runner.
+            static Os::EventCount& finished_event();
     };
 
 
@@ -84,17 +164,80 @@ namespace etfw {
             RunStatus stop() override;
     };
 
+    /// @brief Runs a service on the shared worker pool (see SvcPool)
+    ///     instead of a thread of its own
+    /// @details pre_run_init, process and the service's event sources
+    ///     are run by whichever pool worker picks the service up, one
+    ///     step at a time, and never on two workers at once. process must
+    ///     not block.
+    ///
+    ///     A service without event sources has nothing to sleep on, so
+    ///     process is called every SVC_POOL_POLL_MS. A service with event
+    ///     sources is parked after a step in which no source had work,
+    ///     and runs again when a source is notified or its earliest
+    ///     deadline passes, so idle services cost no CPU.
+    class PooledRunner : public iSvcRunner
+    {
+        public:
+            PooledRunner(iSvc* svc);
+
+            RunStatus start() override;
+
+            /// @brief Requests a stop. The service is stopped and cleaned
+            ///     up on a pool worker. A service still starting stops once
+            ///     its pre_run_init returns.
+            RunStatus stop() override;
+
+            /// @brief Get the number of steps run
+            inline size_t runs() const { return Runs.load(std::memory_order_relaxed); }
+
+            friend class SvcPool;
+
+        private:
+            /// @brief Pool scheduling state
+            enum class Sched_t : uint8_t
+            {
+                IDLE,       //< Parked
+                QUEUED,     //< In a worker deque or the injection queue
+                RUNNING,    //< Running on a worker
+                NOTIFIED,   //< Running, and must be queued again after
+            };
+
+            std::atomic<Sched_t> Sched;
+            std::atomic<Os::TimeNs_t> WakeNs;   //< Parked deadline. Read by the pool.
+            std::atomic<size_t> Runs;
+            bool Inited;                        //< pre_run_init ran. Cleanup is due on stop.
+            Os::EventCount Event;               //< Notified by the sources
+            const Os::EventCount::NotifyHook Hook;
+            msg::EventSources_t Sources;
+
+            /// @brief Run one step of the service. Called by a pool worker.
+            /// @return Time to run the service again without a notify. 0 to
+            ///     run it again now, Os::TimeNsNever to wait for a notify.
+            Os::TimeNs_t run_once();
+
+            /// @brief Event notify hook. Schedules the runner.
+            static void on_notify(void* runner);
+    };
+
     class iActiveRunnerExt : public iSvcRunner
     {
         public:
             using Priority_t = Os::Thread::Config::Priority_t;
             using Stack_t = Os::Thread::Config::Stack::Buf_t;
             using StackBuf_t = Os::Thread::Config::Stack::BufPtr_t;
+            using CpuMask_t = Os::Thread::Config::CpuMask_t;
 
+            /// @param svc Service to run
+            /// @param priority Task priority. Applies under a real-time OS_THREAD_SCHED_POLICY.
+            /// @param stack_buf Task stack
+            /// @param stack_sz Task stack size in Stack_t words
+            /// @param affinity CPUs the task may run on. 0 for any CPU.
             iActiveRunnerExt(iSvc* svc,
                 Priority_t priority,
                 const StackBuf_t stack_buf,
-                const size_t stack_sz
+                const size_t stack_sz,
+                const CpuMask_t affinity = 0
             );
 
             /**
@@ -111,10 +254,27 @@ namespace etfw {
              */
             RunStatus stop() override;
 
+            /// @brief Wait for the service to finish and its thread to exit
+            bool wait_finished(const Os::TimeNs_t deadline_ns) override;
+
+        protected:
+            /**
+             * @brief Runs one iteration of the main loop. Calls the
+             *  service's process method.
+             * 
+             * @return Service run state
+             */
+            virtual iSvc::RunStatus run_once();
+
+            /// @brief Called by start once it has claimed a stopped runner,
+            ///     before the thread is created
+            virtual void prepare_start() {}
+
         private:
             Priority_t TaskPriority;
             const StackBuf_t StackBuf;
             const size_t StackSz;
+            const CpuMask_t Affinity;
             Os::Thread task_;
 
             /**
@@ -154,24 +314,143 @@ namespace etfw {
             using Base_t = iActiveRunnerExt;
 
             iActiveRunner(iSvc* svc,
-                Priority_t priority
+                Priority_t priority,
+                CpuMask_t affinity = 0
             ):
-                Base_t(svc, priority, Stack, TStackSz)
+                Base_t(svc, priority, Stack, TStackSz, affinity)
             {}
 
         private:
-            Base_t::Stack_t Stack[TStackSz];
+            alignas(16) Base_t::Stack_t Stack[TStackSz];
     };
 
-    template <iActiveRunnerExt::Priority_t TPriority, size_t TStackSz>
+    template <iActiveRunnerExt::Priority_t TPriority, size_t TStackSz,
+        iActiveRunnerExt::CpuMask_t TAffinity = 0>
     class ActiveRunner : public iActiveRunner<TStackSz>
     {
         public:
             using Base_t = iActiveRunner<TStackSz>;
 
             ActiveRunner(iSvc* svc):
-                Base_t(svc, TPriority)
+                Base_t(svc, TPriority, TAffinity)
             {}
     };
 
+    /// @brief Active runner that sleeps on the service's event sources
+    ///     (iSvc::event_sources) instead of calling process in a loop
+    /// @details Each iteration dispatches every source without blocking,
+    ///     then sleeps until a source is notified or the earliest source
+    ///     deadline passes. An idle service makes no syscalls and uses no
+    ///     CPU. Sources are attached when the runner starts.
+    ///
+    ///     The service's process method is still called after each round
+    ///     of dispatching, so it must not block. Services without a
+    ///     run_loop don't need one.
+    class iEventRunnerExt : public iActiveRunnerExt
+    {
+        public:
+            iEventRunnerExt(iSvc* svc,
+                Priority_t priority,
+                const StackBuf_t stack_buf,
+                const size_t stack_sz,
+                const CpuMask_t affinity = 0
+            );
+
+            /**
+             * @brief Requests a stop and wakes the runner
+             * 
+             * @return RunStatus 
+             */
+            RunStatus stop() override;
+
+            /// @brief Get the number of times the runner went to sleep
+            inline size_t sleeps() const { return Sleeps.load(std::memory_order_relaxed); }
+
+        protected:
+            iSvc::RunStatus run_once() override;
+
+            /// @brief Attaches the service's event sources
+            void prepare_start() override;
+
+        private:
+            Os::EventCount Event;
+            msg::EventSources_t Sources;
+            std::atomic<size_t> Sleeps;     //< Iterations with no work
+    };
+
+    template <iActiveRunnerExt::Priority_t TPriority, size_t TStackSz,
+        iActiveRunnerExt::CpuMask_t TAffinity = 0>
+    class EventRunner : public iEventRunnerExt
+    {
+        public:
+            using Base_t = iEventRunnerExt;
+
+            EventRunner(iSvc* svc):
+                Base_t(svc, TPriority, Stack, TStackSz, TAffinity)
+            {}
+
+        private:
+            alignas(16) Base_t::Stack_t Stack[TStackSz];
+    };
+
+    /// @brief Runs a service as a fiber on the shared fiber scheduler
+    ///     thread (see FiberScheduler) instead of a thread of its own
+    /// @details The service's process method runs on the runner's stack
+    ///     and the fiber yields after every call, so any number of fiber
+    ///     services share one OS thread. A blocking read of an
+    ///     EventCount-backed queue (e.g. BlockingMsgQueue::front) parks
+    ///     the fiber until the queue is notified rather than blocking the
+    ///     thread. Other blocking calls (sleeps, sockets) block every
+    ///     fiber and must be avoided.
+    ///
+    ///     The stack is painted on start so stack_used reports its
+    ///     high-water mark.
+    class iFiberRunnerExt : public iSvcRunner
+    {
+        public:
+            using Stack_t = Os::Fiber::Stack_t::Buf_t;
+            using StackBuf_t = Os::Fiber::Stack_t::BufPtr_t;
+
+            /// @param svc Service to run
+            /// @param stack_buf Fiber stack
+            /// @param stack_sz Fiber stack size in Stack_t words
+            iFiberRunnerExt(iSvc* svc,
+                const StackBuf_t stack_buf,
+                const size_t stack_sz
+            );
+
+            RunStatus start() override;
+
+            RunStatus stop() override;
+
+            /// @brief Get the service's fiber
+            inline const Os::Fiber& fiber() const { return fiber_; }
+
+            /// @brief Get the stack high-water mark in bytes
+            inline size_t stack_used() const { return fiber_.stack_used(); }
+
+        private:
+            const StackBuf_t StackBuf;
+            const size_t StackSz;
+            Os::Fiber fiber_;
+            bool added_;            //< Fiber added to the scheduler
+
+            /// @brief Fiber routine. Runs the service state machine.
+            static void fiber_sm(void* runner);
+    };
+
+    template <size_t TStackSz>
+    class FiberRunner : public iFiberRunnerExt
+    {
+        public:
+            using Base_t = iFiberRunnerExt;
+
+            FiberRunner(iSvc* svc):
+                Base_t(svc, Stack, TStackSz)
+            {}
+
+        private:
+            alignas(16) Base_t::Stack_t Stack[TStackSz];
+    };
+
 }
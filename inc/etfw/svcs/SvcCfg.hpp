@@ -7,6 +7,19 @@
 #include <string>
 #include "CommonTraits.hpp"
 
+/// Default CPU time budget of one service cycle, in microseconds. 0 for
+/// none. Services override it with a Cfg::EXEC_BUDGET_US member.
+#ifndef SVC_EXEC_BUDGET_US
+#define SVC_EXEC_BUDGET_US  0
+#endif
+
+/// Default time one service cycle may run before it is stalled, in
+/// milliseconds. 0 for none. Services override it with a
+/// Cfg::EXEC_STALL_MS member.
+#ifndef SVC_EXEC_STALL_MS
+#define SVC_EXEC_STALL_MS   0
+#endif
+
 namespace etfw {
 
     class iSvc;
@@ -42,12 +55,53 @@ namespace etfw {
         using CmdHandler_t = MsgHandler_t<TConcreteSvc, TMsgs...>;
     };
 
-    template <uint8_t TPriority, size_t TStackSz>
+    /// @brief Active service trait
+    /// @tparam TPriority Task priority. Applies under a real-time OS_THREAD_SCHED_POLICY.
+    /// @tparam TStackSz Task stack size in 32-bit words. The task runs on
+    ///     this buffer, so it must be at least the OS minimum.
+    /// @tparam TAffinity CPUs the task may run on, bit N for CPU N. 0 for
+    ///     any CPU.
+    template <uint8_t TPriority, size_t TStackSz,
+        iActiveRunnerExt::CpuMask_t TAffinity = 0>
     struct ActiveSvcCfg : public SvcRunTrait
     {
         static constexpr uint8_t PRIORITY = TPriority;
         static constexpr size_t STACK_SZ = TStackSz;
-        using Runner_t = etfw::ActiveRunner<TPriority, TStackSz>;
+        static constexpr iActiveRunnerExt::CpuMask_t AFFINITY = TAffinity;
+        using Runner_t = etfw::ActiveRunner<TPriority, TStackSz, TAffinity>;
+    };
+
+    /// @brief Pooled service trait. The service runs on the shared worker
+    ///     pool (see SvcPool) rather than a thread of its own, so its
+    ///     process method must not block. Event sources are supported.
+    struct PooledSvcCfg : public SvcRunTrait
+    {
+        using Runner_t = etfw::PooledRunner;
+    };
+
+    /// @brief Fiber service trait. The service runs as a fiber on the
+    ///     shared fiber scheduler thread (see FiberScheduler).
+    /// @tparam TStackSz Fiber stack size in 32-bit words
+    template <size_t TStackSz>
+    struct FiberSvcCfg : public SvcRunTrait
+    {
+        static constexpr size_t STACK_SZ = TStackSz;
+        using Runner_t = etfw::FiberRunner<TStackSz>;
+    };
+
+    /// @brief Event-driven active service trait. The service's task sleeps
+    ///     on the sources returned by iSvc::event_sources.
+    /// @tparam TPriority Task priority. Applies under a real-time OS_THREAD_SCHED_POLICY.
+    /// @tparam TStackSz Task stack size in 32-bit words
+    /// @tparam TAffinity CPUs the task may run on. 0 for any CPU.
+    template <uint8_t TPriority, size_t TStackSz,
+        iActiveRunnerExt::CpuMask_t TAffinity = 0>
+    struct EventSvcCfg : public SvcRunTrait
+    {
+        static constexpr uint8_t PRIORITY = TPriority;
+        static constexpr size_t STACK_SZ = TStackSz;
+        static constexpr iActiveRunnerExt::CpuMask_t AFFINITY = TAffinity;
+        using Runner_t = etfw::EventRunner<TPriority, TStackSz, TAffinity>;
     };
 
     //template <etfw::SvcId_t TId, typename TRunnerTrait>
@@ -88,10 +142,69 @@ namespace etfw {
             //using ChildrenTs = TypeList<TChildren...>;
     };
 
-    template <uint8_t TPriority, size_t TStackSz>
+    template <uint8_t TPriority, size_t TStackSz,
+        iActiveRunnerExt::CpuMask_t TAffinity = 0>
     struct ChildSvcCfg
     {
-        using Runner_t = etfw::ActiveRunner<TPriority, TStackSz>;
+        using Runner_t = etfw::ActiveRunner<TPriority, TStackSz, TAffinity>;
+    };
+
+    /// @brief CPU time budget of one service cycle, in microseconds.
+    ///     Cfg::EXEC_BUDGET_US if declared. 0 for none.
+    template <typename T, typename = void>
+    struct svc_exec_budget_us : std::integral_constant<uint32_t, SVC_EXEC_BUDGET_US> {};
+
+    template <typename T>
+    struct svc_exec_budget_us<T, std::void_t<decltype(T::EXEC_BUDGET_US)>>
+        : std::integral_constant<uint32_t, T::EXEC_BUDGET_US> {};
+
+    /// @brief Time one service cycle may run before it is stalled, in
+    ///     milliseconds. Cfg::EXEC_STALL_MS if declared. 0 for none.
+    template <typename T, typename = void>
+    struct svc_exec_stall_ms : std::integral_constant<uint32_t, SVC_EXEC_STALL_MS> {};
+
+    template <typename T>
+    struct svc_exec_stall_ms<T, std::void_t<decltype(T::EXEC_STALL_MS)>>
+        : std::integral_constant<uint32_t, T::EXEC_STALL_MS> {};
+
+    /// @brief Lowest log level built into a service. Cfg::LOG_LEVEL if
+    ///     declared, but never below ETF_LOG_LEVEL.
+    template <typename T, typename = void>
+    struct svc_log_level : std::integral_constant<LogLevel, LogLevelMin> {};
+
+    template <typename T>
+    struct svc_log_level<T, std::void_t<decltype(T::LOG_LEVEL)>>
+        : std::integral_constant<LogLevel,
+            (T::LOG_LEVEL > LogLevelMin) ? T::LOG_LEVEL : LogLevelMin> {};
+
+    /// @brief Init dependencies of an app: the IDs of the apps whose init
+    ///     must succeed before its own (see iExecutor::start_all).
+    ///     Declared in the app's Cfg as InitDeps.
+    /// @tparam ...TIds App IDs
+    template <SvcId_t... TIds>
+    struct SvcDeps
+    {
+        static constexpr size_t COUNT = sizeof...(TIds);
+
+        /// @brief IDs, plus a pad entry so an empty list is a valid array
+        static constexpr SvcId_t IDS[COUNT + 1] = {TIds..., 0};
+
+        /// @brief Check if the list holds an ID
+        static constexpr bool contains(const SvcId_t id)
+        {
+            return ((id == TIds) || ... || false);
+        }
+    };
+
+    /// @brief Init dependencies of a service. Cfg::InitDeps if declared.
+    ///     None otherwise.
+    template <typename T, typename = void>
+    struct svc_init_deps { using type = SvcDeps<>; };
+
+    template <typename T>
+    struct svc_init_deps<T, std::void_t<typename T::InitDeps>>
+    {
+        using type = typename T::InitDeps;
     };
 
     template<typename T, typename = void>
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "Runner.hpp"
+#include "WorkDeque.hpp"
+#include "os/EventCount.hpp"
+#include "os/Mutex.hpp"
+#include "os/Task.hpp"
+#include <atomic>
+#include <cstddef>
+
+/// Number of worker threads in the shared service pool
+#ifndef SVC_POOL_NUM_WORKERS
+#define SVC_POOL_NUM_WORKERS    4
+#endif
+
+/// Pool worker stack size, in 32-bit words
+#ifndef SVC_POOL_STACK_SZ
+#define SVC_POOL_STACK_SZ       OS_THREAD_DEFAULT_STACK_SZ
+#endif
+
+/// Pool worker priority. Applies under a real-time OS_THREAD_SCHED_POLICY.
+#ifndef SVC_POOL_PRIORITY
+#define SVC_POOL_PRIORITY       0
+#endif
+
+/// Period a pooled service without event sources runs at, in
+/// milliseconds. 0 runs it again as soon as a worker is free.
+#ifndef SVC_POOL_POLL_MS
+#define SVC_POOL_POLL_MS        1
+#endif
+
+/// Maximum number of services that can run on the pool. Power of 2.
+#ifndef SVC_POOL_MAX_SVCS
+#define SVC_POOL_MAX_SVCS       128
+#endif
+
+namespace etfw {
+
+    /// @brief Shared worker pool for pooled services (see PooledRunner)
+    /// @details Each worker owns a Chase-Lev deque of runnable services.
+    ///     A worker runs one step of the oldest service in its own deque
+    ///     and, if the service is still runnable, pushes it back, so
+    ///     runnable services on a worker take turns round robin.
+    ///     Services made runnable from outside the pool go through a
+    ///     locked injection queue. A worker with no work of its own takes
+    ///     from the injection queue, then steals the oldest service from
+    ///     the other workers, and sleeps if there is nothing to steal.
+    ///
+    ///     Every service has a single scheduling token, so it is queued
+    ///     in at most one place and never runs on two workers at once.
+    ///     Workers are started by the first pooled service to start and
+    ///     run until the pool is destroyed.
+    class SvcPool
+    {
+        public:
+            static constexpr size_t NumWorkers = SVC_POOL_NUM_WORKERS;
+            static constexpr size_t MaxSvcs = SVC_POOL_MAX_SVCS;
+
+            static_assert(NumWorkers > 0, "Service pool needs at least one worker");
+
+            /// @brief Pool statistics snapshot
+            struct Stats
+            {
+                size_t Runs;    //< Service steps run
+                size_t Steals;  //< Services taken from another worker
+                size_t Sleeps;  //< Times a worker went idle
+            };
+
+            /// @brief Get the shared pool
+            static SvcPool& instance();
+
+            /// @brief Stops and joins the workers
+            ~SvcPool();
+
+            /// @brief Add a service. Done once per runner, on its first start.
+            void add(PooledRunner& runner);
+
+            /// @brief Start the workers if they aren't running
+            /// @return False if a worker failed to start
+            bool start();
+
+            /// @brief Make a service runnable. Any thread.
+            void schedule(PooledRunner& runner);
+
+            /// @brief Get the statistics of one worker
+            Stats worker_stats(const size_t idx) const;
+
+            /// @brief Get the statistics of every worker combined
+            Stats stats() const;
+
+        private:
+            using Deque_t = WorkDeque<PooledRunner*, MaxSvcs>;
+
+            /// Takes between checks of the injection queue ahead of the
+            /// worker's own deque
+            static constexpr size_t InjectInterval = 31;
+
+            struct alignas(64) Worker
+            {
+                SvcPool* Pool;
+                size_t Idx;
+                Os::Thread Thread;
+                Deque_t Deque;
+                std::atomic<size_t> Runs;
+                std::atomic<size_t> Steals;
+                std::atomic<size_t> Sleeps;
+                size_t Takes;                   //< Worker thread only
+                alignas(16) Os::Thread::Config::Stack::Buf_t Stack[SVC_POOL_STACK_SZ];
+
+                Worker(): Pool(nullptr), Idx(0), Runs(0), Steals(0), Sleeps(0), Takes(0) {}
+            };
+
+            Worker workers_[NumWorkers];
+            Os::EventCount idle_;           //< Idle workers sleep here
+            Os::Mutex lock_;                //< Guards the injection queue and startup
+            PooledRunner* inject_[MaxSvcs]; //< Injection ring
+            size_t inject_head_;
+            std::atomic<size_t> inject_count_;
+            PooledRunner* runners_[MaxSvcs];
+            std::atomic<size_t> num_runners_;
+            std::atomic<Os::TimeNs_t> next_wake_;   //< Earliest parked deadline
+            std::atomic<bool> running_;
+
+            SvcPool();
+
+            /// @brief Worker thread routine
+            static void worker_main(void* worker);
+
+            /// @brief Find a runnable service for a worker
+            /// @return Service. Nullptr if there is no work.
+            PooledRunner* take(Worker& worker);
+
+            /// @brief Take the oldest service in the injection queue
+            /// @return Service. Nullptr if the queue is empty.
+            PooledRunner* take_injected();
+
+            /// @brief Run one step of a service and requeue or park it
+            void run(Worker& worker, PooledRunner& runner);
+
+            /// @brief Queue a runnable service and wake a worker
+            void enqueue(PooledRunner& runner);
+
+            /// @brief Checks if any service is queued
+            bool has_work() const;
+
+            /// @brief Schedule parked services whose deadline passed
+            /// @param now_ns Current Os::Clock time
+            void wake_due(const Os::TimeNs_t now_ns);
+
+            /// @brief Lower the earliest parked deadline
+            /// @return True if the deadline was lowered
+            bool lower_next_wake(const Os::TimeNs_t wake_ns);
+    };
+
+}
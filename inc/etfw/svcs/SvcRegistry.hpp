@@ -1,7 +1,8 @@
 
 #pragma once
 
-#include <etl/vector.h>
+#include <cstddef>
+#include <cstdint>
 #include "SvcTypes.hpp"
 #include "../status.hpp"
 //#include "iSvc.hpp"
@@ -28,6 +29,158 @@ namespace etfw
     //        iSvc* end() {return data() + size();}
     //};
 
+    /// @brief Service table indexed by ID
+    /// @details Services are kept in a dense array for iteration, and a
+    ///     256-entry table maps each service ID to its slot in the array,
+    ///     so find, insert and erase are O(1). Erase moves the last
+    ///     service into the freed slot, so iteration order is insertion
+    ///     order until a service is erased. Storage is provided by
+    ///     SvcTable.
+    /// @tparam T Service type. Must have an id() method.
+    template <typename T>
+    class iSvcTable
+    {
+        public:
+            /// @brief Largest number of services a table can hold
+            static constexpr size_t MaxCapacity = 255;
+
+            /// @brief Find a service by ID
+            /// @return Service. Nullptr if the ID isn't in the table.
+            inline T* find(const SvcId_t id) const
+            {
+                const uint8_t slot = Slots[id];
+                return (slot != NoSlot) ? Svcs[slot] : nullptr;
+            }
+
+            /// @brief Check if the table holds an ID
+            inline bool contains(const SvcId_t id) const { return Slots[id] != NoSlot; }
+
+            /// @brief Get the array slot of an ID
+            /// @return Slot. size() if the ID isn't in the table.
+            inline size_t index_of(const SvcId_t id) const
+            {
+                const uint8_t slot = Slots[id];
+                return (slot != NoSlot) ? slot : Count;
+            }
+
+            /// @brief Add a service at the end of the array
+            /// @return False if its ID is taken or the table is full
+            bool insert(T* svc)
+            {
+                const SvcId_t id = svc->id();
+                if (Slots[id] != NoSlot || Count == Capacity)
+                {
+                    return false;
+                }
+                Svcs[Count] = svc;
+                Slots[id] = static_cast<uint8_t>(Count);
+                Count++;
+                return true;
+            }
+
+            /// @brief Remove a service by ID
+            /// @return False if the ID isn't in the table
+            bool erase(const SvcId_t id)
+            {
+                const uint8_t slot = Slots[id];
+                if (slot == NoSlot)
+                {
+                    return false;
+                }
+                Count--;
+                if (slot != Count)
+                {
+                    Svcs[slot] = Svcs[Count];
+                    Slots[Svcs[slot]->id()] = slot;
+                }
+                Slots[id] = NoSlot;
+                return true;
+            }
+
+            /// @brief Remove every service
+            void clear()
+            {
+                for (size_t i = 0; i < Count; i++)
+                {
+                    Slots[Svcs[i]->id()] = NoSlot;
+                }
+                Count = 0;
+            }
+
+            inline size_t size() const { return Count; }
+            inline size_t capacity() const { return Capacity; }
+            inline bool full() const { return Count == Capacity; }
+
+            inline T** data() { return Svcs; }
+            inline T** begin() { return Svcs; }
+            inline T** end() { return Svcs + Count; }
+            inline T* const* begin() const { return Svcs; }
+            inline T* const* end() const { return Svcs + Count; }
+
+            iSvcTable(const iSvcTable&) = delete;
+            iSvcTable& operator=(const iSvcTable&) = delete;
+
+        protected:
+            iSvcTable(T** svcs, const size_t capacity):
+                Svcs(svcs),
+                Capacity(capacity),
+                Count(0)
+            {
+                for (uint8_t& slot: Slots)
+                {
+                    slot = NoSlot;
+                }
+            }
+
+            /// @brief Copy other's services into new storage
+            iSvcTable(T** svcs, const size_t capacity, const iSvcTable& other):
+                Svcs(svcs),
+                Capacity(capacity),
+                Count(other.Count)
+            {
+                for (size_t i = 0; i < Count; i++)
+                {
+                    Svcs[i] = other.Svcs[i];
+                }
+                for (size_t id = 0; id < 256; id++)
+                {
+                    Slots[id] = other.Slots[id];
+                }
+            }
+
+            ~iSvcTable() = default;
+
+        private:
+            static constexpr uint8_t NoSlot = 0xFF;
+
+            T** const Svcs;
+            const size_t Capacity;
+            size_t Count;
+            uint8_t Slots[256];     //< Array slot of each ID. NoSlot if absent.
+    };
+
+    /// @brief Service table with storage for MaxNumSvcs services
+    template <typename T, size_t MaxNumSvcs>
+    class SvcTable : public iSvcTable<T>
+    {
+        static_assert(MaxNumSvcs <= iSvcTable<T>::MaxCapacity,
+            "Service tables hold up to 255 services");
+
+        public:
+            SvcTable():
+                iSvcTable<T>(Storage, MaxNumSvcs)
+            {}
+
+            SvcTable(const SvcTable& other):
+                iSvcTable<T>(Storage, MaxNumSvcs, other)
+            {}
+
+            SvcTable& operator=(const SvcTable&) = delete;
+
+        private:
+            T* Storage[(MaxNumSvcs > 0) ? MaxNumSvcs : 1];
+    };
+
     template <typename T, size_t MaxNumSvcs>
     class SvcRegistry
     {
@@ -52,13 +205,13 @@ namespace etfw
                     "Success",
                     "Registration error, registry full",
                     "Requested service ID is not registered",
-                    "Registration error, service ID already registered"
+                    "Registration error, service ID already registered",
                     "Unknown/ETL registration error"
                 };
             };
             using Status = EtfwStatus<StatusTrait>;
 
-            using SvcContainer_t = etl::vector<T*, MaxNumSvcs>;
+            using SvcContainer_t = SvcTable<T, MaxNumSvcs>;
 
             SvcRegistry(){}
 
@@ -69,18 +222,11 @@ namespace etfw
                     return Status::Code::ALREADY_REGISTERED;
                 }
 
-                size_t num_registered_svcs = Svcs.size();
-                if (num_registered_svcs == MaxNumSvcs)
+                if (!Svcs.insert(&svc))
                 {
                     return Status::Code::REGISTRY_FULL;
                 }
 
-                Svcs.push_back(&svc);
-                if (Svcs.size() != num_registered_svcs+1)
-                {
-                    return Status::Code::UNKNOWN_REGISTRATION_ERROR;
-                }
-
                 return Status::Code::OK;
             }
 
@@ -91,36 +237,21 @@ namespace etfw
 
             Status unregister_svc(const SvcId_t svc_id)
             {
-                return Status::Code::UNKNOWN_REGISTRATION_ERROR;
-            }
-
-            T* find_svc(const SvcId_t svc_id)
-            {
-                T* ret = nullptr;
-                for (auto &svc: Svcs)
+                if (!Svcs.erase(svc_id))
                 {
-                    if (svc->id() == svc_id)
-                    {
-                        ret = svc;
-                        break;
-                    }
+                    return Status::Code::UNREGISTERED_ERR;
                 }
-                return ret;
+                return Status::Code::OK;
             }
 
+            inline T* find_svc(const SvcId_t svc_id) { return Svcs.find(svc_id); }
+
             bool is_registered(T& svc)
             {
                 return is_registered(svc.id());
             }
 
-            bool is_registered(const SvcId_t svc_id)
-            {
-                if (find_svc(svc_id) == nullptr)
-                {
-                    return false;
-                }
-                return true;
-            }
+            inline bool is_registered(const SvcId_t svc_id) { return Svcs.contains(svc_id); }
 
             inline size_t num_svcs(void) const { return Svcs.size(); }
 
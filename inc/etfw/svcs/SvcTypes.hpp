@@ -2,6 +2,7 @@
 #pragma once
 
 #include <cstdint>
+#include <etl/span.h>
 
 namespace etfw
 {
@@ -10,4 +11,7 @@ namespace etfw
 
     using AppId_t = SvcId_t;
     using AppChildId_t = SvcId_t;
+
+    /// @brief Read-only list of service IDs
+    using SvcIds_t = etl::span<const SvcId_t>;
 }
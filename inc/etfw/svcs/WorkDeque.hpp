@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace etfw {
+
+    /// @brief Fixed capacity Chase-Lev work-stealing deque
+    /// @details The owning thread pushes and pops at the bottom. Any other
+    ///     thread may steal from the top. Only the owner's pop and a steal
+    ///     racing for the last item contend, and they settle it with a CAS
+    ///     on top. Memory orders follow Le et al., "Correct and Efficient
+    ///     Work-Stealing for Weak Memory Models" (PPoPP 2013).
+    ///
+    ///     The deque doesn't grow. Callers must bound the number of items
+    ///     in flight to TCapacity.
+    /// @tparam T Item type. Must be trivially copyable, e.g. a pointer.
+    /// @tparam TCapacity Maximum number of items. Must be a power of 2.
+    template <typename T, size_t TCapacity>
+    class WorkDeque
+    {
+        static_assert(TCapacity > 0 && (TCapacity & (TCapacity - 1)) == 0,
+            "Work deque capacity must be a power of 2");
+
+        public:
+            static constexpr size_t Capacity = TCapacity;
+
+            WorkDeque():
+                top_(0),
+                bottom_(0)
+            {}
+
+            /// @brief Push an item. Owner only.
+            /// @return False if the deque is full
+            bool push(const T item)
+            {
+                const int64_t b = bottom_.load(std::memory_order_relaxed);
+                const int64_t t = top_.load(std::memory_order_acquire);
+                if ((b - t) >= static_cast<int64_t>(TCapacity))
+                {
+                    return false;
+                }
+                items_[b & Mask].store(item, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return true;
+            }
+
+            /// @brief Pop the most recently pushed item. Owner only.
+            /// @param[out] item Popped item
+            /// @return False if the deque is empty
+            bool pop(T& item)
+            {
+                const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+                bottom_.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t t = top_.load(std::memory_order_relaxed);
+
+                bool popped = false;
+                if (t <= b)
+                {
+                    item = items_[b & Mask].load(std::memory_order_relaxed);
+                    popped = true;
+                    if (t == b)
+                    {
+                        // Last item. Race thieves for it.
+                        popped = top_.compare_exchange_strong(t, t + 1,
+                            std::memory_order_seq_cst, std::memory_order_relaxed);
+                        bottom_.store(b + 1, std::memory_order_relaxed);
+                    }
+                }
+                else
+                {
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                }
+                return popped;
+            }
+
+            /// @brief Take the oldest item. Any thread.
+            /// @param[out] item Stolen item
+            /// @return False if the deque was empty or another thread won
+            ///     the item
+            bool steal(T& item)
+            {
+                int64_t t = top_.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const int64_t b = bottom_.load(std::memory_order_acquire);
+                if (t >= b)
+                {
+                    return false;
+                }
+                item = items_[t & Mask].load(std::memory_order_relaxed);
+                return top_.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed);
+            }
+
+            /// @brief Get the number of items. Approximate unless called by
+            ///     the owner with no thieves active.
+            inline size_t size() const
+            {
+                const int64_t b = bottom_.load(std::memory_order_relaxed);
+                const int64_t t = top_.load(std::memory_order_relaxed);
+                return (b > t) ? static_cast<size_t>(b - t) : 0;
+            }
+
+            inline bool empty() const { return size() == 0; }
+
+        private:
+            static constexpr int64_t Mask = static_cast<int64_t>(TCapacity) - 1;
+
+            // Thieves hit top, the owner hits bottom. Keep them on separate
+            // cache lines.
+            alignas(64) std::atomic<int64_t> top_;
+            alignas(64) std::atomic<int64_t> bottom_;
+            alignas(64) std::atomic<T> items_[TCapacity];
+    };
+
+}
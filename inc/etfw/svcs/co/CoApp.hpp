@@ -0,0 +1,182 @@
+#pragma once
+
+#include "Task.hpp"
+#include "Pipe.hpp"
+#include "svcs/App.hpp"
+#include <type_traits>
+
+/// Largest coroutine frame a coroutine app holds, in bytes. Raise it if
+/// co_frames().largest() exceeds it.
+#ifndef CO_APP_FRAME_SZ
+#define CO_APP_FRAME_SZ             512
+#endif
+
+/// Number of coroutine frames per app. Also the maximum number of
+/// spawned tasks.
+#ifndef CO_APP_MAX_TASKS
+#define CO_APP_MAX_TASKS            16
+#endif
+
+/// Maximum number of event sources (e.g. pipes) a coroutine app adds
+#ifndef CO_APP_MAX_SOURCES
+#define CO_APP_MAX_SOURCES          8
+#endif
+
+/// Depth of a coroutine app's response queue
+#ifndef CO_APP_RESP_QUEUE_DEPTH
+#define CO_APP_RESP_QUEUE_DEPTH     8
+#endif
+
+/// Default time a coroutine app waits for a response
+#ifndef CO_APP_REQUEST_TIMEOUT_MS
+#define CO_APP_REQUEST_TIMEOUT_MS   1000
+#endif
+
+namespace etfw
+{
+    /// @brief Application written as coroutines instead of a run_loop
+    ///     state machine
+    /// @details Derived implements `co::Task run()`, which is spawned when
+    ///     the app starts and may spawn further tasks. Tasks co_await
+    ///     pipe.next() on co::Pipe members, sleep_for, yield, request and
+    ///     other tasks. The app exits once every task has returned.
+    ///
+    ///     All tasks run on the app's runner thread, resumed by its event
+    ///     sources: the app's scheduler, its response pipe and the sources
+    ///     added with add_event_source. The runner must be event driven
+    ///     (EventSvcCfg or PooledSvcCfg). Coroutine frames come from a
+    ///     static per-app arena, never the heap. Tasks still suspended
+    ///     when the app stops are destroyed.
+    /// @tparam Derived Derived application
+    /// @tparam Cfg App configuration
+    /// @tparam TFrameSz Largest coroutine frame in bytes
+    /// @tparam TMaxTasks Number of coroutine frames and spawned tasks
+    template <typename Derived, typename Cfg,
+        size_t TFrameSz = CO_APP_FRAME_SZ, size_t TMaxTasks = CO_APP_MAX_TASKS>
+    class CoApp : public App<Derived, Cfg>
+    {
+    public:
+        using Base_t = App<Derived, Cfg>;
+        using Runner_t = typename Base_t::Runner_t;
+        using Status = typename Base_t::Status;
+        using RunState = typename Base_t::RunState;
+        using Task = co::Task;
+        using ResponsePipe_t = co::Pipe<CO_APP_RESP_QUEUE_DEPTH>;
+
+        static_assert(std::is_base_of<iEventRunnerExt, Runner_t>::value ||
+            std::is_base_of<PooledRunner, Runner_t>::value,
+            "Coroutine apps need an event-driven runner (EventSvcCfg or PooledSvcCfg)");
+
+        CoApp():
+            Base_t(),
+            sources_{&sched_, &responses_},
+            num_sources_(2)
+        {}
+
+        /// @brief Get the coroutine frame arena. Used by co::Task.
+        inline co::iFrameArena& co_frames() { return frames_; }
+
+        /// @brief Get the task scheduler
+        inline const co::Scheduler& scheduler() const { return sched_; }
+
+        Status init_(void) override
+        {
+            Status stat = Base_t::init_();
+            if (stat.success())
+            {
+                iApp::subscribe_cmd(responses_.subscription());
+            }
+            return stat;
+        }
+
+        RunState pre_run_init() override
+        {
+            if (!sched_.spawn(static_cast<Derived*>(this)->run()))
+            {
+                this->log(LogLevel::ERROR,
+                    "Failed to spawn run task. Increase CO_APP_FRAME_SZ or CO_APP_MAX_TASKS");
+                return RunState::ERROR;
+            }
+            return RunState::OK;
+        }
+
+        RunState process(void) override
+        {
+            return (sched_.active() > 0) ? RunState::OK : RunState::DONE;
+        }
+
+        RunState post_run_cleanup() override
+        {
+            sched_.destroy_all();
+            return RunState::OK;
+        }
+
+        msg::EventSources_t event_sources() override
+        {
+            return msg::EventSources_t(sources_, num_sources_);
+        }
+
+    protected:
+        /// @brief Add an event source (e.g. a co::Pipe) whose dispatch
+        ///     resumes tasks. Must be called before the app starts.
+        /// @param source Event source. Must outlive the app.
+        /// @return False if CO_APP_MAX_SOURCES sources were already added
+        bool add_event_source(msg::iEventSource& source)
+        {
+            if (num_sources_ == MaxSources)
+            {
+                return false;
+            }
+            sources_[num_sources_++] = &source;
+            return true;
+        }
+
+        /// @brief Start a task beside the running ones
+        /// @param task Task
+        /// @return False if the arena ran out of frames or tasks
+        inline bool spawn(Task&& task) { return sched_.spawn(etl::move(task)); }
+
+        /// @brief co_await to suspend the calling task for a time
+        /// @param t_ms Time to sleep
+        inline co::Scheduler::SleepAwaiter sleep_for(const Os::TimeMs_t t_ms)
+        {
+            return sched_.sleep_for(t_ms);
+        }
+
+        /// @brief co_await to let the other ready tasks run
+        inline co::Scheduler::YieldAwaiter yield() { return sched_.yield(); }
+
+        /// @brief Send a command and co_await its response
+        /// @details The response is matched by message ID only. It must be
+        ///     sent on the command bus (iApp::send_cmd) in a shared buffer.
+        ///     The app stays subscribed to the response ID afterwards.
+        /// @tparam TResp Response message type
+        /// @tparam TCmd Command message type
+        /// @param cmd Command to send
+        /// @param timeout_ms Time to wait for the response
+        /// @return Awaiter resuming with the response. Invalid on timeout.
+        template <typename TResp, typename TCmd>
+        typename ResponsePipe_t::NextAwaiter request(const TCmd& cmd,
+            const Os::TimeMs_t timeout_ms = CO_APP_REQUEST_TIMEOUT_MS)
+        {
+            // Subscribe before the command goes out. The response is
+            // queued until the caller suspends.
+            const bool subscribed = responses_.subscription().subscribe(TResp::ID);
+            ETFW_ASSERT(subscribed,
+                "Response subscription full. Increase MSG_MAX_NUM_SUBSCRIPTIONS");
+            (void)subscribed;
+            iApp::template send_cmd<TCmd>(cmd);
+            return responses_.next(TResp::ID, timeout_ms);
+        }
+
+    private:
+        static constexpr size_t MaxSources = 2 + CO_APP_MAX_SOURCES;
+
+        co::FrameArena<TFrameSz, TMaxTasks> frames_;
+        co::StaticScheduler<TMaxTasks> sched_;
+        ResponsePipe_t responses_;
+        msg::iEventSource* sources_[MaxSources];
+        size_t num_sources_;
+    };
+
+}
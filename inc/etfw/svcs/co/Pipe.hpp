@@ -0,0 +1,279 @@
+#pragma once
+
+#include "Task.hpp"
+#include "msg/Broker.hpp"
+#include "msg/BlockingMsgQueue.hpp"
+#include "msg/Pkt.hpp"
+#include <etl/message_router.h>
+#include <atomic>
+
+/// Maximum number of tasks waiting on one coroutine pipe at once
+#ifndef CO_PIPE_MAX_WAITERS
+#define CO_PIPE_MAX_WAITERS     4
+#endif
+
+namespace etfw::co {
+
+    /// @brief Message pipe tasks co_await on
+    /// @details Queues shared message handles like msg::QueuedPipe, and is
+    ///     an event source of its service. Instead of calling a handler,
+    ///     each message is handed to a waiting task: co_await next()
+    ///     resumes with the next message, or an empty message once its
+    ///     timeout passes. A task may also wait for one message ID only,
+    ///     e.g. a response (see CoApp::request).
+    ///
+    ///     Messages stay queued while no task waits. A message no waiting
+    ///     task accepts is dropped, so a pipe shared by filtered waits
+    ///     (e.g. responses) discards stale messages. Messages sent without
+    ///     a shared buffer can't be queued and are dropped.
+    ///
+    ///     receive may be called from any number of threads at once: the
+    ///     queue serializes its producers (see msg::BlockingMsgQueue).
+    ///     Everything else runs on the service's runner thread.
+    /// @tparam QueueDepth Maximum number of queued messages
+    /// @tparam TMaxWaiters Maximum number of tasks waiting at once
+    template <size_t QueueDepth, size_t TMaxWaiters = CO_PIPE_MAX_WAITERS>
+    class Pipe : public etl::imessage_router, public msg::iEventSource
+    {
+        public:
+            using Handle_t = std::coroutine_handle<>;
+
+            /// @brief Suspends a task until a message arrives
+            class NextAwaiter
+            {
+                public:
+                    /// @param pipe Pipe to read
+                    /// @param id Message ID to wait for. msg::MsgIdRsvd for any.
+                    /// @param deadline_ns Time to give up at
+                    NextAwaiter(Pipe& pipe, const msg::MsgId_t id, const Os::TimeNs_t deadline_ns):
+                        pipe_(pipe),
+                        id_(id),
+                        deadline_ns_(deadline_ns),
+                        queued_(false)
+                    {}
+
+                    NextAwaiter(const NextAwaiter&) = delete;
+                    NextAwaiter& operator=(const NextAwaiter&) = delete;
+
+                    ~NextAwaiter()
+                    {
+                        // Frame destroyed while waiting
+                        if (queued_)
+                        {
+                            pipe_.remove_waiter(*this);
+                        }
+                    }
+
+                    /// @brief Takes a queued message without suspending if
+                    ///     any message will do
+                    bool await_ready() noexcept
+                    {
+                        return (msg::MsgIdRsvd == id_) && pipe_.queue_.front(msg_);
+                    }
+
+                    void await_suspend(Handle_t task) noexcept
+                    {
+                        task_ = task;
+                        pipe_.add_waiter(*this);
+                    }
+
+                    /// @return Message. Invalid if the wait timed out.
+                    msg::SharedMsg await_resume() noexcept { return etl::move(msg_); }
+
+                    friend class Pipe;
+
+                private:
+                    Pipe& pipe_;
+                    const msg::MsgId_t id_;
+                    const Os::TimeNs_t deadline_ns_;
+                    Handle_t task_;
+                    msg::SharedMsg msg_;
+                    bool queued_;
+            };
+
+            /// @param id Pipe ID
+            Pipe(const etl::message_router_id_t id = 0):
+                etl::imessage_router(id),
+                subs_(*this),
+                num_waiters_(0),
+                dropped_(0),
+                unmatched_(0)
+            {}
+
+            /// @brief Wait for the next message
+            NextAwaiter next()
+            {
+                return NextAwaiter(*this, msg::MsgIdRsvd, Os::TimeNsNever);
+            }
+
+            /// @brief Wait for the next message, for a time
+            /// @param timeout_ms Time to wait
+            NextAwaiter next(const Os::TimeMs_t timeout_ms)
+            {
+                return NextAwaiter(*this, msg::MsgIdRsvd, deadline(timeout_ms));
+            }
+
+            /// @brief Wait for the next message with an ID, for a time.
+            ///     Other messages that arrive meanwhile go to other
+            ///     waiters or are dropped.
+            /// @param id Message ID
+            /// @param timeout_ms Time to wait
+            NextAwaiter next(const msg::MsgId_t id, const Os::TimeMs_t timeout_ms)
+            {
+                return NextAwaiter(*this, id, deadline(timeout_ms));
+            }
+
+            /// @brief Get the broker subscription
+            inline msg::Subscription& subscription() { return subs_; }
+
+            bool accepts(etl::message_id_t id) const override { return subs_.has(id); }
+            bool is_null_router() const override { return false; }
+            bool is_producer() const override { return false; }
+            bool is_consumer() const override { return true; }
+
+            /// @brief Queue a shared message. Any thread, concurrently
+            ///     with other publishers.
+            /// @param sm Shared message. Only the handle is queued.
+            void receive(etl::shared_message sm) override
+            {
+                // The broker only routes subscribed IDs, and the runner
+                // thread may be changing the subscription
+                if (!queue_.emplace(etl::move(sm)))
+                {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            /// @brief Message sent without a shared buffer. Dropped.
+            void receive(const etl::imessage& msg) override
+            {
+                (void)msg;
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void attach(Os::EventCount* event) override { queue_.attach(event); }
+
+            Os::TimeNs_t deadline_ns() const override
+            {
+                if (num_waiters_ > 0 && !queue_.empty())
+                {
+                    // A waiter was added after the last dispatch
+                    return 0;
+                }
+                Os::TimeNs_t deadline = Os::TimeNsNever;
+                for (size_t i = 0; i < num_waiters_; i++)
+                {
+                    deadline = std::min(deadline, waiters_[i]->deadline_ns_);
+                }
+                return deadline;
+            }
+
+            bool dispatch(const Os::TimeNs_t now_ns) override
+            {
+                bool handled = false;
+
+                msg::SharedMsg sm;
+                size_t budget = BatchSz;
+                while (num_waiters_ > 0 && budget > 0 && queue_.front(sm))
+                {
+                    budget--;
+                    NextAwaiter* waiter = find_waiter(sm.get_message().get_message_id());
+                    if (waiter == nullptr)
+                    {
+                        unmatched_++;
+                        sm = msg::SharedMsg();
+                        continue;
+                    }
+                    remove_waiter(*waiter);
+                    waiter->msg_ = etl::move(sm);
+                    waiter->task_.resume();
+                    handled = true;
+                }
+
+                // Resumed tasks may add and remove waiters. Rescan after each.
+                size_t i = 0;
+                while (i < num_waiters_)
+                {
+                    NextAwaiter* waiter = waiters_[i];
+                    if (waiter->deadline_ns_ <= now_ns)
+                    {
+                        remove_waiter(*waiter);
+                        waiter->task_.resume();
+                        handled = true;
+                        i = 0;
+                    }
+                    else
+                    {
+                        i++;
+                    }
+                }
+                return handled;
+            }
+
+            /// @brief Get the number of messages dropped because the queue
+            ///     was full or they had no shared buffer
+            inline size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+            /// @brief Get the number of messages no waiting task accepted
+            inline size_t unmatched() const { return unmatched_; }
+
+            /// @brief Get the number of waiting tasks
+            inline size_t waiters() const { return num_waiters_; }
+
+        private:
+            /// @brief Maximum number of messages handed out per dispatch
+            static constexpr size_t BatchSz = std::min<size_t>(QueueDepth, MSG_QUEUE_DRAIN_BATCH);
+
+            msg::Subscription subs_;
+            msg::BlockingMsgQueue<msg::SharedMsg, QueueDepth> queue_;
+            NextAwaiter* waiters_[TMaxWaiters];     //< Oldest first
+            size_t num_waiters_;
+            std::atomic<size_t> dropped_;
+            size_t unmatched_;
+
+            static inline Os::TimeNs_t deadline(const Os::TimeMs_t timeout_ms)
+            {
+                return Os::Clock::now_ns() + (static_cast<Os::TimeNs_t>(timeout_ms) * Os::NsPerMs);
+            }
+
+            void add_waiter(NextAwaiter& waiter)
+            {
+                ETFW_ASSERT(num_waiters_ < TMaxWaiters,
+                    "Too many tasks waiting on a pipe. Increase CO_PIPE_MAX_WAITERS");
+                waiter.queued_ = true;
+                waiters_[num_waiters_++] = &waiter;
+            }
+
+            void remove_waiter(NextAwaiter& waiter)
+            {
+                for (size_t i = 0; i < num_waiters_; i++)
+                {
+                    if (waiters_[i] == &waiter)
+                    {
+                        // Keep the oldest waiter first
+                        for (size_t j = i + 1; j < num_waiters_; j++)
+                        {
+                            waiters_[j - 1] = waiters_[j];
+                        }
+                        num_waiters_--;
+                        break;
+                    }
+                }
+                waiter.queued_ = false;
+            }
+
+            /// @brief Find the oldest waiter that accepts a message ID
+            NextAwaiter* find_waiter(const msg::MsgId_t id) const
+            {
+                for (size_t i = 0; i < num_waiters_; i++)
+                {
+                    if (msg::MsgIdRsvd == waiters_[i]->id_ || id == waiters_[i]->id_)
+                    {
+                        return waiters_[i];
+                    }
+                }
+                return nullptr;
+            }
+    };
+
+}
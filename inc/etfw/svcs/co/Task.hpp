@@ -0,0 +1,556 @@
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "etfw coroutine services need C++20. Configure with -DENABLE_COROUTINES=ON."
+#endif
+
+#include "os/Clock.hpp"
+#include "msg/EventSource.hpp"
+#include "etfw_assert.hpp"
+#include <coroutine>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace etfw::co {
+
+    class Scheduler;
+
+    /// @brief Fixed-block allocator for coroutine frames
+    /// @details Every frame takes one block, whatever its size. A frame
+    ///     larger than a block, or one allocated while every block is in
+    ///     use, fails: the coroutine is not created and its Task is empty.
+    ///     largest() reports the biggest frame requested, to size blocks.
+    ///
+    ///     Not thread safe. Frames are created and destroyed by the
+    ///     owning service's runner thread only.
+    class iFrameArena
+    {
+        public:
+            iFrameArena(const iFrameArena&) = delete;
+            iFrameArena& operator=(const iFrameArena&) = delete;
+
+            /// @brief Allocate a frame
+            /// @param sz Frame size in bytes
+            /// @return Frame. Nullptr if too large or the arena is empty.
+            void* allocate(const size_t sz) noexcept
+            {
+                largest_ = std::max(largest_, sz);
+                if (sz > frame_sz_ || free_ == nullptr)
+                {
+                    failures_++;
+                    return nullptr;
+                }
+                Header* block = free_;
+                free_ = block->Next;
+                block->Arena = this;
+                in_use_++;
+                peak_ = std::max(peak_, in_use_);
+                return reinterpret_cast<uint8_t*>(block) + HeaderSz;
+            }
+
+            /// @brief Return a frame to the arena it came from
+            /// @param frame Frame returned by allocate
+            static void release(void* frame) noexcept
+            {
+                Header* block = reinterpret_cast<Header*>(
+                    static_cast<uint8_t*>(frame) - HeaderSz);
+                iFrameArena& arena = *block->Arena;
+                block->Next = arena.free_;
+                arena.free_ = block;
+                arena.in_use_--;
+            }
+
+            /// @brief Get the largest frame size the arena holds, in bytes
+            inline size_t frame_size() const { return frame_sz_; }
+
+            /// @brief Get the number of frames in use
+            inline size_t in_use() const { return in_use_; }
+
+            /// @brief Get the most frames ever in use at once
+            inline size_t peak() const { return peak_; }
+
+            /// @brief Get the number of failed allocations
+            inline size_t failures() const { return failures_; }
+
+            /// @brief Get the largest frame size requested, in bytes
+            inline size_t largest() const { return largest_; }
+
+        protected:
+            /// @brief Block header. Links free blocks, and points back to
+            ///     the arena while the block is in use.
+            struct Header
+            {
+                iFrameArena* Arena;
+                Header* Next;
+            };
+
+            /// @brief Header size, padded to keep frames max aligned
+            static constexpr size_t HeaderSz =
+                (sizeof(Header) + alignof(std::max_align_t) - 1) &
+                ~(alignof(std::max_align_t) - 1);
+
+            /// @brief Round a frame size up to keep blocks max aligned
+            static constexpr size_t block_size(const size_t frame_sz)
+            {
+                return HeaderSz + ((frame_sz + alignof(std::max_align_t) - 1) &
+                    ~(alignof(std::max_align_t) - 1));
+            }
+
+            /// @param blocks Block storage. num_frames * block_size(frame_sz) bytes.
+            /// @param frame_sz Largest frame size in bytes
+            /// @param num_frames Number of blocks
+            iFrameArena(uint8_t* blocks, const size_t frame_sz, const size_t num_frames):
+                free_(nullptr),
+                frame_sz_(block_size(frame_sz) - HeaderSz),
+                in_use_(0),
+                peak_(0),
+                failures_(0),
+                largest_(0)
+            {
+                for (size_t i = num_frames; i > 0; i--)
+                {
+                    Header* block = reinterpret_cast<Header*>(
+                        blocks + ((i - 1) * block_size(frame_sz)));
+                    block->Next = free_;
+                    free_ = block;
+                }
+            }
+
+        private:
+            Header* free_;
+            const size_t frame_sz_;
+            size_t in_use_;
+            size_t peak_;
+            size_t failures_;
+            size_t largest_;
+    };
+
+    /// @brief Frame arena with static storage
+    /// @tparam TFrameSz Largest frame size in bytes
+    /// @tparam TNumFrames Number of frames
+    template <size_t TFrameSz, size_t TNumFrames>
+    class FrameArena : public iFrameArena
+    {
+        public:
+            FrameArena():
+                iFrameArena(blocks_, TFrameSz, TNumFrames)
+            {}
+
+        private:
+            alignas(std::max_align_t) uint8_t blocks_[TNumFrames * block_size(TFrameSz)];
+    };
+
+    /// @brief Coroutine type for service logic. Starts suspended.
+    /// @details A Task is either spawned on a Scheduler, which then owns
+    ///     it, or co_awaited by another task, which resumes when it
+    ///     returns. Tasks return no value.
+    ///
+    ///     Frames come from the frame arena of the coroutine's first
+    ///     argument, i.e. the object a member coroutine is called on.
+    ///     That object must have a co_frames() method returning an
+    ///     iFrameArena (see CoApp). Coroutines without one don't compile,
+    ///     so frames never come from the heap. If the arena is out of
+    ///     frames the Task is empty (see valid).
+    class Task
+    {
+        public:
+            struct promise_type;
+            using Handle_t = std::coroutine_handle<promise_type>;
+
+            /// @brief Resumes the awaiting task, or releases a spawned one
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(Handle_t task) noexcept;
+                void await_resume() const noexcept {}
+            };
+
+            struct promise_type
+            {
+                std::coroutine_handle<> Continuation;   //< Awaiting task
+                Scheduler* Sched = nullptr;             //< Owner of a spawned task
+
+                template <typename TOwner, typename... TArgs>
+                    requires requires(TOwner& owner) { owner.co_frames().allocate(0); }
+                static void* operator new(size_t sz, TOwner& owner, TArgs&&...) noexcept
+                {
+                    return owner.co_frames().allocate(sz);
+                }
+
+                /// Coroutines must allocate from a frame arena
+                static void* operator new(size_t sz) = delete;
+
+                static void operator delete(void* frame) noexcept
+                {
+                    iFrameArena::release(frame);
+                }
+
+                static Task get_return_object_on_allocation_failure() noexcept { return Task(); }
+
+                Task get_return_object() noexcept { return Task(Handle_t::from_promise(*this)); }
+                std::suspend_always initial_suspend() const noexcept { return {}; }
+                FinalAwaiter final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                void unhandled_exception() const noexcept
+                {
+                    ETFW_ASSERT(false, "Unhandled exception in coroutine");
+                }
+            };
+
+            /// @brief Starts the task and resumes the awaiter when it returns
+            struct Awaiter
+            {
+                Handle_t Callee;
+
+                bool await_ready() const noexcept { return !Callee || Callee.done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+                {
+                    Callee.promise().Continuation = awaiter;
+                    return Callee;
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            Task(): handle_(nullptr) {}
+
+            Task(Task&& other) noexcept:
+                handle_(other.handle_)
+            {
+                other.handle_ = nullptr;
+            }
+
+            Task& operator=(Task&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    reset();
+                    handle_ = other.handle_;
+                    other.handle_ = nullptr;
+                }
+                return *this;
+            }
+
+            Task(const Task&) = delete;
+            Task& operator=(const Task&) = delete;
+
+            ~Task() { reset(); }
+
+            /// @brief Check if the coroutine was created
+            /// @return False if its frame could not be allocated
+            inline bool valid() const { return static_cast<bool>(handle_); }
+
+            /// @brief Run the task until it returns. An empty task returns
+            ///     immediately.
+            Awaiter operator co_await() && noexcept { return Awaiter{handle_}; }
+
+            /// @brief Give up ownership of the coroutine
+            inline Handle_t release()
+            {
+                Handle_t handle = handle_;
+                handle_ = nullptr;
+                return handle;
+            }
+
+        private:
+            Handle_t handle_;
+
+            explicit Task(Handle_t handle): handle_(handle) {}
+
+            inline void reset()
+            {
+                if (handle_)
+                {
+                    handle_.destroy();
+                    handle_ = nullptr;
+                }
+            }
+    };
+
+    /// @brief Runs a service's spawned tasks. Single threaded.
+    /// @details The scheduler is an event source of the service it
+    ///     belongs to. Its dispatch resumes tasks that were spawned or
+    ///     yielded, and sleeping tasks whose time is up. Its deadline is
+    ///     the earliest sleeper, so an event-driven runner sleeps until
+    ///     then. Tasks waiting on a pipe are resumed by the pipe.
+    ///
+    ///     Every method must be called from the runner thread.
+    class Scheduler : public msg::iEventSource
+    {
+        public:
+            using Handle_t = std::coroutine_handle<>;
+
+            /// @brief Suspends a task until a deadline
+            class SleepAwaiter
+            {
+                public:
+                    SleepAwaiter(Scheduler& sched, const Os::TimeNs_t deadline_ns):
+                        sched_(sched),
+                        deadline_ns_(deadline_ns),
+                        queued_(false)
+                    {}
+
+                    SleepAwaiter(const SleepAwaiter&) = delete;
+                    SleepAwaiter& operator=(const SleepAwaiter&) = delete;
+
+                    ~SleepAwaiter()
+                    {
+                        // Frame destroyed while asleep
+                        if (queued_)
+                        {
+                            sched_.remove_sleeper(*this);
+                        }
+                    }
+
+                    bool await_ready() const noexcept { return false; }
+
+                    void await_suspend(Handle_t task) noexcept
+                    {
+                        task_ = task;
+                        sched_.add_sleeper(*this);
+                    }
+
+                    void await_resume() const noexcept {}
+
+                    friend class Scheduler;
+
+                private:
+                    Scheduler& sched_;
+                    const Os::TimeNs_t deadline_ns_;
+                    Handle_t task_;
+                    bool queued_;
+            };
+
+            /// @brief Requeues a task behind the other ready tasks
+            class YieldAwaiter
+            {
+                public:
+                    YieldAwaiter(Scheduler& sched): sched_(sched) {}
+
+                    bool await_ready() const noexcept { return false; }
+                    void await_suspend(Handle_t task) noexcept { sched_.make_ready(task); }
+                    void await_resume() const noexcept {}
+
+                private:
+                    Scheduler& sched_;
+            };
+
+            /// @brief Start a task. It first runs on the next dispatch.
+            /// @param task Task. The scheduler takes ownership.
+            /// @return False if the task is empty or too many tasks run
+            bool spawn(Task&& task)
+            {
+                if (!task.valid() || num_tasks_ == max_tasks_)
+                {
+                    spawn_failures_++;
+                    return false;
+                }
+                Task::Handle_t handle = task.release();
+                handle.promise().Sched = this;
+                tasks_[num_tasks_++] = handle;
+                make_ready(handle);
+                return true;
+            }
+
+            /// @brief Suspend the calling task for a time
+            /// @param t_ms Time to sleep. 0 yields.
+            SleepAwaiter sleep_for(const Os::TimeMs_t t_ms)
+            {
+                return SleepAwaiter(*this,
+                    Os::Clock::now_ns() + (static_cast<Os::TimeNs_t>(t_ms) * Os::NsPerMs));
+            }
+
+            /// @brief Let the other ready tasks run
+            YieldAwaiter yield() { return YieldAwaiter(*this); }
+
+            /// @brief Destroy every spawned task, wherever it is suspended
+            void destroy_all()
+            {
+                num_ready_ = 0;
+                while (num_tasks_ > 0)
+                {
+                    Handle_t task = tasks_[--num_tasks_];
+                    task.destroy();
+                }
+            }
+
+            /// @brief Get the number of spawned tasks that haven't returned
+            inline size_t active() const { return num_tasks_; }
+
+            /// @brief Get the number of tasks that could not be spawned
+            inline size_t spawn_failures() const { return spawn_failures_; }
+
+            /// @brief Get the number of task resumes
+            inline size_t resumes() const { return resumes_; }
+
+            void attach(Os::EventCount* event) override { (void)event; }
+
+            Os::TimeNs_t deadline_ns() const override
+            {
+                Os::TimeNs_t deadline = (num_ready_ > 0) ? 0 : Os::TimeNsNever;
+                for (size_t i = 0; i < num_sleepers_; i++)
+                {
+                    deadline = std::min(deadline, sleepers_[i]->deadline_ns_);
+                }
+                return deadline;
+            }
+
+            bool dispatch(const Os::TimeNs_t now_ns) override
+            {
+                bool handled = false;
+
+                // Resumed tasks may add and remove sleepers. Rescan after each.
+                size_t i = 0;
+                while (i < num_sleepers_)
+                {
+                    SleepAwaiter* sleeper = sleepers_[i];
+                    if (sleeper->deadline_ns_ <= now_ns)
+                    {
+                        remove_sleeper(*sleeper);
+                        resume(sleeper->task_);
+                        handled = true;
+                        i = 0;
+                    }
+                    else
+                    {
+                        i++;
+                    }
+                }
+
+                // Tasks made ready from here on wait for the next dispatch
+                size_t count = num_ready_;
+                while (count-- > 0)
+                {
+                    Handle_t task = ready_[ready_head_];
+                    ready_head_ = (ready_head_ + 1) % max_tasks_;
+                    num_ready_--;
+                    resume(task);
+                    handled = true;
+                }
+                return handled;
+            }
+
+            friend struct Task::FinalAwaiter;
+
+        protected:
+            /// @param tasks Spawned task storage
+            /// @param ready Ready task ring storage
+            /// @param sleepers Sleeping task storage
+            /// @param max_tasks Size of each storage array
+            Scheduler(Task::Handle_t* tasks,
+                Handle_t* ready,
+                SleepAwaiter** sleepers,
+                const size_t max_tasks
+            ):
+                tasks_(tasks),
+                ready_(ready),
+                sleepers_(sleepers),
+                max_tasks_(max_tasks),
+                num_tasks_(0),
+                ready_head_(0),
+                num_ready_(0),
+                num_sleepers_(0),
+                spawn_failures_(0),
+                resumes_(0)
+            {}
+
+        private:
+            Task::Handle_t* const tasks_;
+            Handle_t* const ready_;
+            SleepAwaiter** const sleepers_;
+            const size_t max_tasks_;
+            size_t num_tasks_;
+            size_t ready_head_;
+            size_t num_ready_;
+            size_t num_sleepers_;
+            size_t spawn_failures_;
+            size_t resumes_;
+
+            inline void resume(Handle_t task)
+            {
+                resumes_++;
+                task.resume();
+            }
+
+            /// @brief Queue a task. Each spawned task is suspended at one
+            ///     point only, so the ring can't overflow.
+            void make_ready(Handle_t task)
+            {
+                ETFW_ASSERT(num_ready_ < max_tasks_, "Coroutine ready queue overflow");
+                ready_[(ready_head_ + num_ready_) % max_tasks_] = task;
+                num_ready_++;
+            }
+
+            void add_sleeper(SleepAwaiter& sleeper)
+            {
+                if (sleeper.deadline_ns_ <= Os::Clock::now_ns())
+                {
+                    make_ready(sleeper.task_);
+                    return;
+                }
+                ETFW_ASSERT(num_sleepers_ < max_tasks_, "Coroutine sleep list overflow");
+                sleeper.queued_ = true;
+                sleepers_[num_sleepers_++] = &sleeper;
+            }
+
+            void remove_sleeper(SleepAwaiter& sleeper)
+            {
+                for (size_t i = 0; i < num_sleepers_; i++)
+                {
+                    if (sleepers_[i] == &sleeper)
+                    {
+                        sleepers_[i] = sleepers_[--num_sleepers_];
+                        break;
+                    }
+                }
+                sleeper.queued_ = false;
+            }
+
+            /// @brief Forget a spawned task that returned
+            void on_return(Task::Handle_t task)
+            {
+                for (size_t i = 0; i < num_tasks_; i++)
+                {
+                    if (tasks_[i] == task)
+                    {
+                        tasks_[i] = tasks_[--num_tasks_];
+                        break;
+                    }
+                }
+            }
+    };
+
+    /// @brief Scheduler with static storage
+    /// @tparam TMaxTasks Maximum number of spawned tasks
+    template <size_t TMaxTasks>
+    class StaticScheduler : public Scheduler
+    {
+        public:
+            StaticScheduler():
+                Scheduler(tasks_, ready_, sleepers_, TMaxTasks)
+            {}
+
+        private:
+            Task::Handle_t tasks_[TMaxTasks];
+            Handle_t ready_[TMaxTasks];
+            SleepAwaiter* sleepers_[TMaxTasks];
+    };
+
+    inline std::coroutine_handle<> Task::FinalAwaiter::await_suspend(Handle_t task) noexcept
+    {
+        promise_type& promise = task.promise();
+        if (promise.Continuation)
+        {
+            return promise.Continuation;
+        }
+        if (promise.Sched != nullptr)
+        {
+            promise.Sched->on_return(task);
+            task.destroy();
+        }
+        return std::noop_coroutine();
+    }
+
+}
@@ -7,6 +7,7 @@
 #include "SvcTypes.hpp"
 #include "SvcRegistry.hpp"
 #include "log/Logger.hpp"
+#include "msg/EventSource.hpp"
 
 #ifndef COMPONENT_MAX_NAME_LEN
 #define COMPONENT_MAX_NAME_LEN  24
@@ -99,11 +100,12 @@ class iSvc
                 //iSvc* end() {return data() + size();}
         };
 
+        /// @brief Service registry indexed by ID (see iSvcTable)
         template <typename T, size_t MaxNumSvcs>
         class Registry : public iRegistry
         {
             public:
-                using SvcContainer_t = etl::vector<T*, MaxNumSvcs>;
+                using SvcContainer_t = SvcTable<T, MaxNumSvcs>;
                 
                 Registry(){}
 
@@ -117,48 +119,34 @@ class iSvc
                         return Status::Code::ALREADY_REGISTERED;
                     }
 
-                    size_t num_registered_svcs = Svcs.size();
-                    if (num_registered_svcs == MaxNumSvcs)
+                    if (!Svcs.insert(&svc))
                     {
                         return Status::Code::REGISTRY_FULL;
                     }
 
-                    Svcs.push_back(&svc);
-                    if (Svcs.size() != num_registered_svcs+1)
-                    {
-                        return Status::Code::UNKNOWN_REGISTRATION_ERR;
-                    }
-
                     return Status::Code::OK;
                 }
 
-                T* find_svc(const SvcId_t svc_id)
+                Status unregister_svc(const SvcId_t svc_id)
                 {
-                    T* ret = nullptr;
-                    for (auto &svc: Svcs)
+                    if (!Svcs.erase(svc_id))
                     {
-                        if (svc->id() == svc_id)
-                        {
-                            ret = svc;
-                            break;
-                        }
+                        return Status::Code::UNREGISTERED_ERR;
                     }
-                    return ret;
+                    return Status::Code::OK;
                 }
 
+                /// @brief Unregister every service
+                inline void clear() { Svcs.clear(); }
+
+                inline T* find_svc(const SvcId_t svc_id) { return Svcs.find(svc_id); }
+
                 bool is_registered(T& svc)
                 {
                     return is_registered(svc.id());
                 }
 
-                bool is_registered(const SvcId_t svc_id)
-                {
-                    if (find_svc(svc_id) == nullptr)
-                    {
-                        return false;
-                    }
-                    return true;
-                }
+                inline bool is_registered(const SvcId_t svc_id) { return Svcs.contains(svc_id); }
             
             private:
                 SvcContainer_t Svcs;
@@ -174,16 +162,19 @@ class iSvc
                     svc_(svc)
                 {}
 
-                /// @brief Formats and logs a service message. 
+                /// @brief Formats and logs a service message. Returns
+                ///     before formatting if the level is filtered out
+                ///     (see iSvc::log_enabled).
                 /// @param level Log level
                 /// @param format String/format to log.
                 /// @param Args String format arguments
-                void log(const LogLevel level, const char* format, ...)
+                template <typename... TArgs>
+                inline void log(const LogLevel level, const char* format, TArgs... args)
                 {
-                    va_list args;
-                    va_start(args, format);
-                    svc_->log(level, format, args);
-                    va_end(args);
+                    if (svc_->log_enabled(level))
+                    {
+                        svc_->log(level, format, args...);
+                    }
                 }
 
             private:
@@ -230,6 +221,23 @@ class iSvc
         /// @return Service name
         inline const char* name_raw() const { return Name.data(); }
 
+        /// @brief Check if a message of a level would be logged: the
+        ///     level is built into the service (see ETF_LOG_LEVEL and
+        ///     App::LOG_LEVEL) and at or above its runtime level
+        inline bool log_enabled(const LogLevel level) const
+        {
+            return (level >= LogLevelMin) && (level >= BuildLvl) && LogLvl.enabled(level);
+        }
+
+        /// @brief Get the service's runtime log level
+        inline LogLevel log_level() const { return LogLvl.get(); }
+
+        /// @brief Set the service's runtime log level. Lower levels are
+        ///     dropped before formatting. Levels compiled out of the
+        ///     service (see App::LOG_LEVEL) stay out.
+        /// @param level Lowest level logged
+        inline void set_log_level(const LogLevel level) { LogLvl.set(level); }
+
         /// @brief Service entry function. Called by runner when started.
         /// @return Service run state
         /// @retval [OK] Service will continue to main/periodic process.
@@ -251,8 +259,19 @@ class iSvc
         /// @retval [ERROR] Service has encountered a cleanup error.
         virtual RunStatus post_run_cleanup() { return RunStatus::OK; }
 
+        /// @brief Inputs an event-driven runner sleeps on and dispatches.
+        ///     Queried when the runner starts, and by a stop to wake
+        ///     receives blocked on them (see iEventSource::wake).
+        /// @return Event sources. Must outlive the runner.
+        virtual msg::EventSources_t event_sources() { return {}; }
+
         virtual iRegistry* children() { return nullptr; }
 
+        /// @brief Get the service's runner, e.g. to read its state or
+        ///     execution statistics
+        /// @return Runner. Nullptr if the service has none.
+        inline iSvcRunner* get_runner() { return runner(); }
+
         friend class iSvcRunner;
         friend class AccessProxy;
 
@@ -269,6 +288,11 @@ class iSvc
         /// @param name Service name
         iSvc(SvcId_t id, const char* name);
 
+        /// @brief Set the lowest level built into the service. Called
+        ///     once by the service's constructor.
+        /// @param level Lowest level built in (see svc_log_level)
+        inline void set_build_log_level(const LogLevel level) { BuildLvl = level; }
+
         /// @brief Returns the service's runner object
         /// @return Pointer to service runner.
         virtual iSvcRunner* runner() = 0;
@@ -308,6 +332,8 @@ class iSvc
 
         volatile bool IsInit;
         volatile bool IsStarted;
+        LogLevel BuildLvl;      //< Lowest level built in
+        LogThreshold LogLvl;
 };
 
 }
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "Logger.hpp"
+#include "os/Clock.hpp"
+#include "os/EventCount.hpp"
+#include "os/Task.hpp"
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+
+/// Number of threads that can hold a log ring at once. Rings of exited
+/// threads are reused.
+#ifndef ETF_ASYNC_LOG_THREADS
+#define ETF_ASYNC_LOG_THREADS       16
+#endif
+
+/// Size of each thread's log ring, in bytes. Power of 2.
+#ifndef ETF_ASYNC_LOG_RING_SZ
+#define ETF_ASYNC_LOG_RING_SZ       8192
+#endif
+
+/// Largest log record, in bytes. Longer string arguments are truncated.
+#ifndef ETF_ASYNC_LOG_RECORD_SZ
+#define ETF_ASYNC_LOG_RECORD_SZ     512
+#endif
+
+/// Caller name bytes kept per record, including the terminator
+#ifndef ETF_ASYNC_LOG_CALLER_SZ
+#define ETF_ASYNC_LOG_CALLER_SZ     24
+#endif
+
+/// Longest time a record waits in a ring before it is written, in
+/// milliseconds. Rings past half full are written at once.
+#ifndef ETF_ASYNC_LOG_PERIOD_MS
+#define ETF_ASYNC_LOG_PERIOD_MS     5
+#endif
+
+/// Logger thread stack size, in 32-bit words
+#ifndef ETF_ASYNC_LOG_STACK_SZ
+#define ETF_ASYNC_LOG_STACK_SZ      OS_THREAD_DEFAULT_STACK_SZ
+#endif
+
+/// Format of a line written by the logger thread: timestamp seconds and
+/// microseconds, then ETF_LOG_FMT
+#define ETF_ASYNC_LOG_FMT   "%llu.%06llu " ETF_LOG_FMT
+
+namespace etfw {
+
+    /// @brief Asynchronous log core with deferred formatting (see
+    ///     AsyncLogPolicy)
+    /// @details A logging thread copies the record into a lock-free ring
+    ///     of its own: format pointer, level, caller name, timestamp and
+    ///     the arguments, packed by type (see LogArgs). String arguments
+    ///     are copied. Formatting and output happen on one logger thread,
+    ///     which merges the rings by timestamp and hands each line to the
+    ///     sink. So format strings must outlive the logger, as string
+    ///     literals do.
+    ///
+    ///     A record that doesn't fit in its ring is dropped and counted,
+    ///     and the logger thread reports the drops in the output. Logging
+    ///     never blocks.
+    class AsyncLog
+    {
+        public:
+            static constexpr size_t NumRings = ETF_ASYNC_LOG_THREADS;
+            static constexpr size_t RingSz = ETF_ASYNC_LOG_RING_SZ;
+            static constexpr size_t RecordSz = ETF_ASYNC_LOG_RECORD_SZ;
+            static constexpr size_t CallerSz = ETF_ASYNC_LOG_CALLER_SZ;
+
+            static_assert((RingSz & (RingSz - 1)) == 0, "Log ring size must be a power of 2");
+            static_assert(RecordSz <= (RingSz / 2), "Log records must fit twice in a ring");
+
+            /// @brief Writes one formatted line. Called on the logger thread.
+            using Sink_t = void (*)(const LogLevel level, const char* line);
+
+            /// @brief Logger statistics
+            struct Stats
+            {
+                uint64_t Logged;    //< Records queued
+                uint64_t Dropped;   //< Records dropped on a full ring
+                uint64_t NoRing;    //< Records dropped with no free ring
+            };
+
+            class Ring;
+
+            /// @brief A thread's ring. Returned to the logger when the
+            ///     thread exits.
+            struct ThreadRing
+            {
+                Ring* R = nullptr;
+
+                ~ThreadRing();
+            };
+
+            /// @brief Start the logger thread
+            /// @param sink Line writer
+            explicit AsyncLog(const Sink_t sink);
+
+            /// @brief Write what is queued and stop the logger thread
+            ~AsyncLog();
+
+            AsyncLog(const AsyncLog&) = delete;
+            AsyncLog& operator=(const AsyncLog&) = delete;
+
+            /// @brief Queue a record. Formats and writes on the caller if
+            ///     the logger thread isn't running.
+            /// @param ring Calling thread's ring
+            /// @param level Severity level
+            /// @param caller Calling component's name. Copied.
+            /// @param fmt printf format. Must outlive the logger.
+            /// @param args Format arguments
+            void log(ThreadRing& ring, const LogLevel level, const char* caller,
+                const char* fmt, va_list args);
+
+            /// @brief Wait until every record queued before the call is
+            ///     written
+            void flush();
+
+            /// @brief Get the logger statistics
+            Stats stats() const;
+
+            /// @brief Log ring of one thread. Single producer, single
+            ///     consumer.
+            class alignas(64) Ring
+            {
+                public:
+                    enum State : uint8_t
+                    {
+                        FREE,
+                        OWNED,
+                        ORPHANED    //< Owner exited. Freed once drained.
+                    };
+
+                    std::atomic<size_t> Head;       //< Read position. Logger thread.
+                    alignas(64) std::atomic<size_t> Tail;   //< Write position. Owner.
+                    std::atomic<uint64_t> Logged;   //< Owner
+                    std::atomic<uint64_t> Dropped;  //< Owner
+                    alignas(64) std::atomic<uint8_t> Claim;
+                    uint64_t Reported;              //< Drops reported. Logger thread.
+                    alignas(8) uint8_t Buf[RingSz];
+
+                    Ring(): Head(0), Tail(0), Logged(0), Dropped(0), Claim(FREE), Reported(0) {}
+            };
+
+        private:
+            Sink_t Sink;
+            Ring Rings[NumRings];
+            std::atomic<uint64_t> NoRing;
+            uint64_t NoRingReported;        //< Logger thread
+            std::atomic<bool> Running;
+            Os::EventCount Wake;            //< Wakes the logger thread
+            Os::Thread Thread;
+            alignas(16) Os::Thread::Config::Stack::Buf_t Stack[ETF_ASYNC_LOG_STACK_SZ];
+
+            /// @brief Claim a free ring
+            /// @return Ring. Nullptr if every ring is taken.
+            Ring* claim();
+
+            /// @brief Copy a record into a ring
+            /// @return False if the ring was full
+            bool push(Ring& ring, const void* rec, const size_t sz);
+
+            /// @brief Write every queued record, oldest first
+            /// @return Number of records written
+            size_t drain();
+
+            /// @brief Format a record and hand it to the sink
+            void emit(const void* rec);
+
+            /// @brief Logger thread routine
+            static void logger_main(void* log);
+    };
+
+    /// @brief Asynchronous logging policy for Logger (see AsyncLog)
+    /// @details Each logging thread gets a ring on its first log. Lines
+    ///     are formatted on the logger thread and written with
+    ///     TSink::write, as ETF_ASYNC_LOG_FMT. Set ETF_LOG_ASYNC to make
+    ///     AsyncLogPolicy<ConsoleLogPolicy> the framework logger.
+    /// @tparam TSink Policy with a static write(level, msg)
+    template <typename TSink>
+    struct AsyncLogPolicy
+    {
+        /// @brief Get the policy's logger. Started on first use.
+        static AsyncLog& instance()
+        {
+            static AsyncLog log(&TSink::write);
+            return log;
+        }
+
+        static void write(const LogLevel level, const char* msg)
+        {
+            log_raw(level, "", "%s", msg);
+        }
+
+        static void write_new(const LogLevel lvl, const char* caller, const char* fmt, va_list fmt_args)
+        {
+            instance().log(Ring, lvl, caller, fmt, fmt_args);
+        }
+
+        /// @brief Wait until every line logged before the call is written
+        static void flush() { instance().flush(); }
+
+        static AsyncLog::Stats stats() { return instance().stats(); }
+
+        private:
+            static inline thread_local AsyncLog::ThreadRing Ring;
+
+            static void log_raw(const LogLevel level, const char* caller, const char* fmt, ...)
+            {
+                va_list args;
+                va_start(args, fmt);
+                instance().log(Ring, level, caller, fmt, args);
+                va_end(args);
+            }
+    };
+
+}
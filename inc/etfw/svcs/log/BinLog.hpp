@@ -0,0 +1,384 @@
+#pragma once
+
+#include "Logger.hpp"
+#include "os/Clock.hpp"
+#include "os/EventCount.hpp"
+#include "os/File.hpp"
+#include "os/Mutex.hpp"
+#include "os/Task.hpp"
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+
+/// Binary log block size, in bytes. Records reach the file in whole
+/// blocks. Multiple of 4096.
+#ifndef ETF_BIN_LOG_BLOCK_SZ
+#define ETF_BIN_LOG_BLOCK_SZ    65536
+#endif
+
+/// Number of binary log block buffers. Records go to one while the
+/// flusher thread writes the others out. At least 2.
+#ifndef ETF_BIN_LOG_BLOCKS
+#define ETF_BIN_LOG_BLOCKS      4
+#endif
+
+/// Longest time a record waits in a partly filled block before the block
+/// is written, in milliseconds, give or take as much again. Each such
+/// write pads a whole block. 0 writes blocks only once full, and on
+/// flush and close.
+#ifndef ETF_BIN_LOG_FLUSH_MS
+#define ETF_BIN_LOG_FLUSH_MS    1000
+#endif
+
+/// Binary log flusher thread stack size, in 32-bit words
+#ifndef ETF_BIN_LOG_STACK_SZ
+#define ETF_BIN_LOG_STACK_SZ    OS_THREAD_DEFAULT_STACK_SZ
+#endif
+
+/// Largest packed argument list of one binary log record, in bytes.
+/// Longer string arguments are truncated.
+#ifndef ETF_BIN_LOG_ARGS_SZ
+#define ETF_BIN_LOG_ARGS_SZ     384
+#endif
+
+/// Distinct format strings per binary log file
+#ifndef ETF_BIN_LOG_FMTS
+#define ETF_BIN_LOG_FMTS        1024
+#endif
+
+/// Distinct callers per binary log file
+#ifndef ETF_BIN_LOG_CALLERS
+#define ETF_BIN_LOG_CALLERS     256
+#endif
+
+/// Caller name bytes kept per binary log file, including the terminator
+#ifndef ETF_BIN_LOG_CALLER_SZ
+#define ETF_BIN_LOG_CALLER_SZ   32
+#endif
+
+namespace etfw {
+
+    /// @brief Binary log file layout
+    /// @details A file is a sequence of BlockSz blocks, each starting
+    ///     with a BlockHead. Records follow the header back to back and
+    ///     the rest of the block is zero. A record starts with a byte
+    ///     holding its kind in the high nibble:
+    ///
+    ///     - FMT and CALLER define an ID before its first use: varint ID,
+    ///       varint length, then the string's bytes.
+    ///     - LOG holds its level in the low nibble, then varints for the
+    ///       nanoseconds since the previous LOG record in the block (or
+    ///       BaseNs), the format ID, the caller ID and the packed
+    ///       arguments size, then the arguments (see LogArgs).
+    ///
+    ///     IDs count up from 0 in each file. Format 0 is "%s" and caller
+    ///     0 is "", the fallbacks when a registry is full. Definitions
+    ///     are cut to FmtLenMax and CallerSz - 1 bytes. Headers are in
+    ///     host byte order.
+    struct BinLogFormat
+    {
+        static constexpr uint32_t Magic = 0x4C425445;   //< "ETBL"
+        static constexpr uint16_t Version = 1;
+        static constexpr size_t BlockSz = ETF_BIN_LOG_BLOCK_SZ;
+        static constexpr size_t ArgsSz = ETF_BIN_LOG_ARGS_SZ;
+        static constexpr size_t NumFmts = ETF_BIN_LOG_FMTS;
+        static constexpr size_t NumCallers = ETF_BIN_LOG_CALLERS;
+        static constexpr size_t CallerSz = ETF_BIN_LOG_CALLER_SZ;
+        static constexpr size_t FmtLenMax = ETF_MAX_LOG_MSG_SZ - 1;
+
+        static_assert((BlockSz % 4096) == 0, "Binary log blocks must be a multiple of 4096 bytes");
+        static_assert(NumFmts <= 0xFFFF && NumCallers <= 0xFFFF, "Binary log IDs must fit 16 bits");
+
+        enum Kind : uint8_t
+        {
+            LOG = 1,
+            FMT = 2,
+            CALLER = 3
+        };
+
+        /// @brief Start of every block
+        struct BlockHead
+        {
+            uint32_t Magic;
+            uint16_t Version;
+            uint16_t HeadSz;        //< sizeof(BlockHead)
+            uint32_t BlockSz;
+            uint32_t Used;          //< Record bytes after the header
+            uint64_t Seq;           //< Block number in the file
+            Os::TimeNs_t BaseNs;    //< Os::Clock time deltas start from
+        };
+
+        static constexpr size_t HeadSz = sizeof(BlockHead);
+    };
+
+    /// @brief Binary log writer (see BinLogPolicy)
+    /// @details Records are a few bytes each: no text is formatted, format
+    ///     strings and callers are written once per file and then referred
+    ///     to by ID, and arguments are packed by type. Records collect in
+    ///     a block buffer. BinLogReader turns a file back into text.
+    ///
+    ///     Format strings are registered by address, so they must be
+    ///     string literals or otherwise live as long as the file. Callers
+    ///     are registered by name. Logging threads share the block under
+    ///     a lock. The thread that fills a block moves on to the next
+    ///     buffer and leaves the full one to a flusher thread, which
+    ///     writes it out whole, so logging threads never wait on the
+    ///     file. The flusher also writes a partly filled block once its
+    ///     first record is FlushMs old. flush and close write what is
+    ///     left on the calling thread.
+    ///
+    ///     A record logged while every other buffer waits for the flusher
+    ///     is dropped and counted.
+    class BinLog
+    {
+        public:
+            using Status = Os::File::Status;
+
+            static constexpr size_t NumBlocks = ETF_BIN_LOG_BLOCKS;
+
+            static_assert(NumBlocks >= 2, "Binary logs need a block to fill while one is written");
+
+            /// @brief Writer statistics
+            struct Stats
+            {
+                uint64_t Records;   //< Log records written
+                uint64_t Bytes;     //< Bytes of records, definitions included
+                uint64_t Blocks;    //< Blocks written to the file
+                uint64_t Dropped;   //< Records logged while closed or with no free block, or lost to a write error
+            };
+
+            /// @brief Start the flusher thread
+            BinLog();
+
+            /// @brief Stop the flusher thread and close the file
+            ~BinLog();
+
+            BinLog(const BinLog&) = delete;
+            BinLog& operator=(const BinLog&) = delete;
+
+            /// @brief Create a log file, truncating an existing one.
+            ///     Closes the open file first.
+            /// @param path File path
+            /// @param flush_ms Longest time a record waits in a partly
+            ///     filled block. 0 waits for the block to fill.
+            /// @return File open status
+            Status open(const char* path, const uint32_t flush_ms = ETF_BIN_LOG_FLUSH_MS);
+
+            /// @brief Flush and close the file
+            /// @return Status of the last block write
+            Status close();
+
+            /// @brief Write out the full blocks and the current one, if it
+            ///     holds records, on the calling thread. The next record
+            ///     starts a new block.
+            /// @return Block write status
+            Status flush();
+
+            /// @brief Add a record. Dropped if no file is open or no block
+            ///     is free. A failed block write closes the file, since
+            ///     the records after it could refer to definitions it
+            ///     held.
+            /// @param level Severity level
+            /// @param caller Calling component's name
+            /// @param fmt printf format. Must outlive the file.
+            /// @param args Format arguments
+            void log(const LogLevel level, const char* caller, const char* fmt, va_list args);
+
+            /// @brief Get the writer statistics
+            Stats stats();
+
+        private:
+            static constexpr uint16_t NoId = UINT16_MAX;
+            static constexpr size_t FmtSlots = BinLogFormat::NumFmts * 2;
+            static constexpr size_t CallerSlots = BinLogFormat::NumCallers * 2;
+
+            /// @brief Header fields of a full block
+            struct Sealed
+            {
+                size_t Used;
+                size_t Records;
+                uint64_t Seq;
+                Os::TimeNs_t BaseNs;
+            };
+
+            Os::Mutex Lock;             //< Blocks, registries, Open and counters
+            Os::Mutex IoLock;           //< File. Taken before Lock.
+            Os::File File;
+            bool Open;
+            Os::TimeNs_t FlushNs;
+            size_t Used;                //< Block bytes, header included
+            size_t BlockRecords;        //< Log records in the block
+            uint64_t Seq;
+            Os::TimeNs_t BaseNs;
+            Os::TimeNs_t LastNs;
+            Os::TimeNs_t FirstNs;       //< First log record in the block
+            uint64_t NumSealed;         //< Blocks handed to the flusher
+            uint64_t NumWritten;        //< Blocks written or discarded
+            Sealed Full[NumBlocks];     //< By block buffer
+            Stats Counts;
+            std::atomic<bool> Running;
+            Os::EventCount Wake;        //< Wakes the flusher thread
+            Os::Thread Thread;
+
+            /// Format registry: addresses hashed to IDs
+            const char* FmtKeys[FmtSlots];
+            uint16_t FmtIds[FmtSlots];
+            size_t NumFmts;
+
+            /// Caller registry: names hashed to IDs
+            char Callers[BinLogFormat::NumCallers][BinLogFormat::CallerSz];
+            uint16_t CallerIds[CallerSlots];   //< ID + 1. 0 if free.
+            size_t NumCallers;
+
+            uint8_t* Block;             //< Buffer records go to
+            alignas(4096) uint8_t Blocks[NumBlocks][BinLogFormat::BlockSz];
+            alignas(16) Os::Thread::Config::Stack::Buf_t Stack[ETF_BIN_LOG_STACK_SZ];
+
+            /// @brief Empty the registries and define the fallback IDs.
+            ///     Lock held.
+            void reset(const Os::TimeNs_t now);
+
+            /// @brief Make room for a record and the definitions it may
+            ///     need, handing the block to the flusher if it is too
+            ///     full. Lock held.
+            /// @param[out] sealed Set if the block was handed over
+            /// @return False if the file is closed or no block is free
+            bool reserve(const Os::TimeNs_t now, bool& sealed);
+
+            /// @brief Hand the block to the flusher and start the next
+            ///     one. A block must be free. Lock held.
+            void seal(const Os::TimeNs_t now);
+
+            /// @brief Write out the oldest full block. On failure, drops
+            ///     the blocks after it and closes the file. IoLock held.
+            /// @param[out] status Write status
+            /// @return True if a block was written
+            bool write_sealed(Status& status);
+
+            /// @brief Write out the full blocks, and the current one if
+            ///     all is set or its first record is FlushNs old. IoLock
+            ///     held.
+            Status service(const bool all);
+
+            /// @brief Flusher thread routine
+            static void flusher_main(void* log);
+
+            /// @brief Add a FMT or CALLER record. Room must be reserved.
+            void define(const uint8_t kind, const uint16_t id, const char* str, const size_t len);
+
+            /// @brief Get a format's ID, registering it if new. Room must
+            ///     be reserved.
+            /// @return ID. NoId if the registry is full.
+            uint16_t fmt_id(const char* fmt);
+
+            /// @brief Get a caller's ID, registering it if new. Room must
+            ///     be reserved.
+            /// @return ID. 0 ("") if the registry is full.
+            uint16_t caller_id(const char* caller);
+
+            /// @brief Append bytes to the block. Room must be reserved.
+            inline void put(const void* data, const size_t sz);
+
+            /// @brief Append a varint to the block. Room must be reserved.
+            inline void put_varint(const uint64_t val);
+    };
+
+    /// @brief Binary logging policy for Logger (see BinLog). Open the
+    ///     file with instance().open before logging; records logged
+    ///     while it is closed are dropped.
+    struct BinLogPolicy
+    {
+        /// @brief Get the policy's writer
+        static BinLog& instance()
+        {
+            static BinLog log;
+            return log;
+        }
+
+        static void write(const LogLevel level, const char* msg)
+        {
+            log_raw(level, "", "%s", msg);
+        }
+
+        static void write_new(const LogLevel lvl, const char* caller, const char* fmt, va_list fmt_args)
+        {
+            instance().log(lvl, caller, fmt, fmt_args);
+        }
+
+        private:
+            static void log_raw(const LogLevel level, const char* caller, const char* fmt, ...)
+            {
+                va_list args;
+                va_start(args, fmt);
+                instance().log(level, caller, fmt, args);
+                va_end(args);
+            }
+    };
+
+    /// @brief Reads a binary log file back (see BinLog)
+    class BinLogReader
+    {
+        public:
+            using Status = Os::File::Status;
+
+            /// @brief One log record
+            struct Entry
+            {
+                Os::TimeNs_t TimeNs;
+                LogLevel Level;
+                const char* Caller;
+                const char* Fmt;
+                char Msg[ETF_MAX_LOG_MSG_SZ];   //< Formatted message
+            };
+
+            BinLogReader();
+
+            /// @brief Open a log file. Closes the open file first.
+            /// @param path File path
+            /// @return File open status
+            Status open(const char* path);
+
+            void close();
+
+            /// @brief Read the next log record
+            /// @param[out] entry Record. Its strings stay valid until the
+            ///     file is closed.
+            /// @return True if a record was read. False at the end of the
+            ///     file or of its valid blocks (see corrupt).
+            bool next(Entry& entry);
+
+            /// @brief Check if reading stopped at an invalid block or
+            ///     record, rather than the end of the file
+            inline bool corrupt() const { return Corrupt; }
+
+        private:
+            Os::File File;
+            bool Open;
+            bool Corrupt;
+            size_t Pos;                 //< Next record in the block
+            size_t End;                 //< End of the block's records
+            uint64_t Seq;               //< Next block number
+            Os::TimeNs_t LastNs;
+            const char* Fmts[BinLogFormat::NumFmts];
+            const char* Callers[BinLogFormat::NumCallers];
+            size_t NumFmts;
+            size_t NumCallers;
+            size_t StringsUsed;
+            char Strings[BinLogFormat::NumFmts * (BinLogFormat::FmtLenMax + 1) +
+                BinLogFormat::NumCallers * BinLogFormat::CallerSz];
+            alignas(4096) uint8_t Block[BinLogFormat::BlockSz];
+
+            /// @brief Read the next block
+            /// @return False at the end of the file, or if the block is invalid
+            bool load_block();
+
+            /// @brief Read a varint at Pos
+            bool get_varint(uint64_t& val);
+
+            /// @brief Read a FMT or CALLER record at Pos
+            /// @return False if it is invalid
+            bool define(const uint8_t kind);
+    };
+
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "Logger.hpp"
+#include "os/Clock.hpp"
+#include "os/EventCount.hpp"
+#include "os/File.hpp"
+#include "os/Mutex.hpp"
+#include "os/Task.hpp"
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+
+/// Size of each of the two file log staging buffers, in bytes
+#ifndef ETF_FILE_LOG_BUF_SZ
+#define ETF_FILE_LOG_BUF_SZ     65536
+#endif
+
+/// Longest time a line stays buffered before it is written, in
+/// milliseconds. Buffers past half full are written at once. 0 writes
+/// only buffers past half full, and on flush and close.
+#ifndef ETF_FILE_LOG_FLUSH_MS
+#define ETF_FILE_LOG_FLUSH_MS   50
+#endif
+
+/// Longest time written lines wait for a data sync, in milliseconds,
+/// give or take ETF_FILE_LOG_FLUSH_MS. 0 syncs after every write. Syncs
+/// only happen with writes, so with no flush period they wait for the
+/// next write, flush or close.
+#ifndef ETF_FILE_LOG_SYNC_MS
+#define ETF_FILE_LOG_SYNC_MS    1000
+#endif
+
+/// File size that starts a new log file, in bytes. 0 disables.
+#ifndef ETF_FILE_LOG_ROTATE_SZ
+#define ETF_FILE_LOG_ROTATE_SZ  (64 * 1024 * 1024)
+#endif
+
+/// File age that starts a new log file, in seconds. 0 disables.
+#ifndef ETF_FILE_LOG_ROTATE_S
+#define ETF_FILE_LOG_ROTATE_S   0
+#endif
+
+/// Rotated log files kept, as <path>.1 (newest) to <path>.N
+#ifndef ETF_FILE_LOG_KEEP
+#define ETF_FILE_LOG_KEEP       4
+#endif
+
+/// Longest log file path, including the terminator
+#ifndef ETF_FILE_LOG_PATH_SZ
+#define ETF_FILE_LOG_PATH_SZ    128
+#endif
+
+/// File log flusher thread stack size, in 32-bit words
+#ifndef ETF_FILE_LOG_STACK_SZ
+#define ETF_FILE_LOG_STACK_SZ   OS_THREAD_DEFAULT_STACK_SZ
+#endif
+
+namespace etfw {
+
+    /// @brief Buffered, rotating log file (see FileLogPolicy)
+    /// @details Logging threads copy their line into a staging buffer and
+    ///     return. A flusher thread swaps the buffer for the second one
+    ///     and writes the full one in a single write, every FlushMs or
+    ///     once it is half full, so logging threads never wait on the
+    ///     file. With FlushMs 0, only flush, close and half full buffers
+    ///     write, so callers decide when lines reach the file. The file
+    ///     is opened to append, and data syncs run on the flusher thread
+    ///     at most SyncMs apart rather than on every write.
+    ///
+    ///     Before a write would take the file past RotateSz, or once it
+    ///     is RotateSec old, the file is renamed to <path>.1, older files
+    ///     move up one number, the oldest past Keep is removed, and a new
+    ///     file is started. Lines are never split across files.
+    ///
+    ///     A line that doesn't fit in the buffer is dropped and counted,
+    ///     and the flusher reports the drops in the file.
+    class FileLog
+    {
+        public:
+            using Status = Os::File::Status;
+
+            static constexpr size_t BufSz = ETF_FILE_LOG_BUF_SZ;
+            static constexpr size_t PathSz = ETF_FILE_LOG_PATH_SZ;
+
+            /// @brief File and flush settings
+            struct Config
+            {
+                const char* Path = nullptr;                 //< Copied. Shorter than PathSz.
+                size_t RotateSz = ETF_FILE_LOG_ROTATE_SZ;   //< 0 disables
+                uint32_t RotateSec = ETF_FILE_LOG_ROTATE_S; //< 0 disables
+                uint32_t Keep = ETF_FILE_LOG_KEEP;          //< Rotated files kept
+                uint32_t FlushMs = ETF_FILE_LOG_FLUSH_MS;   //< 0 disables
+                uint32_t SyncMs = ETF_FILE_LOG_SYNC_MS;
+            };
+
+            /// @brief File log statistics
+            struct Stats
+            {
+                uint64_t Lines;     //< Lines buffered
+                uint64_t Dropped;   //< Lines dropped on a full buffer or closed file
+                uint64_t Bytes;     //< Bytes written to files
+                uint64_t Writes;    //< File writes
+                uint64_t Syncs;     //< Data syncs
+                uint64_t Rotations;
+                uint64_t Errors;    //< Failed writes, syncs and rotations
+            };
+
+            /// @brief Start the flusher thread
+            FileLog();
+
+            /// @brief Stop the flusher thread and close the file
+            ~FileLog();
+
+            FileLog(const FileLog&) = delete;
+            FileLog& operator=(const FileLog&) = delete;
+
+            /// @brief Open a log file to append to. Closes the open file
+            ///     first.
+            /// @param cfg File and flush settings
+            /// @return File open status. INVALID_ARGUMENT if the path is
+            ///     too long.
+            Status open(const Config& cfg);
+
+            /// @brief Write and sync what is buffered, then close the file
+            /// @return Status of the last write or sync
+            Status close();
+
+            /// @brief Buffer a line. The newline is added. Dropped if no
+            ///     file is open or the buffer is full.
+            /// @param line Line to write
+            void write(const char* line);
+
+            /// @brief Write and sync what is buffered, on the calling
+            ///     thread
+            /// @return Status of the write or sync
+            Status flush();
+
+            /// @brief Get the file log statistics. Doesn't wait for
+            ///     writes or syncs.
+            Stats stats();
+
+        private:
+            Os::Mutex Lock;             //< Staging buffers, Open, Cfg and counters
+            Os::Mutex IoLock;           //< File and rotation. Taken before Lock.
+            Os::File File;
+            Config Cfg;
+            char Path[PathSz];
+            bool Open;
+            uint8_t Active;             //< Buffer lines go to
+            size_t Used[2];
+            size_t FileSz;
+            Os::TimeNs_t OpenedNs;
+            Os::TimeNs_t SyncedNs;
+            bool Dirty;                 //< Written since the last sync
+            uint64_t Reported;          //< Drops reported in the file
+            uint64_t Opens;             //< Files opened. Restarts the flush period.
+            Stats Counts;
+            std::atomic<bool> Running;
+            Os::EventCount Wake;        //< Wakes the flusher thread
+            Os::Thread Thread;
+            alignas(64) uint8_t Bufs[2][BufSz];
+            alignas(16) Os::Thread::Config::Stack::Buf_t Stack[ETF_FILE_LOG_STACK_SZ];
+
+            /// @brief Write what is buffered, report drops, and rotate and
+            ///     sync when due. IoLock held.
+            /// @param sync Sync written data now
+            Status service(const bool sync);
+
+            /// @brief Write bytes to the file. IoLock held.
+            Status write_out(uint8_t* data, const size_t sz);
+
+            /// @brief Start a new file, keeping the old ones. IoLock held.
+            Status rotate(const Os::TimeNs_t now);
+
+            /// @brief Flusher thread routine
+            static void flusher_main(void* log);
+    };
+
+    /// @brief File logging policy for Logger (see FileLog). Writes the
+    ///     lines ConsoleLogPolicy prints. Open the file with
+    ///     instance().open before logging; lines logged while it is
+    ///     closed are dropped. For timestamps and formatting off the
+    ///     logging thread, wrap it: AsyncLogPolicy<FileLogPolicy>.
+    struct FileLogPolicy
+    {
+        /// @brief Get the policy's file log
+        static FileLog& instance()
+        {
+            static FileLog log;
+            return log;
+        }
+
+        static void write(const LogLevel level, const char* msg)
+        {
+            instance().write(msg);
+        }
+
+        static void write_new(const LogLevel lvl, const char* caller, const char* fmt, va_list fmt_args)
+        {
+            char msg[ETF_MAX_LOG_MSG_SZ];
+            std::vsnprintf(msg, sizeof(msg), fmt, fmt_args);
+            char line[ETF_MAX_LOG_MSG_SZ + 48];
+            std::snprintf(line, sizeof(line), ETF_LOG_FMT, caller, log_lvl_to_str(lvl), msg);
+            instance().write(line);
+        }
+    };
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+
+namespace etfw {
+
+    /// @brief Packs printf arguments into bytes, and formats them back
+    /// @details Argument types are read off the format string, so packed
+    ///     arguments only make sense with the format they were packed
+    ///     with. Integers and pointers are LEB128 varints, zigzagged if
+    ///     signed. Floating point values are 8-byte doubles. Strings are a
+    ///     varint length followed by their bytes, truncated to fit.
+    ///
+    ///     Supports the printf conversions except wide strings. Packing
+    ///     stops at the first conversion it can't type, and formatting
+    ///     writes the rest of the format as is.
+    struct LogArgs
+    {
+        /// @brief Longest varint, in bytes
+        static constexpr size_t VarintMaxSz = 10;
+
+        /// @brief Pack the arguments of a format
+        /// @param fmt printf format
+        /// @param args Format arguments
+        /// @param[out] buf Packed arguments
+        /// @param sz buf size
+        /// @return Bytes used. Arguments that don't fit are left out.
+        static size_t pack(const char* fmt, va_list args, uint8_t* buf, const size_t sz);
+
+        /// @brief Format packed arguments
+        /// @param fmt Format the arguments were packed with
+        /// @param args Packed arguments
+        /// @param sz Packed arguments size
+        /// @param[out] out Formatted string. Always terminated.
+        /// @param out_sz out size. Must not be 0.
+        /// @return Length of out
+        static size_t format(const char* fmt, const uint8_t* args, const size_t sz,
+            char* out, const size_t out_sz);
+
+        /// @brief Write a varint
+        /// @return Bytes written. 0 if it doesn't fit.
+        static size_t put_varint(const uint64_t val, uint8_t* buf, const size_t sz);
+
+        /// @brief Read a varint
+        /// @return Bytes read. 0 if buf ends first.
+        static size_t get_varint(const uint8_t* buf, const size_t sz, uint64_t& val);
+    };
+
+}
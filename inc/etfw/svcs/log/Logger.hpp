@@ -7,6 +7,8 @@
 #include <cstdio>
 #include <cstdarg>
 #include <array>
+#include <atomic>
+#include <cstdint>
 
 #ifndef ETF_MAX_LOG_MSG_SZ
 #define ETF_MAX_LOG_MSG_SZ  256
@@ -14,6 +16,12 @@
 
 #define ETF_LOG_MSG_TS_SZ   12
 
+/// Lowest log level built in, as a LogLevel value: 0 (DEBUG) to 4
+/// (CRITICAL). Log calls below it compile to nothing.
+#ifndef ETF_LOG_LEVEL
+#define ETF_LOG_LEVEL       0
+#endif
+
 #define ETF_LOG_FMT     "%-20s %-12s %s"
 
 namespace etfw {
@@ -28,6 +36,43 @@ namespace etfw {
         CRITICAL    ///< Highest severity, unrecoverable error has occurred.
     };
 
+    /// @brief Lowest log level built in (see ETF_LOG_LEVEL)
+    static constexpr LogLevel LogLevelMin = static_cast<LogLevel>(ETF_LOG_LEVEL);
+
+    /// @brief Runtime log level of one component. Messages below it are
+    ///     dropped before they are formatted.
+    class LogThreshold
+    {
+        public:
+            explicit LogThreshold(const LogLevel level = LogLevelMin):
+                Level(static_cast<uint8_t>(level)) {}
+
+            /// @brief Copy other's level
+            LogThreshold(const LogThreshold& other):
+                Level(other.Level.load(std::memory_order_relaxed)) {}
+
+            LogThreshold& operator=(const LogThreshold&) = delete;
+
+            /// @brief Check if a message of a level passes
+            inline bool enabled(const LogLevel level) const
+            {
+                return static_cast<uint8_t>(level) >= Level.load(std::memory_order_relaxed);
+            }
+
+            inline LogLevel get() const
+            {
+                return static_cast<LogLevel>(Level.load(std::memory_order_relaxed));
+            }
+
+            inline void set(const LogLevel level)
+            {
+                Level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+            }
+
+        private:
+            std::atomic<uint8_t> Level;
+    };
+
     /// @brief Returns the string representation of a log severity level
     /// @param lvl Severity level
     /// @return C-style string of severity level
@@ -67,12 +112,22 @@ namespace etfw {
         using Level = LogLevel;
         static constexpr size_t MsgBufSz = ETF_MAX_LOG_MSG_SZ;
 
+        /// @brief Check if a level is built in (see ETF_LOG_LEVEL)
+        static constexpr bool enabled(const Level level)
+        {
+            return level >= LogLevelMin;
+        }
+
         /// @brief Sends a C-style string to all writers
         /// @param level Severity level
         /// @param format String to write. Formattable
         /// @param Args Variadic string format arguments 
         static void log(const Level level, const char* format, ...)
         {
+            if (!enabled(level))
+            {
+                return;
+            }
             std::array<char, MsgBufSz> MsgBuf;
             va_list args;
             va_start(args, format);
@@ -89,6 +144,10 @@ namespace etfw {
         /// @param Args Variadic string format arguments 
         static void log(const Level level, const char* caller_name, const char* fmt, ...)
         {
+            if (!enabled(level))
+            {
+                return;
+            }
             va_list args;
             va_start(args, fmt);
             (TLogWriters::write_new(level, caller_name, fmt, args), ...);
@@ -102,6 +161,10 @@ namespace etfw {
         /// @param args Pre-processed va_list string format arguments
         static void log(const Level level, const char* caller_name, const char* fmt, va_list args)
         {
+            if (!enabled(level))
+            {
+                return;
+            }
             (TLogWriters::write_new(level, caller_name, fmt, args), ...);
         }
 
@@ -142,6 +205,16 @@ struct ConsoleLogPolicy
     }
 };
 
+/// Set to 1 to log through AsyncLogPolicy<ConsoleLogPolicy>
+#ifndef ETF_LOG_ASYNC
+#define ETF_LOG_ASYNC   0
+#endif
+
 #ifndef EtfLog
+#if ETF_LOG_ASYNC
+#include "AsyncLog.hpp"
+#define EtfLog    ::etfw::Logger<::etfw::AsyncLogPolicy<ConsoleLogPolicy>>
+#else
 #define EtfLog    ::etfw::Logger<ConsoleLogPolicy>
 #endif
+#endif
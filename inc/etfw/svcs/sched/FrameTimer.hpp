@@ -0,0 +1,121 @@
+#pragma once
+
+#include "os/Clock.hpp"
+#include <etl/span.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace etfw {
+namespace sched {
+
+    /// @brief Timing statistics for one minor frame slot
+    struct SlotStats
+    {
+        uint32_t Wakes;         //< Times the slot ran
+        uint32_t Overruns;      //< Times the slot was skipped for running late
+        Os::TimeNs_t JitterMin; //< Smallest wake delay past the slot start
+        Os::TimeNs_t JitterMax; //< Largest wake delay past the slot start
+        Os::TimeNs_t JitterSum; //< Sum of wake delays. See jitter_mean.
+
+        SlotStats()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            Wakes = 0;
+            Overruns = 0;
+            JitterMin = Os::TimeNsNever;
+            JitterMax = 0;
+            JitterSum = 0;
+        }
+
+        inline Os::TimeNs_t jitter_mean() const
+        {
+            return (Wakes > 0) ? (JitterSum / Wakes) : 0;
+        }
+    };
+
+    /// @brief Time source of a FrameTimer
+    class iFrameClock
+    {
+        public:
+            virtual Os::TimeNs_t now_ns() = 0;
+
+            /// @brief Sleep until an absolute time of this clock
+            virtual void sleep_until(const Os::TimeNs_t deadline_ns) = 0;
+
+        protected:
+            ~iFrameClock() = default;
+    };
+
+    /// @brief Frame clock on Os::Clock. Used unless a timer is given
+    ///     another clock.
+    class OsFrameClock : public iFrameClock
+    {
+        public:
+            Os::TimeNs_t now_ns() override { return Os::Clock::now_ns(); }
+
+            void sleep_until(const Os::TimeNs_t deadline_ns) override
+            {
+                Os::Clock::sleep_until(deadline_ns);
+            }
+
+            static OsFrameClock& instance();
+    };
+
+    /// @brief Minor frame clock
+    /// @details Frame k of a run starts at start + k * period. Each wait
+    ///     sleeps to the next frame start as an absolute CLOCK_MONOTONIC
+    ///     time, so time spent handling a frame doesn't push later frames
+    ///     back. If the caller falls more than a frame behind, the frames
+    ///     whose start has already passed are skipped and counted as
+    ///     overruns for their slot rather than run back to back.
+    class FrameTimer
+    {
+        public:
+            /// @param period_ns Minor frame period
+            /// @param stats One entry per minor frame in the major frame
+            /// @param clock Time source
+            FrameTimer(const Os::TimeNs_t period_ns, etl::span<SlotStats> stats,
+                iFrameClock& clock = OsFrameClock::instance());
+
+            /// @brief Start frame 0 one period from now. Call from the
+            ///     thread that waits; it also minimizes that thread's timer
+            ///     slack.
+            void start();
+
+            /// @brief Start frame 0 one period from start_ns (see start())
+            /// @param start_ns Time of the timer's clock
+            void start(const Os::TimeNs_t start_ns);
+
+            /// @brief Sleep until the next minor frame starts
+            /// @return Index of the frame, within the major frame
+            size_t wait();
+
+            /// @brief Get the number of complete major frames
+            inline uint32_t major_frames() const { return major_frames_; }
+
+            inline Os::TimeNs_t period_ns() const { return period_ns_; }
+
+            inline size_t num_frames() const { return stats_.size(); }
+
+            inline const SlotStats& stats(const size_t frame) const { return stats_[frame]; }
+
+            void reset_stats();
+
+        private:
+            const Os::TimeNs_t period_ns_;
+            etl::span<SlotStats> stats_;
+            iFrameClock& clock_;
+            Os::TimeNs_t next_ns_;      //< Start of the next frame
+            size_t frame_;              //< Index of the next frame
+            uint32_t major_frames_;
+
+            /// @brief Move to the following frame
+            void advance();
+    };
+
+}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "svcs/App.hpp"
+#include "svcs/SvcCfg.hpp"
+#include "msg/Message.hpp"
+#include "FrameTimer.hpp"
+#include "SchedTbl.hpp"
+
+/// @brief Scheduler task priority. Should be above every app it wakes.
+#ifndef SCHED_APP_PRIORITY
+#define SCHED_APP_PRIORITY          90
+#endif
+
+/// @brief Scheduler task stack size, in 32-bit words
+#ifndef SCHED_APP_STACK_SZ
+#define SCHED_APP_STACK_SZ          OS_THREAD_DEFAULT_STACK_SZ
+#endif
+
+/// @brief Default send list capacity of each minor frame
+#ifndef SCHED_MAX_MSGS_PER_FRAME
+#define SCHED_MAX_MSGS_PER_FRAME    8
+#endif
+
+namespace etfw {
+namespace sched {
+
+    /// @brief Scheduler app configuration
+    /// @tparam TId Scheduler app ID
+    /// @tparam TMinorFrameUs Minor frame period in microseconds
+    /// @tparam TNumMinorFrames Minor frames per major frame
+    /// @tparam TMaxMsgsPerFrame Send list capacity of each minor frame
+    template <SvcId_t TId,
+        uint32_t TMinorFrameUs,
+        size_t TNumMinorFrames,
+        size_t TMaxMsgsPerFrame = SCHED_MAX_MSGS_PER_FRAME,
+        uint8_t TPriority = SCHED_APP_PRIORITY,
+        size_t TStackSz = SCHED_APP_STACK_SZ>
+    struct SchedAppCfg : public SvcCfg<TId, ActiveSvcCfg<TPriority, TStackSz>>
+    {
+        static_assert(TMinorFrameUs > 0, "Minor frame period must be non-zero");
+
+        static constexpr const char* NAME = "SCHED";
+        static constexpr uint32_t MINOR_FRAME_US = TMinorFrameUs;
+        static constexpr size_t NUM_MINOR_FRAMES = TNumMinorFrames;
+        static constexpr size_t MAX_MSGS_PER_FRAME = TMaxMsgsPerFrame;
+    };
+
+    /// @brief Frame scheduler app. Sends each minor frame's wakeup
+    ///     messages through the command broker at the start of the frame.
+    /// @details The schedule table is copied when the app is constructed.
+    ///     Frames are timed with FrameTimer, so they don't drift and each
+    ///     slot's wake jitter and overruns are recorded (see stats).
+    /// @tparam Cfg Scheduler configuration. See SchedAppCfg.
+    template <typename Cfg>
+    class SchedApp : public App<SchedApp<Cfg>, Cfg>
+    {
+        public:
+            using Base_t = App<SchedApp<Cfg>, Cfg>;
+            using Status = typename Base_t::Status;
+            using RunState = typename Base_t::RunState;
+            using Tbl_t = SchedTbl<Cfg::NUM_MINOR_FRAMES, Cfg::MAX_MSGS_PER_FRAME>;
+
+            static constexpr Os::TimeNs_t MinorFrameNs =
+                static_cast<Os::TimeNs_t>(Cfg::MINOR_FRAME_US) * 1000;
+
+            /// @param tbl Schedule. Copied.
+            SchedApp(const Tbl_t& tbl):
+                Base_t(),
+                tbl_(tbl),
+                timer_(MinorFrameNs, etl::span<SlotStats>(stats_, Cfg::NUM_MINOR_FRAMES))
+            {}
+
+            Status app_init()
+            {
+                return Status::Code::OK;
+            }
+
+            RunState pre_run_init() override
+            {
+                timer_.start();
+                return RunState::OK;
+            }
+
+            RunState run_loop()
+            {
+                const size_t frame = timer_.wait();
+                for (const msg::MsgId_t id: tbl_.frame(frame))
+                {
+                    msg::iBaseMsg wakeup(id);
+                    iApp::send_cmd(wakeup);
+                }
+                return RunState::OK;
+            }
+
+            Status app_cleanup()
+            {
+                return Status::Code::OK;
+            }
+
+            /// @brief Get a minor frame slot's timing statistics
+            /// @param frame Minor frame index
+            inline const SlotStats& stats(const size_t frame) const { return timer_.stats(frame); }
+
+            /// @brief Get the number of complete major frames
+            inline uint32_t major_frames() const { return timer_.major_frames(); }
+
+            /// @brief Log every slot's statistics
+            void log_stats()
+            {
+                for (size_t frame = 0; frame < Cfg::NUM_MINOR_FRAMES; frame++)
+                {
+                    const SlotStats& slot = timer_.stats(frame);
+                    this->log(LogLevel::INFO,
+                        "Slot %u: wakes %u, overruns %u, jitter us min %u mean %u max %u",
+                        static_cast<unsigned>(frame),
+                        static_cast<unsigned>(slot.Wakes),
+                        static_cast<unsigned>(slot.Overruns),
+                        static_cast<unsigned>((slot.Wakes > 0) ? (slot.JitterMin / 1000) : 0),
+                        static_cast<unsigned>(slot.jitter_mean() / 1000),
+                        static_cast<unsigned>(slot.JitterMax / 1000));
+                }
+            }
+
+        private:
+            const Tbl_t tbl_;
+            SlotStats stats_[Cfg::NUM_MINOR_FRAMES];
+            FrameTimer timer_;
+    };
+
+}
+}
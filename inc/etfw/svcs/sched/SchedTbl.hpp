@@ -0,0 +1,126 @@
+#pragma once
+
+#include "msg/Message.hpp"
+#include "status.hpp"
+#include <etl/span.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace etfw {
+namespace sched {
+
+    /// @brief Schedule table status code trait
+    struct SchedTblStatusTrait
+    {
+        enum class Code : int32_t
+        {
+            OK,
+            INVALID_FRAME,
+            INVALID_PERIOD,
+            FRAME_FULL,
+
+            COUNT
+        };
+
+        static constexpr StatusStr_t ErrStrLkup[] =
+        {
+            "Success",
+            "Minor frame index out of range",
+            "Period must divide the major frame",
+            "Minor frame send list full"
+        };
+    };
+
+    /// @brief Message schedule for one major frame
+    /// @details Holds a send list per minor frame. The scheduler only
+    ///     walks the current frame's list, so the cost of a frame depends
+    ///     on what it sends, not on the size of the table.
+    /// @tparam TNumFrames Minor frames per major frame
+    /// @tparam TMaxMsgsPerFrame Send list capacity of each minor frame
+    template <size_t TNumFrames, size_t TMaxMsgsPerFrame>
+    class SchedTbl
+    {
+        static_assert(TNumFrames > 0, "Major frame must have at least one minor frame");
+        static_assert(TMaxMsgsPerFrame > 0, "Minor frame send lists must have capacity");
+
+        public:
+            using Status = EtfwStatus<SchedTblStatusTrait>;
+            using MsgId_t = msg::MsgId_t;
+
+            static constexpr size_t NUM_FRAMES = TNumFrames;
+            static constexpr size_t MAX_MSGS_PER_FRAME = TMaxMsgsPerFrame;
+
+            SchedTbl():
+                counts_{}
+            {}
+
+            /// @brief Send a message in one minor frame
+            /// @param frame Minor frame index
+            /// @param id Message ID to send
+            Status add(const size_t frame, const MsgId_t id)
+            {
+                if (frame >= TNumFrames)
+                {
+                    return Status::Code::INVALID_FRAME;
+                }
+                if (counts_[frame] >= TMaxMsgsPerFrame)
+                {
+                    return Status::Code::FRAME_FULL;
+                }
+                ids_[frame][counts_[frame]++] = id;
+                return Status::Code::OK;
+            }
+
+            /// @brief Send a message every period_frames minor frames
+            /// @details Nothing is added unless every frame has room
+            /// @param id Message ID to send
+            /// @param period_frames Minor frames between sends. Must divide
+            ///     the major frame so the rate is the same across majors.
+            /// @param offset First minor frame to send in
+            Status add_periodic(const MsgId_t id, const size_t period_frames,
+                const size_t offset = 0)
+            {
+                if (period_frames == 0 || (TNumFrames % period_frames) != 0)
+                {
+                    return Status::Code::INVALID_PERIOD;
+                }
+                if (offset >= period_frames)
+                {
+                    return Status::Code::INVALID_FRAME;
+                }
+                for (size_t frame = offset; frame < TNumFrames; frame += period_frames)
+                {
+                    if (counts_[frame] >= TMaxMsgsPerFrame)
+                    {
+                        return Status::Code::FRAME_FULL;
+                    }
+                }
+                for (size_t frame = offset; frame < TNumFrames; frame += period_frames)
+                {
+                    ids_[frame][counts_[frame]++] = id;
+                }
+                return Status::Code::OK;
+            }
+
+            /// @brief Get a minor frame's send list
+            /// @param frame Minor frame index. Must be in range.
+            inline etl::span<const MsgId_t> frame(const size_t frame) const
+            {
+                return etl::span<const MsgId_t>(ids_[frame], counts_[frame]);
+            }
+
+            void clear()
+            {
+                for (auto& count: counts_)
+                {
+                    count = 0;
+                }
+            }
+
+        private:
+            MsgId_t ids_[TNumFrames][TMaxMsgsPerFrame];
+            size_t counts_[TNumFrames];
+    };
+
+}
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include "svcs/App.hpp"
+#include "svcs/SvcCfg.hpp"
+#include "msg/Message.hpp"
+#include "msg/EventSource.hpp"
+#include "os/Mutex.hpp"
+#include "TimerWheel.hpp"
+#include "etfw_assert.hpp"
+#include <algorithm>
+#include <atomic>
+
+/// @brief Timer app task priority. Should be above the apps it serves.
+#ifndef TIMER_APP_PRIORITY
+#define TIMER_APP_PRIORITY      80
+#endif
+
+/// @brief Timer app task stack size, in 32-bit words
+#ifndef TIMER_APP_STACK_SZ
+#define TIMER_APP_STACK_SZ      OS_THREAD_DEFAULT_STACK_SZ
+#endif
+
+/// @brief Default number of timers the timer app can hold armed at once
+#ifndef TIMER_APP_MAX_TIMERS
+#define TIMER_APP_MAX_TIMERS    1024
+#endif
+
+/// @brief Default timer resolution, in microseconds
+#ifndef TIMER_APP_TICK_US
+#define TIMER_APP_TICK_US       1000
+#endif
+
+namespace etfw {
+namespace timer {
+
+    /// @brief Timer expiry message
+    struct iTimerMsg : public msg::iBaseMsg
+    {
+        TimerId_t Timer;    //< Timer that expired
+        uint32_t Missed;    //< Periodic expiries skipped since the last one
+
+        iTimerMsg(const msg::MsgId_t id, const TimerId_t timer, const uint32_t missed):
+            msg::iBaseMsg(id, sizeof(iTimerMsg)),
+            Timer(timer),
+            Missed(missed)
+        {}
+    };
+
+    /// @brief Timer expiry message with a compile-time ID, for routers.
+    ///     Arm timers with TimerMsg<...>::ID.
+    /// @tparam TId Message ID
+    template <msg::MsgId_t TId>
+    struct TimerMsg : public iTimerMsg
+    {
+        static constexpr msg::MsgId_t ID = TId;
+
+        TimerMsg():
+            iTimerMsg(TId, TimerIdInvalid, 0)
+        {}
+    };
+
+    /// @brief Timer app configuration
+    /// @tparam TId Timer app ID
+    /// @tparam TMaxTimers Maximum number of armed timers
+    /// @tparam TTickUs Timer resolution in microseconds
+    template <SvcId_t TId,
+        size_t TMaxTimers = TIMER_APP_MAX_TIMERS,
+        uint32_t TTickUs = TIMER_APP_TICK_US,
+        uint8_t TPriority = TIMER_APP_PRIORITY,
+        size_t TStackSz = TIMER_APP_STACK_SZ>
+    struct TimerAppCfg : public SvcCfg<TId, EventSvcCfg<TPriority, TStackSz>>
+    {
+        static_assert(TTickUs > 0, "Timer tick must be non-zero");
+
+        static constexpr const char* NAME = "TIMER";
+        static constexpr size_t MAX_TIMERS = TMaxTimers;
+        static constexpr uint32_t TICK_US = TTickUs;
+    };
+
+    /// @brief Timer app. Sends a message when a one-shot or periodic timer
+    ///     expires.
+    /// @details Any thread may arm or cancel timers. The app's task sleeps
+    ///     until the next wheel event and is woken early only if a timer is
+    ///     armed ahead of it. Expiries are built in a command broker buffer
+    ///     (see iApp::send_cmd), so they reach queued pipes subscribed to
+    ///     the timer's message ID without being copied. They are sent
+    ///     with the wheel unlocked, so synchronous handlers may arm and
+    ///     cancel timers.
+    ///
+    ///     Timers never fire early. They fire within a tick of their expiry
+    ///     plus the task's wake latency. Once cancel returns, the timer
+    ///     sends nothing more, though an expiry may already be queued.
+    /// @tparam Cfg Timer app configuration. See TimerAppCfg.
+    template <typename Cfg>
+    class TimerApp : public App<TimerApp<Cfg>, Cfg>, public msg::iEventSource
+    {
+        public:
+            using Base_t = App<TimerApp<Cfg>, Cfg>;
+            using Status = typename Base_t::Status;
+            using TimerStatus = TimerWheel::Status;
+
+            static constexpr Os::TimeNs_t TickNs =
+                static_cast<Os::TimeNs_t>(Cfg::TICK_US) * 1000;
+
+            TimerApp():
+                Base_t(),
+                origin_ns_(Os::Clock::now_ns()),
+                event_(nullptr),
+                wait_tick_(TickNever),
+                sources_{this}
+            {
+                auto stat = lock_.init();
+                ETFW_ASSERT(stat.success(), "Failed to initialize timer lock");
+            }
+
+            /// @brief Send a message once after a delay
+            /// @param[out] timer Timer handle
+            /// @param msg_id Message to send
+            /// @param delay_ms Delay in milliseconds
+            TimerStatus start_oneshot(TimerId_t& timer, const msg::MsgId_t msg_id,
+                const Os::TimeMs_t delay_ms)
+            {
+                return arm(timer, msg_id, to_ns(delay_ms), 0);
+            }
+
+            /// @brief Send a message every period, starting one period from now
+            /// @param[out] timer Timer handle
+            /// @param msg_id Message to send
+            /// @param period_ms Period in milliseconds. Rounded up to whole ticks.
+            TimerStatus start_periodic(TimerId_t& timer, const msg::MsgId_t msg_id,
+                const Os::TimeMs_t period_ms)
+            {
+                const Os::TimeNs_t period_ns = to_ns(period_ms);
+                const Tick_t period = std::max<Tick_t>((period_ns + TickNs - 1) / TickNs, 1);
+                return arm(timer, msg_id, period_ns, period);
+            }
+
+            /// @brief Stop a timer
+            /// @param timer Timer handle
+            TimerStatus cancel(const TimerId_t timer)
+            {
+                lock_.lock();
+                const TimerStatus stat = wheel_.cancel(timer);
+                lock_.unlock();
+                return stat;
+            }
+
+            /// @brief Get the number of armed timers
+            size_t active()
+            {
+                lock_.lock();
+                const size_t count = wheel_.active();
+                lock_.unlock();
+                return count;
+            }
+
+            /// @brief Get the number of expiries sent
+            inline size_t expiries() const { return expiries_.load(std::memory_order_relaxed); }
+
+            Status app_init()
+            {
+                return Status::Code::OK;
+            }
+
+            Status app_cleanup()
+            {
+                return Status::Code::OK;
+            }
+
+            /// @brief Runner sleeps on the timing wheel
+            msg::EventSources_t event_sources() override
+            {
+                return msg::EventSources_t(sources_, 1);
+            }
+
+            void attach(Os::EventCount* event) override
+            {
+                lock_.lock();
+                event_ = event;
+                lock_.unlock();
+            }
+
+            Os::TimeNs_t deadline_ns() const override
+            {
+                lock_.lock();
+                const Tick_t next = wheel_.next_event();
+                wait_tick_ = next;
+                lock_.unlock();
+                return (next == TickNever) ? Os::TimeNsNever : (origin_ns_ + (next * TickNs));
+            }
+
+            bool dispatch(const Os::TimeNs_t now_ns) override
+            {
+                const Tick_t now = (now_ns - origin_ns_) / TickNs;
+                // Send once unlocked, so handlers may arm and cancel timers
+                lock_.lock();
+                const size_t fired = wheel_.advance(now,
+                    [this](const TimerId_t id, const msg::MsgId_t msg_id, const uint32_t missed)
+                    {
+                        fired_[fired_count_++] = Expiry{id, msg_id, missed};
+                    });
+                lock_.unlock();
+                for (size_t i = 0; i < fired; i++)
+                {
+                    const Expiry& expiry = fired_[i];
+                    iApp::send_cmd<iTimerMsg>(expiry.MsgId, expiry.Id, expiry.Missed);
+                }
+                fired_count_ = 0;
+                expiries_.fetch_add(fired, std::memory_order_relaxed);
+                return fired > 0;
+            }
+
+        private:
+            /// @brief Timer expiry waiting to be sent
+            struct Expiry
+            {
+                TimerId_t Id;
+                msg::MsgId_t MsgId;
+                uint32_t Missed;
+            };
+
+            StaticTimerWheel<Cfg::MAX_TIMERS> wheel_;
+            /// Expiries of one dispatch. Each armed timer fires at most
+            /// once per advance.
+            Expiry fired_[Cfg::MAX_TIMERS];
+            size_t fired_count_ = 0;
+            mutable Os::Mutex lock_;            //< Guards the wheel and wait_tick_
+            const Os::TimeNs_t origin_ns_;      //< Clock time of tick 0
+            Os::EventCount* event_;             //< Runner event
+            mutable Tick_t wait_tick_;          //< Tick the runner sleeps until
+            std::atomic<size_t> expiries_{0};
+            msg::iEventSource* const sources_[1];
+
+            static inline Os::TimeNs_t to_ns(const Os::TimeMs_t t_ms)
+            {
+                return static_cast<Os::TimeNs_t>(t_ms) * Os::NsPerMs;
+            }
+
+            /// @brief Arm a timer delay_ns from now
+            TimerStatus arm(TimerId_t& timer, const msg::MsgId_t msg_id,
+                const Os::TimeNs_t delay_ns, const Tick_t period)
+            {
+                // Round up so the timer can't fire before the delay passes
+                const Os::TimeNs_t expiry_ns = (Os::Clock::now_ns() - origin_ns_) + delay_ns;
+                const Tick_t expiry = (expiry_ns + TickNs - 1) / TickNs;
+
+                lock_.lock();
+                const TimerStatus stat = wheel_.arm(timer, msg_id, expiry, period);
+                const bool wake = stat.success() && (expiry < wait_tick_) &&
+                    (event_ != nullptr);
+                if (wake)
+                {
+                    wait_tick_ = expiry;
+                }
+                lock_.unlock();
+
+                if (wake)
+                {
+                    event_->notify();
+                }
+                return stat;
+            }
+    };
+
+}
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include "msg/Message.hpp"
+#include "status.hpp"
+#include <etl/span.h>
+#include <cstddef>
+#include <cstdint>
+
+/// @brief Number of timing wheel levels. Each level has 64 slots, so a
+///     wheel spans 64^levels ticks before long timers have to be re-filed.
+#ifndef TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_LEVELS      4
+#endif
+
+namespace etfw {
+namespace timer {
+
+    /// @brief Timer handle. Holds the timer's pool index and a generation
+    ///     count, so a stale handle never touches a reused timer.
+    using TimerId_t = uint32_t;
+
+    /// @brief Handle no timer is ever given
+    constexpr TimerId_t TimerIdInvalid = 0;
+
+    /// @brief Wheel time, in ticks
+    using Tick_t = uint64_t;
+
+    /// @brief Tick that never arrives. Used for "nothing armed".
+    constexpr Tick_t TickNever = UINT64_MAX;
+
+    /// @brief Timer status code trait
+    struct TimerStatusTrait
+    {
+        enum class Code : int32_t
+        {
+            OK,
+            NO_TIMERS,
+            INVALID_TIMER,
+
+            COUNT
+        };
+
+        static constexpr StatusStr_t ErrStrLkup[] =
+        {
+            "Success",
+            "Timer pool depleted",
+            "Timer handle stale or invalid"
+        };
+    };
+
+    /// @brief Hierarchical timing wheel
+    /// @details Level L has 64 slots of 64^L ticks each. A timer is filed
+    ///     in the lowest level whose span covers its delay, so arm and
+    ///     cancel are O(1) list operations. When a lower level wraps, the
+    ///     next slot of the level above is cascaded down. Each level keeps
+    ///     a bitmap of occupied slots, which lets advance jump straight to
+    ///     the next tick with work instead of stepping through idle ticks.
+    ///
+    ///     Timers come from a fixed pool and are linked by index. The wheel
+    ///     is not thread-safe; see TimerApp for a locked, threaded user.
+    class TimerWheel
+    {
+        public:
+            using Status = EtfwStatus<TimerStatusTrait>;
+
+            static constexpr size_t NumLevels = TIMER_WHEEL_LEVELS;
+            static constexpr size_t SlotBits = 6;
+            static constexpr size_t NumSlots = 1 << SlotBits;
+
+            /// @brief Largest delay filed without re-filing
+            static constexpr Tick_t MaxSpan = (Tick_t(1) << (SlotBits * NumLevels)) - 1;
+
+            static_assert(NumLevels > 0 && (SlotBits * NumLevels) < 64,
+                "Invalid number of timing wheel levels");
+
+            /// @brief Pool entry
+            struct Timer
+            {
+                Tick_t Expiry;          //< Tick the timer fires at
+                Tick_t Period;          //< Ticks between expiries. 0 for one-shot.
+                msg::MsgId_t MsgId;     //< Message sent on expiry
+                uint32_t Prev;          //< Previous timer in the slot list
+                uint32_t Next;          //< Next timer in the slot or free list
+                uint16_t Gen;           //< Handle generation
+                uint8_t Level;          //< Level filed in. FreeLevel if unused.
+                uint8_t Slot;           //< Slot filed in
+            };
+
+            /// @param timers Timer pool. See StaticTimerWheel.
+            TimerWheel(etl::span<Timer> timers);
+
+            /// @brief Arm a timer
+            /// @param[out] id Handle of the armed timer
+            /// @param msg_id Message to send on expiry
+            /// @param expiry Tick to fire at. Ticks already passed fire on
+            ///     the next tick.
+            /// @param period Ticks between later expiries. 0 for one-shot.
+            Status arm(TimerId_t& id, const msg::MsgId_t msg_id,
+                const Tick_t expiry, const Tick_t period = 0);
+
+            /// @brief Disarm a timer and return it to the pool
+            /// @param id Timer handle
+            /// @return INVALID_TIMER if the timer already expired or was
+            ///     cancelled
+            Status cancel(const TimerId_t id);
+
+            /// @brief Checks if a handle refers to an armed timer
+            bool armed(const TimerId_t id) const;
+
+            /// @brief Get the next tick advance has work at
+            /// @details This is either an expiry or a cascade, so it may be
+            ///     earlier than the next expiry.
+            /// @return Tick, or TickNever if nothing is armed
+            Tick_t next_event() const;
+
+            /// @brief Fire every timer expiring up to and including a tick
+            /// @details on_expiry(id, msg_id, missed) is called for each
+            ///     expired timer. Periodic timers are re-armed first. If a
+            ///     periodic timer fell more than a period behind, it fires
+            ///     once and the skipped expiries are passed as missed.
+            ///     on_expiry must not arm or cancel timers.
+            /// @param to Tick to advance to
+            /// @param on_expiry Expiry handler
+            /// @return Number of expired timers
+            template <typename TFunc>
+            size_t advance(const Tick_t to, TFunc&& on_expiry)
+            {
+                size_t fired = 0;
+                while (now_ < to)
+                {
+                    const Tick_t next = next_event();
+                    if (next > to)
+                    {
+                        now_ = to;
+                        break;
+                    }
+
+                    uint32_t idx = take_expired(next);
+                    while (idx != Nil)
+                    {
+                        Timer& timer = timers_[idx];
+                        const uint32_t next_idx = timer.Next;
+                        const TimerId_t id = to_id(idx, timer.Gen);
+                        uint32_t missed = 0;
+                        if (timer.Period > 0)
+                        {
+                            const Tick_t behind = (to - timer.Expiry) / timer.Period;
+                            missed = static_cast<uint32_t>(behind);
+                            timer.Expiry += (behind + 1) * timer.Period;
+                            file(idx);
+                        }
+                        else
+                        {
+                            release(idx);
+                        }
+                        on_expiry(id, timer.MsgId, missed);
+                        fired++;
+                        idx = next_idx;
+                    }
+                }
+                return fired;
+            }
+
+            /// @brief Get the current tick
+            inline Tick_t now() const { return now_; }
+
+            /// @brief Get the number of armed timers
+            inline size_t active() const { return active_; }
+
+            /// @brief Get the size of the timer pool
+            inline size_t capacity() const { return timers_.size(); }
+
+        private:
+            static constexpr uint32_t Nil = UINT32_MAX;
+            static constexpr uint8_t FreeLevel = UINT8_MAX;
+            static constexpr size_t SlotMask = NumSlots - 1;
+            static constexpr size_t IdxBits = 20;
+            static constexpr TimerId_t IdxMask = (TimerId_t(1) << IdxBits) - 1;
+            static constexpr uint16_t MaxGen = (1 << (32 - IdxBits)) - 1;
+
+            etl::span<Timer> timers_;
+            uint32_t heads_[NumLevels][NumSlots];   //< Slot list heads
+            uint64_t occupied_[NumLevels];          //< Non-empty slot bitmaps
+            uint32_t free_;                         //< Free list head
+            size_t active_;
+            Tick_t now_;
+
+            static inline TimerId_t to_id(const uint32_t idx, const uint16_t gen)
+            {
+                return (static_cast<TimerId_t>(gen) << IdxBits) | idx;
+            }
+
+            /// @brief Get the armed timer a handle refers to
+            /// @return Pool index, or Nil
+            uint32_t lookup(const TimerId_t id) const;
+
+            /// @brief Insert a timer into the slot for its expiry
+            void file(const uint32_t idx);
+
+            /// @brief Remove a timer from its slot
+            void unfile(const uint32_t idx);
+
+            /// @brief Return a timer to the pool
+            void release(const uint32_t idx);
+
+            /// @brief Move to a tick, cascading any higher level slots due
+            /// @param tick Tick returned by next_event
+            /// @return The tick's expired timers, linked by Next
+            uint32_t take_expired(const Tick_t tick);
+    };
+
+    /// @brief Timing wheel with a statically reserved timer pool
+    /// @tparam TNumTimers Maximum number of armed timers
+    template <size_t TNumTimers>
+    class StaticTimerWheel : public TimerWheel
+    {
+        static_assert(TNumTimers > 0, "Timer pool must not be empty");
+        static_assert(TNumTimers < (1 << 20), "Too many timers for the handle format");
+
+        public:
+            StaticTimerWheel():
+                TimerWheel(etl::span<Timer>(pool_, TNumTimers))
+            {}
+
+        private:
+            Timer pool_[TNumTimers];
+    };
+
+}
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include "svcs/App.hpp"
+#include "svcs/ExecStats.hpp"
+#include "svcs/Runner.hpp"
+#include "svcs/SvcCfg.hpp"
+#include "msg/Message.hpp"
+#include "msg/EventSource.hpp"
+#include "os/Mutex.hpp"
+#include "etfw_assert.hpp"
+#include <algorithm>
+#include <atomic>
+
+/// @brief Watchdog app task priority. Should be above the apps it watches.
+#ifndef WATCHDOG_PRIORITY
+#define WATCHDOG_PRIORITY       85
+#endif
+
+/// @brief Watchdog app task stack size, in 32-bit words
+#ifndef WATCHDOG_STACK_SZ
+#define WATCHDOG_STACK_SZ       OS_THREAD_DEFAULT_STACK_SZ
+#endif
+
+/// @brief Default number of services the watchdog can watch
+#ifndef WATCHDOG_MAX_SVCS
+#define WATCHDOG_MAX_SVCS       16
+#endif
+
+/// @brief Default watchdog check and telemetry period, in milliseconds
+#ifndef WATCHDOG_PERIOD_MS
+#define WATCHDOG_PERIOD_MS      1000
+#endif
+
+namespace etfw {
+namespace watchdog {
+
+    /// @brief What the watchdog does when a service overruns or stalls
+    enum class WatchAction : uint8_t
+    {
+        FLAG,       //< Log it and count it
+        RESTART,    //< Also stop the service and start it again
+    };
+
+    /// @brief Execution time telemetry of one service over one watchdog
+    ///     period. Sent on the status bus.
+    struct ExecTlmMsg : public msg::iBaseMsg
+    {
+        SvcId_t Svc;                //< Service ID
+        bool Stalled;               //< A cycle passed the stall timeout
+        uint16_t CpuPermille;       //< CPU used, in thousandths of one core
+        uint32_t Cycles;            //< Cycles completed
+        uint32_t Overruns;          //< Cycles over the CPU budget
+        Os::TimeNs_t CpuMinNs;      //< Least CPU time of a cycle
+        Os::TimeNs_t CpuMeanNs;     //< Mean CPU time of a cycle
+        Os::TimeNs_t CpuMaxNs;      //< Most CPU time of a cycle
+        Os::TimeNs_t CpuP99Ns;      //< 99th percentile CPU time, bucket upper bound
+        Os::TimeNs_t WallMeanNs;    //< Mean wall time of a cycle
+        Os::TimeNs_t BudgetNs;      //< CPU time budget per cycle. 0 if none.
+
+        ExecTlmMsg(const msg::MsgId_t id, const SvcId_t svc):
+            msg::iBaseMsg(id, sizeof(ExecTlmMsg)),
+            Svc(svc),
+            Stalled(false),
+            CpuPermille(0),
+            Cycles(0),
+            Overruns(0),
+            CpuMinNs(0),
+            CpuMeanNs(0),
+            CpuMaxNs(0),
+            CpuP99Ns(0),
+            WallMeanNs(0),
+            BudgetNs(0)
+        {}
+    };
+
+    /// @brief Execution time telemetry with a compile-time ID, for
+    ///     routers. Subscribe with ExecTlm<Cfg::TLM_ID>::ID.
+    /// @tparam TId Message ID
+    template <msg::MsgId_t TId>
+    struct ExecTlm : public ExecTlmMsg
+    {
+        static constexpr msg::MsgId_t ID = TId;
+
+        ExecTlm():
+            ExecTlmMsg(TId, 0)
+        {}
+    };
+
+    /// @brief Watchdog app configuration
+    /// @tparam TId Watchdog app ID
+    /// @tparam TMaxSvcs Maximum number of watched services
+    /// @tparam TPeriodMs Check and telemetry period in milliseconds
+    template <SvcId_t TId,
+        size_t TMaxSvcs = WATCHDOG_MAX_SVCS,
+        uint32_t TPeriodMs = WATCHDOG_PERIOD_MS,
+        uint8_t TPriority = WATCHDOG_PRIORITY,
+        size_t TStackSz = WATCHDOG_STACK_SZ>
+    struct WatchdogAppCfg : public SvcCfg<TId, EventSvcCfg<TPriority, TStackSz>>
+    {
+        static_assert(TPeriodMs > 0, "Watchdog period must be non-zero");
+
+        static constexpr const char* NAME = "WATCHDOG";
+        static constexpr size_t MAX_SVCS = TMaxSvcs;
+        static constexpr uint32_t PERIOD_MS = TPeriodMs;
+        /// Execution time telemetry message ID
+        static constexpr msg::MsgId_t TLM_ID =
+            msg::to_msg_id<TId, msg::MsgType_t::TLM, 0>();
+    };
+
+    /// @brief Execution time watchdog
+    /// @details Every period, reads the ExecStats of each watched service
+    ///     and sends an ExecTlmMsg for it (Cfg::TLM_ID) on the status bus.
+    ///     A service whose cycles went over its CPU budget (see
+    ///     SvcCfg EXEC_BUDGET_US) overran. A service whose current cycle
+    ///     has run past its stall timeout (EXEC_STALL_MS) stalled: it
+    ///     stopped cycling. Both are logged and counted, and RESTART
+    ///     services are also stopped and started again.
+    ///
+    ///     A stalled service can't be preempted. It is asked to stop, and
+    ///     is started again on the first period after its runner stops,
+    ///     i.e. after the stuck cycle returns.
+    /// @tparam Cfg Watchdog app configuration. See WatchdogAppCfg.
+    template <typename Cfg>
+    class WatchdogApp : public App<WatchdogApp<Cfg>, Cfg>
+    {
+        public:
+            using Base_t = App<WatchdogApp<Cfg>, Cfg>;
+            using Status = typename Base_t::Status;
+            using Timer_t = msg::PeriodicTimer<WatchdogApp>;
+
+            WatchdogApp():
+                Base_t(),
+                timer_(*this, Cfg::PERIOD_MS),
+                num_svcs_(0),
+                last_ns_(0),
+                sources_{&timer_}
+            {
+                auto stat = lock_.init();
+                ETFW_ASSERT(stat.success(), "Failed to initialize watchdog lock");
+            }
+
+            /// @brief Watch a service
+            /// @param svc Service. Must have a runner and outlive the watchdog.
+            /// @param action What to do when it overruns or stalls
+            /// @return Svc status
+            /// @retval [INVALID_STATE] The service has no runner
+            /// @retval [ALREADY_REGISTERED] The service is already watched
+            /// @retval [REGISTRY_FULL] Cfg::MAX_SVCS services are watched
+            Status watch(iSvc& svc, const WatchAction action = WatchAction::FLAG)
+            {
+                iSvcRunner* runner = svc.get_runner();
+                if (runner == nullptr)
+                {
+                    return Status::Code::INVALID_STATE;
+                }
+
+                Status stat = Status::Code::OK;
+                lock_.lock();
+                if (find(svc) != nullptr)
+                {
+                    stat = Status::Code::ALREADY_REGISTERED;
+                }
+                else if (num_svcs_ == Cfg::MAX_SVCS)
+                {
+                    stat = Status::Code::REGISTRY_FULL;
+                }
+                else
+                {
+                    Watched& w = svcs_[num_svcs_++];
+                    w.Svc = &svc;
+                    w.Action = action;
+                    w.Restarting = false;
+                    w.Stalled = false;
+                    snapshot(w, runner->exec_stats());
+                    runner->exec_stats().take_window_min_ns();
+                    runner->exec_stats().take_window_max_ns();
+                }
+                lock_.unlock();
+                return stat;
+            }
+
+            /// @brief Get the number of overrunning cycles seen
+            inline size_t overruns() const { return overruns_.load(std::memory_order_relaxed); }
+
+            /// @brief Get the number of stalls seen
+            inline size_t stalls() const { return stalls_.load(std::memory_order_relaxed); }
+
+            /// @brief Get the number of services restarted
+            inline size_t restarts() const { return restarts_.load(std::memory_order_relaxed); }
+
+            Status app_init()
+            {
+                return Status::Code::OK;
+            }
+
+            Status app_cleanup()
+            {
+                return Status::Code::OK;
+            }
+
+            /// @brief Runner sleeps on the check timer
+            msg::EventSources_t event_sources() override
+            {
+                return msg::EventSources_t(sources_, 1);
+            }
+
+            /// @brief Check every watched service
+            void on_timer(const Timer_t& timer)
+            {
+                (void)timer;
+                const Os::TimeNs_t now = Os::Clock::now_ns();
+                const Os::TimeNs_t period = (last_ns_ > 0) ? (now - last_ns_) :
+                    (static_cast<Os::TimeNs_t>(Cfg::PERIOD_MS) * Os::NsPerMs);
+                last_ns_ = now;
+
+                lock_.lock();
+                for (size_t i = 0; i < num_svcs_; i++)
+                {
+                    check(svcs_[i], now, period);
+                }
+                lock_.unlock();
+            }
+
+        private:
+            /// @brief Watched service and its counters at the last check
+            struct Watched
+            {
+                iSvc* Svc;
+                WatchAction Action;
+                bool Stalled;           //< Stalled at the last check
+                bool Restarting;        //< Stop requested, start pending
+                uint64_t Cycles;
+                uint64_t Overruns;
+                Os::TimeNs_t CpuNs;
+                Os::TimeNs_t WallNs;
+                uint32_t Hist[ExecStats::NumBuckets];
+            };
+
+            Timer_t timer_;
+            Watched svcs_[Cfg::MAX_SVCS];
+            size_t num_svcs_;
+            Os::Mutex lock_;                //< Guards svcs_ and num_svcs_
+            Os::TimeNs_t last_ns_;          //< Time of the last check
+            uint32_t hist_[ExecStats::NumBuckets];  //< Scratch histogram
+            std::atomic<size_t> overruns_{0};
+            std::atomic<size_t> stalls_{0};
+            std::atomic<size_t> restarts_{0};
+            msg::iEventSource* const sources_[1];
+
+            Watched* find(const iSvc& svc)
+            {
+                for (size_t i = 0; i < num_svcs_; i++)
+                {
+                    if (svcs_[i].Svc == &svc)
+                    {
+                        return &svcs_[i];
+                    }
+                }
+                return nullptr;
+            }
+
+            static void snapshot(Watched& w, const ExecStats& exec)
+            {
+                w.Cycles = exec.cycles();
+                w.Overruns = exec.overruns();
+                w.CpuNs = exec.cpu_total_ns();
+                w.WallNs = exec.wall_total_ns();
+                exec.histogram(w.Hist);
+            }
+
+            static bool is_stopped(const iSvcRunner::State_t state)
+            {
+                return (state == iSvcRunner::State_t::STOPPED) ||
+                    (state == iSvcRunner::State_t::EXITED) ||
+                    (state == iSvcRunner::State_t::ERROR);
+            }
+
+            void check(Watched& w, const Os::TimeNs_t now, const Os::TimeNs_t period)
+            {
+                iSvcRunner* runner = w.Svc->get_runner();
+                ExecStats& exec = runner->exec_stats();
+
+                if (w.Restarting)
+                {
+                    if (!is_stopped(runner->state()))
+                    {
+                        return;
+                    }
+                    w.Restarting = false;
+                    w.Stalled = false;
+                    if (w.Svc->start().success())
+                    {
+                        restarts_.fetch_add(1, std::memory_order_relaxed);
+                        this->log(LogLevel::INFO, "Restarted %s", w.Svc->name_raw());
+                    }
+                    else
+                    {
+                        this->log(LogLevel::ERROR, "Failed to restart %s", w.Svc->name_raw());
+                    }
+                }
+
+                // Counters since the last check
+                const Watched last = w;
+                snapshot(w, exec);
+                const uint64_t cycles = w.Cycles - last.Cycles;
+                const uint64_t overruns = w.Overruns - last.Overruns;
+                const Os::TimeNs_t cpu_ns = w.CpuNs - last.CpuNs;
+                const Os::TimeNs_t wall_ns = w.WallNs - last.WallNs;
+                for (size_t b = 0; b < ExecStats::NumBuckets; b++)
+                {
+                    hist_[b] = w.Hist[b] - last.Hist[b];
+                }
+                const Os::TimeNs_t min_ns = exec.take_window_min_ns();
+                const Os::TimeNs_t max_ns = exec.take_window_max_ns();
+                const Os::TimeNs_t cycle_start = exec.cycle_start_ns();
+                const bool stalled = exec.stalled(now);
+
+                ExecTlmMsg tlm(Cfg::TLM_ID, w.Svc->id());
+                tlm.Stalled = stalled;
+                tlm.Cycles = static_cast<uint32_t>(cycles);
+                tlm.Overruns = static_cast<uint32_t>(overruns);
+                tlm.CpuPermille = static_cast<uint16_t>(std::min<Os::TimeNs_t>(
+                    (cpu_ns * 1000) / period, UINT16_MAX));
+                tlm.BudgetNs = exec.budget_ns();
+                if (cycles > 0)
+                {
+                    tlm.CpuMinNs = min_ns;
+                    tlm.CpuMeanNs = cpu_ns / cycles;
+                    tlm.CpuMaxNs = max_ns;
+                    tlm.CpuP99Ns = ExecStats::percentile_ns(hist_, 99);
+                    tlm.WallMeanNs = wall_ns / cycles;
+                }
+                iApp::send_status<ExecTlmMsg>(tlm);
+
+                bool failed = false;
+                if (overruns > 0)
+                {
+                    overruns_.fetch_add(static_cast<size_t>(overruns), std::memory_order_relaxed);
+                    this->log(LogLevel::WARNING, "%s: %llu cycles over the %lluus budget, max %lluus",
+                        w.Svc->name_raw(), static_cast<unsigned long long>(overruns),
+                        static_cast<unsigned long long>(tlm.BudgetNs / 1000),
+                        static_cast<unsigned long long>(max_ns / 1000));
+                    failed = true;
+                }
+                if (stalled && !w.Stalled)
+                {
+                    stalls_.fetch_add(1, std::memory_order_relaxed);
+                    this->log(LogLevel::ERROR, "%s: stalled for %llums",
+                        w.Svc->name_raw(),
+                        static_cast<unsigned long long>(
+                            (now > cycle_start) ? ((now - cycle_start) / Os::NsPerMs) : 0));
+                    failed = true;
+                }
+                w.Stalled = stalled;
+
+                if (failed && w.Action == WatchAction::RESTART)
+                {
+                    w.Svc->stop();
+                    w.Restarting = true;
+                }
+            }
+    };
+
+}
+}
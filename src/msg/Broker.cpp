@@ -1,5 +1,6 @@
 
 #include <etfw/msg/Broker.hpp>
+#include <os/Task.hpp>
 
 using namespace etfw::msg;
 
@@ -9,10 +10,45 @@ Broker::Stats::Stats():
     AllocateFailures(0)
 {}
 
+/// Nested dispatches tracked per thread. Deeper ones are counted only.
+static constexpr size_t MaxTrackedDispatches = 8;
+
+/// Brokers the calling thread is dispatching on, innermost last.
+/// Subscription changes made from a handler on the same broker skip the
+/// grace period wait, which would otherwise wait on the handler's own
+/// dispatch. Changes to other brokers still wait.
+struct DispatchStack
+{
+    const Broker* Brokers[MaxTrackedDispatches];
+    size_t Depth;
+
+    bool has(const Broker* broker) const
+    {
+        // Untracked nested dispatches could be on any broker
+        if (Depth > MaxTrackedDispatches)
+        {
+            return true;
+        }
+        for (size_t i = 0; i < Depth; i++)
+        {
+            if (Brokers[i] == broker)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static thread_local DispatchStack tls_dispatching = {};
+
 Broker::Broker():
-    msg_pool_(100)
+    msg_pool_(),
+    gen_(0),
+    current_(&snapshots_[0])
 {
-    assert(lock_.init().success() &&
+    auto stat = lock_.init();
+    assert(stat.success() &&
         "Failed to initialize broker lock");
 }
 
@@ -21,9 +57,7 @@ void Broker::send_buf(Buf& msg_buf)
     if (msg_buf.buf_size() >= sizeof(iBaseMsg))
     {
         SharedMsg sm(msg_buf);
-        lock_.lock();
-        receive(sm);
-        lock_.unlock();
+        dispatch(sm.get_message().get_message_id(), sm);
     }
     else
     {
@@ -31,22 +65,175 @@ void Broker::send_buf(Buf& msg_buf)
     }
 }
 
-void Broker::register_pipe(iPipe& pipe)
+void Broker::receive(const etl::imessage& msg)
 {
+    dispatch(msg.get_message_id(), msg);
+}
+
+void Broker::receive(etl::shared_message sm)
+{
+    dispatch(sm.get_message().get_message_id(), sm);
+}
+
+void Broker::subscribe(iSubscription& sub)
+{
+    uint64_t gen = 0;
     lock_.lock();
+    sub.set_observer(this);
+    const bool added = update([&sub](Index_t& index)
+    {
+        return index.add(sub);
+    }, gen);
+    lock_.unlock();
+    // Replacing a subscription may drop IDs, wait out their publishers
+    wait_readers(gen);
+    ETFW_ASSERT(added,
+        "Broker subscription table full. Increase MSG_BROKER_MAX_PIPES/MSG_BROKER_MAX_MSG_IDS");
+}
+
+void Broker::unsubscribe(etl::imessage_router& router)
+{
+    uint64_t gen = 0;
+    lock_.lock();
+    update([&router](Index_t& index)
+    {
+        index.remove(router);
+        return true;
+    }, gen);
+    lock_.unlock();
+    wait_readers(gen);
+}
+
+void Broker::register_pipe(iPipe& pipe)
+{
     subscribe(pipe.subs());
+    lock_.lock();
     stats_.RegisteredPipes++;
     lock_.unlock();
 }
 
 void Broker::unregister_pipe(iPipe& pipe)
 {
-    lock_.lock();
     unsubscribe(pipe);
+    lock_.lock();
     stats_.RegisteredPipes--;
     lock_.unlock();
 }
 
+void Broker::on_subscribe(const etl::imessage_router& router, const MsgId_t id)
+{
+    uint64_t gen = 0;
+    lock_.lock();
+    const bool added = update([&router, id](Index_t& index)
+    {
+        return index.add(router, id);
+    }, gen);
+    lock_.unlock();
+    ETFW_ASSERT(added,
+        "Broker subscription table full. Increase MSG_BROKER_MAX_MSG_IDS");
+}
+
+void Broker::on_unsubscribe(const etl::imessage_router& router, const MsgId_t id)
+{
+    uint64_t gen = 0;
+    lock_.lock();
+    update([&router, id](Index_t& index)
+    {
+        index.remove(router, id);
+        return true;
+    }, gen);
+    lock_.unlock();
+    wait_readers(gen);
+}
+
+Broker::Snapshot& Broker::acquire_snapshot()
+{
+    Snapshot* snap = current_.load();
+    for (;;)
+    {
+        snap->Readers.fetch_add(1);
+        // Re-check after pinning. A writer only reuses snapshots with no
+        // readers that are no longer current, so once this passes the
+        // snapshot can't change under us.
+        Snapshot* check = current_.load();
+        if (check == snap)
+        {
+            break;
+        }
+        snap->Readers.fetch_sub(1);
+        snap = check;
+    }
+    if (tls_dispatching.Depth < MaxTrackedDispatches)
+    {
+        tls_dispatching.Brokers[tls_dispatching.Depth] = this;
+    }
+    tls_dispatching.Depth++;
+    return *snap;
+}
+
+void Broker::release_snapshot(Snapshot& snap)
+{
+    tls_dispatching.Depth--;
+    snap.Readers.fetch_sub(1, std::memory_order_release);
+}
+
+template <typename TFunc>
+bool Broker::update(TFunc&& func, uint64_t& gen)
+{
+    // Find a spare snapshot no publisher is reading. The calling thread
+    // may itself be routing through one of them if called from a handler,
+    // and other handlers may be waiting on the lock with theirs pinned.
+    Snapshot* old_snap = current_.load(std::memory_order_relaxed);
+    Snapshot* spare = nullptr;
+    while (spare == nullptr)
+    {
+        for (auto& snap: snapshots_)
+        {
+            if (&snap != old_snap && snap.Readers.load() == 0)
+            {
+                spare = &snap;
+                break;
+            }
+        }
+        if (spare == nullptr)
+        {
+            lock_.unlock();
+            Os::Thread::yield();
+            lock_.lock();
+            old_snap = current_.load(std::memory_order_relaxed);
+        }
+    }
+
+    spare->Index = old_snap->Index;
+    const bool ret = func(spare->Index);
+    gen = ++gen_;
+    spare->Gen.store(gen, std::memory_order_relaxed);
+    current_.store(spare);
+    return ret;
+}
+
+void Broker::wait_readers(const uint64_t gen)
+{
+    // A handler on this broker would wait on its own dispatch
+    if (tls_dispatching.has(this))
+    {
+        return;
+    }
+
+    // Publishers that pinned an older snapshot may still call routers
+    // that were just removed. Snapshots published since were copied from
+    // this change, and older ones can no longer be pinned, so their
+    // readers only drain.
+    for (auto& snap: snapshots_)
+    {
+        while (snap.Gen.load(std::memory_order_acquire) < gen &&
+            snap.Readers.load(std::memory_order_acquire) != 0)
+        {
+            Os::Thread::yield();
+        }
+    }
+}
+
 Buf* Broker::get_message_buf(const size_t buf_sz)
 {
     // The message pool has an internal lock, no need to lock here
@@ -1,9 +1,87 @@
 
 #include "msg/Pool.hpp"
 #include <cstring>
+#include <new>
 
 using namespace etfw::msg;
 
+/// Mask of the block index + 1 within a tagged free list head
+static constexpr uint64_t FREE_HEAD_IDX_MASK = 0xFFFFFFFFull;
+
+/// Increment applied to the ABA tag of a free list head on every update
+static constexpr uint64_t FREE_HEAD_TAG_INC = (1ull << 32);
+
+/// Number of blocks moved between a magazine and its slab at once
+static constexpr size_t MAGAZINE_BATCH_SZ = (MSG_POOL_MAGAZINE_SZ + 1) / 2;
+
+/// @brief Thread local lookup from a pool to the calling thread's cache
+struct CacheEntry
+{
+    uint32_t PoolId;                    //< Pool cache ID. 0 if unused.
+    uint32_t LiveSlot;                  //< Pool's slot in live_cache_ids
+    MsgBufPool* Pool;
+    MsgBufPool::ThreadCache* Cache;     //< Nullptr if the pool had none left
+};
+
+static thread_local CacheEntry tls_caches[MSG_POOL_MAX_CACHED_POOLS] = {};
+
+/// @brief Gives an exiting thread's caches back to their pools
+/// @details Armed when the thread first claims a cache, so threads that
+///     never cache don't register an exit handler.
+struct CacheFlusher
+{
+    bool Armed = false;
+
+    ~CacheFlusher();
+};
+
+static thread_local CacheFlusher tls_cache_flusher;
+
+/// cache_epoch as of the calling thread's last sweep of tls_caches
+static thread_local uint32_t tls_cache_epoch = 0;
+
+/// Source of unique pool cache IDs. IDs are never reused, so an entry
+/// left behind by a destroyed pool never matches a new one.
+static std::atomic<uint32_t> next_cache_id(1);
+
+/// Cache IDs of the live caching pools. 0 if the slot is free.
+static std::atomic<uint32_t> live_cache_ids[MSG_POOL_MAX_CACHING_POOLS] = {};
+
+/// Bumped each time a caching pool is destroyed. Threads then sweep their
+/// entries of dead pools, which may have died on another thread.
+static std::atomic<uint32_t> cache_epoch(0);
+
+/// @brief Add to a counter only ever written by one thread
+static inline void owner_add(MsgBufPool::Counter_t& counter, const size_t val)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + val,
+        std::memory_order_relaxed);
+}
+
+/// @brief Subtract from a counter only ever written by one thread
+static inline void owner_sub(MsgBufPool::Counter_t& counter, const size_t val)
+{
+    counter.store(counter.load(std::memory_order_relaxed) - val,
+        std::memory_order_relaxed);
+}
+
+CacheFlusher::~CacheFlusher()
+{
+    if (!Armed)
+    {
+        return;
+    }
+    for (auto& entry: tls_caches)
+    {
+        // Pools destroyed since the thread cached them are skipped
+        if (entry.Cache != nullptr &&
+            live_cache_ids[entry.LiveSlot].load(std::memory_order_acquire) == entry.PoolId)
+        {
+            entry.Pool->flush_thread_cache();
+        }
+    }
+}
+
 MsgBufPool::Stats::Stats(size_t num_items):
     NumItems(num_items),
     ItemsInUse(0),
@@ -12,14 +90,23 @@ MsgBufPool::Stats::Stats(size_t num_items):
     ReleaseCount(0)
 {}
 
+MsgBufPool::Stats::Stats(const Stats& other):
+    NumItems(other.NumItems),
+    ItemsInUse(other.ItemsInUse.load(std::memory_order_relaxed)),
+    WaterMark(other.WaterMark.load(std::memory_order_relaxed)),
+    AllocCount(other.AllocCount.load(std::memory_order_relaxed)),
+    ReleaseCount(other.ReleaseCount.load(std::memory_order_relaxed))
+{}
+
 MsgBufPool::Stats& MsgBufPool::Stats::operator++()
 {
-    ++AllocCount;
-    ++ItemsInUse;
-    if (ItemsInUse > WaterMark)
-    {
-        ++WaterMark;
-    }
+    AllocCount.fetch_add(1, std::memory_order_relaxed);
+    size_t in_use = ItemsInUse.fetch_add(1, std::memory_order_relaxed) + 1;
+    size_t water_mark = WaterMark.load(std::memory_order_relaxed);
+    while (in_use > water_mark &&
+        !WaterMark.compare_exchange_weak(water_mark, in_use,
+            std::memory_order_relaxed))
+    {}
     return *this;
 }
 
@@ -32,8 +119,8 @@ MsgBufPool::Stats MsgBufPool::Stats::operator++(int)
 
 MsgBufPool::Stats& MsgBufPool::Stats::operator--()
 {
-    ++ReleaseCount;
-    --ItemsInUse;
+    ReleaseCount.fetch_add(1, std::memory_order_relaxed);
+    ItemsInUse.fetch_sub(1, std::memory_order_relaxed);
     return *this;
 }
 
@@ -44,9 +131,59 @@ MsgBufPool::Stats MsgBufPool::Stats::operator--(int)
     return tmp;
 }
 
+MsgBufPool::Slab::Slab(uint8_t* mem, Link_t* links, size_t msg_sz, size_t num_blocks):
+    Mem(mem),
+    Links(links),
+    MsgSz(msg_sz),
+    BlockSz(MsgBufPool::block_size(msg_sz)),
+    FreeHead(0),
+    SlabStats(num_blocks)
+{}
+
+void* MsgBufPool::Slab::pop()
+{
+    uint64_t head = FreeHead.load(std::memory_order_acquire);
+    while ((head & FREE_HEAD_IDX_MASK) != 0)
+    {
+        const uint32_t idx = static_cast<uint32_t>(head & FREE_HEAD_IDX_MASK) - 1;
+        // May read a stale link if another thread pops this block first.
+        // The tag bump makes the CAS below fail in that case.
+        const uint64_t next = Links[idx].load(std::memory_order_relaxed);
+        const uint64_t new_head = ((head & ~FREE_HEAD_IDX_MASK) + FREE_HEAD_TAG_INC) | next;
+        if (FreeHead.compare_exchange_weak(head, new_head,
+                std::memory_order_acquire, std::memory_order_acquire))
+        {
+            return Mem + (idx * BlockSz);
+        }
+    }
+    return nullptr;
+}
+
+void MsgBufPool::Slab::push(void* block)
+{
+    const size_t idx = static_cast<size_t>(
+        static_cast<uint8_t*>(block) - Mem) / BlockSz;
+    uint64_t head = FreeHead.load(std::memory_order_relaxed);
+    uint64_t new_head;
+    do
+    {
+        Links[idx].store(static_cast<uint32_t>(head & FREE_HEAD_IDX_MASK),
+            std::memory_order_relaxed);
+        new_head = ((head & ~FREE_HEAD_IDX_MASK) + FREE_HEAD_TAG_INC) |
+            static_cast<uint64_t>(idx + 1);
+    } while (!FreeHead.compare_exchange_weak(head, new_head,
+        std::memory_order_release, std::memory_order_relaxed));
+}
+
 /// TODO: need to remove/replace with actual num items for stats
 MsgBufPool::MsgBufPool():
-    stats_(100)
+    stats_(100),
+    slabs_(nullptr),
+    num_slabs_(0),
+    caches_(nullptr),
+    num_caches_(0),
+    cache_id_(0),
+    live_slot_(0)
 {
     auto stat = mut_.init();
     assert(stat.success() &&
@@ -54,21 +191,185 @@ MsgBufPool::MsgBufPool():
 }
 
 MsgBufPool::MsgBufPool(size_t max_items):
-    stats_(max_items)
+    stats_(max_items),
+    slabs_(nullptr),
+    num_slabs_(0),
+    caches_(nullptr),
+    num_caches_(0),
+    cache_id_(0),
+    live_slot_(0)
+{
+    auto stat = mut_.init();
+    assert(stat.success() &&
+        "Failed to initialize mutex");
+}
+
+MsgBufPool::MsgBufPool(Slab* slabs, size_t num_slabs, size_t num_items):
+    stats_(num_items),
+    slabs_(slabs),
+    num_slabs_(num_slabs),
+    caches_(nullptr),
+    num_caches_(0),
+    cache_id_(0),
+    live_slot_(0)
 {
+    ETFW_ASSERT(slabs != nullptr,
+        "Attempt to construct slab pool with null slabs");
     auto stat = mut_.init();
     assert(stat.success() &&
         "Failed to initialize mutex");
 }
 
+void MsgBufPool::init_slabs()
+{
+    for (size_t i = 0; i < num_slabs_; i++)
+    {
+        Slab& slab = slabs_[i];
+        const size_t num_blocks = slab.SlabStats.NumItems;
+        // Link blocks in address order: block n points to block n+1
+        for (size_t blk = 0; blk < num_blocks; blk++)
+        {
+            const uint32_t next = (blk + 1 < num_blocks) ?
+                static_cast<uint32_t>(blk + 2) : 0;
+            slab.Links[blk].store(next, std::memory_order_relaxed);
+        }
+        slab.FreeHead.store((num_blocks > 0) ? 1 : 0, std::memory_order_release);
+    }
+}
+
+MsgBufPool::~MsgBufPool()
+{
+    if (cache_id_ != 0)
+    {
+        for (auto& entry: tls_caches)
+        {
+            if (entry.PoolId == cache_id_)
+            {
+                entry = CacheEntry{};
+            }
+        }
+        live_cache_ids[live_slot_].store(0, std::memory_order_release);
+        cache_epoch.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void MsgBufPool::init_caches(ThreadCache* caches, Magazine* mags, size_t num_caches)
+{
+    ETFW_ASSERT(num_slabs_ > 0,
+        "Thread caches require a slab mode pool");
+    ETFW_ASSERT(caches != nullptr && mags != nullptr,
+        "Attempt to initialize null thread caches");
+    const uint32_t id = next_cache_id.fetch_add(1, std::memory_order_relaxed);
+    for (uint32_t slot = 0; slot < MSG_POOL_MAX_CACHING_POOLS; slot++)
+    {
+        uint32_t expected = 0;
+        if (live_cache_ids[slot].compare_exchange_strong(expected, id,
+                std::memory_order_acq_rel))
+        {
+            for (size_t i = 0; i < num_caches; i++)
+            {
+                caches[i].Mags = &mags[i * num_slabs_];
+            }
+            caches_ = caches;
+            num_caches_ = num_caches;
+            cache_id_ = id;
+            live_slot_ = slot;
+            return;
+        }
+    }
+}
+
+size_t MsgBufPool::items_in_use() const
+{
+    const size_t in_use = stats_.ItemsInUse.load(std::memory_order_relaxed);
+    const size_t stranded = cache_stats().Stranded;
+    // Counters are read separately and may briefly disagree
+    return (in_use > stranded) ? (in_use - stranded) : 0;
+}
+
+MsgBufPool::CacheStats MsgBufPool::cache_stats() const
+{
+    CacheStats ret = {0, 0, 0};
+    for (size_t i = 0; i < num_caches_; i++)
+    {
+        const CacheStats cache = thread_cache_stats(i);
+        ret.Hits += cache.Hits;
+        ret.Misses += cache.Misses;
+        ret.Stranded += cache.Stranded;
+    }
+    return ret;
+}
+
+MsgBufPool::CacheStats MsgBufPool::thread_cache_stats(const size_t idx) const
+{
+    CacheStats ret = {0, 0, 0};
+    if (idx < num_caches_)
+    {
+        const ThreadCache& cache = caches_[idx];
+        ret.Hits = cache.Hits.load(std::memory_order_relaxed);
+        ret.Misses = cache.Misses.load(std::memory_order_relaxed);
+        ret.Stranded = cache.Cached.load(std::memory_order_relaxed);
+    }
+    return ret;
+}
+
+void MsgBufPool::flush_thread_cache()
+{
+    if (cache_id_ == 0)
+    {
+        return;
+    }
+
+    for (auto& entry: tls_caches)
+    {
+        if (entry.PoolId != cache_id_)
+        {
+            continue;
+        }
+
+        ThreadCache* cache = entry.Cache;
+        entry = CacheEntry{};
+        if (cache != nullptr)
+        {
+            for (size_t i = 0; i < num_slabs_; i++)
+            {
+                Magazine& mag = cache->Mags[i];
+                owner_sub(cache->Cached, mag.Count);
+                while (mag.Count > 0)
+                {
+                    slab_push(slabs_[i], mag.Blocks[--mag.Count]);
+                }
+            }
+            cache->Claimed.store(false, std::memory_order_release);
+        }
+        break;
+    }
+}
+
+const MsgBufPool::Stats* MsgBufPool::slab_stats(const size_t idx) const
+{
+    if (idx < num_slabs_)
+    {
+        return &slabs_[idx].SlabStats;
+    }
+    return nullptr;
+}
+
+size_t MsgBufPool::slab_msg_size(const size_t idx) const
+{
+    if (idx < num_slabs_)
+    {
+        return slabs_[idx].MsgSz;
+    }
+    return 0;
+}
+
 Buf* MsgBufPool::allocate(const size_t sz)
 {
     Buf* ret = nullptr;
     const size_t total_sz = sizeof(Buf) + sz;
 
-    lock();
     ret = static_cast<Buf*>(allocate_raw(total_sz, etl::alignment_of<void*>::value));
-    unlock();
 
     if (ret != nullptr)
     {
@@ -80,21 +381,15 @@ Buf* MsgBufPool::allocate(const size_t sz)
 
 void MsgBufPool::release(const etl::ireference_counted_message& msg)
 {
-    lock();
     /// TODO: ensure ref count == 0 ???
-    ::operator delete(static_cast<void*>(const_cast<etl::ireference_counted_message*>(&msg)));
-    --stats_;
-    unlock();
+    free_raw(static_cast<void*>(const_cast<etl::ireference_counted_message*>(&msg)));
 }
 
 void MsgBufPool::release(Buf* buf)
 {
     if (buf != nullptr)
     {
-        lock();
-        ::operator delete(static_cast<void*>(buf));
-        --stats_;
-        unlock();
+        free_raw(static_cast<void*>(buf));
     }
 }
 
@@ -108,14 +403,226 @@ void MsgBufPool::unlock()
     mut_.unlock();
 }
 
+MsgBufPool::Slab* MsgBufPool::find_slab(const void* buf)
+{
+    for (size_t i = 0; i < num_slabs_; i++)
+    {
+        if (slabs_[i].owns(buf))
+        {
+            return &slabs_[i];
+        }
+    }
+    return nullptr;
+}
+
+void MsgBufPool::free_raw(void* buf)
+{
+    if (num_slabs_ == 0)
+    {
+        lock();
+        ::operator delete(buf);
+        --stats_;
+        unlock();
+    }
+    else
+    {
+        Slab* slab = find_slab(buf);
+        ETFW_ASSERT(slab != nullptr,
+            "Attempt to release buffer not owned by this pool");
+        if (slab != nullptr)
+        {
+            ThreadCache* cache = thread_cache();
+            if (cache != nullptr)
+            {
+                cache_push(*cache, static_cast<size_t>(slab - slabs_), buf);
+            }
+            else
+            {
+                slab_push(*slab, buf);
+            }
+        }
+    }
+}
+
+MsgBufPool::ThreadCache* MsgBufPool::thread_cache()
+{
+    if (num_caches_ == 0)
+    {
+        return nullptr;
+    }
+
+    for (auto& entry: tls_caches)
+    {
+        if (entry.PoolId == cache_id_)
+        {
+            return entry.Cache;
+        }
+    }
+
+    // Drop the entries of pools destroyed since the last sweep, so they
+    // don't hold slots forever
+    const uint32_t epoch = cache_epoch.load(std::memory_order_acquire);
+    if (epoch != tls_cache_epoch)
+    {
+        for (auto& entry: tls_caches)
+        {
+            if (entry.PoolId != 0 &&
+                live_cache_ids[entry.LiveSlot].load(std::memory_order_acquire) != entry.PoolId)
+            {
+                entry = CacheEntry{};
+            }
+        }
+        tls_cache_epoch = epoch;
+    }
+
+    CacheEntry* unused = nullptr;
+    for (auto& entry: tls_caches)
+    {
+        if (entry.PoolId == 0)
+        {
+            unused = &entry;
+            break;
+        }
+    }
+
+    if (unused == nullptr)
+    {
+        // Thread already caches too many pools
+        return nullptr;
+    }
+
+    ThreadCache* cache = nullptr;
+    for (size_t i = 0; i < num_caches_; i++)
+    {
+        bool expected = false;
+        if (caches_[i].Claimed.compare_exchange_strong(expected, true,
+                std::memory_order_acquire))
+        {
+            cache = &caches_[i];
+            break;
+        }
+    }
+
+    if (cache != nullptr)
+    {
+        tls_cache_flusher.Armed = true;
+    }
+
+    // Remember a failed claim too so the thread doesn't rescan on every call
+    unused->PoolId = cache_id_;
+    unused->LiveSlot = live_slot_;
+    unused->Pool = this;
+    unused->Cache = cache;
+    return cache;
+}
+
+void* MsgBufPool::slab_pop(Slab& slab)
+{
+    void* ret = slab.pop();
+    if (ret != nullptr)
+    {
+        ++slab.SlabStats;
+        ++stats_;
+    }
+    return ret;
+}
+
+void MsgBufPool::slab_push(Slab& slab, void* block)
+{
+    slab.push(block);
+    --slab.SlabStats;
+    --stats_;
+}
+
+void* MsgBufPool::cache_pop(ThreadCache& cache, const size_t idx)
+{
+    Magazine& mag = cache.Mags[idx];
+    if (mag.Count > 0)
+    {
+        owner_add(cache.Hits, 1);
+    }
+    else
+    {
+        owner_add(cache.Misses, 1);
+        while (mag.Count < MAGAZINE_BATCH_SZ)
+        {
+            void* block = slab_pop(slabs_[idx]);
+            if (block == nullptr)
+            {
+                break;
+            }
+            mag.Blocks[mag.Count++] = block;
+        }
+        if (mag.Count == 0)
+        {
+            return nullptr;
+        }
+        owner_add(cache.Cached, mag.Count);
+    }
+
+    owner_sub(cache.Cached, 1);
+    return mag.Blocks[--mag.Count];
+}
+
+void MsgBufPool::cache_push(ThreadCache& cache, const size_t idx, void* block)
+{
+    Magazine& mag = cache.Mags[idx];
+    if (mag.Count == MSG_POOL_MAGAZINE_SZ)
+    {
+        // Flush the coldest blocks from the bottom of the magazine
+        for (size_t i = 0; i < MAGAZINE_BATCH_SZ; i++)
+        {
+            slab_push(slabs_[idx], mag.Blocks[i]);
+        }
+        memmove(&mag.Blocks[0], &mag.Blocks[MAGAZINE_BATCH_SZ],
+            (MSG_POOL_MAGAZINE_SZ - MAGAZINE_BATCH_SZ) * sizeof(void*));
+        mag.Count -= MAGAZINE_BATCH_SZ;
+        owner_sub(cache.Cached, MAGAZINE_BATCH_SZ);
+    }
+    mag.Blocks[mag.Count++] = block;
+    owner_add(cache.Cached, 1);
+}
+
 void* MsgBufPool::allocate_raw(size_t sz, size_t alignment)
 {
     void* ret = nullptr;
-    if (stats_.mem_avail())
+
+    if (num_slabs_ == 0)
+    {
+        lock();
+        if (stats_.mem_avail())
+        {
+            ret = ::operator new((sz+3) & ~3, std::nothrow);
+            if (ret != nullptr)
+            {
+                ++stats_;
+            }
+        }
+        unlock();
+    }
+    else
     {
-        ret = (void*)(new uint8_t[(sz+3) & ~3]);
-        stats_++;
+        // Slabs are sorted by size. Take the smallest block that fits,
+        // falling back to larger size classes when a class is depleted.
+        // The slab free lists bound the number of items in use.
+        size_t idx = 0;
+        while (idx < num_slabs_ && slabs_[idx].BlockSz < sz)
+        {
+            idx++;
+        }
+
+        ThreadCache* cache = (idx < num_slabs_) ? thread_cache() : nullptr;
+        if (cache != nullptr)
+        {
+            ret = cache_pop(*cache, idx++);
+        }
+
+        for (; ret == nullptr && idx < num_slabs_; idx++)
+        {
+            ret = slab_pop(slabs_[idx]);
+        }
     }
+
     return ret;
 }
 
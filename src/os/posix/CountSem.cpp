@@ -6,12 +6,14 @@
 
 using namespace Os;
 
-CountSem::CountSem()
+CountSem::CountSem():
+    IsInit(false)
 {
     CountSemCount++;
 }
 
-CountSem::CountSem(const CountVal init_val)
+CountSem::CountSem(const CountVal init_val):
+    IsInit(false)
 {
     int err = sem_init(&_Sem, 0, static_cast<unsigned int>(init_val));
     ETFW_ASSERT(err == 0, "Failed to initialize semaphore");
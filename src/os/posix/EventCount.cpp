@@ -0,0 +1,233 @@
+#include "os/EventCount.hpp"
+#include "os/Fiber.hpp"
+#include "etfw_assert.hpp"
+#include <errno.h>
+#include <unistd.h>
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace Os;
+
+#ifdef __linux__
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) &&
+    std::atomic<uint32_t>::is_always_lock_free,
+    "Futex word must be a plain 32-bit integer");
+
+static inline uint32_t* futex_word(std::atomic<uint32_t>& word)
+{
+    return reinterpret_cast<uint32_t*>(&word);
+}
+#endif
+
+/// @brief Tell the CPU we're in a spin-wait loop
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+
+EventCount::EventCount():
+    epoch_(0),
+    sleepers_(0),
+    syscalls_(0),
+    hook_(nullptr)
+{
+#ifndef __linux__
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    const int cond_err = pthread_cond_init(&cond_, &attr);
+    pthread_condattr_destroy(&attr);
+    const int mutex_err = pthread_mutex_init(&mutex_, nullptr);
+    ETFW_ASSERT(cond_err == 0 && mutex_err == 0,
+        "Failed to initialize event count");
+#endif
+}
+
+EventCount::~EventCount()
+{
+#ifndef __linux__
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&mutex_);
+#endif
+}
+
+EventCount::Status EventCount::wait(const Key_t key, const TimeMs_t t_ms)
+{
+    if (t_ms == 0)
+    {
+        return spin(key) ? Status::Code::OK : Status::Code::TIMEOUT;
+    }
+    return wait_until(key, Clock::now_ns() + (static_cast<TimeNs_t>(t_ms) * NsPerMs));
+}
+
+EventCount::Status EventCount::wait_until(const Key_t key, const TimeNs_t deadline_ns)
+{
+    if (Fiber::current() != nullptr)
+    {
+        return fiber_wait(key, deadline_ns);
+    }
+    if (deadline_ns == TimeNsNever)
+    {
+        return wait(key);
+    }
+    if (spin(key))
+    {
+        return Status::Code::OK;
+    }
+    const timespec deadline = Clock::to_timespec(deadline_ns);
+    return sleep(key, &deadline);
+}
+
+EventCount::Status EventCount::wait(const Key_t key)
+{
+    if (Fiber::current() != nullptr)
+    {
+        return fiber_wait(key, TimeNsNever);
+    }
+    if (spin(key))
+    {
+        return Status::Code::OK;
+    }
+    return sleep(key, nullptr);
+}
+
+bool EventCount::spin(const Key_t key) const
+{
+    // On one CPU the notifier can't run while we spin
+    static const uint32_t spin_count =
+        (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? OS_EVENT_SPIN_COUNT : 0;
+    for (uint32_t i = 0; i < spin_count; i++)
+    {
+        if (epoch_.load(std::memory_order_acquire) != key)
+        {
+            return true;
+        }
+        cpu_relax();
+    }
+    return (epoch_.load(std::memory_order_acquire) != key);
+}
+
+EventCount::Status EventCount::fiber_wait(const Key_t key, const TimeNs_t deadline_ns)
+{
+    Fiber& fiber = *Fiber::current();
+    // Either notify sees the hook and unparks the fiber, or the epoch
+    // check below sees the notify
+    const NotifyHook* hook = nullptr;
+    const bool hooked = hook_.compare_exchange_strong(hook, &fiber.unpark_hook(),
+        std::memory_order_seq_cst);
+    ETFW_ASSERT(hooked, "Fiber wait on an event that already has a notify hook");
+
+    Status stat = Status::Code::OK;
+    while (epoch_.load(std::memory_order_seq_cst) == key)
+    {
+        if (!Fiber::park(deadline_ns))
+        {
+            if (epoch_.load(std::memory_order_acquire) == key)
+            {
+                stat = Status::Code::TIMEOUT;
+            }
+            break;
+        }
+    }
+    hook_.store(nullptr, std::memory_order_seq_cst);
+    return stat;
+}
+
+#ifdef __linux__
+
+EventCount::Status EventCount::sleep(const Key_t key, const timespec* deadline)
+{
+    Status stat = Status::Code::OK;
+    // Announce the sleep before the kernel re-checks the epoch. Either
+    // notify sees the sleeper and wakes it, or the futex sees the new epoch.
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    while (epoch_.load(std::memory_order_acquire) == key)
+    {
+        syscalls_.fetch_add(1, std::memory_order_relaxed);
+        // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline
+        const long ret = syscall(SYS_futex, futex_word(epoch_),
+            FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, key, deadline,
+            nullptr, FUTEX_BITSET_MATCH_ANY);
+        if (ret != 0)
+        {
+            const int err = errno;
+            if (err == ETIMEDOUT)
+            {
+                stat = Status::Code::TIMEOUT;
+                break;
+            }
+            else if (err != EAGAIN && err != EINTR)
+            {
+                stat = Status::Code::OS_ERR;
+                break;
+            }
+        }
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+
+    // A notify may have landed between the timeout and the last check
+    if (stat.code() == Status::Code::TIMEOUT &&
+        epoch_.load(std::memory_order_acquire) != key)
+    {
+        stat = Status::Code::OK;
+    }
+    return stat;
+}
+
+void EventCount::wake()
+{
+    syscalls_.fetch_add(1, std::memory_order_relaxed);
+    syscall(SYS_futex, futex_word(epoch_), FUTEX_WAKE | FUTEX_PRIVATE_FLAG,
+        INT_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+EventCount::Status EventCount::sleep(const Key_t key, const timespec* deadline)
+{
+    Status stat = Status::Code::OK;
+    pthread_mutex_lock(&mutex_);
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    while (epoch_.load(std::memory_order_acquire) == key)
+    {
+        syscalls_.fetch_add(1, std::memory_order_relaxed);
+        const int err = (deadline == nullptr) ?
+            pthread_cond_wait(&cond_, &mutex_) :
+            pthread_cond_timedwait(&cond_, &mutex_, deadline);
+        if (err == ETIMEDOUT)
+        {
+            if (epoch_.load(std::memory_order_acquire) == key)
+            {
+                stat = Status::Code::TIMEOUT;
+            }
+            break;
+        }
+        else if (err != 0)
+        {
+            stat = Status::Code::OS_ERR;
+            break;
+        }
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    pthread_mutex_unlock(&mutex_);
+    return stat;
+}
+
+void EventCount::wake()
+{
+    syscalls_.fetch_add(1, std::memory_order_relaxed);
+    // Taking the lock orders the wake after a sleeper's epoch check
+    pthread_mutex_lock(&mutex_);
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+#endif
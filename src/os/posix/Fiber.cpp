@@ -0,0 +1,342 @@
+#include "os/Fiber.hpp"
+#include "etfw_assert.hpp"
+#include <cstring>
+
+using namespace Os;
+
+#if (defined(__x86_64__) || defined(__aarch64__)) && defined(__ELF__)
+#define OS_FIBER_ASM_SWITCH 1
+#else
+#define OS_FIBER_ASM_SWITCH 0
+#endif
+
+/// Fiber running on the calling thread
+static thread_local Fiber* tls_fiber = nullptr;
+
+#if OS_FIBER_ASM_SWITCH
+
+extern "C"
+{
+    /// @brief Save the callee-saved registers on the current stack, store
+    ///     the stack pointer in *from_sp, then restore the registers saved
+    ///     on to_sp and return into that context
+    void etfw_fiber_switch(void** from_sp, void* to_sp);
+
+    /// @brief First return address of a new fiber. Calls the entry
+    ///     function placed in the initial frame with its argument.
+    void etfw_fiber_start();
+}
+
+#if defined(__x86_64__)
+
+// Frame, from the saved stack pointer up: MXCSR and x87 control word,
+// r15, r14, r13, r12, rbx, rbp, return address. The section is pushed and
+// popped so the compiler's own section state is left as it was.
+asm(R"(
+    .pushsection .text
+    .globl etfw_fiber_switch
+    .type etfw_fiber_switch, @function
+    .align 16
+etfw_fiber_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size etfw_fiber_switch, .-etfw_fiber_switch
+
+    .globl etfw_fiber_start
+    .type etfw_fiber_start, @function
+    .align 16
+etfw_fiber_start:
+    .cfi_startproc
+    .cfi_undefined rip
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .cfi_endproc
+    .size etfw_fiber_start, .-etfw_fiber_start
+    .popsection
+)");
+
+/// Initial frame size in bytes
+static constexpr size_t FrameSz = 64;
+
+static void* init_frame(uint8_t* top, void (*entry)(void*), void* arg)
+{
+    uint64_t* frame = reinterpret_cast<uint64_t*>(top - FrameSz);
+    // Default MXCSR (all exceptions masked) and x87 control word
+    frame[0] = 0x1F80ull | (0x037Full << 32);
+    frame[1] = 0;                                           // r15
+    frame[2] = 0;                                           // r14
+    frame[3] = reinterpret_cast<uint64_t>(entry);           // r13
+    frame[4] = reinterpret_cast<uint64_t>(arg);             // r12
+    frame[5] = 0;                                           // rbx
+    frame[6] = 0;                                           // rbp
+    frame[7] = reinterpret_cast<uint64_t>(&etfw_fiber_start);
+    return frame;
+}
+
+#elif defined(__aarch64__)
+
+// Frame, from the saved stack pointer up: x19-x28, x29 (fp), x30 (lr),
+// d8-d15
+asm(R"(
+    .pushsection .text
+    .globl etfw_fiber_switch
+    .type etfw_fiber_switch, %function
+    .align 4
+etfw_fiber_switch:
+    sub sp, sp, #160
+    stp x19, x20, [sp, #0]
+    stp x21, x22, [sp, #16]
+    stp x23, x24, [sp, #32]
+    stp x25, x26, [sp, #48]
+    stp x27, x28, [sp, #64]
+    stp x29, x30, [sp, #80]
+    stp d8, d9, [sp, #96]
+    stp d10, d11, [sp, #112]
+    stp d12, d13, [sp, #128]
+    stp d14, d15, [sp, #144]
+    mov x2, sp
+    str x2, [x0]
+    mov sp, x1
+    ldp x19, x20, [sp, #0]
+    ldp x21, x22, [sp, #16]
+    ldp x23, x24, [sp, #32]
+    ldp x25, x26, [sp, #48]
+    ldp x27, x28, [sp, #64]
+    ldp x29, x30, [sp, #80]
+    ldp d8, d9, [sp, #96]
+    ldp d10, d11, [sp, #112]
+    ldp d12, d13, [sp, #128]
+    ldp d14, d15, [sp, #144]
+    add sp, sp, #160
+    ret
+    .size etfw_fiber_switch, .-etfw_fiber_switch
+
+    .globl etfw_fiber_start
+    .type etfw_fiber_start, %function
+    .align 4
+etfw_fiber_start:
+    .cfi_startproc
+    .cfi_undefined x30
+    mov x0, x19
+    blr x20
+    brk #0
+    .cfi_endproc
+    .size etfw_fiber_start, .-etfw_fiber_start
+    .popsection
+)");
+
+/// Initial frame size in bytes
+static constexpr size_t FrameSz = 160;
+
+static void* init_frame(uint8_t* top, void (*entry)(void*), void* arg)
+{
+    uint64_t* frame = reinterpret_cast<uint64_t*>(top - FrameSz);
+    std::memset(frame, 0, FrameSz);
+    frame[0] = reinterpret_cast<uint64_t>(arg);             // x19
+    frame[1] = reinterpret_cast<uint64_t>(entry);           // x20
+    frame[11] = reinterpret_cast<uint64_t>(&etfw_fiber_start);  // x30
+    return frame;
+}
+
+#endif
+
+#else
+
+/// Initial frame size in bytes. ucontext keeps its frame in the Fiber.
+static constexpr size_t FrameSz = 0;
+
+/// Fiber entry, set by the first init. makecontext can't portably pass
+/// a pointer argument, so the trampoline finds its fiber through tls_fiber.
+static void (*ucontext_fiber_entry)(void*) = nullptr;
+
+static void ucontext_entry()
+{
+    ucontext_fiber_entry(tls_fiber);
+}
+
+#endif
+
+Fiber::Fiber():
+    stack_(nullptr),
+    stack_words_(0),
+    routine_(nullptr),
+    arg_(nullptr),
+    state_(State::IDLE),
+    notified_(false),
+    park_deadline_(TimeNsNever),
+    switches_(0),
+    unpark_hook_{on_unpark, this},
+    wake_hook_(nullptr)
+#if OS_FIBER_ASM_SWITCH
+    ,
+    sp_(nullptr),
+    caller_sp_(nullptr)
+#endif
+{}
+
+void Fiber::init(Stack_t stack, Routine_t routine, void* arg)
+{
+    ETFW_ASSERT(state_.load(std::memory_order_acquire) == State::IDLE,
+        "Attempt to initialize a fiber that is still running");
+    ETFW_ASSERT(stack.Buf != nullptr && routine != nullptr,
+        "Invalid fiber configuration");
+    ETFW_ASSERT((reinterpret_cast<uintptr_t>(stack.Buf) % 16) == 0,
+        "Fiber stack must be 16 byte aligned");
+    ETFW_ASSERT(stack.bytes() >= FrameSz +
+        (OS_FIBER_STACK_GUARD_WORDS * sizeof(Stack_t::Buf_t)) + 256,
+        "Fiber stack too small");
+
+    stack_ = stack.Buf;
+    stack_words_ = stack.Sz;
+    routine_ = routine;
+    arg_ = arg;
+    notified_.store(false, std::memory_order_relaxed);
+    park_deadline_ = TimeNsNever;
+    for (size_t i = 0; i < stack_words_; i++)
+    {
+        stack_[i] = OS_FIBER_STACK_CANARY;
+    }
+
+#if OS_FIBER_ASM_SWITCH
+    uint8_t* top = reinterpret_cast<uint8_t*>(stack_ + stack_words_);
+    top -= reinterpret_cast<uintptr_t>(top) % 16;
+    sp_ = init_frame(top, entry, this);
+#else
+    ucontext_fiber_entry = entry;
+    getcontext(&ctx_);
+    ctx_.uc_stack.ss_sp = stack_;
+    ctx_.uc_stack.ss_size = stack.bytes();
+    ctx_.uc_link = nullptr;
+    makecontext(&ctx_, ucontext_entry, 0);
+#endif
+
+    // Publishes the frame to the thread that resumes the fiber
+    state_.store(State::READY, std::memory_order_release);
+}
+
+void Fiber::resume()
+{
+    ETFW_ASSERT(tls_fiber == nullptr, "Fibers can't resume other fibers");
+    ETFW_ASSERT(state_.load(std::memory_order_acquire) != State::IDLE,
+        "Attempt to resume an idle fiber");
+
+    state_.store(State::READY, std::memory_order_relaxed);
+    switches_++;
+    tls_fiber = this;
+#if OS_FIBER_ASM_SWITCH
+    etfw_fiber_switch(&caller_sp_, sp_);
+#else
+    swapcontext(&caller_ctx_, &ctx_);
+#endif
+    tls_fiber = nullptr;
+}
+
+void Fiber::yield()
+{
+    Fiber* fiber = tls_fiber;
+    ETFW_ASSERT(fiber != nullptr, "Fiber yield outside a fiber");
+    fiber->suspend();
+}
+
+bool Fiber::park(const TimeNs_t deadline_ns)
+{
+    Fiber* fiber = tls_fiber;
+    ETFW_ASSERT(fiber != nullptr, "Fiber park outside a fiber");
+    if (!fiber->notified_.exchange(false, std::memory_order_acq_rel))
+    {
+        fiber->park_deadline_ = deadline_ns;
+        fiber->state_.store(State::PARKED, std::memory_order_relaxed);
+        fiber->suspend();
+        fiber->park_deadline_ = TimeNsNever;
+        return fiber->notified_.exchange(false, std::memory_order_acq_rel);
+    }
+    return true;
+}
+
+void Fiber::unpark()
+{
+    notified_.store(true, std::memory_order_seq_cst);
+    const EventCount::NotifyHook* hook = wake_hook_.load(std::memory_order_acquire);
+    if (hook != nullptr)
+    {
+        hook->Fn(hook->Arg);
+    }
+}
+
+Fiber* Fiber::current()
+{
+    return tls_fiber;
+}
+
+void Fiber::set_wake_hook(const EventCount::NotifyHook* hook)
+{
+    wake_hook_.store(hook, std::memory_order_release);
+}
+
+size_t Fiber::stack_used() const
+{
+    // The stack grows down, so the canary survives at the low end
+    size_t untouched = 0;
+    while (untouched < stack_words_ && stack_[untouched] == OS_FIBER_STACK_CANARY)
+    {
+        untouched++;
+    }
+    return (stack_words_ - untouched) * sizeof(Stack_t::Buf_t);
+}
+
+bool Fiber::stack_overflowed() const
+{
+    const size_t guard = (stack_words_ < OS_FIBER_STACK_GUARD_WORDS) ?
+        stack_words_ : OS_FIBER_STACK_GUARD_WORDS;
+    for (size_t i = 0; i < guard; i++)
+    {
+        if (stack_[i] != OS_FIBER_STACK_CANARY)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Fiber::entry(void* fiber)
+{
+    Fiber* self = static_cast<Fiber*>(fiber);
+    self->routine_(self->arg_);
+    self->state_.store(State::IDLE, std::memory_order_release);
+    self->suspend();
+    ETFW_ASSERT(false, "Finished fiber resumed");
+}
+
+void Fiber::suspend()
+{
+#if OS_FIBER_ASM_SWITCH
+    etfw_fiber_switch(&sp_, caller_sp_);
+#else
+    swapcontext(&ctx_, &caller_ctx_);
+#endif
+}
+
+void Fiber::on_unpark(void* fiber)
+{
+    static_cast<Fiber*>(fiber)->unpark();
+}
@@ -200,7 +200,27 @@ File::Status File::size(size_t &result)
         return File::Status::Code::NOT_OPENED;
     }
 
-    return File::Status::Code::NOT_SUPPORTED;
+    struct stat st;
+    if (fstat(_fd, &st) == ERR_RC)
+    {
+        return err_to_status(errno);
+    }
+    result = static_cast<size_t>(st.st_size);
+    return File::Status::Code::OK;
+}
+
+File::Status File::sync()
+{
+    if (_mode == File::Mode::OPEN_NO_MODE)
+    {
+        return File::Status::Code::NOT_OPENED;
+    }
+#ifdef __linux__
+    const int os_ret = fdatasync(_fd);
+#else
+    const int os_ret = fsync(_fd);
+#endif
+    return (os_ret == ERR_RC) ? err_to_status(errno) : File::Status::Code::OK;
 }
 
 File::Status File::position(size_t &result)
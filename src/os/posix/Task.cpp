@@ -1,13 +1,33 @@
 
 #include "os/Task.hpp"
 #include "etfw_assert.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <ctime>
 
 using namespace Os;
 
+// pthread_clockjoin_np, which takes a CLOCK_MONOTONIC deadline, arrived in
+// glibc 2.31. Older libcs fall back to a CLOCK_REALTIME timed join.
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 31)))
+#define OS_THREAD_CLOCKJOIN 1
+#else
+#define OS_THREAD_CLOCKJOIN 0
+#endif
+
 Thread::Thread():
-    state_(Thread::State::NOT_STARTED)
+    state_(Thread::State::NOT_STARTED),
+    joinable_(false),
+    realtime_(false)
 {}
 
+size_t Thread::min_stack_bytes(void)
+{
+    const long min_sz = sysconf(_SC_THREAD_STACK_MIN);
+    return (min_sz > 0) ? static_cast<size_t>(min_sz) : PTHREAD_STACK_MIN;
+}
+
 Thread::Status Thread::start(Thread::Config& cfg)
 {
     Thread::Status status = Thread::Status(Thread::Status::Code::INVALID_STATE);
@@ -16,15 +36,34 @@ Thread::Status Thread::start(Thread::Config& cfg)
         status = validate_config(cfg);
         if (Thread::Status::Code::OK == status.code())
         {
+            // The previous run may still be unwinding on the same stack
+            if (joinable_)
+            {
+                pthread_join(handle_, nullptr);
+                joinable_ = false;
+            }
+
             arg_ = cfg.Arg;
             routine_ = cfg.Routine;
-            int posix_result = pthread_create(&handle_, nullptr, runner, this);
+            realtime_ = cfg.realtime();
+            state_ = Thread::State::RUNNING;
+            int posix_result = create(cfg, realtime_);
+            if (EPERM == posix_result && realtime_)
+            {
+                // Not allowed to use real-time scheduling. Run with the
+                // creator's scheduling instead.
+                realtime_ = false;
+                posix_result = create(cfg, realtime_);
+            }
+
             if (0 != posix_result)
             {
+                state_ = Thread::State::NOT_STARTED;
                 return Thread::Status::Code::THREAD_CREATE_ERROR;
             }
             else
             {
+                joinable_ = true;
                 status = Thread::Status(Thread::Status::Code::OK);
             }
         }
@@ -36,14 +75,60 @@ Thread::Status Thread::start(Thread::Config& cfg)
 Thread::Status Thread::join(void)
 {
     Thread::Status status = Thread::Status(Thread::Status::Code::INVALID_STATE);
-    if (Thread::State::RUNNING == state_)
+    if (joinable_)
     {
-        Thread::Status status = Thread::Status::Code::JOIN_ERROR;
+        status = Thread::Status::Code::JOIN_ERROR;
         int posix_result = pthread_join(handle_, nullptr);
         if (posix_result == 0)
         {
+            joinable_ = false;
+            status = Thread::Status::Code::OK;
+        }
+    }
+
+    return status;
+}
+
+Thread::Status Thread::join(const TimeMs_t timeout_ms)
+{
+    Thread::Status status = Thread::Status(Thread::Status::Code::INVALID_STATE);
+    if (joinable_)
+    {
+        // A monotonic deadline isn't moved by wall clock steps
+        timespec deadline;
+#if OS_THREAD_CLOCKJOIN
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+#else
+        clock_gettime(CLOCK_REALTIME, &deadline);
+#endif
+        deadline.tv_sec += static_cast<time_t>(timeout_ms / 1000);
+        deadline.tv_nsec += static_cast<long>((timeout_ms % 1000) * 1000000);
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        const int posix_result = (timeout_ms == 0) ?
+            pthread_tryjoin_np(handle_, nullptr) :
+#if OS_THREAD_CLOCKJOIN
+            pthread_clockjoin_np(handle_, nullptr, CLOCK_MONOTONIC, &deadline);
+#else
+            pthread_timedjoin_np(handle_, nullptr, &deadline);
+#endif
+        if (posix_result == 0)
+        {
+            joinable_ = false;
             status = Thread::Status::Code::OK;
         }
+        else if (posix_result == ETIMEDOUT || posix_result == EBUSY)
+        {
+            status = Thread::Status::Code::TIMEOUT;
+        }
+        else
+        {
+            status = Thread::Status::Code::JOIN_ERROR;
+        }
     }
 
     return status;
@@ -52,7 +137,7 @@ Thread::Status Thread::join(void)
 Thread::Status Thread::validate_config(Thread::Config& cfg)
 {
     if (cfg.StackBuf.Buf == nullptr ||
-        cfg.StackBuf.Sz == 0)
+        cfg.StackBuf.bytes() < min_stack_bytes())
     {
         return Thread::Status::Code::INVALID_STACK_CFG;
     }
@@ -62,9 +147,89 @@ Thread::Status Thread::validate_config(Thread::Config& cfg)
         return Thread::Status::Code::INVALID_ROUTINE_CFG;
     }
 
+    if (cfg.Policy != SCHED_OTHER && cfg.Policy != SCHED_FIFO && cfg.Policy != SCHED_RR)
+    {
+        return Thread::Status::Code::INVALID_PRIORITY_CFG;
+    }
+
+    if (cfg.Affinity != 0)
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        {
+            return Thread::Status::Code::INVALID_AFFINITY_CFG;
+        }
+
+        bool usable = false;
+        for (size_t cpu = 0; cpu < (sizeof(cfg.Affinity) * CHAR_BIT); cpu++)
+        {
+            if (((cfg.Affinity >> cpu) & 1U) != 0 && CPU_ISSET(cpu, &allowed))
+            {
+                usable = true;
+                break;
+            }
+        }
+        if (!usable)
+        {
+            return Thread::Status::Code::INVALID_AFFINITY_CFG;
+        }
+    }
+
     return Thread::Status::Code::OK;
 }
 
+int Thread::create(const Thread::Config& cfg, const bool realtime)
+{
+    pthread_attr_t attr;
+    int err = pthread_attr_init(&attr);
+    if (0 != err)
+    {
+        return err;
+    }
+
+    err = pthread_attr_setstack(&attr, cfg.StackBuf.Buf, cfg.StackBuf.bytes());
+
+    if (0 == err && realtime)
+    {
+        sched_param param = {};
+        param.sched_priority = std::clamp(static_cast<int>(cfg.Priority),
+            sched_get_priority_min(cfg.Policy),
+            sched_get_priority_max(cfg.Policy));
+        err = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        if (0 == err)
+        {
+            err = pthread_attr_setschedpolicy(&attr, cfg.Policy);
+        }
+        if (0 == err)
+        {
+            err = pthread_attr_setschedparam(&attr, &param);
+        }
+    }
+
+    if (0 == err && cfg.Affinity != 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (size_t cpu = 0; cpu < (sizeof(cfg.Affinity) * CHAR_BIT); cpu++)
+        {
+            if (((cfg.Affinity >> cpu) & 1U) != 0)
+            {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        err = pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+
+    if (0 == err)
+    {
+        err = pthread_create(&handle_, &attr, runner, this);
+    }
+
+    pthread_attr_destroy(&attr);
+    return err;
+}
+
 void* Thread::runner(void *thread_obj)
 {
     ETFW_ASSERT(thread_obj != nullptr,
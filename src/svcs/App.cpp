@@ -50,7 +50,8 @@ Status iApp::start_child(iSvc& child)
 
 Status iApp::unregister_all_children()
 {
-    return Status::Code::UNKNOWN_ERR;
+    Children.clear();
+    return Status::Code::OK;
 }
 
 void iApp::send_cmd(const etl::imessage& msg)
@@ -76,7 +77,7 @@ void iApp::subscribe_cmd(etl::imessage_router& handler,
 }
 
 void iApp::subscribe_cmd(etl::imessage_router& handler,
-    msg::MsgIdContainer &msg_ids)
+    const msg::MsgIdContainer &msg_ids)
 {
     msg::Subscription subscription(handler, msg_ids);
     subscribe_cmd(subscription);
@@ -95,7 +96,7 @@ void iApp::subscribe_status(etl::imessage_router& handler,
 }
 
 void iApp::subscribe_status(etl::imessage_router& handler,
-    msg::MsgIdContainer &msg_ids)
+    const msg::MsgIdContainer &msg_ids)
 {
     msg::Subscription subscription(handler, msg_ids);
     subscribe_status(subscription);
@@ -130,10 +131,3 @@ void iApp::AppFwProxy::subscribe(msg::Subscription& subscription)
     iApp::subscribe_msg(subscription);
 }
 
-void iApp::AppFwProxy::log(const LogLevel level, const char* format, ...)
-{
-    va_list args;
-    va_start(args, format);
-    app_.log(level, format, args);
-    va_end(args);
-}
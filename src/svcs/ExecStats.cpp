@@ -0,0 +1,165 @@
+#include "svcs/ExecStats.hpp"
+#include "msg/BlockingMsgQueue.hpp"
+
+using namespace etfw;
+
+/// Sub-buckets per power of two, as a bit count
+static constexpr unsigned SubBits = 2;
+static constexpr size_t SubBuckets = 1u << SubBits;
+
+const msg::WaitHooks ExecStats::BlockedHooks = {block, unblock};
+
+ExecStats::ExecStats():
+    Cycles(0),
+    CpuTotalNs(0),
+    WallTotalNs(0),
+    CpuMinNs(Os::TimeNsNever),
+    CpuMaxNs(0),
+    WindowMinNs(Os::TimeNsNever),
+    WindowMaxNs(0),
+    Overruns(0),
+    BudgetNs(0),
+    StallNs(0),
+    CycleStartNs(0)
+{
+    for (std::atomic<uint32_t>& count: Hist)
+    {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+ExecStats::ExecStats(const ExecStats& other):
+    Cycles(other.Cycles.load(std::memory_order_relaxed)),
+    CpuTotalNs(other.CpuTotalNs.load(std::memory_order_relaxed)),
+    WallTotalNs(other.WallTotalNs.load(std::memory_order_relaxed)),
+    CpuMinNs(other.CpuMinNs.load(std::memory_order_relaxed)),
+    CpuMaxNs(other.CpuMaxNs.load(std::memory_order_relaxed)),
+    WindowMinNs(other.WindowMinNs.load(std::memory_order_relaxed)),
+    WindowMaxNs(other.WindowMaxNs.load(std::memory_order_relaxed)),
+    Overruns(other.Overruns.load(std::memory_order_relaxed)),
+    BudgetNs(other.BudgetNs.load(std::memory_order_relaxed)),
+    StallNs(other.StallNs.load(std::memory_order_relaxed)),
+    CycleStartNs(other.CycleStartNs.load(std::memory_order_relaxed))
+{
+    for (size_t i = 0; i < NumBuckets; i++)
+    {
+        Hist[i].store(other.Hist[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+void ExecStats::set_budget(const Os::TimeNs_t budget_ns, const Os::TimeNs_t stall_ns)
+{
+    BudgetNs.store(budget_ns, std::memory_order_relaxed);
+    StallNs.store(stall_ns, std::memory_order_relaxed);
+}
+
+void ExecStats::record(const Os::TimeNs_t cpu_ns, const Os::TimeNs_t wall_ns)
+{
+    // Single writer. Plain load/store pairs, except the window extremes
+    // the reader resets.
+    Cycles.store(Cycles.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    CpuTotalNs.store(CpuTotalNs.load(std::memory_order_relaxed) + cpu_ns, std::memory_order_relaxed);
+    WallTotalNs.store(WallTotalNs.load(std::memory_order_relaxed) + wall_ns, std::memory_order_relaxed);
+    if (cpu_ns < CpuMinNs.load(std::memory_order_relaxed))
+    {
+        CpuMinNs.store(cpu_ns, std::memory_order_relaxed);
+    }
+    if (cpu_ns > CpuMaxNs.load(std::memory_order_relaxed))
+    {
+        CpuMaxNs.store(cpu_ns, std::memory_order_relaxed);
+    }
+
+    Os::TimeNs_t window = WindowMinNs.load(std::memory_order_relaxed);
+    while (cpu_ns < window &&
+        !WindowMinNs.compare_exchange_weak(window, cpu_ns, std::memory_order_relaxed))
+    {}
+    window = WindowMaxNs.load(std::memory_order_relaxed);
+    while (cpu_ns > window &&
+        !WindowMaxNs.compare_exchange_weak(window, cpu_ns, std::memory_order_relaxed))
+    {}
+
+    std::atomic<uint32_t>& count = Hist[bucket(cpu_ns)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    const Os::TimeNs_t budget = BudgetNs.load(std::memory_order_relaxed);
+    if (budget > 0 && cpu_ns > budget)
+    {
+        Overruns.store(Overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+bool ExecStats::stalled(const Os::TimeNs_t now_ns) const
+{
+    const Os::TimeNs_t stall = StallNs.load(std::memory_order_relaxed);
+    const Os::TimeNs_t start = CycleStartNs.load(std::memory_order_relaxed);
+    return (stall > 0) && (start > 0) && (now_ns > start) && ((now_ns - start) > stall);
+}
+
+Os::TimeNs_t ExecStats::take_window_max_ns()
+{
+    return WindowMaxNs.exchange(0, std::memory_order_relaxed);
+}
+
+Os::TimeNs_t ExecStats::take_window_min_ns()
+{
+    return WindowMinNs.exchange(Os::TimeNsNever, std::memory_order_relaxed);
+}
+
+void ExecStats::histogram(uint32_t* counts) const
+{
+    for (size_t i = 0; i < NumBuckets; i++)
+    {
+        counts[i] = Hist[i].load(std::memory_order_relaxed);
+    }
+}
+
+size_t ExecStats::bucket(const Os::TimeNs_t ns)
+{
+    if (ns < SubBuckets)
+    {
+        return static_cast<size_t>(ns);
+    }
+    // Power of two, then the next SubBits bits below it
+    const unsigned exp = 63u - static_cast<unsigned>(__builtin_clzll(ns));
+    const size_t sub = static_cast<size_t>(ns >> (exp - SubBits)) & (SubBuckets - 1);
+    const size_t idx = ((exp - SubBits + 1) * SubBuckets) + sub;
+    return (idx < NumBuckets) ? idx : (NumBuckets - 1);
+}
+
+Os::TimeNs_t ExecStats::bucket_max_ns(const size_t bucket)
+{
+    if (bucket < SubBuckets)
+    {
+        return static_cast<Os::TimeNs_t>(bucket);
+    }
+    const unsigned exp = static_cast<unsigned>(bucket / SubBuckets) + SubBits - 1;
+    const Os::TimeNs_t sub = bucket % SubBuckets;
+    const Os::TimeNs_t width = Os::TimeNs_t(1) << (exp - SubBits);
+    return ((SubBuckets + sub) * width) + width - 1;
+}
+
+Os::TimeNs_t ExecStats::percentile_ns(const uint32_t* counts, const uint32_t pct)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < NumBuckets; i++)
+    {
+        total += counts[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    // Smallest bucket with at least pct% of the cycles at or below it
+    const uint64_t rank = ((total * pct) + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NumBuckets; i++)
+    {
+        seen += counts[i];
+        if (seen >= rank && seen > 0)
+        {
+            return bucket_max_ns(i);
+        }
+    }
+    return bucket_max_ns(NumBuckets - 1);
+}
@@ -1,6 +1,9 @@
 
 #include "svcs/Executor.hpp"
 #include "svcs/log/Logger.hpp"
+#include "os/EventCount.hpp"
+#include "os/Mutex.hpp"
+#include "os/Task.hpp"
 
 using namespace etfw;
 
@@ -8,156 +11,393 @@ using Status = iExecutor::Status;
 
 #define __LOG(lvl, fmt, args)   EtfLog::log(lvl, "EXEC", fmt, args)
 
-iExecutor::Node_t iExecutor::find(const SvcId_t id)
+/// Boot threads besides the caller
+static constexpr size_t NumBootThreads = (ETFW_BOOT_WORKERS > 1) ? (ETFW_BOOT_WORKERS - 1) : 0;
+
+struct BootThread
 {
-    iExecutor::Node_t ret = nullptr;
+    Os::Thread Thread;
+    alignas(16) Os::Thread::Config::Stack::Buf_t Stack[ETFW_BOOT_STACK_SZ];
+};
 
-    for (auto& app: Apps)
+/// Shared by every executor. start_all holds boot_lock while using them.
+static BootThread BootThreads[(NumBootThreads > 0) ? NumBootThreads : 1];
+
+static Os::Mutex& boot_lock()
+{
+    static Os::Mutex lock;
+    static const bool init = lock.init().success();
+    (void)init;
+    return lock;
+}
+
+/// @brief Ready queue and progress of one start_all
+struct iExecutor::BootQueue
+{
+    iExecutor& Exec;
+    Os::Mutex Lock;
+    Os::EventCount Changed; //< Notified when an init finishes
+    size_t Head;            //< Next ready slot to init
+    size_t Tail;            //< Ready slots filled
+    size_t Running;         //< Inits in progress
+
+    BootQueue(iExecutor& exec):
+        Exec(exec),
+        Head(0),
+        Tail(0),
+        Running(0)
     {
-        if (app->id() == id)
-        {
-            ret = app;
-            break;
-        }
+        Lock.init();
     }
 
-    return ret;
+    /// @brief Queue an app for init
+    inline void push(const size_t idx)
+    {
+        Exec.Boot[idx].State = BootState::READY;
+        Exec.Boot[Tail++].Ready = idx;
+    }
+};
+
+Status iExecutor::register_app(iApp& app)
+{
+    return register_app(&app);
 }
 
-bool iExecutor::is_registered(const SvcId_t id)
+Status iExecutor::register_app(iApp* app)
 {
-    if (find(id) != nullptr)
+    Status stat = Status::Code::OK;
+    if (is_registered(*app))
     {
-        return true;
+        stat = Status::Code::ID_TAKEN;
     }
-    return false;
+    else if (!Apps.insert(app))
+    {
+        stat = Status::Code::REGISTRY_FULL;
+    }
+
+    return stat;
 }
 
-bool iExecutor::is_registered(const iApp& app)
+Status iExecutor::start_svc(iApp* app)
 {
-    if (find(app.id()) != nullptr)
+    Status stat;
+    iSvc::Status svc_stat = app->start();
+    if (svc_stat.success())
     {
-        return true;
+        stat = Status::Code::OK;
     }
-    return false;
+    else
+    {
+        stat = Status::Code::START_FAILURE;
+    }
+
+    return stat;
 }
 
-Status iExecutor::register_app(iApp& app)
+Status iExecutor::start_all()
 {
-    Status stat = Status::Code::OK;
-    size_t num_registered = Apps.size();
-    if (num_registered < ContainerSize)
+    Os::Mutex& lock = boot_lock();
+    lock.lock();
+    const Os::TimeNs_t begin = Os::Clock::now_ns();
+
+    NumBooted = 0;
+    for (auto& app: Apps)
+    {
+        BootRecord& rec = Boot[NumBooted++];
+        rec.App = app;
+        rec.Times = {0, 0};
+        rec.State = BootState::WAITING;
+        rec.Err = Status::Code::OK;
+        rec.Waiting = app->init_deps().size();
+    }
+
+    // No boot threads yet, so the queue is only locked for consistency
+    BootQueue queue(*this);
+    queue.Lock.lock();
+    for (size_t i = 0; i < NumBooted; i++)
     {
-        if (!is_registered(app))
+        for (const SvcId_t dep: Boot[i].App->init_deps())
         {
-            Apps.push_front(&app);
-            // Need some sort of check for push_back
-            // in case exceptions/asserts are disabled
-            if (Apps.size() == num_registered+1)
+            if (boot_find(dep) == NumBooted)
             {
-                //printf("Registered app %X\n", app);
-                stat = Status::Code::OK;
+                EtfLog::log(LogLevel::ERROR,
+                    "EXEC",
+                    "%s app (ID = %d) depends on unregistered app %d",
+                    Boot[i].App->name_raw(), Boot[i].App->id(), dep);
+                if (Boot[i].State == BootState::WAITING)
+                {
+                    boot_resolve(queue, i, BootState::FAILED, Status::Code::DEPENDENCY_ERR);
+                }
             }
-            else
+        }
+    }
+    for (size_t i = 0; i < NumBooted; i++)
+    {
+        if (Boot[i].State == BootState::WAITING && Boot[i].App->is_init())
+        {
+            boot_resolve(queue, i, BootState::INITIALIZED);
+        }
+    }
+    size_t num_inits = 0;
+    for (size_t i = 0; i < NumBooted; i++)
+    {
+        if (Boot[i].State == BootState::WAITING || Boot[i].State == BootState::READY)
+        {
+            num_inits++;
+            if (Boot[i].State == BootState::WAITING && Boot[i].Waiting == 0)
             {
-                // Unknown registration error. Unlikely to happen 
-                // but still need to cover our bases
-                stat = Status::Code::UNKNOWN_REGISTRATION_ERR;
+                queue.push(i);
             }
         }
-        else
+    }
+    queue.Lock.unlock();
+
+    // More threads than inits would only idle
+    size_t num_threads = 0;
+    while (num_threads < NumBootThreads && (num_threads + 1) < num_inits)
+    {
+        BootThread& thread = BootThreads[num_threads];
+        Os::Thread::Config cfg(thread.Stack, ETFW_BOOT_STACK_SZ, ETFW_BOOT_PRIORITY,
+            &queue, &iExecutor::boot_thread);
+        if (!thread.Thread.start(cfg).success())
         {
-            stat = Status::Code::ID_TAKEN;
+            break;
         }
+        num_threads++;
     }
-    else
+    boot_init(queue);
+    for (size_t i = 0; i < num_threads; i++)
     {
-        stat = Status::Code::REGISTRY_FULL;
+        BootThreads[i].Thread.join();
     }
 
-    return stat;
-}
+    // Whatever still waits is on a cycle or downstream of one
+    for (size_t i = 0; i < NumBooted; i++)
+    {
+        if (Boot[i].State == BootState::WAITING)
+        {
+            EtfLog::log(LogLevel::ERROR,
+                "EXEC",
+                "%s app (ID = %d) waits on an init dependency cycle",
+                Boot[i].App->name_raw(), Boot[i].App->id());
+            Boot[i].State = BootState::FAILED;
+            Boot[i].Err = Status::Code::DEPENDENCY_ERR;
+        }
+    }
+
+    boot_start();
 
-Status iExecutor::register_app(iApp* app)
-{
     Status stat = Status::Code::OK;
-    size_t num_registered = Apps.size();
-    if (num_registered < ContainerSize)
+    size_t num_started = 0;
+    for (size_t i = 0; i < NumBooted; i++)
     {
-        if (!is_registered(*app))
+        if (Boot[i].State == BootState::STARTED)
         {
-            Apps.push_front(app);
-            // Need some sort of check for push_back
-            // in case exceptions/asserts are disabled
-            if (Apps.size() == num_registered+1)
-            {
-                stat = Status::Code::OK;
-            }
-            else
-            {
-                // Unknown registration error. Unlikely to happen 
-                // but still need to cover our bases
-                stat = Status::Code::UNKNOWN_REGISTRATION_ERR;
-            }
+            num_started++;
         }
-        else
+        else if (stat.success())
         {
-            stat = Status::Code::ID_TAKEN;
+            stat = Boot[i].Err;
         }
     }
-    else
-    {
-        stat = Status::Code::REGISTRY_FULL;
-    }
+    EtfLog::log(LogLevel::INFO,
+        "EXEC",
+        "Booted %u of %u apps in %llu us",
+        static_cast<unsigned>(num_started), static_cast<unsigned>(NumBooted),
+        static_cast<unsigned long long>((Os::Clock::now_ns() - begin) / 1000));
 
+    lock.unlock();
     return stat;
 }
 
-Status iExecutor::start_svc(iApp* app)
+bool iExecutor::boot_times(const SvcId_t id, BootTimes& times) const
 {
-    Status stat;
-    iSvc::Status svc_stat = app->start();
-    if (svc_stat.success())
+    // start_all rewrites the records under the boot lock
+    Os::Mutex& lock = boot_lock();
+    lock.lock();
+    const size_t idx = boot_find(id);
+    const bool found = (idx != NumBooted);
+    if (found)
     {
-        stat = Status::Code::OK;
+        times = Boot[idx].Times;
     }
-    else
+    lock.unlock();
+    return found;
+}
+
+size_t iExecutor::boot_find(const SvcId_t id) const
+{
+    // Records were filled in app slot order, and apps are never removed
+    const size_t idx = Apps.index_of(id);
+    return (idx < NumBooted) ? idx : NumBooted;
+}
+
+void iExecutor::boot_thread(void* queue)
+{
+    BootQueue* q = static_cast<BootQueue*>(queue);
+    q->Exec.boot_init(*q);
+}
+
+void iExecutor::boot_init(BootQueue& queue)
+{
+    while (true)
     {
-        stat = Status::Code::START_FAILURE;
-    }
+        const Os::EventCount::Key_t key = queue.Changed.prepare_wait();
+        queue.Lock.lock();
+        if (queue.Head == queue.Tail)
+        {
+            const bool done = (queue.Running == 0);
+            queue.Lock.unlock();
+            if (done)
+            {
+                queue.Changed.cancel_wait(key);
+                break;
+            }
+            // A running init may queue more
+            queue.Changed.wait(key);
+            continue;
+        }
+        const size_t idx = Boot[queue.Head++].Ready;
+        queue.Running++;
+        queue.Lock.unlock();
+        queue.Changed.cancel_wait(key);
 
-    return stat;
+        BootRecord& rec = Boot[idx];
+        const Os::TimeNs_t start = Os::Clock::now_ns();
+        const iSvc::Status svc_stat = rec.App->init();
+        rec.Times.InitNs = Os::Clock::now_ns() - start;
+        if (svc_stat.success())
+        {
+            EtfLog::log(LogLevel::INFO,
+                "EXEC",
+                "%s app (ID = %d) initialized in %llu us",
+                rec.App->name_raw(), rec.App->id(),
+                static_cast<unsigned long long>(rec.Times.InitNs / 1000));
+        }
+        else
+        {
+            EtfLog::log(LogLevel::ERROR,
+                "EXEC",
+                "App init failure. %s app (ID = %d). %s",
+                rec.App->name_raw(), rec.App->id(), svc_stat.str());
+        }
+
+        queue.Lock.lock();
+        if (svc_stat.success())
+        {
+            boot_resolve(queue, idx, BootState::INITIALIZED);
+        }
+        else
+        {
+            boot_resolve(queue, idx, BootState::FAILED, Status::Code::INITIALIZATION_ERR);
+        }
+        queue.Running--;
+        queue.Lock.unlock();
+        queue.Changed.notify();
+    }
 }
 
-Status iExecutor::start_all()
+void iExecutor::boot_resolve(BootQueue& queue, const size_t idx,
+    const BootState state, const Status::Code err)
 {
-    Status stat = Status::Code::OK;
-    for (auto &app: Apps)
+    Boot[idx].State = state;
+    Boot[idx].Err = err;
+
+    const SvcId_t id = Boot[idx].App->id();
+    for (size_t i = 0; i < NumBooted; i++)
     {
-        if (!app->is_init())
+        BootRecord& rec = Boot[i];
+        if (rec.State != BootState::WAITING)
+        {
+            continue;
+        }
+        for (const SvcId_t dep: rec.App->init_deps())
         {
-            iSvc::Status svc_stat = app->init();
-            if (!svc_stat.success())
+            if (dep != id)
             {
                 continue;
             }
+            if (state == BootState::FAILED)
+            {
+                EtfLog::log(LogLevel::ERROR,
+                    "EXEC",
+                    "%s app (ID = %d) skipped. Dependency %s failed",
+                    rec.App->name_raw(), rec.App->id(), Boot[idx].App->name_raw());
+                boot_resolve(queue, i, BootState::FAILED, Status::Code::DEPENDENCY_ERR);
+                break;
+            }
+            if (--rec.Waiting == 0)
+            {
+                queue.push(i);
+            }
         }
+    }
+}
 
-        if (!app->is_started())
+void iExecutor::boot_start()
+{
+    // Each pass starts every app whose dependencies have started. Cycles
+    // already failed, so every pass makes progress until none is left.
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        for (size_t i = 0; i < NumBooted; i++)
         {
-            iSvc::Status svc_stat = app->start();
-            if (!svc_stat.success())
+            BootRecord& rec = Boot[i];
+            if (rec.State != BootState::INITIALIZED)
             {
                 continue;
             }
-            else
+
+            bool deps_started = true;
+            bool deps_failed = false;
+            for (const SvcId_t dep: rec.App->init_deps())
+            {
+                const BootState dep_state = Boot[boot_find(dep)].State;
+                deps_started &= (dep_state == BootState::STARTED);
+                deps_failed |= (dep_state == BootState::FAILED);
+            }
+
+            if (deps_failed)
+            {
+                EtfLog::log(LogLevel::ERROR,
+                    "EXEC",
+                    "%s app (ID = %d) not started. A dependency failed",
+                    rec.App->name_raw(), rec.App->id());
+                rec.State = BootState::FAILED;
+                rec.Err = Status::Code::DEPENDENCY_ERR;
+                progress = true;
+            }
+            else if (deps_started)
             {
-                // Log and increment counters
+                if (!rec.App->is_started())
+                {
+                    const Os::TimeNs_t start = Os::Clock::now_ns();
+                    const Status stat = start_svc(rec.App);
+                    rec.Times.StartNs = Os::Clock::now_ns() - start;
+                    if (!stat.success())
+                    {
+                        EtfLog::log(LogLevel::ERROR,
+                            "EXEC",
+                            "App start failure. %s app (ID = %d)",
+                            rec.App->name_raw(), rec.App->id());
+                        rec.State = BootState::FAILED;
+                        rec.Err = stat.code();
+                        progress = true;
+                        continue;
+                    }
+                    EtfLog::log(LogLevel::INFO,
+                        "EXEC",
+                        "%s app (ID = %d) started in %llu us",
+                        rec.App->name_raw(), rec.App->id(),
+                        static_cast<unsigned long long>(rec.Times.StartNs / 1000));
+                }
+                rec.State = BootState::STARTED;
+                progress = true;
             }
         }
     }
-
-    return stat;
 }
 
 Status iExecutor::start(const SvcId_t app_id)
@@ -202,17 +442,99 @@ Status iExecutor::start(const SvcId_t app_id)
     return stat;
 }
 
-Status iExecutor::stop_all()
+/// @brief Check if an app is started or its runner hasn't finished
+static bool is_running(iApp& app)
+{
+    const iSvcRunner* runner = app.get_runner();
+    return app.is_started() || (runner != nullptr && !runner->is_finished());
+}
+
+bool iExecutor::has_running_dependent(const SvcId_t id) const
 {
     for (auto& app: Apps)
     {
-        if (app->is_started())
+        if (!is_running(*app))
         {
+            continue;
+        }
+        for (const SvcId_t dep: app->init_deps())
+        {
+            if (dep == id)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+Status iExecutor::stop_all()
+{
+    const Os::TimeNs_t start = Os::Clock::now_ns();
+    const Os::TimeNs_t deadline = start +
+        (static_cast<Os::TimeNs_t>(ETFW_STOP_TIMEOUT_MS) * Os::NsPerMs);
+    Status stat = Status::Code::OK;
+
+    // Each pass stops the apps nothing running depends on, then waits for
+    // them. The last pass stops whatever is left, e.g. a cycle.
+    bool remaining = true;
+    bool ordered = true;
+    while (remaining)
+    {
+        const Os::TimeNs_t pass = Os::Clock::now_ns();
+        size_t num_stopped = 0;
+        remaining = false;
+        for (auto& app: Apps)
+        {
+            if (!app->is_started())
+            {
+                continue;
+            }
+            if (ordered && has_running_dependent(app->id()))
+            {
+                remaining = true;
+                continue;
+            }
             app->stop();
+            num_stopped++;
+        }
+        if (num_stopped == 0)
+        {
+            // Everything left waits on something that won't stop first
+            ordered = false;
+            continue;
+        }
+
+        for (auto& app: Apps)
+        {
+            iSvcRunner* runner = app->get_runner();
+            if (runner == nullptr || runner->stop_requested_ns() < pass)
+            {
+                // Not stopped by this pass
+                continue;
+            }
+
+            if (runner->wait_finished(deadline))
+            {
+                EtfLog::log(LogLevel::INFO,
+                    "EXEC",
+                    "Stopped %s app (ID = %d) in %llu us",
+                    app->name_raw(), app->id(),
+                    static_cast<unsigned long long>(runner->stop_latency_ns() / 1000));
+            }
+            else
+            {
+                EtfLog::log(LogLevel::ERROR,
+                    "EXEC",
+                    "%s app (ID = %d) did not stop within %u ms",
+                    app->name_raw(), app->id(),
+                    static_cast<unsigned>(ETFW_STOP_TIMEOUT_MS));
+                stat = Status::Code::STOP_TIMEOUT;
+            }
         }
     }
 
-    return Status::Code::OK;
+    return stat;
 }
 
 Status iExecutor::stop(const SvcId_t app_id)
@@ -237,6 +559,7 @@ Status iExecutor::stop(const SvcId_t app_id)
                     "EXEC",
                     "App stop failure. %s app (ID = %d). %s",
                     app->name_raw(), app->id(), svc_stat.str());
+                stat = Status::Code::STOP_FAILURE;
             }
         }
         else
@@ -251,8 +574,9 @@ Status iExecutor::stop(const SvcId_t app_id)
     {
         EtfLog::log(LogLevel::ERROR,
                     "EXEC",
-                    "App stop failure. %s app (ID = %d) is not registered",
-                    app->name_raw(), app->id());
+                    "App stop failure. App ID %d is not registered",
+                    app_id);
+        stat = Status::Code::UNKNOWN_ID;
     }
 
     return stat;
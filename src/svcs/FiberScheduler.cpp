@@ -0,0 +1,109 @@
+#include "svcs/FiberScheduler.hpp"
+#include "etfw_assert.hpp"
+
+using namespace etfw;
+
+FiberScheduler& FiberScheduler::instance()
+{
+    static FiberScheduler sched;
+    return sched;
+}
+
+FiberScheduler::FiberScheduler():
+    wake_hook_{on_wake, this},
+    num_fibers_(0),
+    switches_(0),
+    sleeps_(0),
+    running_(false)
+{
+    auto stat = lock_.init();
+    ETFW_ASSERT(stat.success(), "Failed to initialize fiber scheduler lock");
+}
+
+FiberScheduler::~FiberScheduler()
+{
+    if (running_.exchange(false))
+    {
+        idle_.notify();
+        thread_.join();
+    }
+}
+
+void FiberScheduler::add(Os::Fiber& fiber)
+{
+    fiber.set_wake_hook(&wake_hook_);
+    lock_.lock();
+    const size_t idx = num_fibers_.load(std::memory_order_relaxed);
+    ETFW_ASSERT(idx < MaxFibers, "Fiber scheduler full. Increase FIBER_SCHED_MAX_FIBERS");
+    fibers_[idx] = &fiber;
+    num_fibers_.store(idx + 1, std::memory_order_release);
+    lock_.unlock();
+}
+
+bool FiberScheduler::start()
+{
+    bool ok = true;
+    lock_.lock();
+    if (!running_.load())
+    {
+        running_.store(true);
+        Os::Thread::Config cfg(stack_, FIBER_SCHED_STACK_SZ,
+            FIBER_SCHED_PRIORITY, this, thread_main);
+        ok = thread_.start(cfg).success();
+        if (!ok)
+        {
+            running_.store(false);
+        }
+    }
+    lock_.unlock();
+    return ok;
+}
+
+void FiberScheduler::thread_main(void* arg)
+{
+    FiberScheduler& sched = *static_cast<FiberScheduler*>(arg);
+
+    while (sched.running_.load(std::memory_order_relaxed))
+    {
+        // Anything made ready after this is seen below or wakes the wait
+        const Os::EventCount::Key_t key = sched.idle_.prepare_wait();
+        const Os::TimeNs_t now = Os::Clock::now_ns();
+        Os::TimeNs_t deadline = Os::TimeNsNever;
+        size_t resumed = 0;
+
+        const size_t count = sched.num_fibers_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++)
+        {
+            Os::Fiber& fiber = *sched.fibers_[i];
+            const Os::Fiber::State state = fiber.state();
+            if (Os::Fiber::State::READY == state ||
+                (Os::Fiber::State::PARKED == state &&
+                    (fiber.notified() || fiber.park_deadline() <= now)))
+            {
+                fiber.resume();
+                resumed++;
+            }
+            else if (Os::Fiber::State::PARKED == state &&
+                fiber.park_deadline() < deadline)
+            {
+                deadline = fiber.park_deadline();
+            }
+        }
+
+        if (resumed > 0)
+        {
+            sched.switches_.fetch_add(resumed, std::memory_order_relaxed);
+            sched.idle_.cancel_wait(key);
+        }
+        else
+        {
+            sched.sleeps_.fetch_add(1, std::memory_order_relaxed);
+            sched.idle_.wait_until(key, deadline);
+        }
+    }
+}
+
+void FiberScheduler::on_wake(void* sched)
+{
+    static_cast<FiberScheduler*>(sched)->idle_.notify();
+}
@@ -1,42 +1,131 @@
 
 #include "svcs/Runner.hpp"
+#include "svcs/SvcPool.hpp"
+#include "svcs/FiberScheduler.hpp"
 #include "svcs/iSvc.hpp"
+#include "msg/BlockingMsgQueue.hpp"
+#include <algorithm>
 
 using namespace etfw;
 
 iSvcRunner::iSvcRunner():
     Svc(nullptr),
-    State(State_t::CREATED)
-{}
+    State(State_t::CREATED),
+    StopRequestNs(0),
+    StopLatencyNs(0)
+{
+    // Queue waits inside a service cycle are input waits, not stalls
+    msg::wait_hooks().store(&ExecStats::BlockedHooks, std::memory_order_release);
+}
 
 iSvcRunner::iSvcRunner(iSvc* svc):
     Svc(svc),
-    State(State_t::CREATED)
-{}
+    State(State_t::CREATED),
+    StopRequestNs(0),
+    StopLatencyNs(0)
+{
+    msg::wait_hooks().store(&ExecStats::BlockedHooks, std::memory_order_release);
+}
 
 iSvcRunner::~iSvcRunner() = default;
 
-void iSvcRunner::stop_children()
+Os::EventCount& iSvcRunner::finished_event()
+{
+    static Os::EventCount event;
+    return event;
+}
+
+bool iSvcRunner::wait_finished(const Os::TimeNs_t deadline_ns)
 {
-    if (Svc != nullptr)
+    Os::EventCount& finished = finished_event();
+    while (true)
     {
-        iSvc::iRegistry *children = Svc->children();
-        if (children != nullptr)
+        // Any runner finishing after this wakes the wait
+        const Os::EventCount::Key_t key = finished.prepare_wait();
+        if (is_finished())
         {
-            for (size_t i = 0; i < children->size(); i++)
-            {
-                children->data()[i]->stop();
-            }
+            finished.cancel_wait(key);
+            return true;
+        }
+        if (Os::Clock::now_ns() >= deadline_ns)
+        {
+            finished.cancel_wait(key);
+            return false;
+        }
+        finished.wait_until(key, deadline_ns);
+    }
+}
+
+bool iSvcRunner::request_stop()
+{
+    // Only a starting or active service moves to STOP_REQUESTED, so the
+    // request can't overwrite a state the runner moved to meanwhile
+    const Os::TimeNs_t now = Os::Clock::now_ns();
+    State_t state = State.load(std::memory_order_acquire);
+    do
+    {
+        if (State_t::STARTING != state && State_t::ACTIVE != state)
+        {
+            return false;
         }
+    } while (!State.compare_exchange_weak(state, State_t::STOP_REQUESTED));
+
+    StopRequestNs = now;
+    // A service blocked in process on one of its sources would otherwise
+    // only see the request when its receive times out
+    for (msg::iEventSource* source: Svc->event_sources())
+    {
+        source->wake();
     }
+    return true;
 }
 
-void iSvcRunner::log(const LogLevel lvl, const char* fmt, ...)
+void iSvcRunner::finish(const State_t state)
 {
-    va_list args;
-    if (Svc != nullptr)
+    if (State_t::STOPPED == state && StopRequestNs != 0)
     {
-        Svc->log(lvl, fmt, args);
+        StopLatencyNs = Os::Clock::now_ns() - StopRequestNs;
+    }
+    // Release pairs with the acquire in is_finished
+    State.store(state, std::memory_order_release);
+    finished_event().notify();
+}
+
+void iSvcRunner::clear_wakes()
+{
+    for (msg::iEventSource* source: Svc->event_sources())
+    {
+        source->clear_wake();
+    }
+}
+
+void iSvcRunner::stop_children(const bool wait)
+{
+    iSvc::iRegistry* children = (Svc != nullptr) ? Svc->children() : nullptr;
+    if (children == nullptr)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < children->size(); i++)
+    {
+        children->data()[i]->stop();
+    }
+
+    if (wait)
+    {
+        const Os::TimeNs_t deadline = Os::Clock::now_ns() +
+            (static_cast<Os::TimeNs_t>(ETFW_STOP_TIMEOUT_MS) * Os::NsPerMs);
+        for (size_t i = 0; i < children->size(); i++)
+        {
+            iSvc* child = children->data()[i];
+            iSvcRunner* runner = child->get_runner();
+            if (runner != nullptr && !runner->wait_finished(deadline))
+            {
+                log(LogLevel::WARNING, "Child %s did not stop within %u ms",
+                    child->name_raw(), static_cast<unsigned>(ETFW_STOP_TIMEOUT_MS));
+            }
+        }
     }
 }
 
@@ -53,31 +142,24 @@ iSvcRunner::RunStatus PassiveRunner::start()
 
 iSvcRunner::RunStatus PassiveRunner::stop()
 {
-    stop_children();
-    /// TODO: need some sort of wait/async call back for children to stop
-    /// before calling cleanup
+    stop_children(true);
     Svc->post_run_cleanup();
     log(LogLevel::INFO, "Passive service stopped");
     return iSvcRunner::RunStatus::OK;
 }
 
-iActiveRunnerExt::iActiveRunnerExt(iSvc* svc,
-    Priority_t priority,
-    const StackBuf_t stack_buf,
-    const size_t stack_sz
-):
+PooledRunner::PooledRunner(iSvc* svc):
     iSvcRunner(svc),
-    TaskPriority(priority),
-    StackBuf(stack_buf),
-    StackSz(stack_sz)
+    Sched(Sched_t::IDLE),
+    WakeNs(Os::TimeNsNever),
+    Runs(0),
+    Inited(false),
+    Hook{on_notify, this}
 {
-    ETFW_ASSERT(stack_buf != nullptr,
-        "Attempt to create active runner with null stack buffer");
-    ETFW_ASSERT(stack_sz > 0,
-        "Attempt to create active runner with invalid stack size");
+    Event.set_notify_hook(&Hook);
 }
 
-iSvcRunner::RunStatus iActiveRunnerExt::start()
+iSvcRunner::RunStatus PooledRunner::start()
 {
     RunStatus run_status = RunStatus::ERROR;
 
@@ -87,41 +169,231 @@ iSvcRunner::RunStatus iActiveRunnerExt::start()
         State_t::STOPPED == State ||
         State_t::ERROR == State)
     {
-        Os::Thread::Routine_t routine = this->task_sm;
-        Os::Thread::RoutineArg_t arg = this;
-        Os::Thread::Config task_cfg(
-            StackBuf,
-            StackSz,
-            TaskPriority,
-            arg,
-            routine
-        );
+        // The pool is created by the first start, after the services
+        // using it, so it is destroyed before them
+        SvcPool& pool = SvcPool::instance();
+        if (State_t::CREATED == State || State_t::INITIALIZED == State)
+        {
+            pool.add(*this);
+        }
+        Sources = Svc->event_sources();
+        for (msg::iEventSource* source: Sources)
+        {
+            ETFW_ASSERT(source != nullptr, "Null event source");
+            source->attach(&Event);
+        }
+
+        clear_wakes();
+        Inited = false;
         State = State_t::STARTING;
-        Os::Thread::Status os_stat = task_.start(task_cfg);
-        if (os_stat.error())
+        if (pool.start())
         {
-            State = State_t::ERROR;
+            pool.schedule(*this);
+            run_status = RunStatus::OK;
         }
         else
         {
-            run_status = RunStatus::OK;
+            finish(State_t::ERROR);
         }
     }
 
     return run_status;
 }
 
+iSvcRunner::RunStatus PooledRunner::stop()
+{
+    RunStatus status = RunStatus::DONE;
+    // A service still starting is stopped once its init returns
+    if (request_stop())
+    {
+        SvcPool::instance().schedule(*this);
+        status = RunStatus::OK;
+    }
+    return status;
+}
+
+Os::TimeNs_t PooledRunner::run_once()
+{
+    Runs.fetch_add(1, std::memory_order_relaxed);
+    Os::TimeNs_t wake = Os::TimeNsNever;
+
+    if (State_t::STARTING == State)
+    {
+        iSvc::RunStatus stat = Svc->pre_run_init();
+        ExecStats::resync();
+        if (iSvc::RunStatus::OK == stat)
+        {
+            // Fails if a stop came in during init. The next step stops
+            // the service.
+            State_t starting = State_t::STARTING;
+            State.compare_exchange_strong(starting, State_t::ACTIVE);
+            Inited = true;
+            wake = 0;
+        }
+        else if (iSvc::RunStatus::DONE == stat)
+        {
+            finish(State_t::EXITED);
+        }
+        else
+        {
+            finish(State_t::ERROR);
+        }
+    }
+    else if (State_t::ACTIVE == State)
+    {
+        // The worker's last reading was taken before the pool picked this
+        // service, so it would charge the pool's overhead to it
+        ExecStats::resync();
+        const ExecStats::Mark mark = Exec.begin();
+        const Os::TimeNs_t now = Os::Clock::now_ns();
+        bool handled = false;
+        for (msg::iEventSource* source: Sources)
+        {
+            handled |= source->dispatch(now);
+            wake = std::min(wake, source->deadline_ns());
+        }
+
+        iSvc::RunStatus stat = Svc->process();
+        Exec.end(mark);
+        if (iSvc::RunStatus::DONE == stat)
+        {
+            log(LogLevel::INFO, "Service returned DONE. Exiting.");
+            stop_children(false);
+            Svc->post_run_cleanup();
+            ExecStats::resync();
+            finish(State_t::EXITED);
+            wake = Os::TimeNsNever;
+        }
+        else if (iSvc::RunStatus::ERROR == stat)
+        {
+            finish(State_t::ERROR);
+            wake = Os::TimeNsNever;
+        }
+        else if (handled)
+        {
+            wake = 0;
+        }
+        else if (Sources.empty())
+        {
+            // Nothing to sleep on. Poll rather than hold a worker.
+            wake = now + (static_cast<Os::TimeNs_t>(SVC_POOL_POLL_MS) * Os::NsPerMs);
+        }
+    }
+    else if (State_t::STOP_REQUESTED == State)
+    {
+        State = State_t::STOPPING;
+        stop_children(false);
+        // A service stopped before its init ran has nothing to clean up
+        if (Inited)
+        {
+            Svc->post_run_cleanup();
+            ExecStats::resync();
+        }
+        finish(State_t::STOPPED);
+        log(LogLevel::INFO, "Service stopped");
+    }
+
+    return wake;
+}
+
+void PooledRunner::on_notify(void* runner)
+{
+    SvcPool::instance().schedule(*static_cast<PooledRunner*>(runner));
+}
+
+iActiveRunnerExt::iActiveRunnerExt(iSvc* svc,
+    Priority_t priority,
+    const StackBuf_t stack_buf,
+    const size_t stack_sz,
+    const CpuMask_t affinity
+):
+    iSvcRunner(svc),
+    TaskPriority(priority),
+    StackBuf(stack_buf),
+    StackSz(stack_sz),
+    Affinity(affinity)
+{
+    ETFW_ASSERT(stack_buf != nullptr,
+        "Attempt to create active runner with null stack buffer");
+    ETFW_ASSERT(stack_sz > 0,
+        "Attempt to create active runner with invalid stack size");
+}
+
+iSvcRunner::RunStatus iActiveRunnerExt::start()
+{
+    // Claim the start before touching anything a running thread may use
+    State_t state = State.load(std::memory_order_acquire);
+    do
+    {
+        if (State_t::CREATED != state &&
+            State_t::INITIALIZED != state &&
+            State_t::EXITED != state &&
+            State_t::STOPPED != state &&
+            State_t::ERROR != state)
+        {
+            return RunStatus::ERROR;
+        }
+    } while (!State.compare_exchange_weak(state, State_t::STARTING));
+
+    RunStatus run_status = RunStatus::ERROR;
+    Os::Thread::Routine_t routine = this->task_sm;
+    Os::Thread::RoutineArg_t arg = this;
+    Os::Thread::Config task_cfg(
+        StackBuf,
+        StackSz,
+        TaskPriority,
+        arg,
+        routine,
+        Affinity
+    );
+    clear_wakes();
+    prepare_start();
+    Os::Thread::Status os_stat = task_.start(task_cfg);
+    if (os_stat.error())
+    {
+        finish(State_t::ERROR);
+    }
+    else
+    {
+        run_status = RunStatus::OK;
+    }
+
+    return run_status;
+}
+
 iSvcRunner::RunStatus iActiveRunnerExt::stop()
 {
     RunStatus status = RunStatus::DONE;
-    if (State_t::ACTIVE == State)
+    // A service still starting is stopped once its init returns
+    if (request_stop())
     {
-        State = State_t::STOP_REQUESTED;
         status = RunStatus::OK;
     }
     return status;
 }
 
+bool iActiveRunnerExt::wait_finished(const Os::TimeNs_t deadline_ns)
+{
+    if (!iSvcRunner::wait_finished(deadline_ns))
+    {
+        return false;
+    }
+
+    // The thread still logs and unwinds after finishing
+    const Os::TimeNs_t now = Os::Clock::now_ns();
+    const Os::TimeMs_t remaining_ms = (deadline_ns > now) ?
+        static_cast<Os::TimeMs_t>((deadline_ns - now + Os::NsPerMs - 1) / Os::NsPerMs) : 0;
+    return task_.join(remaining_ms).code() != Os::Thread::Status::Code::TIMEOUT;
+}
+
+iSvc::RunStatus iActiveRunnerExt::run_once()
+{
+    const ExecStats::Mark mark = Exec.begin();
+    iSvc::RunStatus stat = Svc->process();
+    Exec.end(mark);
+    return stat;
+}
+
 void iActiveRunnerExt::task_sm(void* runner)
 {
     ETFW_ASSERT(runner != nullptr, "Null runner passed into task_sm");
@@ -133,22 +405,30 @@ void iActiveRunnerExt::task_sm(void* runner)
 
 void iActiveRunnerExt::task_sm_start(iActiveRunnerExt* task)
 {
-    if (State_t::STARTING == task->State)
+    if (State_t::STOP_REQUESTED == task->State)
+    {
+        // Stopped before init ran. Nothing to clean up.
+        task->finish(State_t::STOPPED);
+    }
+    else if (State_t::STARTING == task->State)
     {
         iSvc::RunStatus stat = task->Svc->pre_run_init();
         if (iSvc::RunStatus::OK == stat)
         {
             task->log(LogLevel::INFO,
                 "Task context initialization complete. Starting active runner");
-            task->State = State_t::ACTIVE;
+            // Fails if a stop came in during init. task_sm_finish stops
+            // the service.
+            State_t starting = State_t::STARTING;
+            task->State.compare_exchange_strong(starting, State_t::ACTIVE);
         }
         else if (iSvc::RunStatus::DONE == stat)
         {
-            task->State = State_t::EXITED;
+            task->finish(State_t::EXITED);
         }
         else
         {
-            task->State = State_t::ERROR;
+            task->finish(State_t::ERROR);
         }
     }
 }
@@ -159,12 +439,12 @@ void iActiveRunnerExt::task_sm_run(iActiveRunnerExt* task)
         "ActiveRunner initialization complete. Starting task");
     while (State_t::ACTIVE == task->State)
     {
-        iSvc::RunStatus stat = task->Svc->process();
+        iSvc::RunStatus stat = task->run_once();
         if (iSvc::RunStatus::DONE == stat)
         {
             task->log(LogLevel::INFO,
                 "Service returned DONE. Exiting.");
-            task->stop_children();
+            task->stop_children(true);
 
             stat = task->Svc->post_run_cleanup();
             if (iSvc::RunStatus::OK == stat ||
@@ -172,16 +452,16 @@ void iActiveRunnerExt::task_sm_run(iActiveRunnerExt* task)
             {
                 task->log(LogLevel::INFO,
                     "ActiveRunner exit cleanup complete. Service stopped.");
-                task->State = State_t::EXITED;
+                task->finish(State_t::EXITED);
             }
             else
             {
-                // Failure
+                task->finish(State_t::ERROR);
             }
         }
         else if (iSvc::RunStatus::ERROR == stat)
         {
-            task->State = State_t::ERROR;
+            task->finish(State_t::ERROR);
         }
     }
 }
@@ -193,22 +473,217 @@ void iActiveRunnerExt::task_sm_finish(iActiveRunnerExt* task)
         task->log(LogLevel::INFO,
             "Stop requested. Exiting active runner service");
         task->State = State_t::STOPPING;
-        task->stop_children();
+        task->stop_children(true);
+
+        iSvc::RunStatus stat = task->Svc->post_run_cleanup();
+        if (iSvc::RunStatus::OK == stat ||
+            iSvc::RunStatus::DONE == stat)
+        {
+            task->finish(State_t::STOPPED);
+            task->log(LogLevel::INFO,
+                "Service stopped");
+        }
+        else
+        {
+            task->finish(State_t::ERROR);
+        }
+    }
+}
+
+iEventRunnerExt::iEventRunnerExt(iSvc* svc,
+    Priority_t priority,
+    const StackBuf_t stack_buf,
+    const size_t stack_sz,
+    const CpuMask_t affinity
+):
+    iActiveRunnerExt(svc, priority, stack_buf, stack_sz, affinity),
+    Sleeps(0)
+{}
+
+void iEventRunnerExt::prepare_start()
+{
+    Sources = Svc->event_sources();
+    for (msg::iEventSource* source: Sources)
+    {
+        ETFW_ASSERT(source != nullptr, "Null event source");
+        source->attach(&Event);
+    }
+}
+
+iSvcRunner::RunStatus iEventRunnerExt::stop()
+{
+    RunStatus status = iActiveRunnerExt::stop();
+    Event.notify();
+    return status;
+}
+
+iSvc::RunStatus iEventRunnerExt::run_once()
+{
+    // Anything queued after this is seen by dispatch or wakes the wait
+    const Os::EventCount::Key_t key = Event.prepare_wait();
+    if (State_t::ACTIVE != State)
+    {
+        // Stop requested before the wait was prepared
+        Event.cancel_wait(key);
+        return iSvc::RunStatus::OK;
+    }
+
+    const ExecStats::Mark mark = Exec.begin();
+    const Os::TimeNs_t now = Os::Clock::now_ns();
+    Os::TimeNs_t deadline = Os::TimeNsNever;
+    bool handled = false;
+    for (msg::iEventSource* source: Sources)
+    {
+        handled |= source->dispatch(now);
+        deadline = std::min(deadline, source->deadline_ns());
+    }
+
+    iSvc::RunStatus stat = Svc->process();
+    Exec.end(mark);
+    if (handled || iSvc::RunStatus::OK != stat)
+    {
+        Event.cancel_wait(key);
+    }
+    else
+    {
+        Sleeps.fetch_add(1, std::memory_order_relaxed);
+        Event.wait_until(key, deadline);
+    }
+    return stat;
+}
+
+iFiberRunnerExt::iFiberRunnerExt(iSvc* svc,
+    const StackBuf_t stack_buf,
+    const size_t stack_sz
+):
+    iSvcRunner(svc),
+    StackBuf(stack_buf),
+    StackSz(stack_sz),
+    added_(false)
+{
+    ETFW_ASSERT(stack_buf != nullptr,
+        "Attempt to create fiber runner with null stack buffer");
+    ETFW_ASSERT(stack_sz > 0,
+        "Attempt to create fiber runner with invalid stack size");
+}
 
-        /// TODO: need some sort of wait/async call back for children to stop
-        /// before calling cleanup
+iSvcRunner::RunStatus iFiberRunnerExt::start()
+{
+    RunStatus run_status = RunStatus::ERROR;
+
+    if ((State_t::CREATED == State ||
+        State_t::INITIALIZED == State ||
+        State_t::EXITED == State ||
+        State_t::STOPPED == State ||
+        State_t::ERROR == State) &&
+        Os::Fiber::State::IDLE == fiber_.state())
+    {
+        // The scheduler is created by the first start, after the services
+        // using it, so it is destroyed before them
+        FiberScheduler& sched = FiberScheduler::instance();
+        if (!added_)
+        {
+            sched.add(fiber_);
+            added_ = true;
+        }
+
+        clear_wakes();
+        State = State_t::STARTING;
+        fiber_.init(Os::Fiber::Stack_t(StackBuf, StackSz), fiber_sm, this);
+        if (sched.start())
+        {
+            sched.notify();
+            run_status = RunStatus::OK;
+        }
+        else
+        {
+            finish(State_t::ERROR);
+        }
+    }
+
+    return run_status;
+}
+
+iSvcRunner::RunStatus iFiberRunnerExt::stop()
+{
+    RunStatus status = RunStatus::DONE;
+    // A service still starting is stopped once its init returns
+    if (request_stop())
+    {
+        FiberScheduler::instance().notify();
+        status = RunStatus::OK;
+    }
+    return status;
+}
+
+void iFiberRunnerExt::fiber_sm(void* runner)
+{
+    ETFW_ASSERT(runner != nullptr, "Null runner passed into fiber_sm");
+    iFiberRunnerExt* task = static_cast<iFiberRunnerExt*>(runner);
+
+    if (State_t::STOP_REQUESTED == task->State)
+    {
+        // Stopped before init ran. Nothing to clean up.
+        task->finish(State_t::STOPPED);
+    }
+    else if (State_t::STARTING == task->State)
+    {
+        iSvc::RunStatus stat = task->Svc->pre_run_init();
+        if (iSvc::RunStatus::OK == stat)
+        {
+            State_t starting = State_t::STARTING;
+            task->State.compare_exchange_strong(starting, State_t::ACTIVE);
+        }
+        else if (iSvc::RunStatus::DONE == stat)
+        {
+            task->finish(State_t::EXITED);
+        }
+        else
+        {
+            task->finish(State_t::ERROR);
+        }
+    }
 
+    while (State_t::ACTIVE == task->State)
+    {
+        // Other fibers ran on this thread since the last cycle ended
+        ExecStats::resync();
+        const ExecStats::Mark mark = task->Exec.begin();
+        iSvc::RunStatus stat = task->Svc->process();
+        task->Exec.end(mark);
+        if (iSvc::RunStatus::DONE == stat)
+        {
+            task->log(LogLevel::INFO,
+                "Service returned DONE. Exiting.");
+            task->stop_children(false);
+            task->Svc->post_run_cleanup();
+            task->finish(State_t::EXITED);
+        }
+        else if (iSvc::RunStatus::ERROR == stat)
+        {
+            task->finish(State_t::ERROR);
+        }
+        else
+        {
+            Os::Fiber::yield();
+        }
+    }
+
+    if (State_t::STOP_REQUESTED == task->State)
+    {
+        task->State = State_t::STOPPING;
+        task->stop_children(false);
         iSvc::RunStatus stat = task->Svc->post_run_cleanup();
         if (iSvc::RunStatus::OK == stat ||
             iSvc::RunStatus::DONE == stat)
         {
-            task->State = State_t::STOPPED;
+            task->finish(State_t::STOPPED);
             task->log(LogLevel::INFO,
                 "Service stopped");
         }
         else
         {
-            task->State = State_t::ERROR;
+            task->finish(State_t::ERROR);
         }
     }
 }
@@ -0,0 +1,319 @@
+#include "svcs/SvcPool.hpp"
+#include "etfw_assert.hpp"
+
+using namespace etfw;
+
+/// Worker the calling thread runs, if it is a pool worker
+static thread_local void* tls_worker = nullptr;
+
+SvcPool& SvcPool::instance()
+{
+    static SvcPool pool;
+    return pool;
+}
+
+SvcPool::SvcPool():
+    inject_head_(0),
+    inject_count_(0),
+    num_runners_(0),
+    next_wake_(Os::TimeNsNever),
+    running_(false)
+{
+    auto stat = lock_.init();
+    ETFW_ASSERT(stat.success(), "Failed to initialize service pool lock");
+    for (size_t i = 0; i < NumWorkers; i++)
+    {
+        workers_[i].Pool = this;
+        workers_[i].Idx = i;
+    }
+}
+
+SvcPool::~SvcPool()
+{
+    if (running_.exchange(false))
+    {
+        idle_.notify();
+        for (Worker& worker: workers_)
+        {
+            worker.Thread.join();
+        }
+    }
+}
+
+void SvcPool::add(PooledRunner& runner)
+{
+    lock_.lock();
+    const size_t idx = num_runners_.load(std::memory_order_relaxed);
+    ETFW_ASSERT(idx < MaxSvcs, "Service pool full. Increase SVC_POOL_MAX_SVCS");
+    runners_[idx] = &runner;
+    num_runners_.store(idx + 1, std::memory_order_release);
+    lock_.unlock();
+}
+
+bool SvcPool::start()
+{
+    bool ok = true;
+    lock_.lock();
+    if (!running_.load())
+    {
+        running_.store(true);
+        for (Worker& worker: workers_)
+        {
+            Os::Thread::Config cfg(worker.Stack, SVC_POOL_STACK_SZ,
+                SVC_POOL_PRIORITY, &worker, worker_main);
+            ok &= worker.Thread.start(cfg).success();
+        }
+    }
+    lock_.unlock();
+    return ok;
+}
+
+void SvcPool::schedule(PooledRunner& runner)
+{
+    using Sched_t = PooledRunner::Sched_t;
+    Sched_t sched = runner.Sched.load();
+    while (true)
+    {
+        if (sched == Sched_t::IDLE)
+        {
+            if (runner.Sched.compare_exchange_weak(sched, Sched_t::QUEUED))
+            {
+                enqueue(runner);
+                return;
+            }
+        }
+        else if (sched == Sched_t::RUNNING)
+        {
+            // The worker running it queues it again when it's done
+            if (runner.Sched.compare_exchange_weak(sched, Sched_t::NOTIFIED))
+            {
+                return;
+            }
+        }
+        else
+        {
+            // Already queued or due to be
+            return;
+        }
+    }
+}
+
+SvcPool::Stats SvcPool::worker_stats(const size_t idx) const
+{
+    Stats stats = {0, 0, 0};
+    if (idx < NumWorkers)
+    {
+        const Worker& worker = workers_[idx];
+        stats.Runs = worker.Runs.load(std::memory_order_relaxed);
+        stats.Steals = worker.Steals.load(std::memory_order_relaxed);
+        stats.Sleeps = worker.Sleeps.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+SvcPool::Stats SvcPool::stats() const
+{
+    Stats total = {0, 0, 0};
+    for (size_t i = 0; i < NumWorkers; i++)
+    {
+        const Stats stats = worker_stats(i);
+        total.Runs += stats.Runs;
+        total.Steals += stats.Steals;
+        total.Sleeps += stats.Sleeps;
+    }
+    return total;
+}
+
+void SvcPool::worker_main(void* arg)
+{
+    Worker& worker = *static_cast<Worker*>(arg);
+    SvcPool& pool = *worker.Pool;
+    tls_worker = &worker;
+
+    while (pool.running_.load(std::memory_order_relaxed))
+    {
+        const Os::TimeNs_t now = Os::Clock::now_ns();
+        if (now >= pool.next_wake_.load(std::memory_order_relaxed))
+        {
+            pool.wake_due(now);
+        }
+
+        PooledRunner* runner = pool.take(worker);
+        if (runner != nullptr)
+        {
+            pool.run(worker, *runner);
+            continue;
+        }
+
+        // Anything queued after this is seen by has_work or wakes the wait
+        const Os::EventCount::Key_t key = pool.idle_.prepare_wait();
+        if (!pool.running_.load() || pool.has_work())
+        {
+            pool.idle_.cancel_wait(key);
+            continue;
+        }
+        worker.Sleeps.fetch_add(1, std::memory_order_relaxed);
+        pool.idle_.wait_until(key, pool.next_wake_.load());
+    }
+    tls_worker = nullptr;
+}
+
+PooledRunner* SvcPool::take(Worker& worker)
+{
+    PooledRunner* runner = nullptr;
+
+    // Services that stay runnable keep a worker's deque from emptying.
+    // Check the injection queue now and then so they can't starve it.
+    worker.Takes++;
+    if ((worker.Takes % InjectInterval) == 0)
+    {
+        runner = take_injected();
+        if (runner != nullptr)
+        {
+            return runner;
+        }
+    }
+
+    // Oldest first, so services that stay runnable take turns instead of
+    // the last one pushed running again and again
+    if (worker.Deque.steal(runner))
+    {
+        return runner;
+    }
+
+    runner = take_injected();
+    if (runner != nullptr)
+    {
+        return runner;
+    }
+
+    for (size_t i = 1; i < NumWorkers; i++)
+    {
+        Worker& victim = workers_[(worker.Idx + i) % NumWorkers];
+        if (victim.Deque.steal(runner))
+        {
+            worker.Steals.fetch_add(1, std::memory_order_relaxed);
+            return runner;
+        }
+    }
+    return nullptr;
+}
+
+PooledRunner* SvcPool::take_injected()
+{
+    PooledRunner* runner = nullptr;
+    if (inject_count_.load() > 0)
+    {
+        lock_.lock();
+        if (inject_count_.load(std::memory_order_relaxed) > 0)
+        {
+            runner = inject_[inject_head_];
+            inject_head_ = (inject_head_ + 1) % MaxSvcs;
+            inject_count_.fetch_sub(1);
+        }
+        lock_.unlock();
+    }
+    return runner;
+}
+
+void SvcPool::run(Worker& worker, PooledRunner& runner)
+{
+    using Sched_t = PooledRunner::Sched_t;
+    runner.Sched.store(Sched_t::RUNNING);
+    runner.WakeNs.store(Os::TimeNsNever);
+    const Os::TimeNs_t wake = runner.run_once();
+    worker.Runs.fetch_add(1, std::memory_order_relaxed);
+
+    if (wake == 0)
+    {
+        runner.Sched.store(Sched_t::QUEUED);
+        enqueue(runner);
+        return;
+    }
+
+    if (wake != Os::TimeNsNever)
+    {
+        runner.WakeNs.store(wake);
+        if (lower_next_wake(wake))
+        {
+            // Sleeping workers may be waiting for a later deadline
+            idle_.notify();
+        }
+    }
+
+    Sched_t sched = Sched_t::RUNNING;
+    if (!runner.Sched.compare_exchange_strong(sched, Sched_t::IDLE))
+    {
+        // Notified while running
+        runner.Sched.store(Sched_t::QUEUED);
+        enqueue(runner);
+    }
+}
+
+void SvcPool::enqueue(PooledRunner& runner)
+{
+    Worker* worker = static_cast<Worker*>(tls_worker);
+    if (worker == nullptr || worker->Pool != this || !worker->Deque.push(&runner))
+    {
+        lock_.lock();
+        const size_t count = inject_count_.load(std::memory_order_relaxed);
+        ETFW_ASSERT(count < MaxSvcs, "Service pool injection queue overflow");
+        inject_[(inject_head_ + count) % MaxSvcs] = &runner;
+        inject_count_.fetch_add(1);
+        lock_.unlock();
+    }
+    idle_.notify();
+}
+
+bool SvcPool::has_work() const
+{
+    if (inject_count_.load() > 0)
+    {
+        return true;
+    }
+    for (const Worker& worker: workers_)
+    {
+        if (!worker.Deque.empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SvcPool::wake_due(const Os::TimeNs_t now_ns)
+{
+    // Runners parking meanwhile lower next_wake_ after storing their
+    // deadline, so the scan below sees any deadline this reset drops
+    next_wake_.store(Os::TimeNsNever);
+    const size_t count = num_runners_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++)
+    {
+        PooledRunner& runner = *runners_[i];
+        Os::TimeNs_t wake = runner.WakeNs.load();
+        if (wake <= now_ns)
+        {
+            if (runner.WakeNs.compare_exchange_strong(wake, Os::TimeNsNever))
+            {
+                schedule(runner);
+            }
+        }
+        else if (wake != Os::TimeNsNever)
+        {
+            lower_next_wake(wake);
+        }
+    }
+}
+
+bool SvcPool::lower_next_wake(const Os::TimeNs_t wake_ns)
+{
+    Os::TimeNs_t next = next_wake_.load();
+    while (wake_ns < next)
+    {
+        if (next_wake_.compare_exchange_weak(next, wake_ns))
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -7,14 +7,18 @@ iSvc::iSvc(SvcId_t id, Name_t& name):
     Id(id),
     Name(name),
     IsInit(false),
-    IsStarted(false)
+    IsStarted(false),
+    BuildLvl(LogLevelMin),
+    LogLvl(LogLevelMin)
 {}
 
 iSvc::iSvc(SvcId_t id, const char* name):
     Id(id),
     Name(name),
     IsInit(false),
-    IsStarted(false)
+    IsStarted(false),
+    BuildLvl(LogLevelMin),
+    LogLvl(LogLevelMin)
 {}
 
 iSvc::Status iSvc::init(void)
@@ -98,8 +102,24 @@ iSvc::Status iSvc::cleanup(void)
 
 void iSvc::log(const LogLevel level, const char* format, ...)
 {
+    if (!log_enabled(level))
+    {
+        return;
+    }
     va_list args;
     va_start(args, format);
     EtfLog::log(level, name_raw(), format, args);
     va_end(args);
 }
+
+void iSvc::log(const char* format, ...)
+{
+    if (!log_enabled(LogLevel::INFO))
+    {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    EtfLog::log(LogLevel::INFO, name_raw(), format, args);
+    va_end(args);
+}
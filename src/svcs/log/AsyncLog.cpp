@@ -0,0 +1,327 @@
+#include "svcs/log/AsyncLog.hpp"
+#include "svcs/log/LogArgs.hpp"
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+using namespace etfw;
+
+/// Record kinds
+enum RecordKind : uint8_t
+{
+    PAD,    //< Skips to the end of the ring
+    LOG
+};
+
+/// @brief Start of every record in a ring
+struct RecordHead
+{
+    uint32_t Size;      //< Bytes, arguments included. Multiple of 8.
+    uint8_t Kind;
+    uint8_t Level;
+    uint16_t ArgsSz;    //< Packed arguments bytes. Padding follows.
+};
+
+/// @brief Log record header. The packed arguments (see LogArgs) follow
+///     it.
+struct Record
+{
+    RecordHead Head;
+    Os::TimeNs_t TimeNs;
+    const char* Fmt;
+    char Caller[AsyncLog::CallerSz];
+};
+
+static_assert(sizeof(Record) % 8 == 0, "Log records must keep 8-byte alignment");
+static_assert(sizeof(Record) < AsyncLog::RecordSz, "Log records must have room for arguments");
+static_assert((AsyncLog::RecordSz % 8) == 0, "Log records must keep 8-byte alignment");
+static_assert(AsyncLog::RecordSz <= UINT16_MAX, "Log record arguments must fit ArgsSz");
+
+AsyncLog::ThreadRing::~ThreadRing()
+{
+    if (R != nullptr)
+    {
+        // A drained ring can be reused at once. Otherwise the logger
+        // thread frees it after writing what is left.
+        const bool drained = R->Head.load(std::memory_order_acquire) ==
+            R->Tail.load(std::memory_order_relaxed);
+        R->Claim.store(drained ? Ring::FREE : Ring::ORPHANED, std::memory_order_release);
+        R = nullptr;
+    }
+}
+
+AsyncLog::AsyncLog(const Sink_t sink):
+    Sink(sink),
+    NoRing(0),
+    NoRingReported(0),
+    Running(false)
+{
+    Os::Thread::Config cfg(Stack, ETF_ASYNC_LOG_STACK_SZ, 0, this, &AsyncLog::logger_main);
+    Running.store(true, std::memory_order_release);
+    if (!Thread.start(cfg).success())
+    {
+        Running.store(false, std::memory_order_release);
+    }
+}
+
+AsyncLog::~AsyncLog()
+{
+    if (Running.exchange(false, std::memory_order_acq_rel))
+    {
+        Wake.notify();
+        Thread.join();
+    }
+}
+
+void AsyncLog::log(ThreadRing& thread_ring, const LogLevel level, const char* caller,
+    const char* fmt, va_list args)
+{
+    alignas(8) uint8_t buf[RecordSz];
+    Record* rec = new (buf) Record;
+    rec->Head.Kind = LOG;
+    rec->Head.Level = static_cast<uint8_t>(level);
+    rec->TimeNs = Os::Clock::now_ns();
+    rec->Fmt = fmt;
+    size_t i = 0;
+    if (caller != nullptr)
+    {
+        for (; (i + 1) < CallerSz && caller[i] != '\0'; i++)
+        {
+            rec->Caller[i] = caller[i];
+        }
+    }
+    rec->Caller[i] = '\0';
+
+    va_list fmt_args;
+    va_copy(fmt_args, args);
+    const size_t args_sz = LogArgs::pack(fmt, fmt_args, buf + sizeof(Record), RecordSz - sizeof(Record));
+    va_end(fmt_args);
+    rec->Head.ArgsSz = static_cast<uint16_t>(args_sz);
+    rec->Head.Size = static_cast<uint32_t>((sizeof(Record) + args_sz + 7) & ~size_t(7));
+
+    if (!Running.load(std::memory_order_acquire))
+    {
+        emit(rec);
+        return;
+    }
+
+    Ring* ring = thread_ring.R;
+    if (ring == nullptr)
+    {
+        ring = claim();
+        if (ring == nullptr)
+        {
+            NoRing.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        thread_ring.R = ring;
+    }
+    push(*ring, rec, rec->Head.Size);
+}
+
+AsyncLog::Ring* AsyncLog::claim()
+{
+    for (Ring& ring: Rings)
+    {
+        uint8_t expected = Ring::FREE;
+        if (ring.Claim.compare_exchange_strong(expected, Ring::OWNED, std::memory_order_acq_rel))
+        {
+            return &ring;
+        }
+    }
+    return nullptr;
+}
+
+bool AsyncLog::push(Ring& ring, const void* rec, const size_t sz)
+{
+    const size_t tail = ring.Tail.load(std::memory_order_relaxed);
+    const size_t head = ring.Head.load(std::memory_order_acquire);
+    const size_t used = tail - head;
+    const size_t offset = tail & (RingSz - 1);
+
+    // Records don't wrap. Skip the end of the ring if this one won't fit.
+    const size_t pad = ((RingSz - offset) < sz) ? (RingSz - offset) : 0;
+    if ((used + pad + sz) > RingSz)
+    {
+        ring.Dropped.store(ring.Dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (pad != 0)
+    {
+        RecordHead skip = {static_cast<uint32_t>(pad), PAD, 0, 0};
+        std::memcpy(&ring.Buf[offset], &skip, sizeof(skip));
+    }
+    std::memcpy(&ring.Buf[(tail + pad) & (RingSz - 1)], rec, sz);
+    const size_t new_tail = tail + pad + sz;
+    ring.Tail.store(new_tail, std::memory_order_release);
+    ring.Logged.store(ring.Logged.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    // The logger thread only polls, unless a ring is filling up
+    if (used < (RingSz / 2) && (new_tail - head) >= (RingSz / 2))
+    {
+        Wake.notify();
+    }
+    return true;
+}
+
+size_t AsyncLog::drain()
+{
+    char line[ETF_MAX_LOG_MSG_SZ];
+    for (Ring& ring: Rings)
+    {
+        const uint64_t dropped = ring.Dropped.load(std::memory_order_relaxed);
+        if (dropped != ring.Reported)
+        {
+            const Os::TimeNs_t now = Os::Clock::now_ns();
+            char msg[64];
+            std::snprintf(msg, sizeof(msg), "Dropped %llu log messages on a full ring",
+                static_cast<unsigned long long>(dropped - ring.Reported));
+            std::snprintf(line, sizeof(line), ETF_ASYNC_LOG_FMT,
+                static_cast<unsigned long long>(now / Os::NsPerSec),
+                static_cast<unsigned long long>((now % Os::NsPerSec) / 1000),
+                "ASYNC_LOG", log_lvl_to_str(LogLevel::WARNING), msg);
+            Sink(LogLevel::WARNING, line);
+            ring.Reported = dropped;
+        }
+    }
+    const uint64_t no_ring = NoRing.load(std::memory_order_relaxed);
+    if (no_ring != NoRingReported)
+    {
+        const Os::TimeNs_t now = Os::Clock::now_ns();
+        char msg[64];
+        std::snprintf(msg, sizeof(msg), "Dropped %llu log messages with no free ring",
+            static_cast<unsigned long long>(no_ring - NoRingReported));
+        std::snprintf(line, sizeof(line), ETF_ASYNC_LOG_FMT,
+            static_cast<unsigned long long>(now / Os::NsPerSec),
+            static_cast<unsigned long long>((now % Os::NsPerSec) / 1000),
+            "ASYNC_LOG", log_lvl_to_str(LogLevel::WARNING), msg);
+        Sink(LogLevel::WARNING, line);
+        NoRingReported = no_ring;
+    }
+
+    // Merge the rings, oldest record first
+    size_t count = 0;
+    while (true)
+    {
+        Ring* oldest = nullptr;
+        const Record* oldest_rec = nullptr;
+        for (Ring& ring: Rings)
+        {
+            if (ring.Claim.load(std::memory_order_acquire) == Ring::FREE)
+            {
+                continue;
+            }
+
+            size_t head = ring.Head.load(std::memory_order_relaxed);
+            const size_t tail = ring.Tail.load(std::memory_order_acquire);
+            while (head != tail)
+            {
+                const RecordHead* rec_head =
+                    reinterpret_cast<const RecordHead*>(&ring.Buf[head & (RingSz - 1)]);
+                if (rec_head->Kind != PAD)
+                {
+                    break;
+                }
+                head += rec_head->Size;
+                ring.Head.store(head, std::memory_order_release);
+            }
+            if (head == tail)
+            {
+                continue;
+            }
+
+            const Record* rec = reinterpret_cast<const Record*>(&ring.Buf[head & (RingSz - 1)]);
+            if (oldest == nullptr || rec->TimeNs < oldest_rec->TimeNs)
+            {
+                oldest = &ring;
+                oldest_rec = rec;
+            }
+        }
+
+        if (oldest == nullptr)
+        {
+            break;
+        }
+        emit(oldest_rec);
+        oldest->Head.store(oldest->Head.load(std::memory_order_relaxed) + oldest_rec->Head.Size,
+            std::memory_order_release);
+        count++;
+    }
+
+    // Free the rings of exited threads
+    for (Ring& ring: Rings)
+    {
+        if (ring.Claim.load(std::memory_order_acquire) == Ring::ORPHANED &&
+            ring.Head.load(std::memory_order_relaxed) == ring.Tail.load(std::memory_order_acquire))
+        {
+            ring.Claim.store(Ring::FREE, std::memory_order_release);
+        }
+    }
+
+    return count;
+}
+
+void AsyncLog::emit(const void* data)
+{
+    const Record* rec = static_cast<const Record*>(data);
+    char msg[ETF_MAX_LOG_MSG_SZ];
+    LogArgs::format(rec->Fmt, reinterpret_cast<const uint8_t*>(rec + 1), rec->Head.ArgsSz,
+        msg, sizeof(msg));
+
+    const LogLevel level = static_cast<LogLevel>(rec->Head.Level);
+    char line[ETF_MAX_LOG_MSG_SZ + ETF_ASYNC_LOG_CALLER_SZ + 48];
+    std::snprintf(line, sizeof(line), ETF_ASYNC_LOG_FMT,
+        static_cast<unsigned long long>(rec->TimeNs / Os::NsPerSec),
+        static_cast<unsigned long long>((rec->TimeNs % Os::NsPerSec) / 1000),
+        rec->Caller, log_lvl_to_str(level), msg);
+    Sink(level, line);
+}
+
+void AsyncLog::flush()
+{
+    size_t tails[NumRings];
+    for (size_t i = 0; i < NumRings; i++)
+    {
+        tails[i] = Rings[i].Tail.load(std::memory_order_acquire);
+    }
+    Wake.notify();
+
+    for (size_t i = 0; i < NumRings; i++)
+    {
+        while (Running.load(std::memory_order_acquire) &&
+            Rings[i].Head.load(std::memory_order_acquire) < tails[i])
+        {
+            Os::Clock::sleep_until(Os::Clock::now_ns() + (Os::NsPerMs / 10));
+        }
+    }
+}
+
+AsyncLog::Stats AsyncLog::stats() const
+{
+    Stats stats = {0, 0, NoRing.load(std::memory_order_relaxed)};
+    for (const Ring& ring: Rings)
+    {
+        stats.Logged += ring.Logged.load(std::memory_order_relaxed);
+        stats.Dropped += ring.Dropped.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void AsyncLog::logger_main(void* log)
+{
+    AsyncLog& self = *static_cast<AsyncLog*>(log);
+    while (self.Running.load(std::memory_order_acquire))
+    {
+        const Os::EventCount::Key_t key = self.Wake.prepare_wait();
+        if (self.drain() == 0)
+        {
+            self.Wake.wait(key, ETF_ASYNC_LOG_PERIOD_MS);
+        }
+        else
+        {
+            self.Wake.cancel_wait(key);
+        }
+    }
+    self.drain();
+}
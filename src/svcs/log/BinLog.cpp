@@ -0,0 +1,625 @@
+#include "svcs/log/BinLog.hpp"
+#include "svcs/log/LogArgs.hpp"
+#include <cstring>
+
+using namespace etfw;
+
+/// Largest LOG record: tag, four varints and the arguments
+static constexpr size_t LogRecordMax = 1 + (4 * LogArgs::VarintMaxSz) + BinLogFormat::ArgsSz;
+
+/// Largest FMT or CALLER record: tag, two varints and the string
+static constexpr size_t DefRecordMax = 1 + (2 * LogArgs::VarintMaxSz) + BinLogFormat::FmtLenMax;
+
+/// Room a log call reserves: its record, and a format and caller to define
+static constexpr size_t LogRoomMax = LogRecordMax + (2 * DefRecordMax);
+
+static_assert(BinLogFormat::HeadSz == 32, "Binary log block header layout changed");
+static_assert((BinLogFormat::HeadSz + LogRoomMax) <= BinLogFormat::BlockSz,
+    "Binary log blocks must hold the largest records");
+static_assert(BinLogFormat::CallerSz > 1, "Binary log callers need room for a name");
+
+/// @brief Caller name length as stored
+static inline size_t caller_len(const char* caller)
+{
+    size_t len = 0;
+    while (len < (BinLogFormat::CallerSz - 1) && caller[len] != '\0')
+    {
+        len++;
+    }
+    return len;
+}
+
+//
+// BinLog
+//
+
+BinLog::BinLog():
+    Open(false),
+    FlushNs(0),
+    Used(BinLogFormat::HeadSz),
+    BlockRecords(0),
+    Seq(0),
+    BaseNs(0),
+    LastNs(0),
+    FirstNs(0),
+    NumSealed(0),
+    NumWritten(0),
+    Full{},
+    Counts{},
+    Running(false),
+    NumFmts(0),
+    NumCallers(0),
+    Block(Blocks[0])
+{
+    Lock.init();
+    IoLock.init();
+    Os::Thread::Config cfg(Stack, ETF_BIN_LOG_STACK_SZ, 0, this, &BinLog::flusher_main);
+    Running.store(true, std::memory_order_release);
+    if (!Thread.start(cfg).success())
+    {
+        Running.store(false, std::memory_order_release);
+    }
+}
+
+BinLog::~BinLog()
+{
+    if (Running.exchange(false, std::memory_order_acq_rel))
+    {
+        Wake.notify();
+        Thread.join();
+    }
+    close();
+}
+
+BinLog::Status BinLog::open(const char* path, const uint32_t flush_ms)
+{
+    close();
+    IoLock.lock();
+    Status status = File.open(path, Os::File::OPEN_CREATE, Os::File::OVERWRITE);
+    if (status.success())
+    {
+        Lock.lock();
+        Open = true;
+        FlushNs = static_cast<Os::TimeNs_t>(flush_ms) * Os::NsPerMs;
+        Seq = 0;
+        NumSealed = 0;
+        NumWritten = 0;
+        Block = Blocks[0];
+        reset(Os::Clock::now_ns());
+        Lock.unlock();
+    }
+    IoLock.unlock();
+    // The flusher waits out the old flush period otherwise
+    Wake.notify();
+    return status;
+}
+
+BinLog::Status BinLog::close()
+{
+    IoLock.lock();
+    Status status = service(true);
+    Lock.lock();
+    // Records logged since service ran are dropped
+    Counts.Dropped += BlockRecords;
+    Used = BinLogFormat::HeadSz;
+    BlockRecords = 0;
+    Open = false;
+    Lock.unlock();
+    File.close();
+    IoLock.unlock();
+    return status;
+}
+
+BinLog::Status BinLog::flush()
+{
+    IoLock.lock();
+    Lock.lock();
+    const bool open = Open;
+    Lock.unlock();
+    Status status = open ? service(true) : Status(Status::Code::NOT_OPENED);
+    IoLock.unlock();
+    return status;
+}
+
+void BinLog::log(const LogLevel level, const char* caller, const char* fmt, va_list args)
+{
+    // Packing is the bulk of the work, so it stays outside the lock
+    uint8_t packed[BinLogFormat::ArgsSz];
+    va_list fmt_args;
+    va_copy(fmt_args, args);
+    size_t packed_sz = LogArgs::pack(fmt, fmt_args, packed, sizeof(packed));
+    va_end(fmt_args);
+
+    bool added = false;
+    bool sealed = false;
+    Lock.lock();
+    const Os::TimeNs_t now = Os::Clock::now_ns();
+    if (reserve(now, sealed))
+    {
+        uint16_t fmt_ref = fmt_id(fmt);
+        if (fmt_ref == NoId)
+        {
+            // Format registry full. Log the text under "%s".
+            char msg[ETF_MAX_LOG_MSG_SZ];
+            const size_t len = LogArgs::format(fmt, packed, packed_sz, msg, sizeof(msg));
+            packed_sz = LogArgs::put_varint(len, packed, sizeof(packed));
+            std::memcpy(packed + packed_sz, msg, len);
+            packed_sz += len;
+            fmt_ref = 0;
+        }
+        const uint16_t caller_ref = caller_id((caller != nullptr) ? caller : "");
+
+        const size_t start = Used;
+        Block[Used++] = static_cast<uint8_t>((BinLogFormat::LOG << 4) | static_cast<uint8_t>(level));
+        put_varint(now - LastNs);
+        put_varint(fmt_ref);
+        put_varint(caller_ref);
+        put_varint(packed_sz);
+        put(packed, packed_sz);
+        LastNs = now;
+        if (BlockRecords == 0)
+        {
+            FirstNs = now;
+        }
+        BlockRecords++;
+        Counts.Records++;
+        Counts.Bytes += Used - start;
+        added = true;
+    }
+    if (!added)
+    {
+        Counts.Dropped++;
+    }
+    Lock.unlock();
+
+    if (sealed)
+    {
+        if (Running.load(std::memory_order_acquire))
+        {
+            Wake.notify();
+        }
+        else
+        {
+            // No flusher. Write the block here.
+            IoLock.lock();
+            service(false);
+            IoLock.unlock();
+        }
+    }
+}
+
+BinLog::Stats BinLog::stats()
+{
+    Lock.lock();
+    const Stats counts = Counts;
+    Lock.unlock();
+    return counts;
+}
+
+void BinLog::reset(const Os::TimeNs_t now)
+{
+    for (size_t i = 0; i < FmtSlots; i++)
+    {
+        FmtKeys[i] = nullptr;
+    }
+    for (size_t i = 0; i < CallerSlots; i++)
+    {
+        CallerIds[i] = 0;
+    }
+    Used = BinLogFormat::HeadSz;
+    BlockRecords = 0;
+    BaseNs = now;
+    LastNs = now;
+
+    // Fallbacks for full registries. Format 0 is never looked up by
+    // address, so it takes no slot.
+    NumFmts = 1;
+    NumCallers = 0;
+    define(BinLogFormat::FMT, 0, "%s", 2);
+    caller_id("");
+}
+
+bool BinLog::reserve(const Os::TimeNs_t now, bool& sealed)
+{
+    if (!Open)
+    {
+        return false;
+    }
+    if ((Used + LogRoomMax) > BinLogFormat::BlockSz)
+    {
+        if ((NumSealed - NumWritten) >= (NumBlocks - 1))
+        {
+            // Every other block waits for the flusher
+            return false;
+        }
+        seal(now);
+        sealed = true;
+    }
+    return true;
+}
+
+void BinLog::seal(const Os::TimeNs_t now)
+{
+    Full[NumSealed % NumBlocks] = {Used, BlockRecords, Seq, BaseNs};
+    NumSealed++;
+    Block = Blocks[NumSealed % NumBlocks];
+    Seq++;
+    Used = BinLogFormat::HeadSz;
+    BlockRecords = 0;
+    BaseNs = now;
+    LastNs = now;
+}
+
+bool BinLog::write_sealed(Status& status)
+{
+    Lock.lock();
+    if (NumWritten == NumSealed)
+    {
+        Lock.unlock();
+        return false;
+    }
+    uint8_t* const block = Blocks[NumWritten % NumBlocks];
+    const Sealed full = Full[NumWritten % NumBlocks];
+    Lock.unlock();
+
+    // Logging threads don't touch a sealed block
+    BinLogFormat::BlockHead head;
+    head.Magic = BinLogFormat::Magic;
+    head.Version = BinLogFormat::Version;
+    head.HeadSz = static_cast<uint16_t>(BinLogFormat::HeadSz);
+    head.BlockSz = static_cast<uint32_t>(BinLogFormat::BlockSz);
+    head.Used = static_cast<uint32_t>(full.Used - BinLogFormat::HeadSz);
+    head.Seq = full.Seq;
+    head.BaseNs = full.BaseNs;
+    std::memcpy(block, &head, sizeof(head));
+    std::memset(block + full.Used, 0, BinLogFormat::BlockSz - full.Used);
+
+    status = Status::Code::OK;
+    size_t written = 0;
+    while (written < BinLogFormat::BlockSz)
+    {
+        size_t sz = BinLogFormat::BlockSz - written;
+        status = File.write(block + written, sz);
+        if (!status.success())
+        {
+            break;
+        }
+        if (sz == 0)
+        {
+            status = Status::Code::OTHER_ERROR;
+            break;
+        }
+        written += sz;
+    }
+
+    Lock.lock();
+    NumWritten++;
+    if (status.success())
+    {
+        Counts.Blocks++;
+    }
+    else
+    {
+        // Later blocks could refer to definitions this one held
+        Counts.Dropped += full.Records + BlockRecords;
+        while (NumWritten != NumSealed)
+        {
+            Counts.Dropped += Full[NumWritten % NumBlocks].Records;
+            NumWritten++;
+        }
+        Used = BinLogFormat::HeadSz;
+        BlockRecords = 0;
+        Open = false;
+    }
+    Lock.unlock();
+    if (!status.success())
+    {
+        File.close();
+    }
+    return status.success();
+}
+
+BinLog::Status BinLog::service(const bool all)
+{
+    Status status = Status::Code::OK;
+    Status last = Status::Code::OK;
+    // A second pass takes the current block if every other one was full
+    for (int pass = 0; pass < 2; pass++)
+    {
+        Lock.lock();
+        const Os::TimeNs_t now = Os::Clock::now_ns();
+        const bool due = all ||
+            (FlushNs != 0 && BlockRecords != 0 && (now - FirstNs) >= FlushNs);
+        if (Open && due && Used > BinLogFormat::HeadSz &&
+            (NumSealed - NumWritten) < (NumBlocks - 1))
+        {
+            seal(now);
+        }
+        Lock.unlock();
+
+        while (write_sealed(last))
+        {
+        }
+        status = last.success() ? status : last;
+    }
+    return status;
+}
+
+void BinLog::flusher_main(void* log)
+{
+    BinLog& self = *static_cast<BinLog*>(log);
+    while (self.Running.load(std::memory_order_acquire))
+    {
+        const Os::EventCount::Key_t key = self.Wake.prepare_wait();
+        self.Lock.lock();
+        const bool full = self.NumSealed != self.NumWritten;
+        const Os::TimeNs_t flush_ns = self.Open ? self.FlushNs : 0;
+        self.Lock.unlock();
+        if (full)
+        {
+            self.Wake.cancel_wait(key);
+        }
+        else if (flush_ns != 0)
+        {
+            self.Wake.wait(key, static_cast<Os::TimeMs_t>(flush_ns / Os::NsPerMs));
+        }
+        else
+        {
+            self.Wake.wait(key);
+        }
+
+        self.IoLock.lock();
+        self.service(false);
+        self.IoLock.unlock();
+    }
+}
+
+void BinLog::define(const uint8_t kind, const uint16_t id, const char* str, const size_t len)
+{
+    const size_t start = Used;
+    Block[Used++] = static_cast<uint8_t>(kind << 4);
+    put_varint(id);
+    put_varint(len);
+    put(str, len);
+    Counts.Bytes += Used - start;
+}
+
+uint16_t BinLog::fmt_id(const char* fmt)
+{
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(fmt);
+    size_t slot = static_cast<size_t>(((addr ^ (addr >> 17)) * 0x9E3779B97F4A7C15ull) >> 32) % FmtSlots;
+    while (FmtKeys[slot] != nullptr)
+    {
+        if (FmtKeys[slot] == fmt)
+        {
+            return FmtIds[slot];
+        }
+        slot = (slot + 1) % FmtSlots;
+    }
+    if (NumFmts >= BinLogFormat::NumFmts)
+    {
+        return NoId;
+    }
+
+    const uint16_t id = static_cast<uint16_t>(NumFmts++);
+    FmtKeys[slot] = fmt;
+    FmtIds[slot] = id;
+    const size_t len = strnlen(fmt, BinLogFormat::FmtLenMax);
+    define(BinLogFormat::FMT, id, fmt, len);
+    return id;
+}
+
+uint16_t BinLog::caller_id(const char* caller)
+{
+    const size_t len = caller_len(caller);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(caller[i])) * 16777619u;
+    }
+
+    size_t slot = hash % CallerSlots;
+    while (CallerIds[slot] != 0)
+    {
+        const char* name = Callers[CallerIds[slot] - 1];
+        if (std::strncmp(name, caller, len) == 0 && name[len] == '\0')
+        {
+            return static_cast<uint16_t>(CallerIds[slot] - 1);
+        }
+        slot = (slot + 1) % CallerSlots;
+    }
+    if (NumCallers >= BinLogFormat::NumCallers)
+    {
+        return 0;
+    }
+
+    const uint16_t id = static_cast<uint16_t>(NumCallers++);
+    std::memcpy(Callers[id], caller, len);
+    Callers[id][len] = '\0';
+    CallerIds[slot] = static_cast<uint16_t>(id + 1);
+    define(BinLogFormat::CALLER, id, caller, len);
+    return id;
+}
+
+inline void BinLog::put(const void* data, const size_t sz)
+{
+    std::memcpy(Block + Used, data, sz);
+    Used += sz;
+}
+
+inline void BinLog::put_varint(const uint64_t val)
+{
+    Used += LogArgs::put_varint(val, Block + Used, BinLogFormat::BlockSz - Used);
+}
+
+//
+// BinLogReader
+//
+
+BinLogReader::BinLogReader():
+    Open(false),
+    Corrupt(false),
+    Pos(0),
+    End(0),
+    Seq(0),
+    LastNs(0),
+    NumFmts(0),
+    NumCallers(0),
+    StringsUsed(0)
+{
+}
+
+BinLogReader::Status BinLogReader::open(const char* path)
+{
+    close();
+    Status status = File.open(path, Os::File::OPEN_READ, Os::File::NO_OVERWRITE);
+    if (status.success())
+    {
+        Open = true;
+        Corrupt = false;
+        Pos = 0;
+        End = 0;
+        Seq = 0;
+        LastNs = 0;
+        NumFmts = 0;
+        NumCallers = 0;
+        StringsUsed = 0;
+    }
+    return status;
+}
+
+void BinLogReader::close()
+{
+    if (Open)
+    {
+        File.close();
+        Open = false;
+    }
+}
+
+bool BinLogReader::next(Entry& entry)
+{
+    while (Open && !Corrupt)
+    {
+        if (Pos >= End)
+        {
+            if (!load_block())
+            {
+                return false;
+            }
+            continue;
+        }
+
+        const uint8_t tag = Block[Pos++];
+        const uint8_t kind = tag >> 4;
+        if (kind == BinLogFormat::FMT || kind == BinLogFormat::CALLER)
+        {
+            if (!define(kind))
+            {
+                Corrupt = true;
+            }
+            continue;
+        }
+
+        uint64_t delta = 0;
+        uint64_t fmt = 0;
+        uint64_t caller = 0;
+        uint64_t args_sz = 0;
+        const uint8_t level = tag & 0x0F;
+        if (kind != BinLogFormat::LOG || level > static_cast<uint8_t>(LogLevel::CRITICAL) ||
+            !get_varint(delta) || !get_varint(fmt) || !get_varint(caller) ||
+            !get_varint(args_sz) || fmt >= NumFmts || caller >= NumCallers ||
+            args_sz > (End - Pos))
+        {
+            Corrupt = true;
+            continue;
+        }
+
+        LastNs += delta;
+        entry.TimeNs = LastNs;
+        entry.Level = static_cast<LogLevel>(level);
+        entry.Fmt = Fmts[fmt];
+        entry.Caller = Callers[caller];
+        LogArgs::format(entry.Fmt, Block + Pos, static_cast<size_t>(args_sz),
+            entry.Msg, sizeof(entry.Msg));
+        Pos += static_cast<size_t>(args_sz);
+        return true;
+    }
+    return false;
+}
+
+bool BinLogReader::load_block()
+{
+    size_t got = 0;
+    while (got < BinLogFormat::BlockSz)
+    {
+        size_t sz = BinLogFormat::BlockSz - got;
+        if (!File.read(Block + got, sz).success())
+        {
+            Corrupt = true;
+            return false;
+        }
+        if (sz == 0)
+        {
+            break;
+        }
+        got += sz;
+    }
+    if (got == 0)
+    {
+        return false;
+    }
+
+    BinLogFormat::BlockHead head;
+    std::memcpy(&head, Block, sizeof(head));
+    if (got != BinLogFormat::BlockSz || head.Magic != BinLogFormat::Magic ||
+        head.Version != BinLogFormat::Version || head.HeadSz != BinLogFormat::HeadSz ||
+        head.BlockSz != BinLogFormat::BlockSz ||
+        head.Used > (BinLogFormat::BlockSz - BinLogFormat::HeadSz) || head.Seq != Seq)
+    {
+        Corrupt = true;
+        return false;
+    }
+    Pos = BinLogFormat::HeadSz;
+    End = BinLogFormat::HeadSz + head.Used;
+    LastNs = head.BaseNs;
+    Seq++;
+    return true;
+}
+
+bool BinLogReader::get_varint(uint64_t& val)
+{
+    const size_t sz = LogArgs::get_varint(Block + Pos, End - Pos, val);
+    Pos += sz;
+    return sz != 0;
+}
+
+bool BinLogReader::define(const uint8_t kind)
+{
+    uint64_t id = 0;
+    uint64_t len = 0;
+    const bool fmt = (kind == BinLogFormat::FMT);
+    const size_t count = fmt ? NumFmts : NumCallers;
+    const size_t cap = fmt ? BinLogFormat::NumFmts : BinLogFormat::NumCallers;
+    const size_t len_max = fmt ? BinLogFormat::FmtLenMax : (BinLogFormat::CallerSz - 1);
+    if (!get_varint(id) || !get_varint(len) || id != count || count >= cap ||
+        len > len_max || len > (End - Pos))
+    {
+        return false;
+    }
+
+    char* str = Strings + StringsUsed;
+    std::memcpy(str, Block + Pos, static_cast<size_t>(len));
+    str[len] = '\0';
+    StringsUsed += static_cast<size_t>(len) + 1;
+    Pos += static_cast<size_t>(len);
+    if (fmt)
+    {
+        Fmts[NumFmts++] = str;
+    }
+    else
+    {
+        Callers[NumCallers++] = str;
+    }
+    return true;
+}
@@ -0,0 +1,332 @@
+#include "svcs/log/FileLog.hpp"
+#include <cstdio>
+#include <cstring>
+
+using namespace etfw;
+
+/// Rotated file name: path, '.', number
+static constexpr size_t RotatedPathSz = FileLog::PathSz + 12;
+
+FileLog::FileLog():
+    Cfg(),
+    Path{},
+    Open(false),
+    Active(0),
+    Used{0, 0},
+    FileSz(0),
+    OpenedNs(0),
+    SyncedNs(0),
+    Dirty(false),
+    Reported(0),
+    Opens(0),
+    Counts{},
+    Running(false)
+{
+    Lock.init();
+    IoLock.init();
+    Os::Thread::Config cfg(Stack, ETF_FILE_LOG_STACK_SZ, 0, this, &FileLog::flusher_main);
+    Running.store(true, std::memory_order_release);
+    if (!Thread.start(cfg).success())
+    {
+        Running.store(false, std::memory_order_release);
+    }
+}
+
+FileLog::~FileLog()
+{
+    if (Running.exchange(false, std::memory_order_acq_rel))
+    {
+        Wake.notify();
+        Thread.join();
+    }
+    close();
+}
+
+FileLog::Status FileLog::open(const Config& cfg)
+{
+    close();
+    if (cfg.Path == nullptr || strnlen(cfg.Path, PathSz) >= PathSz)
+    {
+        return Status::Code::INVALID_ARGUMENT;
+    }
+
+    IoLock.lock();
+    Lock.lock();
+    Cfg = cfg;
+    std::strcpy(Path, cfg.Path);
+    Cfg.Path = Path;
+    Lock.unlock();
+    Status status = File.open(Path, Os::File::OPEN_APPEND, Os::File::NO_OVERWRITE);
+    if (status.success())
+    {
+        if (!File.size(FileSz).success())
+        {
+            FileSz = 0;
+        }
+        OpenedNs = Os::Clock::now_ns();
+        SyncedNs = OpenedNs;
+        Dirty = false;
+
+        Lock.lock();
+        Open = true;
+        Used[0] = 0;
+        Used[1] = 0;
+        Reported = Counts.Dropped;
+        Opens++;
+        Lock.unlock();
+    }
+    IoLock.unlock();
+    // The flusher waits out the old flush period otherwise
+    Wake.notify();
+    return status;
+}
+
+FileLog::Status FileLog::close()
+{
+    IoLock.lock();
+    const Status status = service(true);
+    Lock.lock();
+    const bool was_open = Open;
+    Open = false;
+    Lock.unlock();
+    if (was_open)
+    {
+        File.close();
+    }
+    IoLock.unlock();
+    return status;
+}
+
+void FileLog::write(const char* line)
+{
+    const size_t len = std::strlen(line);
+    bool wake = false;
+    Lock.lock();
+    size_t& used = Used[Active];
+    if (!Open || (used + len + 1) > BufSz)
+    {
+        Counts.Dropped++;
+        wake = Open;
+    }
+    else
+    {
+        std::memcpy(&Bufs[Active][used], line, len);
+        Bufs[Active][used + len] = '\n';
+        // The flusher only polls, unless the buffer is filling up
+        wake = (used < (BufSz / 2)) && ((used + len + 1) >= (BufSz / 2));
+        used += len + 1;
+        Counts.Lines++;
+    }
+    Lock.unlock();
+    if (wake)
+    {
+        Wake.notify();
+    }
+}
+
+FileLog::Status FileLog::flush()
+{
+    IoLock.lock();
+    const Status status = service(true);
+    IoLock.unlock();
+    return status;
+}
+
+FileLog::Stats FileLog::stats()
+{
+    Lock.lock();
+    const Stats counts = Counts;
+    Lock.unlock();
+    return counts;
+}
+
+FileLog::Status FileLog::service(const bool sync)
+{
+    // Take the full buffer. Lines go to the other one while it is written.
+    Lock.lock();
+    if (!Open)
+    {
+        Lock.unlock();
+        return Status::Code::OK;
+    }
+    const uint8_t out = Active;
+    const size_t sz = Used[out];
+    const uint64_t dropped = Counts.Dropped - Reported;
+    if (sz != 0)
+    {
+        Active ^= 1;
+        Used[Active] = 0;
+    }
+    Reported += dropped;
+    Lock.unlock();
+
+    Status status = Status::Code::OK;
+    const Os::TimeNs_t now = Os::Clock::now_ns();
+    if (sz != 0)
+    {
+        if (Cfg.RotateSz != 0 && FileSz != 0 && (FileSz + sz) > Cfg.RotateSz)
+        {
+            status = rotate(now);
+        }
+        if (status.success())
+        {
+            status = write_out(Bufs[out], sz);
+        }
+    }
+    if (dropped != 0 && status.success())
+    {
+        char msg[64];
+        std::snprintf(msg, sizeof(msg), "Dropped %llu log lines on a full buffer",
+            static_cast<unsigned long long>(dropped));
+        char line[128];
+        const int len = std::snprintf(line, sizeof(line), ETF_LOG_FMT "\n", "FILE_LOG",
+            log_lvl_to_str(LogLevel::WARNING), msg);
+        status = write_out(reinterpret_cast<uint8_t*>(line), static_cast<size_t>(len));
+    }
+
+    if (Cfg.RotateSec != 0 && FileSz != 0 && (now - OpenedNs) >= (Cfg.RotateSec * Os::NsPerSec))
+    {
+        const Status rotated = rotate(now);
+        status = status.success() ? rotated : status;
+    }
+    if (Dirty && (sync || (now - SyncedNs) >= (Cfg.SyncMs * Os::NsPerMs)))
+    {
+        const Status synced = File.sync();
+        Lock.lock();
+        if (synced.success())
+        {
+            Counts.Syncs++;
+            Dirty = false;
+        }
+        else
+        {
+            Counts.Errors++;
+        }
+        Lock.unlock();
+        SyncedNs = now;
+        status = status.success() ? synced : status;
+    }
+    return status;
+}
+
+FileLog::Status FileLog::write_out(uint8_t* data, const size_t sz)
+{
+    Status status = Status::Code::OK;
+    size_t written = 0;
+    while (written < sz)
+    {
+        size_t chunk = sz - written;
+        status = File.write(data + written, chunk);
+        if (!status.success())
+        {
+            break;
+        }
+        if (chunk == 0)
+        {
+            status = Status::Code::OTHER_ERROR;
+            break;
+        }
+        written += chunk;
+    }
+    FileSz += written;
+    if (written != 0)
+    {
+        Dirty = true;
+    }
+    Lock.lock();
+    Counts.Bytes += written;
+    if (status.success())
+    {
+        Counts.Writes++;
+    }
+    else
+    {
+        Counts.Errors++;
+    }
+    Lock.unlock();
+    return status;
+}
+
+FileLog::Status FileLog::rotate(const Os::TimeNs_t now)
+{
+    const bool synced = Dirty && File.sync().success();
+    Dirty = false;
+    SyncedNs = now;
+    File.close();
+
+    char from[RotatedPathSz];
+    char to[RotatedPathSz];
+    if (Cfg.Keep == 0)
+    {
+        std::remove(Path);
+    }
+    else
+    {
+        std::snprintf(to, sizeof(to), "%s.%u", Path, static_cast<unsigned>(Cfg.Keep));
+        std::remove(to);
+        for (uint32_t i = Cfg.Keep - 1; i > 0; i--)
+        {
+            std::snprintf(from, sizeof(from), "%s.%u", Path, static_cast<unsigned>(i));
+            std::snprintf(to, sizeof(to), "%s.%u", Path, static_cast<unsigned>(i + 1));
+            std::rename(from, to);
+        }
+        std::snprintf(to, sizeof(to), "%s.1", Path);
+        std::rename(Path, to);
+    }
+
+    FileSz = 0;
+    OpenedNs = now;
+    const Status status = File.open(Path, Os::File::OPEN_APPEND, Os::File::NO_OVERWRITE);
+    Lock.lock();
+    if (synced)
+    {
+        Counts.Syncs++;
+    }
+    if (status.success())
+    {
+        Counts.Rotations++;
+    }
+    else
+    {
+        // Nowhere to write. Lines are dropped until the next open.
+        Counts.Errors++;
+        Open = false;
+    }
+    Lock.unlock();
+    return status;
+}
+
+void FileLog::flusher_main(void* log)
+{
+    FileLog& self = *static_cast<FileLog*>(log);
+    uint64_t opens = 0;
+    Os::TimeNs_t due_ns = Os::TimeNsNever;
+    while (self.Running.load(std::memory_order_acquire))
+    {
+        const Os::EventCount::Key_t key = self.Wake.prepare_wait();
+        self.Lock.lock();
+        const bool filling = self.Used[self.Active] >= (BufSz / 2);
+        const bool reopened = self.Opens != opens;
+        opens = self.Opens;
+        const Os::TimeNs_t flush_ns = static_cast<Os::TimeNs_t>(self.Cfg.FlushMs) * Os::NsPerMs;
+        self.Lock.unlock();
+
+        const Os::TimeNs_t now = Os::Clock::now_ns();
+        if (reopened)
+        {
+            due_ns = (flush_ns != 0) ? (now + flush_ns) : Os::TimeNsNever;
+        }
+        if (!filling && now < due_ns)
+        {
+            // Woken early, by a filling buffer, an open or the destructor
+            self.Wake.wait_until(key, due_ns);
+            continue;
+        }
+        self.Wake.cancel_wait(key);
+
+        self.IoLock.lock();
+        self.service(false);
+        self.IoLock.unlock();
+        due_ns = (flush_ns != 0) ? (Os::Clock::now_ns() + flush_ns) : Os::TimeNsNever;
+    }
+}
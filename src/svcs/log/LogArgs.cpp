@@ -0,0 +1,529 @@
+#include "svcs/log/LogArgs.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace etfw;
+
+/// Argument length modifiers
+enum class ArgLen : uint8_t
+{
+    NONE, HH, H, L, LL, J, Z, T, LD
+};
+
+/// @brief One printf conversion
+struct Conversion
+{
+    const char* Begin;  //< The '%'
+    const char* Len;    //< Length modifier, after flags, width and precision
+    char Conv;
+    ArgLen LenMod;
+    uint8_t Stars;      //< '*' width and precision arguments
+};
+
+/// @brief Parse a conversion
+/// @param fmt Its '%'. Not a "%%".
+/// @return Character after the conversion
+static const char* parse_conversion(const char* fmt, Conversion& conv)
+{
+    conv.Begin = fmt++;
+    conv.Stars = 0;
+    while (*fmt != '\0' && std::strchr("-+ #0'", *fmt) != nullptr)
+    {
+        fmt++;
+    }
+    if (*fmt == '*')
+    {
+        conv.Stars++;
+        fmt++;
+    }
+    while (*fmt >= '0' && *fmt <= '9')
+    {
+        fmt++;
+    }
+    if (*fmt == '.')
+    {
+        fmt++;
+        if (*fmt == '*')
+        {
+            conv.Stars++;
+            fmt++;
+        }
+        while (*fmt >= '0' && *fmt <= '9')
+        {
+            fmt++;
+        }
+    }
+
+    conv.Len = fmt;
+    conv.LenMod = ArgLen::NONE;
+    switch (*fmt)
+    {
+        case 'h':
+            fmt++;
+            conv.LenMod = (*fmt == 'h') ? ArgLen::HH : ArgLen::H;
+            fmt += (*fmt == 'h') ? 1 : 0;
+            break;
+        case 'l':
+            fmt++;
+            conv.LenMod = (*fmt == 'l') ? ArgLen::LL : ArgLen::L;
+            fmt += (*fmt == 'l') ? 1 : 0;
+            break;
+        case 'q': conv.LenMod = ArgLen::LL; fmt++; break;
+        case 'j': conv.LenMod = ArgLen::J; fmt++; break;
+        case 'z': conv.LenMod = ArgLen::Z; fmt++; break;
+        case 't': conv.LenMod = ArgLen::T; fmt++; break;
+        case 'L': conv.LenMod = ArgLen::LD; fmt++; break;
+        default: break;
+    }
+
+    conv.Conv = *fmt;
+    return (*fmt != '\0') ? (fmt + 1) : fmt;
+}
+
+static inline uint64_t zigzag(const int64_t val)
+{
+    return (static_cast<uint64_t>(val) << 1) ^ static_cast<uint64_t>(val >> 63);
+}
+
+static inline int64_t unzigzag(const uint64_t val)
+{
+    return static_cast<int64_t>(val >> 1) ^ -static_cast<int64_t>(val & 1);
+}
+
+/// @brief Get the size of a varint
+static inline size_t varint_sz(uint64_t val)
+{
+    size_t n = 1;
+    while (val >= 0x80)
+    {
+        val >>= 7;
+        n++;
+    }
+    return n;
+}
+
+/// @brief Writes packed arguments
+class ArgWriter
+{
+    public:
+        ArgWriter(uint8_t* buf, const size_t sz):
+            Begin(buf), Pos(buf), End(buf + sz) {}
+
+        inline size_t size() const { return static_cast<size_t>(Pos - Begin); }
+
+        bool put(const uint64_t val)
+        {
+            const size_t n = LogArgs::put_varint(val, Pos, static_cast<size_t>(End - Pos));
+            Pos += n;
+            return n > 0;
+        }
+
+        bool put_double(const double val)
+        {
+            if ((End - Pos) < 8)
+            {
+                return false;
+            }
+            std::memcpy(Pos, &val, sizeof(val));
+            Pos += 8;
+            return true;
+        }
+
+        /// @brief Copy a string, truncated to the space left
+        bool put_str(const char* str)
+        {
+            if (str == nullptr)
+            {
+                str = "(null)";
+            }
+            const size_t room = static_cast<size_t>(End - Pos);
+            if (room < 2)
+            {
+                return false;
+            }
+            size_t len = strnlen(str, room - 1);
+            while ((len + varint_sz(len)) > room)
+            {
+                len--;
+            }
+            Pos += LogArgs::put_varint(len, Pos, room);
+            std::memcpy(Pos, str, len);
+            Pos += len;
+            return true;
+        }
+
+    private:
+        uint8_t* const Begin;
+        uint8_t* Pos;
+        uint8_t* const End;
+};
+
+/// @brief Reads packed arguments
+class ArgReader
+{
+    public:
+        ArgReader(const uint8_t* buf, const size_t sz):
+            Pos(buf), End(buf + sz) {}
+
+        bool get(uint64_t& val)
+        {
+            const size_t n = LogArgs::get_varint(Pos, static_cast<size_t>(End - Pos), val);
+            Pos += n;
+            return n > 0;
+        }
+
+        bool get_double(double& val)
+        {
+            if ((End - Pos) < 8)
+            {
+                return false;
+            }
+            std::memcpy(&val, Pos, sizeof(val));
+            Pos += 8;
+            return true;
+        }
+
+        /// @brief Read a string. Not terminated.
+        bool get_str(const char*& str, size_t& len)
+        {
+            uint64_t str_len = 0;
+            if (!get(str_len) || static_cast<uint64_t>(End - Pos) < str_len)
+            {
+                return false;
+            }
+            str = reinterpret_cast<const char*>(Pos);
+            len = static_cast<size_t>(str_len);
+            Pos += len;
+            return true;
+        }
+
+    private:
+        const uint8_t* Pos;
+        const uint8_t* const End;
+};
+
+size_t LogArgs::put_varint(uint64_t val, uint8_t* buf, const size_t sz)
+{
+    size_t n = 0;
+    do
+    {
+        if (n == sz)
+        {
+            return 0;
+        }
+        const uint8_t low = static_cast<uint8_t>(val & 0x7F);
+        val >>= 7;
+        buf[n++] = low | ((val != 0) ? 0x80 : 0);
+    } while (val != 0);
+    return n;
+}
+
+size_t LogArgs::get_varint(const uint8_t* buf, const size_t sz, uint64_t& val)
+{
+    val = 0;
+    for (size_t n = 0; n < sz && n < VarintMaxSz; n++)
+    {
+        val |= static_cast<uint64_t>(buf[n] & 0x7F) << (7 * n);
+        if ((buf[n] & 0x80) == 0)
+        {
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+size_t LogArgs::pack(const char* fmt, va_list args, uint8_t* buf, const size_t sz)
+{
+    ArgWriter out(buf, sz);
+    while (*fmt != '\0')
+    {
+        if (*fmt != '%')
+        {
+            fmt++;
+            continue;
+        }
+        if (fmt[1] == '%')
+        {
+            fmt += 2;
+            continue;
+        }
+
+        Conversion conv;
+        fmt = parse_conversion(fmt, conv);
+        for (uint8_t i = 0; i < conv.Stars; i++)
+        {
+            if (!out.put(zigzag(va_arg(args, int))))
+            {
+                return out.size();
+            }
+        }
+
+        bool ok = true;
+        switch (conv.Conv)
+        {
+            case 'd':
+            case 'i':
+            {
+                int64_t val;
+                switch (conv.LenMod)
+                {
+                    case ArgLen::HH: val = static_cast<signed char>(va_arg(args, int)); break;
+                    case ArgLen::H: val = static_cast<short>(va_arg(args, int)); break;
+                    case ArgLen::L: val = va_arg(args, long); break;
+                    case ArgLen::LL: val = va_arg(args, long long); break;
+                    case ArgLen::J: val = va_arg(args, intmax_t); break;
+                    case ArgLen::Z: val = static_cast<int64_t>(va_arg(args, size_t)); break;
+                    case ArgLen::T: val = va_arg(args, ptrdiff_t); break;
+                    default: val = va_arg(args, int); break;
+                }
+                ok = out.put(zigzag(val));
+                break;
+            }
+
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+            {
+                uint64_t val;
+                switch (conv.LenMod)
+                {
+                    case ArgLen::HH: val = static_cast<unsigned char>(va_arg(args, unsigned)); break;
+                    case ArgLen::H: val = static_cast<unsigned short>(va_arg(args, unsigned)); break;
+                    case ArgLen::L: val = va_arg(args, unsigned long); break;
+                    case ArgLen::LL: val = va_arg(args, unsigned long long); break;
+                    case ArgLen::J: val = va_arg(args, uintmax_t); break;
+                    case ArgLen::Z: val = va_arg(args, size_t); break;
+                    case ArgLen::T: val = static_cast<uint64_t>(va_arg(args, ptrdiff_t)); break;
+                    default: val = va_arg(args, unsigned); break;
+                }
+                ok = out.put(val);
+                break;
+            }
+
+            case 'c':
+                ok = out.put(static_cast<uint8_t>(va_arg(args, int)));
+                break;
+
+            case 'e': case 'E':
+            case 'f': case 'F':
+            case 'g': case 'G':
+            case 'a': case 'A':
+                ok = out.put_double((conv.LenMod == ArgLen::LD) ?
+                    static_cast<double>(va_arg(args, long double)) : va_arg(args, double));
+                break;
+
+            case 's':
+                if (conv.LenMod == ArgLen::L)
+                {
+                    return out.size();
+                }
+                ok = out.put_str(va_arg(args, const char*));
+                break;
+
+            case 'p':
+                ok = out.put(reinterpret_cast<uintptr_t>(va_arg(args, void*)));
+                break;
+
+            case 'n':
+                // Nothing to write back to
+                (void)va_arg(args, void*);
+                break;
+
+            default:
+                return out.size();
+        }
+
+        if (!ok)
+        {
+            return out.size();
+        }
+    }
+    return out.size();
+}
+
+template <typename T>
+static int print_arg(char* out, const size_t sz, const char* spec,
+    const uint8_t stars, const int* star_args, const T val)
+{
+    switch (stars)
+    {
+        case 0: return std::snprintf(out, sz, spec, val);
+        case 1: return std::snprintf(out, sz, spec, star_args[0], val);
+        default: return std::snprintf(out, sz, spec, star_args[0], star_args[1], val);
+    }
+}
+
+/// @brief Format one conversion from its packed argument
+/// @return Characters the conversion needs, as snprintf. -1 if it can't
+///     be formatted.
+static int format_conversion(const Conversion& conv, ArgReader& in, char* out, const size_t sz)
+{
+    // Flags, width and precision as given, then the length of the
+    // unpacked type
+    char spec[32];
+    const size_t prefix = static_cast<size_t>(conv.Len - conv.Begin);
+    if (prefix + 4 > sizeof(spec))
+    {
+        return -1;
+    }
+    std::memcpy(spec, conv.Begin, prefix);
+    char* type = spec + prefix;
+
+    int star_args[2] = {0, 0};
+    for (uint8_t i = 0; i < conv.Stars; i++)
+    {
+        uint64_t val;
+        if (!in.get(val))
+        {
+            return -1;
+        }
+        star_args[i] = static_cast<int>(unzigzag(val));
+    }
+
+    uint64_t val = 0;
+    switch (conv.Conv)
+    {
+        case 'd':
+        case 'i':
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            if (!in.get(val))
+            {
+                return -1;
+            }
+            type[0] = 'l';
+            type[1] = 'l';
+            type[2] = conv.Conv;
+            type[3] = '\0';
+            if (conv.Conv == 'd' || conv.Conv == 'i')
+            {
+                return print_arg(out, sz, spec, conv.Stars, star_args,
+                    static_cast<long long>(unzigzag(val)));
+            }
+            return print_arg(out, sz, spec, conv.Stars, star_args, static_cast<unsigned long long>(val));
+
+        case 'c':
+            if (!in.get(val))
+            {
+                return -1;
+            }
+            type[0] = 'c';
+            type[1] = '\0';
+            return print_arg(out, sz, spec, conv.Stars, star_args, static_cast<int>(val));
+
+        case 'e': case 'E':
+        case 'f': case 'F':
+        case 'g': case 'G':
+        case 'a': case 'A':
+        {
+            double dval;
+            if (!in.get_double(dval))
+            {
+                return -1;
+            }
+            type[0] = conv.Conv;
+            type[1] = '\0';
+            return print_arg(out, sz, spec, conv.Stars, star_args, dval);
+        }
+
+        case 's':
+        {
+            const char* str = nullptr;
+            size_t len = 0;
+            if (conv.LenMod == ArgLen::L || !in.get_str(str, len))
+            {
+                return -1;
+            }
+            // Packed strings aren't terminated, so they are printed with a
+            // precision: the given one, capped at the string's length
+            int precision = static_cast<int>(len);
+            size_t keep = prefix;
+            uint8_t stars = conv.Stars;
+            const char* dot = static_cast<const char*>(std::memchr(spec, '.', prefix));
+            if (dot != nullptr)
+            {
+                keep = static_cast<size_t>(dot - spec);
+                int given;
+                if (dot[1] == '*')
+                {
+                    stars--;
+                    given = star_args[stars];
+                }
+                else
+                {
+                    given = std::atoi(dot + 1);
+                }
+                if (given >= 0 && given < precision)
+                {
+                    precision = given;
+                }
+            }
+            spec[keep] = '.';
+            spec[keep + 1] = '*';
+            spec[keep + 2] = 's';
+            spec[keep + 3] = '\0';
+            star_args[stars] = precision;
+            return print_arg(out, sz, spec, stars + 1, star_args, str);
+        }
+
+        case 'p':
+            if (!in.get(val))
+            {
+                return -1;
+            }
+            type[0] = 'p';
+            type[1] = '\0';
+            return print_arg(out, sz, spec, conv.Stars, star_args,
+                reinterpret_cast<void*>(static_cast<uintptr_t>(val)));
+
+        case 'n':
+            return 0;
+
+        default:
+            return -1;
+    }
+}
+
+size_t LogArgs::format(const char* fmt, const uint8_t* args, const size_t sz,
+    char* out, const size_t out_sz)
+{
+    ArgReader in(args, sz);
+    size_t len = 0;
+    bool typed = true;
+    while (*fmt != '\0' && (len + 1) < out_sz)
+    {
+        if (*fmt != '%' || !typed)
+        {
+            out[len++] = *fmt++;
+            continue;
+        }
+        if (fmt[1] == '%')
+        {
+            out[len++] = '%';
+            fmt += 2;
+            continue;
+        }
+
+        Conversion conv;
+        const char* next = parse_conversion(fmt, conv);
+        const int n = format_conversion(conv, in, out + len, out_sz - len);
+        if (n < 0)
+        {
+            // Untyped or out of arguments. The rest is written as is.
+            typed = false;
+            continue;
+        }
+        len += static_cast<size_t>(n);
+        if (len >= out_sz)
+        {
+            len = out_sz - 1;
+        }
+        fmt = next;
+    }
+    out[len] = '\0';
+    return len;
+}
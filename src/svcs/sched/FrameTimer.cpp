@@ -0,0 +1,87 @@
+#include "svcs/sched/FrameTimer.hpp"
+#include "etfw_assert.hpp"
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+using namespace etfw::sched;
+
+OsFrameClock& OsFrameClock::instance()
+{
+    static OsFrameClock clock;
+    return clock;
+}
+
+FrameTimer::FrameTimer(const Os::TimeNs_t period_ns, etl::span<SlotStats> stats,
+    iFrameClock& clock):
+    period_ns_(period_ns),
+    stats_(stats),
+    clock_(clock),
+    next_ns_(0),
+    frame_(0),
+    major_frames_(0)
+{
+    ETFW_ASSERT(period_ns > 0, "Minor frame period must be non-zero");
+    ETFW_ASSERT(!stats.empty(), "Major frame must have at least one minor frame");
+}
+
+void FrameTimer::start()
+{
+    start(clock_.now_ns());
+}
+
+void FrameTimer::start(const Os::TimeNs_t start_ns)
+{
+#ifdef __linux__
+    // Time sharing threads get 50 us of timer slack by default
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+#endif
+    next_ns_ = start_ns + period_ns_;
+    frame_ = 0;
+    major_frames_ = 0;
+}
+
+size_t FrameTimer::wait()
+{
+    clock_.sleep_until(next_ns_);
+    const Os::TimeNs_t now = clock_.now_ns();
+
+    // Skip frames whose successor has already started
+    while (now >= (next_ns_ + period_ns_))
+    {
+        stats_[frame_].Overruns++;
+        advance();
+    }
+
+    const size_t frame = frame_;
+    const Os::TimeNs_t jitter = now - next_ns_;
+    SlotStats& slot = stats_[frame];
+    slot.Wakes++;
+    slot.JitterSum += jitter;
+    slot.JitterMin = std::min(slot.JitterMin, jitter);
+    slot.JitterMax = std::max(slot.JitterMax, jitter);
+
+    advance();
+    return frame;
+}
+
+void FrameTimer::reset_stats()
+{
+    for (SlotStats& slot: stats_)
+    {
+        slot.reset();
+    }
+}
+
+void FrameTimer::advance()
+{
+    next_ns_ += period_ns_;
+    frame_++;
+    if (frame_ == stats_.size())
+    {
+        frame_ = 0;
+        major_frames_++;
+    }
+}
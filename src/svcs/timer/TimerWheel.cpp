@@ -0,0 +1,201 @@
+#include "svcs/timer/TimerWheel.hpp"
+#include "etfw_assert.hpp"
+#include <algorithm>
+
+using namespace etfw::timer;
+
+using Status = TimerWheel::Status;
+
+TimerWheel::TimerWheel(etl::span<Timer> timers):
+    timers_(timers),
+    free_(Nil),
+    active_(0),
+    now_(0)
+{
+    ETFW_ASSERT(!timers.empty() && timers.size() <= IdxMask,
+        "Invalid timer pool size");
+    for (auto& level: heads_)
+    {
+        std::fill(std::begin(level), std::end(level), Nil);
+    }
+    std::fill(std::begin(occupied_), std::end(occupied_), 0);
+
+    for (size_t i = timers_.size(); i > 0; i--)
+    {
+        Timer& timer = timers_[i - 1];
+        timer.Gen = 1;
+        timer.Level = FreeLevel;
+        timer.Next = free_;
+        free_ = static_cast<uint32_t>(i - 1);
+    }
+}
+
+Status TimerWheel::arm(TimerId_t& id, const msg::MsgId_t msg_id,
+    const Tick_t expiry, const Tick_t period)
+{
+    if (free_ == Nil)
+    {
+        return Status::Code::NO_TIMERS;
+    }
+
+    const uint32_t idx = free_;
+    Timer& timer = timers_[idx];
+    free_ = timer.Next;
+    active_++;
+
+    timer.Expiry = std::max(expiry, now_ + 1);
+    timer.Period = period;
+    timer.MsgId = msg_id;
+    file(idx);
+
+    id = to_id(idx, timer.Gen);
+    return Status::Code::OK;
+}
+
+Status TimerWheel::cancel(const TimerId_t id)
+{
+    const uint32_t idx = lookup(id);
+    if (idx == Nil)
+    {
+        return Status::Code::INVALID_TIMER;
+    }
+    unfile(idx);
+    release(idx);
+    return Status::Code::OK;
+}
+
+bool TimerWheel::armed(const TimerId_t id) const
+{
+    return lookup(id) != Nil;
+}
+
+Tick_t TimerWheel::next_event() const
+{
+    Tick_t next = TickNever;
+    for (size_t level = 0; level < NumLevels; level++)
+    {
+        if (occupied_[level] == 0)
+        {
+            continue;
+        }
+
+        // Slots are visited in order after the current one. Rotate the
+        // bitmap so bit 0 is the slot after the current one.
+        const size_t shift = level * SlotBits;
+        const Tick_t base = now_ >> shift;
+        const size_t start = (base + 1) & SlotMask;
+        const uint64_t bits = occupied_[level];
+        const uint64_t rotated = (start == 0) ? bits :
+            ((bits >> start) | (bits << (NumSlots - start)));
+        const Tick_t ahead = static_cast<Tick_t>(__builtin_ctzll(rotated)) + 1;
+        next = std::min(next, (base + ahead) << shift);
+    }
+    return next;
+}
+
+uint32_t TimerWheel::lookup(const TimerId_t id) const
+{
+    const uint32_t idx = id & IdxMask;
+    if (idx >= timers_.size())
+    {
+        return Nil;
+    }
+    const Timer& timer = timers_[idx];
+    if (timer.Level == FreeLevel || to_id(idx, timer.Gen) != id)
+    {
+        return Nil;
+    }
+    return idx;
+}
+
+void TimerWheel::file(const uint32_t idx)
+{
+    Timer& timer = timers_[idx];
+
+    // Timers past the top level's span wait in its furthest slot and are
+    // re-filed when it cascades
+    const Tick_t delta = timer.Expiry - now_;
+    const Tick_t target = (delta > MaxSpan) ? (now_ + MaxSpan) : timer.Expiry;
+
+    size_t level = 0;
+    while (level < (NumLevels - 1) &&
+        (target - now_) >= (Tick_t(1) << (SlotBits * (level + 1))))
+    {
+        level++;
+    }
+    const size_t slot = (target >> (SlotBits * level)) & SlotMask;
+
+    timer.Level = static_cast<uint8_t>(level);
+    timer.Slot = static_cast<uint8_t>(slot);
+    timer.Prev = Nil;
+    timer.Next = heads_[level][slot];
+    if (timer.Next != Nil)
+    {
+        timers_[timer.Next].Prev = idx;
+    }
+    heads_[level][slot] = idx;
+    occupied_[level] |= (uint64_t(1) << slot);
+}
+
+void TimerWheel::unfile(const uint32_t idx)
+{
+    Timer& timer = timers_[idx];
+    if (timer.Prev != Nil)
+    {
+        timers_[timer.Prev].Next = timer.Next;
+    }
+    else
+    {
+        heads_[timer.Level][timer.Slot] = timer.Next;
+        if (timer.Next == Nil)
+        {
+            occupied_[timer.Level] &= ~(uint64_t(1) << timer.Slot);
+        }
+    }
+    if (timer.Next != Nil)
+    {
+        timers_[timer.Next].Prev = timer.Prev;
+    }
+}
+
+void TimerWheel::release(const uint32_t idx)
+{
+    Timer& timer = timers_[idx];
+    timer.Level = FreeLevel;
+    timer.Gen = (timer.Gen == MaxGen) ? 1 : (timer.Gen + 1);
+    timer.Next = free_;
+    free_ = idx;
+    active_--;
+}
+
+uint32_t TimerWheel::take_expired(const Tick_t tick)
+{
+    now_ = tick;
+
+    // Cascade from the top so timers dropping through several levels
+    // land in slots that haven't been visited yet
+    for (size_t level = NumLevels - 1; level > 0; level--)
+    {
+        const size_t shift = level * SlotBits;
+        if ((tick & ((Tick_t(1) << shift) - 1)) != 0)
+        {
+            continue;
+        }
+        const size_t slot = (tick >> shift) & SlotMask;
+        uint32_t idx = heads_[level][slot];
+        heads_[level][slot] = Nil;
+        occupied_[level] &= ~(uint64_t(1) << slot);
+        while (idx != Nil)
+        {
+            const uint32_t next = timers_[idx].Next;
+            file(idx);
+            idx = next;
+        }
+    }
+
+    const size_t slot = tick & SlotMask;
+    const uint32_t expired = heads_[0][slot];
+    heads_[0][slot] = Nil;
+    occupied_[0] &= ~(uint64_t(1) << slot);
+    return expired;
+}
@@ -1,3 +1,518 @@
-
 #include "ut_framework.hpp"
 
+#include <etfw/svcs/AppChild.hpp>
+#include <etfw/svcs/Executor.hpp>
+#include <etfw/svcs/SvcCfg.hpp>
+#include <etfw/msg/Router.hpp>
+#include <etfw/msg/Pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace event_runner
+{
+
+struct Ping : public etl::message<1>
+{
+    uint32_t Seq;
+
+    Ping(uint32_t seq): Seq(seq) {}
+};
+
+/// Event-driven child with a queued router and a periodic timer
+struct Cfg : public etfw::EventSvcCfg<0, 8192>
+{
+    static constexpr etfw::SvcId_t ID = 1;
+};
+
+class EventSvc : public etfw::AppChild<EventSvc, Cfg>
+{
+    public:
+        using Base_t = etfw::AppChild<EventSvc, Cfg>;
+        using Pipe_t = etfw::msg::QueuedRouter<EventSvc, 4, Ping>;
+        using Timer_t = etfw::msg::PeriodicTimer<EventSvc>;
+
+        static constexpr Os::TimeMs_t TimerPeriodMs = 20;
+
+        EventSvc():
+            Base_t(Cfg::ID, "EVENT_SVC"),
+            pipe_(*this),
+            timer_(*this, TimerPeriodMs),
+            sources_{&pipe_, &timer_}
+        {}
+
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 2);
+        }
+
+        void receive(const Ping& ping)
+        {
+            LastSeq = ping.Seq;
+            Pings++;
+        }
+
+        void on_timer(const Timer_t& timer)
+        {
+            Ticks++;
+        }
+
+        inline Pipe_t& pipe() { return pipe_; }
+        inline const etfw::iEventRunnerExt& runner_ext() const { return Runner; }
+
+        std::atomic<uint32_t> LastSeq{0};
+        std::atomic<size_t> Pings{0};
+        std::atomic<size_t> Ticks{0};
+
+    private:
+        Pipe_t pipe_;
+        Timer_t timer_;
+        etfw::msg::iEventSource* const sources_[2];
+};
+
+template <typename TPred>
+bool wait_for(TPred&& pred, const std::chrono::milliseconds timeout)
+{
+    const auto end = std::chrono::steady_clock::now() + timeout;
+    while (!pred())
+    {
+        if (std::chrono::steady_clock::now() > end)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+TEST(EventRunner, DispatchesSources)
+{
+    static EventSvc svc;
+    ASSERT_TRUE(svc.init().success());
+    ASSERT_TRUE(svc.start().success());
+
+    // Starting a running runner fails without re-attaching its sources
+    EXPECT_EQ(svc.get_runner()->start(), etfw::iSvcRunner::RunStatus::ERROR);
+
+    // Messages wake the runner without waiting for a poll timeout
+    for (uint32_t seq = 1; seq <= 100; seq++)
+    {
+        svc.pipe().receive(Ping(seq));
+        ASSERT_TRUE(wait_for([seq]() { return svc.LastSeq == seq; },
+            std::chrono::milliseconds(1000)));
+    }
+    EXPECT_EQ(svc.Pings, 100);
+
+    // Idle, the runner only wakes for the timer
+    const size_t ticks = svc.Ticks;
+    const size_t sleeps = svc.runner_ext().sleeps();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10 * EventSvc::TimerPeriodMs));
+    const size_t idle_ticks = svc.Ticks - ticks;
+    EXPECT_GE(idle_ticks, 5);
+    EXPECT_LE(svc.runner_ext().sleeps() - sleeps, idle_ticks + 2);
+
+    // Stop wakes the sleeping runner
+    ASSERT_TRUE(svc.stop().success());
+    EXPECT_TRUE(wait_for([]() {
+            return svc.runner_ext().state() == etfw::iSvcRunner::State_t::STOPPED;
+        }, std::chrono::milliseconds(1000)));
+}
+
+}
+
+namespace shutdown
+{
+
+struct Wake : public etl::message<2> {};
+
+struct ChildCfg : public etfw::ChildSvcCfg<0, 8192>
+{
+    static constexpr etfw::SvcId_t ID = 1;
+};
+
+/// Blocks in process on a pipe with a long timeout
+class BlockedChild : public etfw::AppChild<BlockedChild, ChildCfg>
+{
+    public:
+        using Base_t = etfw::AppChild<BlockedChild, ChildCfg>;
+        using Pipe_t = etfw::msg::QueuedRouter<BlockedChild, 2, Wake>;
+
+        BlockedChild():
+            Base_t(ChildCfg::ID, "BLOCKED_CHILD"),
+            pipe_(*this),
+            sources_{&pipe_}
+        {}
+
+        RunState run_loop()
+        {
+            pipe_.receive_msgs(5000);
+            return RunState::OK;
+        }
+
+        /// @brief Lets a stop wake the blocked receive
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 1);
+        }
+
+        void receive(const Wake& wake) {}
+
+    private:
+        Pipe_t pipe_;
+        etfw::msg::iEventSource* const sources_[1];
+};
+
+struct ParentCfg : public etfw::SvcCfg<80, etfw::ActiveSvcCfg<0, 8192>>
+{
+    static constexpr const char* NAME = "BLOCKED_PARENT";
+};
+
+/// Blocks in process like its child
+class BlockedParent : public etfw::App<BlockedParent, ParentCfg>
+{
+    public:
+        using Base_t = etfw::App<BlockedParent, ParentCfg>;
+        using Pipe_t = etfw::msg::QueuedRouter<BlockedParent, 2, Wake>;
+
+        BlockedParent():
+            Base_t(),
+            pipe_(*this),
+            sources_{&pipe_}
+        {}
+
+        Status app_init()
+        {
+            Status stat = child_.init();
+            if (stat.success())
+            {
+                stat = register_child(child_);
+            }
+            return stat;
+        }
+
+        RunState run_loop()
+        {
+            pipe_.receive_msgs(5000);
+            return RunState::OK;
+        }
+
+        Status app_cleanup() { return Status::Code::OK; }
+
+        /// @brief Children are stopped before the parent cleans up
+        RunState post_run_cleanup() override
+        {
+            ChildFinished = child_.get_runner()->is_finished();
+            return RunState::OK;
+        }
+
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 1);
+        }
+
+        void receive(const Wake& wake) {}
+
+        inline BlockedChild& child() { return child_; }
+
+        std::atomic<bool> ChildFinished{false};
+
+    private:
+        BlockedChild child_;
+        Pipe_t pipe_;
+        etfw::msg::iEventSource* const sources_[1];
+};
+
+TEST(Shutdown, StopAllWakesBlockedServices)
+{
+    using State_t = etfw::iSvcRunner::State_t;
+    static BlockedParent parent;
+    static etfw::Executor<1> exec;
+    ASSERT_TRUE(exec.register_app(parent).success());
+    ASSERT_TRUE(exec.start_all().success());
+    ASSERT_TRUE(parent.child().start().success());
+
+    // Both block in a 5s receive
+    ASSERT_TRUE(event_runner::wait_for([]() {
+            return parent.get_runner()->state() == State_t::ACTIVE &&
+                parent.child().get_runner()->state() == State_t::ACTIVE;
+        }, std::chrono::milliseconds(1000)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    const Os::TimeNs_t start = Os::Clock::now_ns();
+    EXPECT_EQ(exec.stop_all().code(), etfw::iExecutor::Status::Code::OK);
+    const Os::TimeNs_t elapsed = Os::Clock::now_ns() - start;
+    EXPECT_LT(elapsed, 500 * Os::NsPerMs);
+
+    EXPECT_EQ(parent.get_runner()->state(), State_t::STOPPED);
+    EXPECT_EQ(parent.child().get_runner()->state(), State_t::STOPPED);
+    EXPECT_TRUE(parent.ChildFinished);
+    EXPECT_GT(parent.get_runner()->stop_latency_ns(), 0);
+    EXPECT_LE(parent.get_runner()->stop_latency_ns(), elapsed);
+
+    // Nothing left to stop
+    EXPECT_TRUE(parent.get_runner()->wait_finished(Os::Clock::now_ns()));
+}
+
+}
+
+namespace pool_restart
+{
+
+using CachedPool = etfw::msg::CachedMsgBufPool<1, etfw::msg::SizeClass<64, 64>>;
+
+struct Cfg : public etfw::SvcCfg<95, etfw::ActiveSvcCfg<0, 8192>>
+{
+    static constexpr const char* NAME = "POOL_USER";
+};
+
+/// Allocates and releases a buffer each iteration, caching blocks on its
+/// runner thread
+class PoolUser : public etfw::App<PoolUser, Cfg>
+{
+    public:
+        PoolUser(CachedPool& pool): pool_(pool) {}
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        RunState run_loop()
+        {
+            etfw::msg::Buf* buf = pool_.allocate(static_cast<size_t>(16));
+            if (buf != nullptr)
+            {
+                buf->release();
+                Iters++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return RunState::OK;
+        }
+
+        std::atomic<size_t> Iters{0};
+
+    private:
+        CachedPool& pool_;
+};
+
+TEST(PoolRestart, RunnerExitFlushesThreadCache)
+{
+    static CachedPool pool;
+    static PoolUser user(pool);
+    ASSERT_TRUE(user.init().success());
+
+    // The only cache is claimed by each new runner thread in turn
+    for (size_t run = 1; run <= 3; run++)
+    {
+        const size_t iters = user.Iters;
+        ASSERT_TRUE(user.start().success());
+        ASSERT_TRUE(event_runner::wait_for([iters]() { return user.Iters >= iters + 10; },
+            std::chrono::milliseconds(1000)));
+        EXPECT_GT(pool.cache_stats().Stranded, 0);
+
+        ASSERT_TRUE(user.stop().success());
+        ASSERT_TRUE(user.get_runner()->wait_finished(Os::Clock::now_ns() + (1000 * Os::NsPerMs)));
+        EXPECT_EQ(pool.cache_stats().Stranded, 0);
+        EXPECT_EQ(pool.stats().ItemsInUse, 0);
+        EXPECT_EQ(pool.thread_cache_stats(0).Misses, run);
+    }
+    EXPECT_EQ(pool.stats().AllocCount, pool.stats().ReleaseCount);
+}
+
+}
+
+namespace boot
+{
+
+using etfw::SvcDeps;
+using etfw::iExecutor;
+
+/// Boot event sequence, to check ordering across threads
+std::atomic<size_t> Seq{0};
+
+template <etfw::SvcId_t TId, typename TDeps>
+struct BootCfg : public etfw::SvcCfg<TId, etfw::ActiveSvcCfg<0, 8192>>
+{
+    static constexpr const char* NAME = "BOOT_APP";
+    using InitDeps = TDeps;
+};
+
+/// Records when its init and start ran. Init takes InitMs, and fails
+/// if Fail is set.
+template <typename TCfg>
+class BootApp : public etfw::App<BootApp<TCfg>, TCfg>
+{
+    public:
+        using Base_t = etfw::App<BootApp<TCfg>, TCfg>;
+        using Status = typename Base_t::Status;
+        using RunState = typename Base_t::RunState;
+
+        Status app_init()
+        {
+            InitBegin = Seq++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(InitMs));
+            InitEnd = Seq++;
+            return Fail ? Status::Code::UNKNOWN_ERR : Status::Code::OK;
+        }
+
+        RunState run_loop()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return RunState::OK;
+        }
+
+        Status app_cleanup() { return Status::Code::OK; }
+
+        Status start_() override
+        {
+            StartSeq = Seq++;
+            return Base_t::start_();
+        }
+
+        Status stop_() override
+        {
+            StopSeq = Seq++;
+            return Base_t::stop_();
+        }
+
+        RunState post_run_cleanup() override
+        {
+            StoppedSeq = Seq++;
+            return Base_t::post_run_cleanup();
+        }
+
+        size_t InitMs = 0;
+        bool Fail = false;
+        std::atomic<size_t> InitBegin{SIZE_MAX};
+        std::atomic<size_t> InitEnd{SIZE_MAX};
+        std::atomic<size_t> StartSeq{SIZE_MAX};
+        std::atomic<size_t> StopSeq{SIZE_MAX};
+        std::atomic<size_t> StoppedSeq{SIZE_MAX};
+};
+
+// Two slow independent roots, then a chain on both
+using RootA = BootApp<BootCfg<100, SvcDeps<>>>;
+using RootB = BootApp<BootCfg<101, SvcDeps<>>>;
+using Mid = BootApp<BootCfg<102, SvcDeps<100, 101>>>;
+using Leaf = BootApp<BootCfg<103, SvcDeps<102>>>;
+
+static_assert(etfw::init_deps_acyclic<RootA, RootB, Mid, Leaf>::value);
+static_assert(etfw::init_deps_acyclic<Leaf, Mid>::value, "Outside dependencies are ignored");
+
+using CycleA = BootApp<BootCfg<110, SvcDeps<112>>>;
+using CycleB = BootApp<BootCfg<111, SvcDeps<110>>>;
+using CycleC = BootApp<BootCfg<112, SvcDeps<111>>>;
+using SelfDep = BootApp<BootCfg<113, SvcDeps<113>>>;
+static_assert(!etfw::init_deps_acyclic<CycleA, CycleB, CycleC>::value);
+static_assert(etfw::init_deps_acyclic<CycleA, CycleB>::value);
+static_assert(!etfw::init_deps_acyclic<RootA, SelfDep>::value);
+
+TEST(Boot, InitsInDependencyOrder)
+{
+    static Leaf leaf;
+    static Mid mid;
+    static RootB root_b;
+    static RootA root_a;
+    static etfw::Executor<4> exec;
+    root_a.InitMs = 100;
+    root_b.InitMs = 100;
+
+    // Registered leaf first, so registration order alone would boot it
+    // first
+    ASSERT_TRUE(exec.register_app(leaf).success());
+    ASSERT_TRUE(exec.register_app(mid).success());
+    ASSERT_TRUE(exec.register_app(root_b).success());
+    ASSERT_TRUE(exec.register_app(root_a).success());
+
+    EXPECT_EQ(exec.start_all().code(), iExecutor::Status::Code::OK);
+
+#if ETFW_BOOT_WORKERS > 1
+    // The roots' inits overlapped
+    EXPECT_LT(root_a.InitBegin, root_b.InitEnd);
+    EXPECT_LT(root_b.InitBegin, root_a.InitEnd);
+#else
+    // One at a time on the caller
+    EXPECT_TRUE((root_a.InitEnd < root_b.InitBegin) || (root_b.InitEnd < root_a.InitBegin));
+#endif
+
+    // Dependents init after their dependencies, and start after them
+    EXPECT_GT(mid.InitBegin, root_a.InitEnd);
+    EXPECT_GT(mid.InitBegin, root_b.InitEnd);
+    EXPECT_GT(leaf.InitBegin, mid.InitEnd);
+    EXPECT_GT(mid.StartSeq, root_a.StartSeq);
+    EXPECT_GT(mid.StartSeq, root_b.StartSeq);
+    EXPECT_GT(leaf.StartSeq, mid.StartSeq);
+    EXPECT_TRUE(leaf.is_started());
+
+    iExecutor::BootTimes times;
+    ASSERT_TRUE(exec.boot_times(RootA::ID, times));
+    EXPECT_GE(times.InitNs, 100 * Os::NsPerMs);
+    EXPECT_GT(times.StartNs, 0);
+    ASSERT_TRUE(exec.boot_times(Leaf::ID, times));
+    EXPECT_LT(times.InitNs, 100 * Os::NsPerMs);
+    EXPECT_FALSE(exec.boot_times(120, times));
+
+    // Nothing left to boot
+    EXPECT_EQ(exec.start_all().code(), iExecutor::Status::Code::OK);
+    ASSERT_TRUE(exec.boot_times(RootA::ID, times));
+    EXPECT_EQ(times.InitNs, 0);
+    EXPECT_EQ(times.StartNs, 0);
+
+    // Dependents stop, and finish, before their dependencies are asked to.
+    // An app stopped before its runner started skips cleanup, so let
+    // them all run first.
+    using State_t = etfw::iSvcRunner::State_t;
+    ASSERT_TRUE(event_runner::wait_for([]() {
+            return leaf.get_runner()->state() == State_t::ACTIVE &&
+                mid.get_runner()->state() == State_t::ACTIVE &&
+                root_a.get_runner()->state() == State_t::ACTIVE &&
+                root_b.get_runner()->state() == State_t::ACTIVE;
+        }, std::chrono::milliseconds(1000)));
+    EXPECT_EQ(exec.stop_all().code(), iExecutor::Status::Code::OK);
+    EXPECT_GT(mid.StopSeq, leaf.StoppedSeq);
+    EXPECT_GT(root_a.StopSeq, mid.StoppedSeq);
+    EXPECT_GT(root_b.StopSeq, mid.StoppedSeq);
+    EXPECT_NE(root_a.StoppedSeq, SIZE_MAX);
+    EXPECT_NE(root_b.StoppedSeq, SIZE_MAX);
+}
+
+using Failing = BootApp<BootCfg<104, SvcDeps<>>>;
+using OnFailing = BootApp<BootCfg<105, SvcDeps<104>>>;
+using OnMissing = BootApp<BootCfg<106, SvcDeps<120>>>;
+using Independent = BootApp<BootCfg<107, SvcDeps<>>>;
+
+TEST(Boot, SkipsAppsOnFailedDependencies)
+{
+    static Failing failing;
+    static OnFailing on_failing;
+    static OnMissing on_missing;
+    static Independent independent;
+    static etfw::Executor<4> exec;
+    failing.Fail = true;
+
+    ASSERT_TRUE(exec.register_app(failing).success());
+    ASSERT_TRUE(exec.register_app(on_failing).success());
+    ASSERT_TRUE(exec.register_app(on_missing).success());
+    ASSERT_TRUE(exec.register_app(independent).success());
+
+    EXPECT_FALSE(exec.start_all().success());
+    EXPECT_NE(failing.InitEnd, SIZE_MAX);
+    EXPECT_EQ(on_failing.InitBegin, SIZE_MAX);
+    EXPECT_EQ(on_missing.InitBegin, SIZE_MAX);
+    EXPECT_FALSE(failing.is_started());
+    EXPECT_FALSE(on_failing.is_started());
+    EXPECT_FALSE(on_missing.is_started());
+
+    // Unrelated apps still boot
+    EXPECT_TRUE(independent.is_started());
+
+    EXPECT_EQ(exec.stop_all().code(), iExecutor::Status::Code::OK);
+
+    // Cycles registered at run time are skipped too
+    static SelfDep self_dep;
+    static etfw::Executor<1> cyclic;
+    ASSERT_TRUE(cyclic.register_app(self_dep).success());
+    EXPECT_EQ(cyclic.start_all().code(), iExecutor::Status::Code::DEPENDENCY_ERR);
+    EXPECT_EQ(self_dep.InitBegin, SIZE_MAX);
+}
+
+}
@@ -0,0 +1,380 @@
+#include "ut_framework.hpp"
+
+// Coroutine services need C++20 (-DENABLE_COROUTINES=ON)
+#if defined(__cpp_impl_coroutine)
+
+#include <etfw/svcs/co/CoApp.hpp>
+#include <etfw/svcs/SvcCfg.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using etfw::co::Task;
+
+template <typename TPred>
+bool wait_for(TPred&& pred, const std::chrono::milliseconds timeout)
+{
+    const auto end = std::chrono::steady_clock::now() + timeout;
+    while (!pred())
+    {
+        if (std::chrono::steady_clock::now() > end)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+/// Owns a frame arena and scheduler, and is driven by hand
+template <size_t TFrameSz, size_t TNumFrames>
+struct Harness
+{
+    etfw::co::FrameArena<TFrameSz, TNumFrames> Frames;
+    etfw::co::StaticScheduler<TNumFrames> Sched;
+    size_t Steps = 0;
+
+    etfw::co::iFrameArena& co_frames() { return Frames; }
+
+    Task step(const size_t n)
+    {
+        Steps += n;
+        co_return;
+    }
+
+    Task yield_twice()
+    {
+        Steps++;
+        co_await Sched.yield();
+        Steps++;
+        co_await Sched.yield();
+        co_await step(10);
+    }
+
+    Task nap(const Os::TimeMs_t t_ms)
+    {
+        co_await Sched.sleep_for(t_ms);
+        Steps++;
+    }
+
+    /// Dispatch until no task is left, or the time runs out
+    void run_for(const Os::TimeMs_t t_ms)
+    {
+        const Os::TimeNs_t end = Os::Clock::now_ns() + (t_ms * Os::NsPerMs);
+        while (Sched.active() > 0 && Os::Clock::now_ns() < end)
+        {
+            Sched.dispatch(Os::Clock::now_ns());
+        }
+    }
+};
+
+TEST(CoTask, SchedulerRunsSpawnedTasks)
+{
+    static Harness<512, 4> h;
+
+    ASSERT_TRUE(h.Sched.spawn(h.yield_twice()));
+    EXPECT_EQ(h.Steps, 0);
+    EXPECT_EQ(h.Sched.deadline_ns(), 0);
+
+    // One dispatch per yield. The awaited task runs inline.
+    h.Sched.dispatch(Os::Clock::now_ns());
+    EXPECT_EQ(h.Steps, 1);
+    h.Sched.dispatch(Os::Clock::now_ns());
+    EXPECT_EQ(h.Steps, 2);
+    EXPECT_EQ(h.Frames.in_use(), 1);
+    h.Sched.dispatch(Os::Clock::now_ns());
+    EXPECT_EQ(h.Steps, 12);
+    EXPECT_EQ(h.Sched.active(), 0);
+    EXPECT_EQ(h.Frames.in_use(), 0);
+    EXPECT_EQ(h.Frames.peak(), 2);
+
+    // Sleepers set the deadline and wake in order
+    h.Steps = 0;
+    const Os::TimeNs_t start = Os::Clock::now_ns();
+    ASSERT_TRUE(h.Sched.spawn(h.nap(20)));
+    ASSERT_TRUE(h.Sched.spawn(h.nap(5)));
+    h.Sched.dispatch(start);
+    EXPECT_GE(h.Sched.deadline_ns(), start + (5 * Os::NsPerMs));
+    EXPECT_LT(h.Sched.deadline_ns(), Os::TimeNsNever);
+    h.run_for(1000);
+    EXPECT_EQ(h.Steps, 2);
+    EXPECT_GE(Os::Clock::now_ns() - start, 20 * Os::NsPerMs);
+    EXPECT_EQ(h.Sched.deadline_ns(), Os::TimeNsNever);
+    EXPECT_EQ(h.Frames.in_use(), 0);
+}
+
+TEST(CoTask, FramesComeFromTheArena)
+{
+    // Out of frames: the task is empty and can't be spawned
+    static Harness<512, 2> h;
+    ASSERT_TRUE(h.Sched.spawn(h.nap(1000)));
+    ASSERT_TRUE(h.Sched.spawn(h.nap(1000)));
+    Task task = h.step(1);
+    EXPECT_FALSE(task.valid());
+    EXPECT_FALSE(h.Sched.spawn(std::move(task)));
+    EXPECT_EQ(h.Frames.failures(), 1);
+    EXPECT_GT(h.Frames.largest(), 0);
+
+    // Suspended tasks are destroyed and their frames returned
+    h.Sched.dispatch(Os::Clock::now_ns());
+    h.Sched.destroy_all();
+    EXPECT_EQ(h.Frames.in_use(), 0);
+    EXPECT_EQ(h.Sched.deadline_ns(), Os::TimeNsNever);
+    ASSERT_TRUE(h.Sched.spawn(h.step(1)));
+    h.run_for(100);
+    EXPECT_EQ(h.Steps, 1);
+
+    // Frames larger than a block fail
+    static Harness<16, 4> tiny;
+    EXPECT_FALSE(tiny.step(1).valid());
+    EXPECT_GT(tiny.Frames.largest(), tiny.Frames.frame_size());
+}
+
+// ~~~~~~~~ Coroutine apps ~~~~~~~~
+
+using etfw::msg::MsgType_t;
+
+constexpr uint32_t NumPublishers = 4;
+
+/// Tagged with its publisher and per publisher sequence number
+struct SeqMsg : public etfw::msg::iBaseMsg
+{
+    static constexpr etfw::msg::MsgId_t ID = etfw::msg::to_msg_id<92, MsgType_t::TLM, 1>();
+    uint32_t Publisher;
+    uint32_t Seq;
+
+    SeqMsg(uint32_t publisher, uint32_t seq):
+        iBaseMsg(ID, sizeof(SeqMsg)), Publisher(publisher), Seq(seq) {}
+};
+
+/// Takes messages from a pipe on a task, checking each publisher's order
+struct Collector : public Harness<512, 2>
+{
+    etfw::co::Pipe<128> Pipe;
+    uint32_t Next[NumPublishers] = {};
+    size_t OutOfOrder = 0;
+    size_t Received = 0;
+
+    Task collect(const size_t total)
+    {
+        while (Received < total)
+        {
+            etfw::msg::SharedMsg sm = co_await Pipe.next(100);
+            if (!sm.is_valid())
+            {
+                continue;
+            }
+            const SeqMsg& msg = etfw::msg::convert<SeqMsg>(sm.get_message());
+            if (msg.Seq != Next[msg.Publisher])
+            {
+                OutOfOrder++;
+            }
+            Next[msg.Publisher] = msg.Seq + 1;
+            Received++;
+        }
+    }
+};
+
+TEST(CoPipe, ManyPublishers)
+{
+    constexpr uint32_t NumSends = 2000;
+    constexpr size_t Total = NumPublishers * NumSends;
+    etfw::msg::Broker broker;
+    Collector c;
+    c.Pipe.subscription().subscribe(SeqMsg::ID);
+    broker.subscribe(c.Pipe.subscription());
+    ASSERT_TRUE(c.Sched.spawn(c.collect(Total)));
+
+    std::vector<std::thread> publishers;
+    for (uint32_t p = 0; p < NumPublishers; p++)
+    {
+        publishers.emplace_back([&broker, p]()
+        {
+            for (uint32_t i = 0; i < NumSends; i++)
+            {
+                // Wait for the task to return buffers instead of dropping
+                // on a full pool
+                etfw::msg::Buf* buf = broker.get_message_buf(sizeof(SeqMsg));
+                while (buf == nullptr)
+                {
+                    std::this_thread::yield();
+                    buf = broker.get_message_buf(sizeof(SeqMsg));
+                }
+                new (buf->data()) SeqMsg(p, i);
+                broker.send_buf(*buf);
+            }
+        });
+    }
+
+    const Os::TimeNs_t end = Os::Clock::now_ns() + (30 * Os::NsPerSec);
+    while (c.Sched.active() > 0 && Os::Clock::now_ns() < end)
+    {
+        const Os::TimeNs_t now = Os::Clock::now_ns();
+        c.Pipe.dispatch(now);
+        c.Sched.dispatch(now);
+        std::this_thread::yield();
+    }
+    for (auto& publisher: publishers)
+    {
+        publisher.join();
+    }
+
+    EXPECT_EQ(c.Sched.active(), 0);
+    EXPECT_EQ(c.Received, Total);
+    EXPECT_EQ(c.OutOfOrder, 0);
+    EXPECT_EQ(c.Pipe.dropped(), 0);
+    for (uint32_t p = 0; p < NumPublishers; p++)
+    {
+        EXPECT_EQ(c.Next[p], NumSends);
+    }
+    broker.unsubscribe(c.Pipe);
+}
+
+struct Cmd : public etfw::msg::iBaseMsg
+{
+    static constexpr etfw::msg::MsgId_t ID = etfw::msg::to_msg_id<90, MsgType_t::CMD, 1>();
+    uint32_t Val;
+
+    Cmd(uint32_t val): iBaseMsg(ID, sizeof(Cmd)), Val(val) {}
+};
+
+struct Resp : public etfw::msg::iBaseMsg
+{
+    static constexpr etfw::msg::MsgId_t ID = etfw::msg::to_msg_id<90, MsgType_t::RESP, 1>();
+    uint32_t Val;
+
+    Resp(uint32_t val): iBaseMsg(ID, sizeof(Resp)), Val(val) {}
+};
+
+/// Nobody answers it
+struct LostResp : public etfw::msg::iBaseMsg
+{
+    static constexpr etfw::msg::MsgId_t ID = etfw::msg::to_msg_id<90, MsgType_t::RESP, 2>();
+
+    LostResp(): iBaseMsg(ID, sizeof(LostResp)) {}
+};
+
+struct ServerCfg : public etfw::SvcCfg<90, etfw::EventSvcCfg<0, 8192>>
+{
+    static constexpr const char* NAME = "CO_SERVER";
+};
+
+struct ClientCfg : public etfw::SvcCfg<91, etfw::EventSvcCfg<0, 8192>>
+{
+    static constexpr const char* NAME = "CO_CLIENT";
+};
+
+/// Answers each command with twice its value
+class Server : public etfw::CoApp<Server, ServerCfg>
+{
+    public:
+        Server()
+        {
+            cmds_.subscription().subscribe(Cmd::ID);
+            add_event_source(cmds_);
+        }
+
+        Status app_init()
+        {
+            subscribe_cmd(cmds_.subscription());
+            return Status::Code::OK;
+        }
+
+        Status app_cleanup() { return Status::Code::OK; }
+
+        Task run()
+        {
+            while (true)
+            {
+                etfw::msg::SharedMsg sm = co_await cmds_.next();
+                const Cmd& cmd = etfw::msg::convert<Cmd>(sm.get_message());
+                send_cmd<Resp>(cmd.Val * 2);
+                Served++;
+            }
+        }
+
+        inline const etfw::iEventRunnerExt& runner_ext() const { return Runner; }
+
+        std::atomic<size_t> Served{0};
+
+    private:
+        etfw::co::Pipe<4> cmds_;
+};
+
+/// Makes requests from two tasks, then returns
+class Client : public etfw::CoApp<Client, ClientCfg>
+{
+    public:
+        static constexpr uint32_t NumRequests = 50;
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        Task run()
+        {
+            spawn(napper());
+            for (uint32_t i = 0; i < NumRequests; i++)
+            {
+                etfw::msg::SharedMsg sm = co_await request<Resp>(Cmd(i));
+                if (sm.is_valid() && etfw::msg::convert<Resp>(sm.get_message()).Val == (2 * i))
+                {
+                    Answered++;
+                }
+            }
+
+            etfw::msg::SharedMsg lost = co_await request<LostResp>(Cmd(0), 20);
+            TimedOut = !lost.is_valid();
+        }
+
+        Task napper()
+        {
+            const Os::TimeNs_t start = Os::Clock::now_ns();
+            co_await sleep_for(10);
+            SleptNs = Os::Clock::now_ns() - start;
+        }
+
+        inline const etfw::iEventRunnerExt& runner_ext() const { return Runner; }
+
+        std::atomic<size_t> Answered{0};
+        std::atomic<bool> TimedOut{false};
+        std::atomic<Os::TimeNs_t> SleptNs{0};
+};
+
+TEST(CoApp, RequestsAndSleepsOnOneThread)
+{
+    static Server server;
+    static Client client;
+    ASSERT_TRUE(server.init().success());
+    ASSERT_TRUE(client.init().success());
+    ASSERT_TRUE(server.start().success());
+    ASSERT_TRUE(client.start().success());
+
+    // The client exits once both of its tasks return
+    ASSERT_TRUE(wait_for([]() {
+            return client.runner_ext().state() == etfw::iSvcRunner::State_t::EXITED;
+        }, std::chrono::milliseconds(5000)));
+    EXPECT_EQ(client.Answered, Client::NumRequests);
+    EXPECT_TRUE(client.TimedOut);
+    EXPECT_GE(client.SleptNs, 10 * Os::NsPerMs);
+    EXPECT_EQ(client.co_frames().in_use(), 0);
+    EXPECT_EQ(client.co_frames().failures(), 0);
+    EXPECT_EQ(server.Served, Client::NumRequests + 1);
+
+    // Stopping destroys the server task, suspended on its pipe
+    EXPECT_EQ(server.scheduler().active(), 1);
+    ASSERT_TRUE(server.stop().success());
+    ASSERT_TRUE(wait_for([]() {
+            return server.runner_ext().state() == etfw::iSvcRunner::State_t::STOPPED;
+        }, std::chrono::milliseconds(2000)));
+    EXPECT_EQ(server.scheduler().active(), 0);
+    EXPECT_EQ(server.co_frames().in_use(), 0);
+}
+
+}
+
+#endif
@@ -0,0 +1,277 @@
+#include "ut_framework.hpp"
+
+#include <etfw/os/Fiber.hpp>
+#include <etfw/msg/BlockingMsgQueue.hpp>
+#include <etfw/svcs/App.hpp>
+#include <etfw/svcs/SvcCfg.hpp>
+#include <etfw/svcs/FiberScheduler.hpp>
+
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+
+template <typename TPred>
+bool wait_for(TPred&& pred, const std::chrono::milliseconds timeout)
+{
+    const auto end = std::chrono::steady_clock::now() + timeout;
+    while (!pred())
+    {
+        if (std::chrono::steady_clock::now() > end)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+constexpr size_t StackWords = 4096;
+alignas(16) Os::Fiber::Stack_t::Buf_t fiber_stack[StackWords];
+
+struct Counter
+{
+    size_t Steps;
+    size_t Yields;
+};
+
+void count_and_yield(void* arg)
+{
+    Counter& counter = *static_cast<Counter*>(arg);
+    for (size_t i = 0; i < counter.Yields; i++)
+    {
+        counter.Steps++;
+        Os::Fiber::yield();
+    }
+    counter.Steps++;
+}
+
+TEST(Fiber, YieldsAndReturns)
+{
+    static Os::Fiber fiber;
+    Counter counter = {0, 100};
+    EXPECT_EQ(Os::Fiber::current(), nullptr);
+    fiber.init(Os::Fiber::Stack_t(fiber_stack, StackWords), count_and_yield, &counter);
+    EXPECT_EQ(fiber.state(), Os::Fiber::State::READY);
+
+    size_t resumes = 0;
+    while (fiber.state() != Os::Fiber::State::IDLE)
+    {
+        fiber.resume();
+        resumes++;
+        EXPECT_EQ(counter.Steps, resumes);
+    }
+    EXPECT_EQ(resumes, counter.Yields + 1);
+    EXPECT_EQ(Os::Fiber::current(), nullptr);
+
+    // Reusable once finished
+    counter = {0, 3};
+    fiber.init(Os::Fiber::Stack_t(fiber_stack, StackWords), count_and_yield, &counter);
+    while (fiber.state() != Os::Fiber::State::IDLE)
+    {
+        fiber.resume();
+    }
+    EXPECT_EQ(counter.Steps, 4);
+}
+
+constexpr size_t GuardBytes = OS_FIBER_STACK_GUARD_WORDS * sizeof(Os::Fiber::Stack_t::Buf_t);
+
+/// Bytes each recurse call writes. Well under the guard, so that with
+/// call overhead a frame still can't step over it.
+constexpr size_t FrameBytes = 64;
+static_assert(FrameBytes * 2 <= GuardBytes, "Test frames must be smaller than the fiber stack guard");
+
+struct StackUse
+{
+    size_t Depth;
+    uintptr_t Limit;    //< Lowest stack address
+};
+
+/// Writes every byte of a FrameBytes frame per call, depth calls deep or
+/// until a frame lands in the guard words above limit. Frames are
+/// closer together than the guard is wide, so the last one stops inside
+/// it rather than past the stack.
+size_t recurse(const size_t depth, const uintptr_t limit)
+{
+    volatile uint8_t frame[FrameBytes];
+    for (size_t i = 0; i < FrameBytes; i++)
+    {
+        frame[i] = static_cast<uint8_t>(depth + i);
+    }
+    if (depth == 0 || reinterpret_cast<uintptr_t>(&frame[0]) < (limit + GuardBytes))
+    {
+        return frame[0];
+    }
+    return frame[FrameBytes - 1] + recurse(depth - 1, limit);
+}
+
+void use_stack(void* arg)
+{
+    const StackUse& use = *static_cast<StackUse*>(arg);
+    recurse(use.Depth, use.Limit);
+}
+
+TEST(Fiber, StackHighWaterMark)
+{
+    static Os::Fiber fiber;
+    StackUse use = {1, reinterpret_cast<uintptr_t>(fiber_stack)};
+    fiber.init(Os::Fiber::Stack_t(fiber_stack, StackWords), use_stack, &use);
+    fiber.resume();
+    const size_t shallow = fiber.stack_used();
+    EXPECT_GT(shallow, 0);
+    EXPECT_LT(shallow, 2048);
+    EXPECT_FALSE(fiber.stack_overflowed());
+
+    use.Depth = 40;
+    fiber.init(Os::Fiber::Stack_t(fiber_stack, StackWords), use_stack, &use);
+    fiber.resume();
+    EXPECT_GE(fiber.stack_used(), 40 * FrameBytes);
+    EXPECT_LT(fiber.stack_used(), fiber.stack_bytes() - GuardBytes);
+    EXPECT_FALSE(fiber.stack_overflowed());
+
+    // Reaching the guard words is reported
+    use.Depth = SIZE_MAX;
+    fiber.init(Os::Fiber::Stack_t(fiber_stack, StackWords), use_stack, &use);
+    fiber.resume();
+    EXPECT_TRUE(fiber.stack_overflowed());
+    EXPECT_LE(fiber.stack_used(), fiber.stack_bytes());
+}
+
+// ~~~~~~~~ Fiber services ~~~~~~~~
+
+constexpr uint64_t NumRoundTrips = 2000;
+constexpr Os::TimeMs_t WaitMs = 100;
+
+struct Link
+{
+    etfw::msg::BlockingMsgQueue<uint64_t, 4> Ping;
+    etfw::msg::BlockingMsgQueue<uint64_t, 4> Pong;
+    etfw::msg::BlockingMsgQueue<uint64_t, 4> Idle;  //< Never written
+};
+
+struct EchoCfg : public etfw::SvcCfg<70, etfw::FiberSvcCfg<4096>>
+{
+    static constexpr const char* NAME = "FIBER_ECHO";
+};
+
+struct InitiatorCfg : public etfw::SvcCfg<71, etfw::FiberSvcCfg<4096>>
+{
+    static constexpr const char* NAME = "FIBER_INIT";
+};
+
+/// Blocks on the ping queue and sends each ping back
+class Echo : public etfw::App<Echo, EchoCfg>
+{
+    public:
+        Echo(Link& link): link_(link) {}
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        RunState run_loop()
+        {
+            Thread = pthread_self();
+            uint64_t seq = 0;
+            if (link_.Ping.front(seq, WaitMs))
+            {
+                link_.Pong.emplace(seq);
+            }
+            return RunState::OK;
+        }
+
+        inline const etfw::iFiberRunnerExt& runner_ext() const { return Runner; }
+
+        pthread_t Thread;
+
+    private:
+        Link& link_;
+};
+
+/// Sends pings and blocks on each reply
+class Initiator : public etfw::App<Initiator, InitiatorCfg>
+{
+    public:
+        Initiator(Link& link): link_(link) {}
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        RunState run_loop()
+        {
+            Thread = pthread_self();
+            if (Done < NumRoundTrips)
+            {
+                uint64_t reply = 0;
+                link_.Ping.emplace(Done.load());
+                if (link_.Pong.front(reply, WaitMs) && reply == Done)
+                {
+                    Done++;
+                }
+                else
+                {
+                    Errors++;
+                }
+            }
+            else
+            {
+                uint64_t unused = 0;
+                link_.Idle.front(unused, WaitMs);
+            }
+            return RunState::OK;
+        }
+
+        inline const etfw::iFiberRunnerExt& runner_ext() const { return Runner; }
+
+        pthread_t Thread;
+        std::atomic<uint64_t> Done{0};
+        std::atomic<size_t> Errors{0};
+
+    private:
+        Link& link_;
+};
+
+TEST(FiberRunner, BlockingQueuesShareOneThread)
+{
+    static Link link;
+    static Echo echo(link);
+    static Initiator initiator(link);
+    ASSERT_TRUE(echo.init().success());
+    ASSERT_TRUE(initiator.init().success());
+    ASSERT_TRUE(echo.start().success());
+    ASSERT_TRUE(initiator.start().success());
+
+    ASSERT_TRUE(wait_for([]() { return initiator.Done == NumRoundTrips; },
+        std::chrono::milliseconds(5000)));
+    EXPECT_EQ(initiator.Errors, 0);
+    EXPECT_TRUE(pthread_equal(echo.Thread, initiator.Thread));
+    EXPECT_FALSE(pthread_equal(echo.Thread, pthread_self()));
+
+    // Blocked reads park the fibers. Idle, the scheduler sleeps until the
+    // next wait timeout instead of spinning.
+    const size_t switches = etfw::FiberScheduler::instance().switches();
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * WaitMs));
+    EXPECT_LT(etfw::FiberScheduler::instance().switches() - switches, 50);
+
+    // An outside thread's push unparks the echo fiber
+    link.Ping.emplace(12345);
+    uint64_t reply = 0;
+    ASSERT_TRUE(link.Pong.front(reply, 1000));
+    EXPECT_EQ(reply, 12345);
+
+    EXPECT_GT(echo.runner_ext().stack_used(), 0);
+    EXPECT_FALSE(echo.runner_ext().fiber().stack_overflowed());
+    EXPECT_FALSE(initiator.runner_ext().fiber().stack_overflowed());
+
+    ASSERT_TRUE(echo.stop().success());
+    ASSERT_TRUE(initiator.stop().success());
+    EXPECT_TRUE(wait_for([]() {
+            return echo.runner_ext().state() == etfw::iSvcRunner::State_t::STOPPED &&
+                initiator.runner_ext().state() == etfw::iSvcRunner::State_t::STOPPED;
+        }, std::chrono::milliseconds(2000)));
+    EXPECT_EQ(echo.runner_ext().fiber().state(), Os::Fiber::State::IDLE);
+}
+
+}
@@ -0,0 +1,770 @@
+#include "ut_framework.hpp"
+
+#include <etfw/svcs/log/AsyncLog.hpp>
+#include <etfw/svcs/log/BinLog.hpp>
+#include <etfw/svcs/log/FileLog.hpp>
+#include <etfw/svcs/App.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using etfw::AsyncLog;
+using etfw::LogLevel;
+
+/// Keeps every line written. Blocks while Hold is set.
+struct Capture
+{
+    static inline std::mutex Lock;
+    static inline std::vector<std::string> Lines;
+    static inline std::atomic<bool> Hold{false};
+    static inline std::atomic<bool> Held{false};
+
+    static void write(const LogLevel level, const char* line)
+    {
+        while (Hold)
+        {
+            Held = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::lock_guard<std::mutex> lock(Lock);
+        Lines.push_back(line);
+    }
+
+    static std::vector<std::string> take()
+    {
+        std::lock_guard<std::mutex> lock(Lock);
+        std::vector<std::string> lines;
+        lines.swap(Lines);
+        return lines;
+    }
+};
+
+void log(AsyncLog& logger, AsyncLog::ThreadRing& ring, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    logger.log(ring, LogLevel::INFO, "LOG_TEST", fmt, args);
+    va_end(args);
+}
+
+/// Line the console policy would write, without the timestamp
+std::string expected(const char* fmt, ...)
+{
+    char msg[ETF_MAX_LOG_MSG_SZ];
+    va_list args;
+    va_start(args, fmt);
+    std::vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+    char line[ETF_MAX_LOG_MSG_SZ + 64];
+    std::snprintf(line, sizeof(line), ETF_LOG_FMT, "LOG_TEST", "INFO", msg);
+    return line;
+}
+
+std::string strip_time(const std::string& line)
+{
+    return line.substr(line.find(' ') + 1);
+}
+
+bool contains(const std::vector<std::string>& lines, const char* text)
+{
+    for (const std::string& line: lines)
+    {
+        if (line.find(text) != std::string::npos)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+#define EXPECT_FORMAT(lines, i, ...) \
+    EXPECT_EQ(strip_time(lines.at(i)), expected(__VA_ARGS__))
+
+TEST(AsyncLog, FormatsLikePrintf)
+{
+    std::unique_ptr<AsyncLog> owner(new AsyncLog(&Capture::write));
+    AsyncLog& logger = *owner;
+    AsyncLog::ThreadRing ring;
+    Capture::take();
+
+    const char* null_str = nullptr;
+    int marker = 0;
+    log(logger, ring, "%d %i %u %x %X %o", -42, 7, 42u, 0xbeefu, 0xbeefu, 8u);
+    log(logger, ring, "%ld %lld %llu %hd %hhd %hu %zu %jd %td",
+        -1234567890123L, -1LL, ~0ULL, static_cast<short>(-3), static_cast<signed char>(-4),
+        static_cast<unsigned short>(65535), static_cast<size_t>(99), static_cast<intmax_t>(-5),
+        static_cast<ptrdiff_t>(-6));
+    log(logger, ring, "[%5d|%-5d|%05d|%+d|% d|%#x]", 12, 12, 12, 12, 12, 255u);
+    log(logger, ring, "%f %.2f %10.3e %g %G %a %Lf", 3.14159, 2.5, 12345.678, 0.0001, 1e20, 1.0,
+        static_cast<long double>(6.25));
+    log(logger, ring, "%s|%-8s|%8s|%.3s|%s", "abc", "left", "right", "truncated", null_str);
+    log(logger, ring, "%c%c 100%% %*d|%-*.*s|%n", 'o', 'k', 6, 42, 8, 3, "precise", &marker);
+    log(logger, ring, "%p", static_cast<void*>(&marker));
+    log(logger, ring, "no arguments");
+    log(logger, ring, "%d then %ls %d", 1, L"wide", 2);
+    logger.flush();
+
+    const std::vector<std::string> lines = Capture::take();
+    ASSERT_EQ(lines.size(), 9);
+    EXPECT_FORMAT(lines, 0, "%d %i %u %x %X %o", -42, 7, 42u, 0xbeefu, 0xbeefu, 8u);
+    EXPECT_FORMAT(lines, 1, "%ld %lld %llu %hd %hhd %hu %zu %jd %td",
+        -1234567890123L, -1LL, ~0ULL, static_cast<short>(-3), static_cast<signed char>(-4),
+        static_cast<unsigned short>(65535), static_cast<size_t>(99), static_cast<intmax_t>(-5),
+        static_cast<ptrdiff_t>(-6));
+    EXPECT_FORMAT(lines, 2, "[%5d|%-5d|%05d|%+d|% d|%#x]", 12, 12, 12, 12, 12, 255u);
+    EXPECT_FORMAT(lines, 3, "%f %.2f %10.3e %g %G %a %Lf", 3.14159, 2.5, 12345.678, 0.0001, 1e20, 1.0,
+        static_cast<long double>(6.25));
+    EXPECT_FORMAT(lines, 4, "%s|%-8s|%8s|%.3s|%s", "abc", "left", "right", "truncated", null_str);
+    EXPECT_FORMAT(lines, 5, "%c%c 100%% %*d|%-*.*s|", 'o', 'k', 6, 42, 8, 3, "precise");
+    EXPECT_FORMAT(lines, 6, "%p", static_cast<void*>(&marker));
+    EXPECT_FORMAT(lines, 7, "no arguments");
+
+    // Wide strings aren't supported. The rest of the format is written as is.
+    EXPECT_EQ(strip_time(lines[8]), expected("1 then %%ls %%d"));
+
+    const AsyncLog::Stats stats = logger.stats();
+    EXPECT_EQ(stats.Logged, 9);
+    EXPECT_EQ(stats.Dropped, 0);
+    EXPECT_EQ(stats.NoRing, 0);
+}
+
+TEST(AsyncLog, KeepsPerThreadOrder)
+{
+    std::unique_ptr<AsyncLog> owner(new AsyncLog(&Capture::write));
+    AsyncLog& logger = *owner;
+    Capture::take();
+
+    constexpr int NumThreads = 4;
+    constexpr int NumMsgs = 500;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NumThreads; t++)
+    {
+        threads.emplace_back([t, &logger]() {
+            AsyncLog::ThreadRing ring;
+            for (int i = 0; i < NumMsgs; i++)
+            {
+                log(logger, ring, "thread %d msg %d", t, i);
+                if ((i % 64) == 0)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& thread: threads)
+    {
+        thread.join();
+    }
+    logger.flush();
+
+    // Each thread's lines are in order. Some may be dropped.
+    int last[NumThreads] = {-1, -1, -1, -1};
+    size_t count = 0;
+    for (const std::string& line: Capture::take())
+    {
+        int t = -1;
+        int i = -1;
+        if (std::sscanf(strip_time(line).c_str(), "LOG_TEST INFO thread %d msg %d", &t, &i) == 2)
+        {
+            ASSERT_GE(t, 0);
+            ASSERT_LT(t, NumThreads);
+            EXPECT_GT(i, last[t]);
+            last[t] = i;
+            count++;
+        }
+    }
+    const AsyncLog::Stats stats = logger.stats();
+    EXPECT_EQ(stats.Logged, count);
+    EXPECT_EQ(stats.Logged + stats.Dropped, NumThreads * NumMsgs);
+    EXPECT_EQ(stats.NoRing, 0);
+}
+
+TEST(AsyncLog, DropsAndReportsOnFullRing)
+{
+    std::unique_ptr<AsyncLog> owner(new AsyncLog(&Capture::write));
+    AsyncLog& logger = *owner;
+    AsyncLog::ThreadRing ring;
+    Capture::take();
+
+    // Stall the logger thread in the sink, then overflow the ring
+    Capture::Held = false;
+    Capture::Hold = true;
+    log(logger, ring, "first");
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (!Capture::Held && std::chrono::steady_clock::now() < end)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!Capture::Held)
+    {
+        Capture::Hold = false;
+        FAIL() << "Logger thread never reached the sink";
+    }
+
+    constexpr size_t NumMsgs = (AsyncLog::RingSz / 64) + 100;
+    for (size_t i = 0; i < NumMsgs; i++)
+    {
+        log(logger, ring, "flood %d", static_cast<int>(i));
+    }
+    AsyncLog::Stats stats = logger.stats();
+    EXPECT_GT(stats.Dropped, 0);
+    EXPECT_EQ(stats.Logged + stats.Dropped, NumMsgs + 1);
+
+    // Logging never blocked. The drops are reported once the sink frees up.
+    Capture::Hold = false;
+    logger.flush();
+    log(logger, ring, "last");
+    logger.flush();
+    const std::vector<std::string> lines = Capture::take();
+    EXPECT_TRUE(contains(lines, "Dropped"));
+    EXPECT_TRUE(contains(lines, "first"));
+    EXPECT_TRUE(contains(lines, "last"));
+    EXPECT_EQ(logger.stats().Dropped, stats.Dropped);
+}
+
+TEST(AsyncLog, ReusesRingsOfExitedThreads)
+{
+    std::unique_ptr<AsyncLog> owner(new AsyncLog(&Capture::write));
+    AsyncLog& logger = *owner;
+    Capture::take();
+
+    // More threads than rings, one after another
+    constexpr int NumThreads = (AsyncLog::NumRings * 2) + 3;
+    for (int t = 0; t < NumThreads; t++)
+    {
+        std::thread thread([t, &logger]() {
+            AsyncLog::ThreadRing ring;
+            log(logger, ring, "thread %d", t);
+            logger.flush();
+        });
+        thread.join();
+    }
+    EXPECT_EQ(Capture::take().size(), NumThreads);
+    EXPECT_EQ(logger.stats().NoRing, 0);
+
+    // With every ring held, records are dropped and reported
+    AsyncLog::ThreadRing rings[AsyncLog::NumRings + 1];
+    for (AsyncLog::ThreadRing& ring: rings)
+    {
+        log(logger, ring, "held");
+    }
+    EXPECT_EQ(rings[AsyncLog::NumRings].R, nullptr);
+    EXPECT_EQ(logger.stats().NoRing, 1);
+    logger.flush();
+    log(logger, rings[0], "again");
+    logger.flush();
+    const std::vector<std::string> lines = Capture::take();
+    EXPECT_TRUE(contains(lines, "no free ring"));
+    EXPECT_TRUE(contains(lines, "again"));
+}
+
+TEST(AsyncLog, LoggerPolicy)
+{
+    using Log = etfw::Logger<etfw::AsyncLogPolicy<Capture>>;
+    Capture::take();
+
+    Log::log(LogLevel::WARNING, "POLICY", "value %d of %s", 3, "three");
+    Log::log(LogLevel::ERROR, "plain message");
+    etfw::AsyncLogPolicy<Capture>::flush();
+
+    const std::vector<std::string> lines = Capture::take();
+    ASSERT_EQ(lines.size(), 2);
+    char line[128];
+    std::snprintf(line, sizeof(line), ETF_LOG_FMT, "POLICY", "WARNING", "value 3 of three");
+    EXPECT_EQ(strip_time(lines[0]), line);
+    EXPECT_NE(lines[1].find("plain message"), std::string::npos);
+    EXPECT_NE(lines[1].find("ERROR"), std::string::npos);
+}
+
+// ~~~~~~~~ Log levels ~~~~~~~~
+
+struct QuietCfg : public etfw::SvcCfg<140, etfw::PassiveSvcCfg>
+{
+    static constexpr const char* NAME = "LOG_QUIET";
+    static constexpr LogLevel LOG_LEVEL = LogLevel::WARNING;
+};
+
+struct LoudCfg : public etfw::SvcCfg<141, etfw::PassiveSvcCfg>
+{
+    static constexpr const char* NAME = "LOG_LOUD";
+};
+
+template <typename Cfg>
+class LevelApp : public etfw::App<LevelApp<Cfg>, Cfg>
+{
+    public:
+        using Base_t = etfw::App<LevelApp<Cfg>, Cfg>;
+        using Status = typename Base_t::Status;
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        void say(const LogLevel level, const char* msg)
+        {
+            this->log(level, "said %s", msg);
+        }
+};
+
+static_assert(LevelApp<QuietCfg>::LOG_LEVEL == LogLevel::WARNING);
+static_assert(LevelApp<LoudCfg>::LOG_LEVEL == etfw::LogLevelMin);
+
+TEST(LogLevel, FiltersByCfgAndRuntimeLevel)
+{
+    static LevelApp<QuietCfg> quiet;
+    static LevelApp<LoudCfg> loud;
+    EXPECT_EQ(quiet.log_level(), LogLevel::WARNING);
+    EXPECT_EQ(loud.log_level(), etfw::LogLevelMin);
+    EXPECT_FALSE(quiet.log_enabled(LogLevel::INFO));
+    EXPECT_TRUE(quiet.log_enabled(LogLevel::ERROR));
+
+    etfw::iSvc::AccessProxy proxy(&quiet);
+    testing::internal::CaptureStdout();
+    quiet.say(LogLevel::DEBUG, "compiled out");
+    quiet.say(LogLevel::WARNING, "warning");
+    loud.say(LogLevel::INFO, "loud info");
+    proxy.log(LogLevel::INFO, "proxy %s", "info");
+    proxy.log(LogLevel::ERROR, "proxy %s", "error");
+
+    // The runtime level filters every path to the service's log
+    quiet.set_log_level(LogLevel::ERROR);
+    loud.set_log_level(LogLevel::ERROR);
+    quiet.say(LogLevel::WARNING, "filtered warning");
+    loud.say(LogLevel::INFO, "filtered info");
+    proxy.log(LogLevel::WARNING, "proxy %s", "filtered");
+    quiet.say(LogLevel::CRITICAL, "critical");
+
+    // Lowering it doesn't bring back what the Cfg compiled out
+    quiet.set_log_level(LogLevel::DEBUG);
+    quiet.say(LogLevel::INFO, "still compiled out");
+    EXPECT_FALSE(quiet.log_enabled(LogLevel::INFO));
+    proxy.log(LogLevel::INFO, "proxy %s", "compiled out");
+    loud.set_log_level(LogLevel::DEBUG);
+    const std::string out = testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(out.find("compiled out"), std::string::npos);
+    EXPECT_EQ(out.find("filtered"), std::string::npos);
+    EXPECT_EQ(out.find("proxy info"), std::string::npos);
+    EXPECT_NE(out.find("said warning"), std::string::npos);
+    EXPECT_NE(out.find("said loud info"), std::string::npos);
+    EXPECT_NE(out.find("proxy error"), std::string::npos);
+    EXPECT_NE(out.find("said critical"), std::string::npos);
+}
+
+// ~~~~~~~~ Binary log ~~~~~~~~
+
+using etfw::BinLog;
+using etfw::BinLogReader;
+
+void blog(BinLog& logger, const LogLevel level, const char* caller, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    logger.log(level, caller, fmt, args);
+    va_end(args);
+}
+
+std::string printed(const char* fmt, ...)
+{
+    char msg[ETF_MAX_LOG_MSG_SZ];
+    va_list args;
+    va_start(args, fmt);
+    std::vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+    return msg;
+}
+
+std::string bin_log_path(const char* name)
+{
+    return testing::TempDir() + name;
+}
+
+TEST(BinLog, RoundTripsRecords)
+{
+    std::unique_ptr<BinLog> logger(new BinLog());
+    std::unique_ptr<BinLogReader> reader(new BinLogReader());
+    BinLogReader::Entry entry;
+    const std::string path = bin_log_path("etfw_bin_log_round_trip.bin");
+
+    blog(*logger, LogLevel::INFO, "SVC_A", "not open");
+    EXPECT_EQ(logger->stats().Dropped, 1);
+    ASSERT_TRUE(logger->open(path.c_str()).success());
+
+    const char* long_caller = "A_CALLER_NAME_LONGER_THAN_THE_REGISTRY_KEEPS";
+    const Os::TimeNs_t start = Os::Clock::now_ns();
+    for (int i = 0; i < 3; i++)
+    {
+        blog(*logger, LogLevel::DEBUG, "SVC_A", "cycle %d took %u us, %s", i, 125u, "ok");
+        blog(*logger, LogLevel::WARNING, "SVC_B", "%ld %+.3f %-6s|%c %p", -1234567890123L, 2.5,
+            "ab", 'z', static_cast<void*>(logger.get()));
+    }
+    blog(*logger, LogLevel::CRITICAL, long_caller, "%s", "last");
+    blog(*logger, LogLevel::ERROR, nullptr, "no caller");
+    const Os::TimeNs_t end = Os::Clock::now_ns();
+    ASSERT_TRUE(logger->close().success());
+
+    const BinLog::Stats stats = logger->stats();
+    EXPECT_EQ(stats.Records, 8);
+    EXPECT_EQ(stats.Blocks, 1);
+    EXPECT_EQ(stats.Dropped, 1);
+
+    ASSERT_TRUE(reader->open(path.c_str()).success());
+    Os::TimeNs_t last = start;
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE(reader->next(entry));
+        EXPECT_EQ(entry.Level, LogLevel::DEBUG);
+        EXPECT_STREQ(entry.Caller, "SVC_A");
+        EXPECT_STREQ(entry.Fmt, "cycle %d took %u us, %s");
+        EXPECT_EQ(entry.Msg, printed("cycle %d took %u us, %s", i, 125u, "ok"));
+        EXPECT_GE(entry.TimeNs, last);
+        last = entry.TimeNs;
+
+        ASSERT_TRUE(reader->next(entry));
+        EXPECT_EQ(entry.Level, LogLevel::WARNING);
+        EXPECT_STREQ(entry.Caller, "SVC_B");
+        EXPECT_EQ(entry.Msg, printed("%ld %+.3f %-6s|%c %p", -1234567890123L, 2.5,
+            "ab", 'z', static_cast<void*>(logger.get())));
+        EXPECT_GE(entry.TimeNs, last);
+        last = entry.TimeNs;
+    }
+    ASSERT_TRUE(reader->next(entry));
+    EXPECT_EQ(entry.Level, LogLevel::CRITICAL);
+    EXPECT_EQ(std::string(entry.Caller), std::string(long_caller, ETF_BIN_LOG_CALLER_SZ - 1));
+    EXPECT_STREQ(entry.Msg, "last");
+    ASSERT_TRUE(reader->next(entry));
+    EXPECT_EQ(entry.Level, LogLevel::ERROR);
+    EXPECT_STREQ(entry.Caller, "");
+    EXPECT_STREQ(entry.Msg, "no caller");
+    EXPECT_LE(entry.TimeNs, end);
+    EXPECT_FALSE(reader->next(entry));
+    EXPECT_FALSE(reader->corrupt());
+    std::remove(path.c_str());
+}
+
+TEST(BinLog, SpansBlocksAndFallsBackWhenFull)
+{
+    std::unique_ptr<BinLog> logger(new BinLog());
+    std::unique_ptr<BinLogReader> reader(new BinLogReader());
+    BinLogReader::Entry entry;
+    const std::string path = bin_log_path("etfw_bin_log_blocks.bin");
+    ASSERT_TRUE(logger->open(path.c_str()).success());
+
+    // More formats than the registry holds. The last ones are logged as
+    // text under format 0.
+    constexpr int NumFmts = ETF_BIN_LOG_FMTS + 16;
+    std::vector<std::string> fmts;
+    fmts.reserve(NumFmts);
+    for (int i = 0; i < NumFmts; i++)
+    {
+        fmts.push_back("format " + std::to_string(i) + " value %d");
+    }
+    constexpr int NumMsgs = 10000;
+    for (int i = 0; i < NumMsgs; i++)
+    {
+        blog(*logger, LogLevel::INFO, "SVC", fmts[i % NumFmts].c_str(), i);
+    }
+    ASSERT_TRUE(logger->close().success());
+    const BinLog::Stats stats = logger->stats();
+    EXPECT_EQ(stats.Records, NumMsgs);
+    EXPECT_EQ(stats.Dropped, 0);
+    EXPECT_GT(stats.Blocks, 1);
+    EXPECT_LT(stats.Bytes, stats.Blocks * ETF_BIN_LOG_BLOCK_SZ);
+
+    ASSERT_TRUE(reader->open(path.c_str()).success());
+    for (int i = 0; i < NumMsgs; i++)
+    {
+        ASSERT_TRUE(reader->next(entry)) << i;
+        EXPECT_EQ(entry.Msg, printed(fmts[i % NumFmts].c_str(), i));
+        if ((i % NumFmts) >= (ETF_BIN_LOG_FMTS - 1))
+        {
+            EXPECT_STREQ(entry.Fmt, "%s");
+        }
+    }
+    EXPECT_FALSE(reader->next(entry));
+    EXPECT_FALSE(reader->corrupt());
+
+    // A damaged block stops the reader after the blocks before it
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    ASSERT_NE(file, nullptr);
+    std::fseek(file, ETF_BIN_LOG_BLOCK_SZ, SEEK_SET);
+    std::fputc(0, file);
+    std::fclose(file);
+    ASSERT_TRUE(reader->open(path.c_str()).success());
+    int count = 0;
+    while (reader->next(entry))
+    {
+        count++;
+    }
+    EXPECT_GT(count, 0);
+    EXPECT_LT(count, NumMsgs);
+    EXPECT_TRUE(reader->corrupt());
+    std::remove(path.c_str());
+}
+
+TEST(BinLog, KeepsPerThreadOrder)
+{
+    std::unique_ptr<BinLog> logger(new BinLog());
+    std::unique_ptr<BinLogReader> reader(new BinLogReader());
+    BinLogReader::Entry entry;
+    const std::string path = bin_log_path("etfw_bin_log_threads.bin");
+    ASSERT_TRUE(logger->open(path.c_str()).success());
+
+    constexpr int NumThreads = 4;
+    constexpr int NumMsgs = 2000;
+    static const char* const Callers[NumThreads] = {"T0", "T1", "T2", "T3"};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NumThreads; t++)
+    {
+        threads.emplace_back([t, &logger]() {
+            for (int i = 0; i < NumMsgs; i++)
+            {
+                blog(*logger, LogLevel::INFO, Callers[t], "thread %d msg %d", t, i);
+            }
+        });
+    }
+    for (std::thread& thread: threads)
+    {
+        thread.join();
+    }
+    ASSERT_TRUE(logger->close().success());
+
+    // Every record is there, each thread's in order, and time never
+    // goes back
+    ASSERT_TRUE(reader->open(path.c_str()).success());
+    int next[NumThreads] = {0, 0, 0, 0};
+    Os::TimeNs_t last = 0;
+    int count = 0;
+    while (reader->next(entry))
+    {
+        int t = -1;
+        int i = -1;
+        ASSERT_EQ(std::sscanf(entry.Msg, "thread %d msg %d", &t, &i), 2);
+        ASSERT_GE(t, 0);
+        ASSERT_LT(t, NumThreads);
+        EXPECT_STREQ(entry.Caller, Callers[t]);
+        EXPECT_EQ(i, next[t]);
+        next[t] = i + 1;
+        EXPECT_GE(entry.TimeNs, last);
+        last = entry.TimeNs;
+        count++;
+    }
+    EXPECT_FALSE(reader->corrupt());
+    EXPECT_EQ(count, NumThreads * NumMsgs);
+    std::remove(path.c_str());
+}
+
+TEST(BinLog, WritesPartBlocksOnTime)
+{
+    std::unique_ptr<BinLog> logger(new BinLog());
+    std::unique_ptr<BinLogReader> reader(new BinLogReader());
+    BinLogReader::Entry entry;
+    const std::string path = bin_log_path("etfw_bin_log_timed.bin");
+
+    // With no flush period, a part block waits for flush
+    ASSERT_TRUE(logger->open(path.c_str(), 0).success());
+    blog(*logger, LogLevel::INFO, "SVC", "held %d", 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(logger->stats().Blocks, 0);
+    ASSERT_TRUE(logger->flush().success());
+    EXPECT_EQ(logger->stats().Blocks, 1);
+
+    // The flusher writes it without being asked
+    ASSERT_TRUE(logger->open(path.c_str(), 5).success());
+    const uint64_t blocks = logger->stats().Blocks;
+    blog(*logger, LogLevel::INFO, "SVC", "on time %d", 2);
+    const Os::TimeNs_t deadline = Os::Clock::now_ns() + Os::NsPerSec;
+    while (logger->stats().Blocks == blocks && Os::Clock::now_ns() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(logger->stats().Blocks, blocks + 1);
+
+    ASSERT_TRUE(reader->open(path.c_str()).success());
+    ASSERT_TRUE(reader->next(entry));
+    EXPECT_STREQ(entry.Msg, "on time 2");
+    EXPECT_FALSE(reader->next(entry));
+    EXPECT_FALSE(reader->corrupt());
+    ASSERT_TRUE(logger->close().success());
+    EXPECT_EQ(logger->stats().Blocks, blocks + 1);
+    std::remove(path.c_str());
+}
+
+// ~~~~~~~~ File log ~~~~~~~~
+
+using etfw::FileLog;
+
+std::string read_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+bool file_exists(const std::string& path)
+{
+    return std::ifstream(path).good();
+}
+
+void remove_logs(const std::string& path)
+{
+    std::remove(path.c_str());
+    for (int i = 1; i <= 4; i++)
+    {
+        std::remove((path + "." + std::to_string(i)).c_str());
+    }
+}
+
+TEST(FileLog, BuffersUntilFlushAndAppends)
+{
+    std::unique_ptr<FileLog> logger(new FileLog());
+    const std::string path = bin_log_path("etfw_file_log_append.log");
+    remove_logs(path);
+    {
+        std::ofstream old(path);
+        old << "old line\n";
+    }
+
+    logger->write("dropped while closed");
+    FileLog::Config cfg;
+    cfg.Path = path.c_str();
+    cfg.FlushMs = 0;
+    cfg.SyncMs = 60000;
+    ASSERT_TRUE(logger->open(cfg).success());
+    logger->write("first");
+    logger->write("second");
+    // The flusher dropped the default period when the file opened
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * ETF_FILE_LOG_FLUSH_MS));
+    EXPECT_EQ(read_file(path), "old line\n");
+
+    ASSERT_TRUE(logger->flush().success());
+    EXPECT_EQ(read_file(path), "old line\nfirst\nsecond\n");
+    logger->write("third");
+    ASSERT_TRUE(logger->close().success());
+    EXPECT_EQ(read_file(path), "old line\nfirst\nsecond\nthird\n");
+
+    // One write and one sync per flush, not per line
+    const FileLog::Stats stats = logger->stats();
+    EXPECT_EQ(stats.Lines, 3);
+    EXPECT_EQ(stats.Dropped, 1);
+    EXPECT_EQ(stats.Bytes, 19);
+    EXPECT_EQ(stats.Writes, 2);
+    EXPECT_EQ(stats.Syncs, 2);
+    EXPECT_EQ(stats.Errors, 0);
+
+    cfg.Path = nullptr;
+    EXPECT_EQ(logger->open(cfg).code(), FileLog::Status::Code::INVALID_ARGUMENT);
+    remove_logs(path);
+}
+
+TEST(FileLog, FlushesAndSyncsOnTime)
+{
+    std::unique_ptr<FileLog> logger(new FileLog());
+    const std::string path = bin_log_path("etfw_file_log_timed.log");
+    remove_logs(path);
+    FileLog::Config cfg;
+    cfg.Path = path.c_str();
+    cfg.FlushMs = 5;
+    cfg.SyncMs = 10;
+    ASSERT_TRUE(logger->open(cfg).success());
+    logger->write("on time");
+
+    // The flusher writes and syncs without being asked
+    const Os::TimeNs_t deadline = Os::Clock::now_ns() + Os::NsPerSec;
+    while (logger->stats().Syncs == 0 && Os::Clock::now_ns() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(read_file(path), "on time\n");
+    EXPECT_EQ(logger->stats().Writes, 1);
+    EXPECT_EQ(logger->stats().Syncs, 1);
+    logger->close();
+    remove_logs(path);
+}
+
+TEST(FileLog, RotatesBySize)
+{
+    std::unique_ptr<FileLog> logger(new FileLog());
+    const std::string path = bin_log_path("etfw_file_log_rotate.log");
+    remove_logs(path);
+    FileLog::Config cfg;
+    cfg.Path = path.c_str();
+    cfg.RotateSz = 100;
+    cfg.Keep = 2;
+    cfg.FlushMs = 0;
+    ASSERT_TRUE(logger->open(cfg).success());
+
+    // 20-byte lines, flushed 3 at a time: 60 bytes per write, so every
+    // second write starts a new file
+    for (int i = 0; i < 12; i++)
+    {
+        char line[32];
+        std::snprintf(line, sizeof(line), "rotating line %05d", i);
+        logger->write(line);
+        if ((i % 3) == 2)
+        {
+            ASSERT_TRUE(logger->flush().success());
+        }
+    }
+    ASSERT_TRUE(logger->close().success());
+
+    EXPECT_EQ(read_file(path), "rotating line 00009\nrotating line 00010\nrotating line 00011\n");
+    EXPECT_EQ(read_file(path + ".1"), "rotating line 00006\nrotating line 00007\nrotating line 00008\n");
+    EXPECT_EQ(read_file(path + ".2"), "rotating line 00003\nrotating line 00004\nrotating line 00005\n");
+    EXPECT_FALSE(file_exists(path + ".3"));
+    EXPECT_EQ(logger->stats().Rotations, 3);
+    EXPECT_EQ(logger->stats().Errors, 0);
+    remove_logs(path);
+}
+
+TEST(FileLog, ReportsDropsOnFullBuffer)
+{
+    std::unique_ptr<FileLog> logger(new FileLog());
+    const std::string path = bin_log_path("etfw_file_log_drops.log");
+    remove_logs(path);
+    FileLog::Config cfg;
+    cfg.Path = path.c_str();
+    ASSERT_TRUE(logger->open(cfg).success());
+
+    // Too long for the buffer
+    const std::string line(FileLog::BufSz, 'x');
+    logger->write(line.c_str());
+    logger->write("kept");
+    ASSERT_TRUE(logger->close().success());
+
+    const std::string text = read_file(path);
+    EXPECT_EQ(text.find("kept\n"), 0);
+    EXPECT_NE(text.find("Dropped 1 log lines on a full buffer"), std::string::npos);
+    EXPECT_EQ(logger->stats().Dropped, 1);
+    remove_logs(path);
+}
+
+TEST(FileLog, LoggerPolicy)
+{
+    using FileLogger = etfw::Logger<etfw::FileLogPolicy>;
+    const std::string path = bin_log_path("etfw_file_log_policy.log");
+    remove_logs(path);
+    FileLog::Config cfg;
+    cfg.Path = path.c_str();
+    ASSERT_TRUE(etfw::FileLogPolicy::instance().open(cfg).success());
+    FileLogger::log(LogLevel::INFO, "LOG_TEST", "value %d", 7);
+    FileLogger::log(LogLevel::ERROR, "plain message");
+    ASSERT_TRUE(etfw::FileLogPolicy::instance().close().success());
+
+    EXPECT_EQ(read_file(path), expected("value %d", 7) + "\nplain message\n");
+    remove_logs(path);
+}
+
+}
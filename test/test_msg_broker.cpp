@@ -2,7 +2,12 @@
 #include "ut_framework.hpp"
 #include <etfw/msg/Broker.hpp>
 #include <etfw/msg/Pipe.hpp>
+#include <etfw/msg/Router.hpp>
 #include <etl/queue.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
@@ -825,6 +830,566 @@ namespace subscription_updates
     }
 }
 
+namespace subscription_set
+{
+    template <MsgId_t VId>
+    struct IdTag
+    {
+        static constexpr MsgId_t ID = VId;
+    };
+
+    TEST(MsgBroker, SubscriptionIdSet)
+    {
+        etfw::msg::MsgIdSet<4> ids{7, 3, 5, 3};
+        EXPECT_EQ(ids.size(), 3);
+        const MsgId_t sorted[] = {3, 5, 7};
+        EXPECT_TRUE(std::equal(ids.begin(), ids.end(), sorted));
+        EXPECT_TRUE(ids.has(5));
+        EXPECT_FALSE(ids.has(4));
+
+        EXPECT_TRUE(ids.insert(1));
+        EXPECT_TRUE(ids.full());
+        EXPECT_TRUE(ids.insert(7));
+        EXPECT_FALSE(ids.insert(9));
+        EXPECT_FALSE(ids.has(9));
+        EXPECT_EQ(*ids.begin(), 1);
+
+        EXPECT_TRUE(ids.erase(5));
+        EXPECT_FALSE(ids.erase(5));
+        EXPECT_EQ(ids.size(), 3);
+
+        using Static_t = etfw::msg::StaticMsgIdSet<IdTag<30>, IdTag<10>, IdTag<20>>;
+        static_assert(Static_t::size() == 3, "Static set size");
+        static_assert(Static_t::has(20), "Static set lookup");
+        static_assert(!Static_t::has(0), "Static set lookup");
+        static_assert(Static_t::Ids.Vals[0] < Static_t::Ids.Vals[1] &&
+            Static_t::Ids.Vals[1] < Static_t::Ids.Vals[2], "Static set sorted");
+    }
+
+    TEST(MsgBroker, SubscriptionIdScan)
+    {
+        // Cover every vector block/tail split, with the match at each position
+        uint32_t ids[40];
+        for (size_t sz = 0; sz <= 40; sz++)
+        {
+            for (size_t i = 0; i < sz; i++)
+            {
+                ids[i] = 0x100 + static_cast<uint32_t>(i);
+            }
+            for (size_t i = 0; i < sz; i++)
+            {
+                EXPECT_TRUE(etfw::msg::id_scan(ids, sz, ids[i])) << "sz " << sz;
+            }
+            EXPECT_FALSE(etfw::msg::id_scan(ids, sz, 0x100 + sz)) << "sz " << sz;
+            EXPECT_FALSE(etfw::msg::id_scan(ids, sz, 0)) << "sz " << sz;
+        }
+    }
+
+    TEST(MsgBroker, SubscriptionCapacity)
+    {
+        etfw::msg::Broker broker;
+        SimplePipe pipe;
+        broker.register_pipe(pipe);
+
+        // Subscribing twice must not deliver twice
+        EXPECT_TRUE(pipe.subscribe(M1_ID));
+        EXPECT_TRUE(pipe.subscribe(M1_ID));
+        EXPECT_EQ(pipe.subs().ids().size(), 1);
+        broker.send<M1>();
+        EXPECT_EQ(pipe.rx_count(), 1);
+
+        // Fill the subscription. Further IDs are rejected.
+        MsgId_t id = 0x100;
+        while (!pipe.subs().ids().full())
+        {
+            EXPECT_TRUE(pipe.subscribe(id++));
+        }
+        EXPECT_EQ(pipe.subs().ids().size(), MSG_MAX_NUM_SUBSCRIPTIONS);
+        EXPECT_FALSE(pipe.subscribe(id));
+        EXPECT_FALSE(pipe.accepts(id));
+
+        EXPECT_TRUE(pipe.unsubscribe(M1_ID));
+        EXPECT_FALSE(pipe.unsubscribe(M1_ID));
+        broker.send<M1>();
+        EXPECT_EQ(pipe.rx_count(), 1);
+
+        broker.unregister_pipe(pipe);
+    }
+}
+
+namespace queued_pipes
+{
+    // Message with a static ID, as used by the static pipes and routers
+    struct LargeMsg : public BaseMsg_t
+    {
+        static constexpr MsgId_t ID = 0x50;
+        uint8_t Payload[200];
+
+        LargeMsg():
+            BaseMsg_t(ID, sizeof(LargeMsg)),
+            Payload{}
+        {}
+    };
+
+    struct Handler
+    {
+        static constexpr etl::message_router_id_t ID = 2;
+
+        void handle(const etl::imessage& msg)
+        {
+            LastMsg = &msg;
+            RxCount++;
+        }
+
+        void receive(const LargeMsg& msg)
+        {
+            handle(msg);
+        }
+
+        const char* name_raw() const { return "HANDLER"; }
+
+        const etl::imessage* LastMsg = nullptr;
+        size_t RxCount = 0;
+    };
+
+    TEST(MsgBroker, QueuedPipeSharedFanOut)
+    {
+        etfw::msg::Broker broker;
+        Handler handlers[3];
+        etfw::msg::QueuedPipe<Handler, 4> pipe0(handlers[0]);
+        etfw::msg::QueuedPipe<Handler, 4> pipe1(handlers[1]);
+        etfw::msg::QueuedPipe<Handler, 4> pipe2(handlers[2]);
+        etfw::msg::QueuedPipe<Handler, 4>* pipes[] = {&pipe0, &pipe1, &pipe2};
+        for (auto pipe: pipes)
+        {
+            pipe->subscribe(M1_ID);
+            broker.register_pipe(*pipe);
+        }
+
+        // One buffer, held by every queue until the last pipe is done
+        broker.send<M1>();
+        EXPECT_EQ(broker.pool_stats().AllocCount, 1);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 1);
+
+        EXPECT_TRUE(pipe0.process_msgs(0));
+        EXPECT_TRUE(pipe1.process_msgs(0));
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 1);
+        EXPECT_TRUE(pipe2.process_msgs(0));
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 0);
+        EXPECT_FALSE(pipe0.process_msgs(0));
+
+        for (auto& handler: handlers)
+        {
+            EXPECT_EQ(handler.RxCount, 1);
+            EXPECT_EQ(handler.LastMsg, handlers[0].LastMsg);
+        }
+
+        // Messages without a shared buffer can't be queued by reference
+        M1 msg;
+        pipe0.receive(msg);
+        EXPECT_EQ(pipe0.dropped(), 1);
+        EXPECT_FALSE(pipe0.process_msgs(0));
+
+        for (auto pipe: pipes)
+        {
+            broker.unregister_pipe(*pipe);
+        }
+    }
+
+    TEST(MsgBroker, StaticQueuedPipe)
+    {
+        etfw::msg::Broker broker;
+        Handler handler;
+        etfw::msg::StaticQueuedPipe<Handler, 2, LargeMsg> pipe(handler);
+        broker.register_pipe(pipe);
+        EXPECT_TRUE(pipe.accepts<LargeMsg>());
+        EXPECT_FALSE(pipe.accepts(M1_ID));
+
+        // Shared delivery queues the broker's buffer
+        broker.send<LargeMsg>();
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 1);
+
+        // Direct delivery copies into the pipe's pool
+        LargeMsg msg;
+        pipe.receive(msg);
+        EXPECT_TRUE(pipe.full());
+
+        // Queue full
+        broker.send<LargeMsg>();
+        EXPECT_EQ(pipe.dropped(), 1);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 1);
+
+        EXPECT_TRUE(pipe.process_msgs(0));
+        EXPECT_EQ(handler.RxCount, 2);
+        EXPECT_NE(handler.LastMsg, &msg);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 0);
+
+        broker.unregister_pipe(pipe);
+    }
+
+    TEST(MsgBroker, StaticPipe)
+    {
+        etfw::msg::Broker broker;
+        Handler handler;
+        etfw::msg::StaticPipe<Handler, LargeMsg> pipe(handler);
+        broker.register_pipe(pipe);
+        EXPECT_TRUE(pipe.accepts<LargeMsg>());
+        EXPECT_FALSE(pipe.accepts(M1_ID));
+        EXPECT_EQ(pipe.subs().ids().size(), 1);
+
+        // Handled on the publishing thread
+        broker.send<LargeMsg>();
+        EXPECT_EQ(handler.RxCount, 1);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 0);
+
+        M1 msg;
+        pipe.receive(msg);
+        EXPECT_EQ(handler.RxCount, 1);
+
+        broker.unregister_pipe(pipe);
+    }
+
+    TEST(MsgBroker, QueuedRouterShared)
+    {
+        etfw::msg::Broker broker;
+        Handler handler;
+        etfw::msg::QueuedRouter<Handler, 2, LargeMsg> router(handler);
+        broker.subscribe(router.subscription());
+
+        broker.send<LargeMsg>();
+        LargeMsg msg;
+        router.receive(msg);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 1);
+
+        EXPECT_EQ(router.receive_msgs(0), decltype(router)::DequeueStat::OK);
+        EXPECT_EQ(handler.RxCount, 2);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 0);
+        EXPECT_EQ(router.receive_msgs(0), decltype(router)::DequeueStat::TIMEOUT);
+
+        // Messages past the queue depth are dropped and counted
+        broker.send<LargeMsg>();
+        broker.send<LargeMsg>();
+        broker.send<LargeMsg>();
+        EXPECT_EQ(router.dropped(), 1);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 2);
+        EXPECT_EQ(router.receive_msgs(0), decltype(router)::DequeueStat::OK);
+        EXPECT_EQ(handler.RxCount, 4);
+
+        broker.unsubscribe(router);
+    }
+
+    TEST(MsgBroker, QueuedRouterWithoutCopyPool)
+    {
+        etfw::msg::Broker broker;
+        Handler handler;
+        etfw::msg::BasicQueuedRouter<Handler, 2, 0, LargeMsg> router(handler);
+        broker.subscribe(router.subscription());
+
+        // Broker messages are queued by reference, direct ones can't be
+        broker.send<LargeMsg>();
+        LargeMsg msg;
+        router.receive(msg);
+        EXPECT_EQ(router.dropped(), 1);
+
+        EXPECT_EQ(router.receive_msgs(0), decltype(router)::DequeueStat::OK);
+        EXPECT_EQ(handler.RxCount, 1);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 0);
+
+        broker.unsubscribe(router);
+    }
+
+    constexpr size_t NumPublishers = 4;
+
+    // Message tagged with its publisher and per publisher sequence number
+    struct SeqMsg : public BaseMsg_t
+    {
+        static constexpr MsgId_t ID = 0x51;
+        uint32_t Publisher;
+        uint32_t Seq;
+
+        SeqMsg(const uint32_t publisher, const uint32_t seq):
+            BaseMsg_t(ID, sizeof(SeqMsg)),
+            Publisher(publisher),
+            Seq(seq)
+        {}
+    };
+
+    struct OrderHandler
+    {
+        static constexpr etl::message_router_id_t ID = 3;
+
+        void handle(const etl::imessage& msg)
+        {
+            receive(static_cast<const SeqMsg&>(msg));
+        }
+
+        void receive(const SeqMsg& msg)
+        {
+            if (msg.Seq != Next[msg.Publisher])
+            {
+                OutOfOrder++;
+            }
+            Next[msg.Publisher] = msg.Seq + 1;
+            RxCount++;
+        }
+
+        const char* name_raw() const { return "ORDER"; }
+
+        uint32_t Next[NumPublishers] = {};
+        size_t OutOfOrder = 0;
+        std::atomic<size_t> RxCount{0};
+    };
+
+    TEST(MsgBroker, QueuedPipeManyPublishers)
+    {
+        constexpr uint32_t NumSends = 2000;
+        constexpr size_t Total = NumPublishers * NumSends;
+        etfw::msg::Broker broker;
+        OrderHandler pipe_handler;
+        OrderHandler router_handler;
+        // Deeper than the broker pool, so the queues never fill
+        etfw::msg::QueuedPipe<OrderHandler, 128> pipe(pipe_handler);
+        etfw::msg::QueuedRouter<OrderHandler, 128, SeqMsg> router(router_handler);
+        pipe.subscribe(SeqMsg::ID);
+        broker.register_pipe(pipe);
+        broker.subscribe(router.subscription());
+
+        std::atomic<bool> timed_out(false);
+        std::thread consumer([&]()
+        {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+            while (pipe_handler.RxCount < Total || router_handler.RxCount < Total)
+            {
+                pipe.process_msgs(1);
+                router.receive_msgs(0);
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    timed_out = true;
+                    break;
+                }
+            }
+        });
+
+        std::vector<std::thread> publishers;
+        for (uint32_t p = 0; p < NumPublishers; p++)
+        {
+            publishers.emplace_back([&broker, p]()
+            {
+                for (uint32_t i = 0; i < NumSends; i++)
+                {
+                    // Wait for the consumer to return buffers instead of
+                    // dropping on a full pool
+                    etfw::msg::Buf* buf = broker.get_message_buf(sizeof(SeqMsg));
+                    while (buf == nullptr)
+                    {
+                        std::this_thread::yield();
+                        buf = broker.get_message_buf(sizeof(SeqMsg));
+                    }
+                    new (buf->data()) SeqMsg(p, i);
+                    broker.send_buf(*buf);
+                }
+            });
+        }
+        for (auto& publisher: publishers)
+        {
+            publisher.join();
+        }
+        consumer.join();
+
+        EXPECT_FALSE(timed_out);
+        EXPECT_EQ(pipe.dropped(), 0);
+        EXPECT_EQ(pipe_handler.RxCount, Total);
+        EXPECT_EQ(router_handler.RxCount, Total);
+        EXPECT_EQ(pipe_handler.OutOfOrder, 0);
+        EXPECT_EQ(router_handler.OutOfOrder, 0);
+        for (size_t p = 0; p < NumPublishers; p++)
+        {
+            EXPECT_EQ(pipe_handler.Next[p], NumSends);
+            EXPECT_EQ(router_handler.Next[p], NumSends);
+        }
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 0);
+
+        broker.unsubscribe(router);
+        broker.unregister_pipe(pipe);
+    }
+}
+
+namespace msg_queue
+{
+    using EventQueue_t = etfw::msg::BlockingMsgQueue<int, 32>;
+    using SemQueue_t = etfw::msg::BlockingMsgQueue<int, 32,
+        etfw::msg::CountSemNotifier>;
+
+    template <typename TQueue>
+    void drain_batch()
+    {
+        TQueue queue;
+        int in[20];
+        for (int i = 0; i < 20; i++)
+        {
+            in[i] = i;
+        }
+        EXPECT_EQ(queue.push_batch(etl::span<int>(in, 20)), 20);
+
+        // Nobody waiting, items available: no syscalls either side
+        int out[8];
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 8), 100), 8);
+        EXPECT_EQ(out[0], 0);
+        EXPECT_EQ(out[7], 7);
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 8), 100), 8);
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 8), 100), 4);
+        EXPECT_EQ(out[3], 19);
+        EXPECT_EQ(queue.syscalls(), 0);
+
+        // Empty and no wait
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 8), 0), 0);
+        EXPECT_EQ(queue.syscalls(), 0);
+
+        // Timeout. One wait.
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 8), 1), 0);
+        EXPECT_EQ(queue.syscalls(), 1);
+
+        // Full queue takes what fits
+        int many[40] = {};
+        EXPECT_EQ(queue.push_batch(etl::span<int>(many, 40)), 32);
+        EXPECT_TRUE(queue.full());
+    }
+
+    template <typename TQueue>
+    void blocking_consumer()
+    {
+        constexpr int NumItems = 10000;
+        TQueue queue;
+        std::thread producer([&queue]()
+        {
+            int next = 0;
+            while (next < NumItems)
+            {
+                int batch[4] = {next, next + 1, next + 2, next + 3};
+                next += static_cast<int>(queue.push_batch(etl::span<int>(batch, 4)));
+                if (queue.full())
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        int expected = 0;
+        int out[16];
+        while (expected < NumItems)
+        {
+            const size_t count = queue.drain(etl::span<int>(out, 16), 1000);
+            ASSERT_GT(count, 0);
+            for (size_t i = 0; i < count; i++)
+            {
+                ASSERT_EQ(out[i], expected);
+                expected++;
+            }
+        }
+        producer.join();
+        EXPECT_TRUE(queue.empty());
+        // At most a wait and a post per drain, usually far fewer
+        EXPECT_LT(queue.syscalls(), static_cast<size_t>(NumItems));
+    }
+
+    TEST(MsgQueue, DrainBatch)
+    {
+        drain_batch<EventQueue_t>();
+        drain_batch<SemQueue_t>();
+    }
+
+    TEST(MsgQueue, BlockingConsumer)
+    {
+        blocking_consumer<EventQueue_t>();
+        blocking_consumer<SemQueue_t>();
+    }
+
+    template <typename TQueue>
+    void wake_consumer()
+    {
+        TQueue queue;
+        int out[4];
+
+        // A wake with nobody waiting is kept for the next wait
+        queue.wake();
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 4), 5000), 0);
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+
+        // ...once
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 4), 5), 0);
+
+        // Wake a sleeping consumer
+        std::thread waker([&queue]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            queue.wake();
+        });
+        start = std::chrono::steady_clock::now();
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 4), 5000), 0);
+        EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+        waker.join();
+
+        // Items queued before the wake are still taken
+        int item = 7;
+        queue.push(item);
+        queue.wake();
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 4), 5000), 1);
+        EXPECT_EQ(out[0], 7);
+
+        // That wake was never received. Clearing it, as a runner's start
+        // does, makes the next wait sleep for its whole timeout.
+        queue.clear_wake();
+        start = std::chrono::steady_clock::now();
+        EXPECT_EQ(queue.drain(etl::span<int>(out, 4), 20), 0);
+        EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(15));
+    }
+
+    TEST(MsgQueue, WakeConsumer)
+    {
+        wake_consumer<EventQueue_t>();
+        wake_consumer<SemQueue_t>();
+    }
+
+    TEST(MsgQueue, EventCount)
+    {
+        using Status = Os::EventCount::Status;
+        Os::EventCount event;
+
+        // Nothing notified
+        auto key = event.prepare_wait();
+        EXPECT_EQ(event.wait(key, 1).code(), Status::Code::TIMEOUT);
+
+        // Notify between prepare and wait isn't lost
+        key = event.prepare_wait();
+        event.notify();
+        EXPECT_EQ(event.wait(key, 1000).code(), Status::Code::OK);
+
+        // Wake a sleeping waiter
+        std::atomic<bool> flag{false};
+        std::thread notifier([&]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            flag = true;
+            event.notify();
+        });
+        while (!flag)
+        {
+            key = event.prepare_wait();
+            if (!flag)
+            {
+                EXPECT_EQ(event.wait(key, 5000).code(), Status::Code::OK);
+            }
+            else
+            {
+                event.cancel_wait(key);
+            }
+        }
+        notifier.join();
+        EXPECT_GT(event.syscalls(), 0);
+    }
+}
+
 namespace dynamic_msg
 {
     TEST(MsgBroker, DynamicMsg)
@@ -871,4 +1436,198 @@ namespace dynamic_msg
     }
 }
 
+namespace many_pipes
+{
+    TEST(MsgBroker, ManyPipes)
+    {
+        constexpr size_t NumPipes = 100;
+        constexpr MsgId_t CommonId = 0xFFFF;
+        etfw::msg::Broker broker;
+        static SimplePipe pipes[NumPipes];
+
+        // Every pipe has a unique ID plus one shared by all of them
+        for (size_t i = 0; i < NumPipes; i++)
+        {
+            pipes[i].subscribe(0x100 + i);
+            pipes[i].subscribe(CommonId);
+            broker.register_pipe(pipes[i]);
+        }
+        EXPECT_EQ(broker.stats().RegisteredPipes, NumPipes);
+
+        broker.send<BaseMsg_t>(CommonId, sizeof(BaseMsg_t));
+        for (auto& pipe: pipes)
+        {
+            EXPECT_EQ(pipe.rx_count(), 1);
+        }
+
+        broker.send<BaseMsg_t>(0x100 + 42, sizeof(BaseMsg_t));
+        EXPECT_EQ(pipes[42].rx_count(), 2);
+        EXPECT_EQ(pipes[42].last_rx_id(), 0x100 + 42);
+        EXPECT_EQ(pipes[41].rx_count(), 1);
+        EXPECT_EQ(pipes[43].rx_count(), 1);
+
+        // Drop every other pipe. The rest keep all of their subscriptions.
+        for (size_t i = 0; i < NumPipes; i += 2)
+        {
+            broker.unregister_pipe(pipes[i]);
+        }
+        broker.send<BaseMsg_t>(CommonId, sizeof(BaseMsg_t));
+        for (size_t i = 1; i < NumPipes; i += 2)
+        {
+            broker.send<BaseMsg_t>(0x100 + i, sizeof(BaseMsg_t));
+        }
+        for (size_t i = 0; i < NumPipes; i++)
+        {
+            const size_t expected = (i % 2 == 0) ? 1 : 3;
+            EXPECT_EQ(pipes[i].rx_count(), (i == 42) ? 2 : expected) << "Pipe " << i;
+        }
+
+        // Re-registering picks up subscription changes made while unregistered
+        pipes[0].unsubscribe(CommonId);
+        broker.register_pipe(pipes[0]);
+        broker.send<BaseMsg_t>(CommonId, sizeof(BaseMsg_t));
+        broker.send<BaseMsg_t>(0x100, sizeof(BaseMsg_t));
+        EXPECT_EQ(pipes[0].rx_count(), 2);
+        EXPECT_EQ(pipes[0].last_rx_id(), 0x100);
+        EXPECT_EQ(pipes[1].rx_count(), 4);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 0);
+    }
+}
+
+namespace churn
+{
+    class CountingPipe : public etfw::msg::iPipe
+    {
+    public:
+        CountingPipe(msg_init_list msg_ids):
+            etfw::msg::iPipe(1, msg_ids),
+            RxCount(0)
+        {}
+
+        void receive(const etl::imessage& msg) override
+        {
+            RxCount++;
+        }
+
+        std::atomic<size_t> RxCount;
+    };
+
+    TEST(MsgBroker, PublishSubscribeChurn)
+    {
+        constexpr size_t NumPublishers = 4;
+        constexpr size_t NumSends = 5000;
+        etfw::msg::Broker broker;
+        CountingPipe stable({M1_ID});
+        CountingPipe churned({M1_ID, M2_ID});
+        broker.register_pipe(stable);
+
+        std::atomic<bool> done(false);
+        std::atomic<size_t> churn_count(0);
+        std::atomic<size_t> late_rx(0);
+
+        // Keep changing the subscription table while messages are routed
+        std::thread churner([&]()
+        {
+            while (!done)
+            {
+                broker.register_pipe(churned);
+                churned.subscribe(M3_ID);
+                churned.unsubscribe(M3_ID);
+                broker.unregister_pipe(churned);
+
+                // Once unregistered the pipe must not be called again
+                const size_t rx = churned.RxCount;
+                std::this_thread::yield();
+                if (churned.RxCount != rx)
+                {
+                    late_rx++;
+                }
+                churn_count++;
+            }
+        });
+
+        std::vector<std::thread> publishers;
+        for (size_t t = 0; t < NumPublishers; t++)
+        {
+            publishers.emplace_back([&broker]()
+            {
+                for (size_t i = 0; i < NumSends; i++)
+                {
+                    broker.send<M1>();
+                    broker.send<M2>();
+                }
+            });
+        }
+        for (auto& publisher: publishers)
+        {
+            publisher.join();
+        }
+        done = true;
+        churner.join();
+
+        EXPECT_GT(churn_count, 0);
+        EXPECT_EQ(late_rx, 0);
+        EXPECT_EQ(stable.RxCount, NumPublishers * NumSends);
+        EXPECT_LE(churned.RxCount, 2 * NumPublishers * NumSends);
+        EXPECT_EQ(broker.stats().RegisteredPipes, 1);
+        EXPECT_EQ(broker.stats().AllocateFailures, 0);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 0);
+        EXPECT_EQ(broker.pool_stats().AllocCount, 2 * NumPublishers * NumSends);
+    }
+
+    /// @brief Changes its own subscription from its handler
+    class ResubscribingPipe : public CountingPipe
+    {
+    public:
+        ResubscribingPipe(msg_init_list msg_ids):
+            CountingPipe(msg_ids)
+        {}
+
+        void receive(const etl::imessage& msg) override
+        {
+            subscribe(M3_ID);
+            unsubscribe(M3_ID);
+            CountingPipe::receive(msg);
+        }
+    };
+
+    TEST(MsgBroker, HandlerSubscribesDuringChurn)
+    {
+        constexpr size_t NumSends = 5000;
+        etfw::msg::Broker broker;
+        ResubscribingPipe handler({M1_ID});
+        CountingPipe churned({M1_ID});
+        broker.register_pipe(handler);
+
+        // The churner waits out the publisher's dispatch while the
+        // publisher's handler waits for the broker
+        std::atomic<bool> done(false);
+        std::atomic<size_t> churn_count(0);
+        std::thread churner([&]()
+        {
+            while (!done)
+            {
+                broker.register_pipe(churned);
+                broker.unregister_pipe(churned);
+                churn_count++;
+            }
+        });
+        std::thread publisher([&broker]()
+        {
+            for (size_t i = 0; i < NumSends; i++)
+            {
+                broker.send<M1>();
+            }
+        });
+        publisher.join();
+        done = true;
+        churner.join();
+
+        EXPECT_GT(churn_count, 0);
+        EXPECT_EQ(handler.RxCount, NumSends);
+        EXPECT_EQ(broker.stats().RegisteredPipes, 1);
+        EXPECT_EQ(broker.pool_stats().ItemsInUse, 0);
+    }
+}
+
 }
@@ -4,6 +4,10 @@
 #include <etfw/msg/Pool.hpp>
 #include <etfw/msg/Broker.hpp>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 namespace
 {
 
@@ -63,7 +67,7 @@ TEST(MsgBuf, AllocateFromMsg)
     struct M3 : public etfw::msg::iBaseMsg
     {
         bool Flag;
-        uint8_t Data[20];
+        uint8_t Data[20] = {};     //< ut_comp expects unused bytes to be zero
         size_t NumBytes;
 
         M3():
@@ -162,4 +166,411 @@ TEST(MsgBuf, AllocateFromMsg)
     EXPECT_EQ(pool.stats().items_avail(), 10) << "Buf from copy not released";
 }
 
+TEST(MsgBuf, SlabSizeClasses)
+{
+    using SlabPool = etfw::msg::StaticMsgBufPool<
+        etfw::msg::SizeClass<64, 2>,
+        etfw::msg::SizeClass<256, 1>>;
+    SlabPool pool;
+
+    EXPECT_EQ(pool.num_slabs(), 2);
+    EXPECT_EQ(pool.stats().NumItems, 3);
+    EXPECT_EQ(pool.slab_msg_size(0), 64);
+    EXPECT_EQ(pool.slab_msg_size(1), 256);
+    EXPECT_EQ(pool.slab_stats(2), nullptr);
+
+    // Small buffers come from the smallest size class
+    etfw::msg::Buf* buf1 = pool.allocate(static_cast<size_t>(32));
+    ASSERT_NE(buf1, nullptr);
+    EXPECT_EQ(buf1->buf_size(), 32);
+    EXPECT_EQ(pool.slab_stats(0)->ItemsInUse, 1);
+    EXPECT_EQ(pool.slab_stats(1)->ItemsInUse, 0);
+
+    // Large buffers skip straight to the large size class
+    etfw::msg::Buf* buf2 = pool.allocate(static_cast<size_t>(200));
+    ASSERT_NE(buf2, nullptr);
+    EXPECT_EQ(pool.slab_stats(0)->ItemsInUse, 1);
+    EXPECT_EQ(pool.slab_stats(1)->ItemsInUse, 1);
+    EXPECT_EQ(pool.stats().items_avail(), 1);
+
+    // Nothing left large enough
+    EXPECT_EQ(pool.allocate(static_cast<size_t>(200)), nullptr);
+    EXPECT_EQ(pool.allocate(static_cast<size_t>(1024)), nullptr);
+
+    buf2->release();
+    EXPECT_EQ(pool.slab_stats(1)->ItemsInUse, 0);
+    EXPECT_EQ(pool.slab_stats(1)->WaterMark, 1);
+    EXPECT_EQ(pool.slab_stats(1)->ReleaseCount, 1);
+
+    // Depleted small class falls back to the larger class
+    etfw::msg::Buf* buf3 = pool.allocate(static_cast<size_t>(64));
+    ASSERT_NE(buf3, nullptr);
+    etfw::msg::Buf* buf4 = pool.allocate(static_cast<size_t>(64));
+    ASSERT_NE(buf4, nullptr);
+    EXPECT_EQ(pool.slab_stats(0)->ItemsInUse, 2);
+    EXPECT_EQ(pool.slab_stats(1)->ItemsInUse, 1);
+    EXPECT_EQ(pool.stats().items_avail(), 0);
+    EXPECT_EQ(pool.allocate(static_cast<size_t>(1)), nullptr);
+
+    buf1->release();
+    buf3->release();
+    buf4->release();
+    EXPECT_EQ(pool.stats().items_avail(), 3);
+    EXPECT_EQ(pool.stats().WaterMark, 3);
+    EXPECT_EQ(pool.stats().AllocCount, 4);
+    EXPECT_EQ(pool.stats().ReleaseCount, 4);
+    EXPECT_EQ(pool.slab_stats(0)->AllocCount, 2);
+    EXPECT_EQ(pool.slab_stats(1)->AllocCount, 2);
+}
+
+TEST(MsgBuf, SlabReuse)
+{
+    using SlabPool = etfw::msg::StaticMsgBufPool<
+        etfw::msg::SizeClass<64, 4>>;
+    SlabPool pool;
+
+    // Released blocks are handed back out without growing the pool
+    etfw::msg::Buf* first = pool.allocate(static_cast<size_t>(16));
+    ASSERT_NE(first, nullptr);
+    first->release();
+    for (int i = 0; i < 100; i++)
+    {
+        etfw::msg::Buf* buf = pool.allocate(static_cast<size_t>(16));
+        ASSERT_NE(buf, nullptr);
+        EXPECT_EQ(buf, first);
+        buf->release();
+    }
+    EXPECT_EQ(pool.stats().ItemsInUse, 0);
+    EXPECT_EQ(pool.stats().WaterMark, 1);
+    EXPECT_EQ(pool.stats().AllocCount, 101);
+}
+
+TEST(MsgBuf, SlabConcurrentAllocRelease)
+{
+    using SlabPool = etfw::msg::StaticMsgBufPool<
+        etfw::msg::SizeClass<64, 8>,
+        etfw::msg::SizeClass<256, 4>>;
+    static SlabPool pool;
+    constexpr size_t NumThreads = 8;
+    constexpr size_t NumIters = 20000;
+    constexpr size_t NumSlots = 4;
+
+    // Buffers are handed between threads through the slots so blocks
+    // are released by a different thread than the one that allocated them
+    std::atomic<etfw::msg::Buf*> slots[NumSlots];
+    for (auto& slot: slots)
+    {
+        slot = nullptr;
+    }
+    std::atomic<size_t> corrupt(0);
+
+    auto worker = [&](const size_t id)
+    {
+        for (size_t i = 0; i < NumIters; i++)
+        {
+            const size_t sz = ((i + id) % 3 == 0) ? 200 : 32;
+            etfw::msg::Buf* buf = pool.allocate(sz);
+            if (buf == nullptr)
+            {
+                continue;
+            }
+            const uint8_t stamp = static_cast<uint8_t>(id + i);
+            memset(buf->data(), stamp, sz);
+
+            etfw::msg::Buf* prev = slots[(id + i) % NumSlots].exchange(buf);
+            if (prev != nullptr)
+            {
+                const uint8_t* data = static_cast<const uint8_t*>(prev->data());
+                for (size_t b = 1; b < prev->buf_size(); b++)
+                {
+                    if (data[b] != data[0])
+                    {
+                        corrupt++;
+                        break;
+                    }
+                }
+                prev->release();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < NumThreads; t++)
+    {
+        threads.emplace_back(worker, t);
+    }
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+    for (auto& slot: slots)
+    {
+        etfw::msg::Buf* buf = slot.exchange(nullptr);
+        if (buf != nullptr)
+        {
+            buf->release();
+        }
+    }
+
+    EXPECT_EQ(corrupt, 0);
+    EXPECT_EQ(pool.stats().ItemsInUse, 0);
+    EXPECT_EQ(pool.stats().AllocCount, pool.stats().ReleaseCount);
+    EXPECT_LE(pool.stats().WaterMark, pool.stats().NumItems);
+    EXPECT_EQ(pool.slab_stats(0)->ItemsInUse, 0);
+    EXPECT_EQ(pool.slab_stats(1)->ItemsInUse, 0);
+
+    // Every block is back on a free list
+    std::vector<etfw::msg::Buf*> bufs;
+    etfw::msg::Buf* buf = nullptr;
+    while ((buf = pool.allocate(static_cast<size_t>(1))) != nullptr)
+    {
+        bufs.push_back(buf);
+    }
+    EXPECT_EQ(bufs.size(), pool.stats().NumItems);
+    for (auto b: bufs)
+    {
+        b->release();
+    }
+}
+
+TEST(MsgBuf, ThreadCacheHitRate)
+{
+    using CachedPool = etfw::msg::CachedMsgBufPool<2,
+        etfw::msg::SizeClass<64, 64>>;
+    CachedPool pool;
+    EXPECT_EQ(pool.num_thread_caches(), 2);
+
+    for (int i = 0; i < 100; i++)
+    {
+        etfw::msg::Buf* buf = pool.allocate(static_cast<size_t>(16));
+        ASSERT_NE(buf, nullptr);
+        buf->release();
+    }
+
+    // First allocation refills the magazine, the rest hit it
+    auto cache = pool.thread_cache_stats(0);
+    EXPECT_EQ(cache.Misses, 1);
+    EXPECT_EQ(cache.Hits, 99);
+    EXPECT_GT(cache.hit_rate(), 0.98f);
+    EXPECT_EQ(pool.thread_cache_stats(1).Hits + pool.thread_cache_stats(1).Misses, 0);
+
+    // Cached blocks stay checked out of the shared pool but not in use
+    EXPECT_GT(cache.Stranded, 0);
+    EXPECT_EQ(pool.stats().ItemsInUse, cache.Stranded);
+    EXPECT_EQ(pool.items_in_use(), 0);
+
+    // Overflowing the magazine flushes blocks back to the shared pool
+    etfw::msg::Buf* bufs[48];
+    for (auto& buf: bufs)
+    {
+        buf = pool.allocate(static_cast<size_t>(16));
+        ASSERT_NE(buf, nullptr);
+    }
+    EXPECT_EQ(pool.items_in_use(), 48);
+    for (auto buf: bufs)
+    {
+        buf->release();
+    }
+    EXPECT_EQ(pool.items_in_use(), 0);
+    EXPECT_LE(pool.cache_stats().Stranded, MSG_POOL_MAGAZINE_SZ);
+
+    pool.flush_thread_cache();
+    EXPECT_EQ(pool.cache_stats().Stranded, 0);
+    EXPECT_EQ(pool.stats().ItemsInUse, 0);
+}
+
+TEST(MsgBuf, ThreadCacheClaims)
+{
+    using CachedPool = etfw::msg::CachedMsgBufPool<2,
+        etfw::msg::SizeClass<64, 64>>;
+    static CachedPool pool;
+
+    auto worker = [](const bool flush)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            etfw::msg::Buf* buf = pool.allocate(static_cast<size_t>(16));
+            ASSERT_NE(buf, nullptr);
+            buf->release();
+        }
+        if (flush)
+        {
+            pool.flush_thread_cache();
+        }
+    };
+
+    // Exiting threads give their caches back, so each finds a free one
+    std::thread(worker, false).join();
+    std::thread(worker, false).join();
+    std::thread(worker, false).join();
+    EXPECT_EQ(pool.cache_stats().Hits, 27);
+    EXPECT_EQ(pool.cache_stats().Misses, 3);
+    EXPECT_EQ(pool.items_in_use(), 0);
+    EXPECT_EQ(pool.cache_stats().Stranded, 0);
+    EXPECT_EQ(pool.stats().ItemsInUse, 0);
+
+    // Two live threads keep their caches, a third has to bypass them
+    std::atomic<size_t> holding(0);
+    std::atomic<bool> release(false);
+    auto holder = [&]()
+    {
+        worker(false);
+        holding++;
+        while (!release)
+        {
+            std::this_thread::yield();
+        }
+    };
+    std::thread a(holder);
+    std::thread b(holder);
+    while (holding < 2)
+    {
+        std::this_thread::yield();
+    }
+    const size_t stranded = pool.cache_stats().Stranded;
+    EXPECT_GT(stranded, 0);
+    const etfw::msg::MsgBufPool::CacheStats before = pool.cache_stats();
+    std::thread(worker, true).join();
+    EXPECT_EQ(pool.cache_stats().Hits, before.Hits);
+    EXPECT_EQ(pool.cache_stats().Misses, before.Misses);
+    EXPECT_EQ(pool.cache_stats().Stranded, stranded);
+    EXPECT_EQ(pool.stats().ReleaseCount + stranded, pool.stats().AllocCount);
+
+    release = true;
+    a.join();
+    b.join();
+    EXPECT_EQ(pool.cache_stats().Stranded, 0);
+    EXPECT_EQ(pool.stats().AllocCount, pool.stats().ReleaseCount);
+}
+
+TEST(MsgBuf, ThreadCacheConcurrent)
+{
+    using CachedPool = etfw::msg::CachedMsgBufPool<4,
+        etfw::msg::SizeClass<64, 128>,
+        etfw::msg::SizeClass<256, 64>>;
+    static CachedPool pool;
+    constexpr size_t NumThreads = 6;
+    constexpr size_t NumIters = 20000;
+    std::atomic<etfw::msg::Buf*> slot(nullptr);
+    const size_t lookups = pool.cache_stats().Hits + pool.cache_stats().Misses;
+
+    // Buffers swap between threads so they are released into a cache other
+    // than the one they were allocated from
+    auto worker = [&](const size_t id)
+    {
+        for (size_t i = 0; i < NumIters; i++)
+        {
+            const size_t sz = ((i + id) % 4 == 0) ? 200 : 32;
+            etfw::msg::Buf* buf = pool.allocate(sz);
+            ASSERT_NE(buf, nullptr);
+            etfw::msg::Buf* prev = slot.exchange(buf);
+            if (prev != nullptr)
+            {
+                prev->release();
+            }
+        }
+        pool.flush_thread_cache();
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < NumThreads; t++)
+    {
+        threads.emplace_back(worker, t);
+    }
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+    slot.exchange(nullptr)->release();
+    pool.flush_thread_cache();
+
+    EXPECT_EQ(pool.cache_stats().Stranded, 0);
+    EXPECT_EQ(pool.stats().ItemsInUse, 0);
+    EXPECT_EQ(pool.stats().AllocCount, pool.stats().ReleaseCount);
+    EXPECT_LE(pool.cache_stats().Hits + pool.cache_stats().Misses - lookups, NumThreads * NumIters);
+}
+
+TEST(MsgBuf, ThreadCacheCrossThreadRelease)
+{
+    using CachedPool = etfw::msg::CachedMsgBufPool<2,
+        etfw::msg::SizeClass<64, 64>>;
+    CachedPool pool;
+    etfw::msg::Buf* bufs[8];
+
+    std::thread([&]()
+    {
+        for (auto& buf: bufs)
+        {
+            buf = pool.allocate(static_cast<size_t>(16));
+            ASSERT_NE(buf, nullptr);
+        }
+    }).join();
+    const size_t hits = pool.cache_stats().Hits;
+    const size_t misses = pool.cache_stats().Misses;
+
+    // Blocks released on another thread land in its cache and serve its
+    // next allocations
+    std::thread([&]()
+    {
+        for (auto buf: bufs)
+        {
+            buf->release();
+        }
+        EXPECT_EQ(pool.items_in_use(), 0);
+        for (auto& buf: bufs)
+        {
+            buf = pool.allocate(static_cast<size_t>(16));
+            ASSERT_NE(buf, nullptr);
+        }
+        for (auto buf: bufs)
+        {
+            buf->release();
+        }
+        pool.flush_thread_cache();
+    }).join();
+
+    EXPECT_EQ(pool.cache_stats().Misses, misses);
+    EXPECT_EQ(pool.cache_stats().Hits, hits + 8);
+    EXPECT_EQ(pool.items_in_use(), 0);
+    EXPECT_EQ(pool.cache_stats().Stranded, 0);
+}
+
+TEST(MsgBuf, ThreadCacheOfPoolDestroyedElsewhere)
+{
+    using CachedPool = etfw::msg::CachedMsgBufPool<2,
+        etfw::msg::SizeClass<64, 64>>;
+    std::vector<CachedPool*> pools;
+
+    // Fill this thread's cache entries, then destroy the pools on another
+    // thread, which can't clear them
+    for (size_t i = 0; i < MSG_POOL_MAX_CACHED_POOLS; i++)
+    {
+        pools.push_back(new CachedPool());
+        etfw::msg::Buf* buf = pools.back()->allocate(static_cast<size_t>(16));
+        ASSERT_NE(buf, nullptr);
+        buf->release();
+        EXPECT_EQ(pools.back()->thread_cache_stats(0).Misses, 1);
+    }
+    std::thread([&]()
+    {
+        for (auto p: pools)
+        {
+            delete p;
+        }
+    }).join();
+
+    // The stale entries are swept, so a new pool still gets a cache
+    CachedPool* pool = new CachedPool();
+    for (int i = 0; i < 10; i++)
+    {
+        etfw::msg::Buf* buf = pool->allocate(static_cast<size_t>(16));
+        ASSERT_NE(buf, nullptr);
+        buf->release();
+    }
+    EXPECT_EQ(pool->cache_stats().Misses, 1);
+    EXPECT_EQ(pool->cache_stats().Hits, 9);
+    pool->flush_thread_cache();
+    delete pool;
+}
+
 }
@@ -0,0 +1,158 @@
+#include "ut_framework.hpp"
+
+#include <etfw/os/Task.hpp>
+
+#include <atomic>
+
+namespace
+{
+
+using Thread = Os::Thread;
+using Status = Thread::Status;
+
+constexpr size_t StackWords = OS_THREAD_DEFAULT_STACK_SZ;
+alignas(16) Thread::Config::Stack::Buf_t Stack[StackWords];
+
+/// @brief What the thread saw of its own context
+struct ThreadInfo
+{
+    uintptr_t Local;
+    uintptr_t AttrStackAddr;
+    size_t AttrStackSz;
+    cpu_set_t Cpus;
+    int Policy;
+    int Priority;
+    std::atomic<bool> Ran{false};
+};
+
+void inspect(void* arg)
+{
+    ThreadInfo* info = static_cast<ThreadInfo*>(arg);
+    int local = 0;
+    info->Local = reinterpret_cast<uintptr_t>(&local);
+
+    pthread_attr_t attr;
+    void* stack_addr = nullptr;
+    pthread_getattr_np(pthread_self(), &attr);
+    pthread_attr_getstack(&attr, &stack_addr, &info->AttrStackSz);
+    pthread_attr_destroy(&attr);
+    info->AttrStackAddr = reinterpret_cast<uintptr_t>(stack_addr);
+
+    CPU_ZERO(&info->Cpus);
+    pthread_getaffinity_np(pthread_self(), sizeof(info->Cpus), &info->Cpus);
+
+    sched_param param;
+    pthread_getschedparam(pthread_self(), &info->Policy, &param);
+    info->Priority = param.sched_priority;
+    info->Ran = true;
+}
+
+/// @return First CPU this process may run on
+size_t first_allowed_cpu()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (size_t cpu = 0; cpu < 64; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            return cpu;
+        }
+    }
+    return 0;
+}
+
+TEST(OsThread, StaticStackAndAffinity)
+{
+    const size_t cpu = first_allowed_cpu();
+    ThreadInfo info;
+    Thread thread;
+    Thread::Config cfg(Stack, StackWords, 0, &info, inspect,
+        Thread::Config::CpuMask_t(1) << cpu);
+
+    ASSERT_EQ(thread.start(cfg).code(), Status::Code::OK);
+    ASSERT_EQ(thread.join().code(), Status::Code::OK);
+    ASSERT_TRUE(info.Ran);
+
+    // Runs on the config buffer, not an OS allocated stack
+    const uintptr_t lo = reinterpret_cast<uintptr_t>(Stack);
+    const uintptr_t hi = lo + sizeof(Stack);
+    EXPECT_GE(info.Local, lo);
+    EXPECT_LT(info.Local, hi);
+    EXPECT_GE(info.AttrStackAddr, lo);
+    EXPECT_LE(info.AttrStackAddr + info.AttrStackSz, hi);
+
+    // Pinned to the requested CPU only
+    EXPECT_EQ(CPU_COUNT(&info.Cpus), 1);
+    EXPECT_TRUE(CPU_ISSET(cpu, &info.Cpus));
+    EXPECT_FALSE(thread.realtime());
+    EXPECT_EQ(info.Policy, SCHED_OTHER);
+}
+
+TEST(OsThread, Priority)
+{
+    // A priority alone doesn't make a thread real-time
+    ThreadInfo info;
+    Thread thread;
+    Thread::Config cfg(Stack, StackWords, 10, &info, inspect);
+    EXPECT_FALSE(cfg.realtime());
+    ASSERT_EQ(thread.start(cfg).code(), Status::Code::OK);
+    ASSERT_EQ(thread.join().code(), Status::Code::OK);
+    ASSERT_TRUE(info.Ran);
+    EXPECT_FALSE(thread.realtime());
+    EXPECT_EQ(info.Policy, SCHED_OTHER);
+
+    // Real-time may be refused. The thread must run either way.
+    ThreadInfo rt_info;
+    Thread::Config rt_cfg(Stack, StackWords, 10, &rt_info, inspect, 0, SCHED_FIFO);
+    EXPECT_TRUE(rt_cfg.realtime());
+    ASSERT_EQ(thread.start(rt_cfg).code(), Status::Code::OK);
+    ASSERT_EQ(thread.join().code(), Status::Code::OK);
+    ASSERT_TRUE(rt_info.Ran);
+
+    if (thread.realtime())
+    {
+        EXPECT_EQ(rt_info.Policy, SCHED_FIFO);
+        EXPECT_EQ(rt_info.Priority, 10);
+    }
+    else
+    {
+        EXPECT_EQ(rt_info.Policy, SCHED_OTHER);
+    }
+}
+
+TEST(OsThread, DefaultStackFitsTarget)
+{
+    EXPECT_LE(Thread::min_stack_bytes(), static_cast<size_t>(OS_THREAD_MIN_STACK_SZ));
+    EXPECT_GE(OS_THREAD_DEFAULT_STACK_SZ * sizeof(Thread::Config::Stack::Buf_t),
+        Thread::min_stack_bytes());
+}
+
+TEST(OsThread, InvalidConfig)
+{
+    ThreadInfo info;
+    Thread thread;
+
+    Thread::Config small_stack(Stack, Thread::min_stack_bytes() /
+        sizeof(Thread::Config::Stack::Buf_t) - 1, 0, &info, inspect);
+    EXPECT_EQ(thread.start(small_stack).code(), Status::Code::INVALID_STACK_CFG);
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    if (!CPU_ISSET(63, &allowed))
+    {
+        Thread::Config bad_cpus(Stack, StackWords, 0, &info, inspect,
+            Thread::Config::CpuMask_t(1) << 63);
+        EXPECT_EQ(thread.start(bad_cpus).code(), Status::Code::INVALID_AFFINITY_CFG);
+    }
+
+    Thread::Config bad_policy(Stack, StackWords, 10, &info, inspect, 0, SCHED_BATCH + 100);
+    EXPECT_EQ(thread.start(bad_policy).code(), Status::Code::INVALID_PRIORITY_CFG);
+
+    EXPECT_EQ(thread.join().code(), Status::Code::INVALID_STATE);
+    EXPECT_FALSE(info.Ran);
+}
+
+}
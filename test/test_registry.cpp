@@ -0,0 +1,117 @@
+#include "ut_framework.hpp"
+
+#include <etfw/svcs/SvcRegistry.hpp>
+#include <etfw/svcs/Executor.hpp>
+
+namespace
+{
+
+struct FakeSvc
+{
+    etfw::SvcId_t Id;
+
+    etfw::SvcId_t id() const { return Id; }
+};
+
+TEST(SvcTable, FindInsertErase)
+{
+    static FakeSvc svcs[4] = {{7}, {0}, {255}, {42}};
+    static etfw::SvcTable<FakeSvc, 4> table;
+    EXPECT_EQ(table.capacity(), 4);
+
+    for (FakeSvc& svc: svcs)
+    {
+        EXPECT_FALSE(table.contains(svc.Id));
+        EXPECT_TRUE(table.insert(&svc));
+    }
+    EXPECT_TRUE(table.full());
+    EXPECT_FALSE(table.insert(&svcs[0]));
+
+    // Insertion order until something is erased
+    size_t i = 0;
+    for (FakeSvc* svc: table)
+    {
+        EXPECT_EQ(svc, &svcs[i]);
+        EXPECT_EQ(table.index_of(svc->Id), i);
+        i++;
+    }
+    EXPECT_EQ(table.find(255), &svcs[2]);
+    EXPECT_EQ(table.find(1), nullptr);
+    EXPECT_EQ(table.index_of(1), table.size());
+
+    // The last service fills the erased slot
+    EXPECT_TRUE(table.erase(7));
+    EXPECT_FALSE(table.erase(7));
+    EXPECT_EQ(table.size(), 3);
+    EXPECT_EQ(table.find(7), nullptr);
+    EXPECT_EQ(table.data()[0], &svcs[3]);
+    EXPECT_EQ(table.find(42), &svcs[3]);
+    EXPECT_EQ(table.index_of(42), 0);
+
+    // Erasing the last slot moves nothing
+    EXPECT_TRUE(table.erase(255));
+    EXPECT_EQ(table.find(0), &svcs[1]);
+    EXPECT_EQ(table.find(42), &svcs[3]);
+
+    EXPECT_TRUE(table.insert(&svcs[0]));
+    EXPECT_EQ(table.find(7), &svcs[0]);
+
+    table.clear();
+    EXPECT_EQ(table.size(), 0);
+    for (FakeSvc& svc: svcs)
+    {
+        EXPECT_FALSE(table.contains(svc.Id));
+    }
+    EXPECT_TRUE(table.insert(&svcs[2]));
+}
+
+TEST(SvcRegistry, RegisterAndUnregister)
+{
+    using Registry_t = etfw::SvcRegistry<FakeSvc, 2>;
+    using Code = Registry_t::Status::Code;
+    static FakeSvc a{3}, b{9}, c{12};
+    static Registry_t registry;
+
+    EXPECT_EQ(registry.register_svc(a).code(), Code::OK);
+    EXPECT_EQ(registry.register_svc(a).code(), Code::ALREADY_REGISTERED);
+    EXPECT_EQ(registry.register_svc(b).code(), Code::OK);
+    EXPECT_EQ(registry.register_svc(c).code(), Code::REGISTRY_FULL);
+    EXPECT_EQ(registry.find_svc(9), &b);
+
+    EXPECT_EQ(registry.unregister_svc(a).code(), Code::OK);
+    EXPECT_EQ(registry.unregister_svc(3).code(), Code::UNREGISTERED_ERR);
+    EXPECT_FALSE(registry.is_registered(a));
+    EXPECT_EQ(registry.num_svcs(), 1);
+    EXPECT_EQ(registry.register_svc(c).code(), Code::OK);
+    EXPECT_EQ(registry.find_svc(12), &c);
+
+    EXPECT_STREQ(Registry_t::Status(Code::UNKNOWN_REGISTRATION_ERROR).str(),
+        "Unknown/ETL registration error");
+}
+
+struct LookupCfg : public etfw::SvcCfg<130, etfw::PassiveSvcCfg>
+{
+    static constexpr const char* NAME = "LOOKUP";
+};
+
+class LookupApp : public etfw::App<LookupApp, LookupCfg>
+{
+    public:
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+};
+
+TEST(Executor, RegistersById)
+{
+    using Code = etfw::iExecutor::Status::Code;
+    static LookupApp app;
+    static etfw::Executor<1> exec;
+
+    EXPECT_EQ(exec.register_app(app).code(), Code::OK);
+    EXPECT_EQ(exec.register_app(&app).code(), Code::ID_TAKEN);
+    EXPECT_EQ(exec.start(131).code(), Code::UNKNOWN_ID);
+    EXPECT_EQ(exec.stop(131).code(), Code::UNKNOWN_ID);
+    EXPECT_EQ(exec.stop(LookupApp::ID).code(), Code::OK);
+}
+
+}
@@ -0,0 +1,156 @@
+#include "ut_framework.hpp"
+
+#include <etfw/svcs/sched/SchedTbl.hpp>
+#include <etfw/svcs/sched/FrameTimer.hpp>
+
+namespace
+{
+
+using etfw::sched::FrameTimer;
+using etfw::sched::SlotStats;
+
+/// @brief Clock that only moves when told to. A sleep ends Late ns past
+///     its deadline.
+class ManualClock : public etfw::sched::iFrameClock
+{
+    public:
+        Os::TimeNs_t Now = 1000000000;
+        Os::TimeNs_t Late = 0;
+
+        Os::TimeNs_t now_ns() override { return Now; }
+
+        void sleep_until(const Os::TimeNs_t deadline_ns) override
+        {
+            if (deadline_ns > Now)
+            {
+                Now = deadline_ns + Late;
+            }
+        }
+};
+
+TEST(SchedTbl, SendLists)
+{
+    using Tbl_t = etfw::sched::SchedTbl<8, 2>;
+    using Code = Tbl_t::Status::Code;
+    Tbl_t tbl;
+
+    EXPECT_EQ(tbl.add(3, 0x10).code(), Code::OK);
+    EXPECT_EQ(tbl.add(8, 0x10).code(), Code::INVALID_FRAME);
+    EXPECT_EQ(tbl.add_periodic(0x20, 2, 1).code(), Code::OK);
+    EXPECT_EQ(tbl.add_periodic(0x30, 3).code(), Code::INVALID_PERIOD);
+    EXPECT_EQ(tbl.add_periodic(0x30, 4, 4).code(), Code::INVALID_FRAME);
+
+    for (size_t frame = 0; frame < Tbl_t::NUM_FRAMES; frame++)
+    {
+        const auto ids = tbl.frame(frame);
+        if (frame == 3)
+        {
+            ASSERT_EQ(ids.size(), 2);
+            EXPECT_EQ(ids[0], 0x10);
+            EXPECT_EQ(ids[1], 0x20);
+        }
+        else if ((frame % 2) == 1)
+        {
+            ASSERT_EQ(ids.size(), 1);
+            EXPECT_EQ(ids[0], 0x20);
+        }
+        else
+        {
+            EXPECT_TRUE(ids.empty());
+        }
+    }
+
+    // Frame 3 is full. Nothing is added.
+    EXPECT_EQ(tbl.add_periodic(0x40, 1).code(), Code::FRAME_FULL);
+    EXPECT_TRUE(tbl.frame(0).empty());
+}
+
+TEST(FrameTimer, NoDrift)
+{
+    constexpr Os::TimeNs_t PeriodNs = 500000;
+    constexpr size_t NumFrames = 4;
+    constexpr size_t NumWaits = 200;
+    SlotStats stats[NumFrames];
+    ManualClock clock;
+    FrameTimer timer(PeriodNs, etl::span<SlotStats>(stats, NumFrames), clock);
+
+    const Os::TimeNs_t start = clock.Now;
+    timer.start();
+    clock.Late = 20000;
+    for (size_t i = 0; i < NumWaits; i++)
+    {
+        EXPECT_EQ(timer.wait(), i % NumFrames);
+        // Work in the frame mustn't push later frames back
+        clock.Now += PeriodNs / 4;
+    }
+
+    // Frames are pinned to start + k * period, so neither the late wakes
+    // nor the loop's work accumulate
+    for (const SlotStats& slot: stats)
+    {
+        EXPECT_EQ(slot.Wakes, NumWaits / NumFrames);
+        EXPECT_EQ(slot.Overruns, 0);
+        EXPECT_EQ(slot.JitterMin, clock.Late);
+        EXPECT_EQ(slot.JitterMax, clock.Late);
+        EXPECT_EQ(slot.jitter_mean(), clock.Late);
+    }
+    EXPECT_EQ(clock.Now, start + NumWaits * PeriodNs + clock.Late + PeriodNs / 4);
+    EXPECT_EQ(timer.major_frames(), NumWaits / NumFrames);
+}
+
+TEST(FrameTimer, Overrun)
+{
+    constexpr Os::TimeNs_t PeriodNs = 1000000;
+    constexpr size_t NumFrames = 4;
+    SlotStats stats[NumFrames];
+    ManualClock clock;
+    FrameTimer timer(PeriodNs, etl::span<SlotStats>(stats, NumFrames), clock);
+
+    timer.start();
+    EXPECT_EQ(timer.wait(), 0);
+    // Frame 0 runs past the start of frame 2. Frame 1 is skipped and
+    // frame 2 runs late.
+    clock.Now += 2 * PeriodNs + (PeriodNs / 2);
+    const size_t frame = timer.wait();
+    EXPECT_EQ(frame, 2);
+    EXPECT_EQ(stats[1].Overruns, 1);
+    EXPECT_EQ(stats[1].Wakes, 0);
+    EXPECT_EQ(stats[frame].Wakes, 1);
+    EXPECT_EQ(stats[frame].JitterMax, PeriodNs / 2);
+
+    // Back on schedule at frame 3
+    EXPECT_EQ(timer.wait(), 3);
+    EXPECT_EQ(stats[3].JitterMax, 0);
+
+    timer.reset_stats();
+    EXPECT_EQ(stats[1].Overruns, 0);
+    EXPECT_EQ(stats[0].Wakes, 0);
+}
+
+TEST(FrameTimer, OsClock)
+{
+    constexpr Os::TimeNs_t PeriodNs = 1000000;
+    constexpr size_t NumFrames = 4;
+    constexpr size_t NumWaits = 8;
+    SlotStats stats[NumFrames];
+    FrameTimer timer(PeriodNs, etl::span<SlotStats>(stats, NumFrames));
+
+    // Wakes can be late on a loaded host, but never early
+    const Os::TimeNs_t start = Os::Clock::now_ns();
+    timer.start(start);
+    for (size_t i = 0; i < NumWaits; i++)
+    {
+        timer.wait();
+    }
+    uint32_t wakes = 0;
+    uint32_t overruns = 0;
+    for (const SlotStats& slot: stats)
+    {
+        wakes += slot.Wakes;
+        overruns += slot.Overruns;
+    }
+    EXPECT_EQ(wakes, NumWaits);
+    EXPECT_GE(Os::Clock::now_ns() - start, (NumWaits + overruns) * PeriodNs);
+}
+
+}
@@ -0,0 +1,286 @@
+#include "ut_framework.hpp"
+
+#include <etfw/svcs/App.hpp>
+#include <etfw/svcs/SvcCfg.hpp>
+#include <etfw/svcs/SvcPool.hpp>
+#include <etfw/svcs/WorkDeque.hpp>
+#include <etfw/msg/Router.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+template <typename TPred>
+bool wait_for(TPred&& pred, const std::chrono::milliseconds timeout)
+{
+    const auto end = std::chrono::steady_clock::now() + timeout;
+    while (!pred())
+    {
+        if (std::chrono::steady_clock::now() > end)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+TEST(WorkDeque, OwnerAndThieves)
+{
+    constexpr size_t NumItems = 200000;
+    constexpr size_t NumThieves = 3;
+    static etfw::WorkDeque<size_t, 64> deque;
+    static std::atomic<uint8_t> taken[NumItems];
+    for (auto& flag: taken)
+    {
+        flag = 0;
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> stolen{0};
+    std::vector<std::thread> thieves;
+    for (size_t i = 0; i < NumThieves; i++)
+    {
+        thieves.emplace_back([&]()
+        {
+            size_t item;
+            while (!done.load())
+            {
+                if (deque.steal(item))
+                {
+                    taken[item]++;
+                    stolen++;
+                }
+            }
+        });
+    }
+
+    size_t item;
+    size_t next = 0;
+    while (next < NumItems)
+    {
+        // Push in bursts and pop some back, so pops race steals for the
+        // last item
+        while (next < NumItems && deque.push(next))
+        {
+            next++;
+            if ((next % 3) == 0)
+            {
+                break;
+            }
+        }
+        if (deque.pop(item))
+        {
+            taken[item]++;
+        }
+    }
+    while (deque.pop(item))
+    {
+        taken[item]++;
+    }
+    done = true;
+    for (auto& thief: thieves)
+    {
+        thief.join();
+    }
+
+    for (size_t i = 0; i < NumItems; i++)
+    {
+        ASSERT_EQ(taken[i], 1) << "Item " << i;
+    }
+    EXPECT_TRUE(deque.empty());
+}
+
+// ~~~~~~~~ Pooled services ~~~~~~~~
+
+struct SpinnerCfg : public etfw::SvcCfg<50, etfw::PooledSvcCfg>
+{
+    static constexpr const char* NAME = "SPINNER";
+};
+
+/// Pooled service without event sources. Checks it never runs on two
+/// workers at once.
+class Spinner : public etfw::App<Spinner, SpinnerCfg>
+{
+    public:
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        RunState run_loop()
+        {
+            if (InProcess.fetch_add(1) != 0)
+            {
+                Overlaps++;
+            }
+            Loops++;
+            for (volatile int i = 0; i < 200; i++)
+            {}
+            InProcess.fetch_sub(1);
+            return RunState::OK;
+        }
+
+        std::atomic<uint32_t> InProcess{0};
+        std::atomic<size_t> Overlaps{0};
+        std::atomic<size_t> Loops{0};
+};
+
+TEST(SvcPool, NeverRunsServiceConcurrently)
+{
+    constexpr size_t NumSvcs = 16;
+    static Spinner spinners[NumSvcs];
+    for (Spinner& svc: spinners)
+    {
+        ASSERT_TRUE(svc.init().success());
+        ASSERT_TRUE(svc.start().success());
+    }
+
+    // Every service makes progress on the shared workers
+    ASSERT_TRUE(wait_for([&]()
+        {
+            for (const Spinner& svc: spinners)
+            {
+                if (svc.Loops < 1000)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }, std::chrono::milliseconds(5000)));
+
+    for (Spinner& svc: spinners)
+    {
+        ASSERT_TRUE(svc.stop().success());
+    }
+    const Os::TimeNs_t deadline = Os::Clock::now_ns() + Os::NsPerSec;
+    for (Spinner& svc: spinners)
+    {
+        EXPECT_EQ(svc.Overlaps, 0);
+        // Finished services are parked
+        ASSERT_TRUE(svc.get_runner()->wait_finished(deadline));
+        const size_t loops = svc.Loops;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * SVC_POOL_POLL_MS));
+        EXPECT_EQ(svc.Loops, loops);
+    }
+}
+
+TEST(SvcPool, PollsServicesWithoutSources)
+{
+    static Spinner svc;
+    ASSERT_TRUE(svc.init().success());
+    ASSERT_TRUE(svc.start().success());
+    ASSERT_TRUE(wait_for([]() { return svc.Loops > 0; }, std::chrono::milliseconds(1000)));
+
+    // Run once per poll period, not back to back
+    const size_t loops = svc.Loops;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20 * SVC_POOL_POLL_MS));
+    EXPECT_LE(svc.Loops - loops, 21u);
+
+    ASSERT_TRUE(svc.stop().success());
+    EXPECT_TRUE(svc.get_runner()->wait_finished(Os::Clock::now_ns() + Os::NsPerSec));
+}
+
+TEST(SvcPool, StopWhileStarting)
+{
+    static Spinner svc;
+    ASSERT_TRUE(svc.init().success());
+    for (int i = 0; i < 100; i++)
+    {
+        // The stop lands before, during or after the worker runs init
+        ASSERT_TRUE(svc.start().success());
+        ASSERT_TRUE(svc.stop().success());
+        ASSERT_TRUE(svc.get_runner()->wait_finished(Os::Clock::now_ns() + Os::NsPerSec))
+            << "Stop lost on start " << i;
+        EXPECT_EQ(svc.get_runner()->state(), etfw::iSvcRunner::State_t::STOPPED);
+    }
+}
+
+struct Ping : public etl::message<1>
+{
+    uint32_t Seq;
+
+    Ping(uint32_t seq): Seq(seq) {}
+};
+
+struct EventCfg : public etfw::SvcCfg<51, etfw::PooledSvcCfg>
+{
+    static constexpr const char* NAME = "POOLED_EVENT";
+};
+
+/// Pooled service with a queued router and a periodic timer
+class EventSvc : public etfw::App<EventSvc, EventCfg>
+{
+    public:
+        using Pipe_t = etfw::msg::QueuedRouter<EventSvc, 4, Ping>;
+        using Timer_t = etfw::msg::PeriodicTimer<EventSvc>;
+
+        static constexpr Os::TimeMs_t TimerPeriodMs = 10;
+
+        EventSvc():
+            pipe_(*this),
+            timer_(*this, TimerPeriodMs),
+            sources_{&pipe_, &timer_}
+        {}
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 2);
+        }
+
+        void receive(const Ping& ping)
+        {
+            LastSeq = ping.Seq;
+        }
+
+        void on_timer(const Timer_t& timer)
+        {
+            Ticks++;
+        }
+
+        inline Pipe_t& pipe() { return pipe_; }
+        inline const etfw::PooledRunner& runner_ext() const { return Runner; }
+
+        std::atomic<uint32_t> LastSeq{0};
+        std::atomic<size_t> Ticks{0};
+
+    private:
+        Pipe_t pipe_;
+        Timer_t timer_;
+        etfw::msg::iEventSource* const sources_[2];
+};
+
+TEST(SvcPool, ParksServicesOnEventSources)
+{
+    static EventSvc svc;
+    ASSERT_TRUE(svc.init().success());
+    ASSERT_TRUE(svc.start().success());
+
+    // Messages schedule the parked service
+    for (uint32_t seq = 1; seq <= 100; seq++)
+    {
+        svc.pipe().receive(Ping(seq));
+        ASSERT_TRUE(wait_for([seq]() { return svc.LastSeq == seq; },
+            std::chrono::milliseconds(1000)));
+    }
+
+    // Idle, the service only runs for its timer
+    const size_t ticks = svc.Ticks;
+    const size_t runs = svc.runner_ext().runs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10 * EventSvc::TimerPeriodMs));
+    const size_t idle_ticks = svc.Ticks - ticks;
+    EXPECT_GE(idle_ticks, 5);
+    EXPECT_LE(svc.runner_ext().runs() - runs, (2 * idle_ticks) + 2);
+
+    ASSERT_TRUE(svc.stop().success());
+    EXPECT_TRUE(wait_for([]() {
+            return svc.runner_ext().state() == etfw::iSvcRunner::State_t::STOPPED;
+        }, std::chrono::milliseconds(1000)));
+}
+
+}
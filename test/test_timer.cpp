@@ -0,0 +1,399 @@
+#include "ut_framework.hpp"
+
+#include <etfw/svcs/timer/TimerWheel.hpp>
+#include <etfw/svcs/timer/TimerApp.hpp>
+#include <etfw/msg/Router.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using namespace etfw::timer;
+using Code = TimerWheel::Status::Code;
+
+/// @brief Expiry seen by a test handler
+struct Expiry
+{
+    Tick_t At;
+    TimerId_t Id;
+    etfw::msg::MsgId_t MsgId;
+    uint32_t Missed;
+};
+
+/// @brief Advance one tick at a time, recording expiries
+template <typename TWheel>
+std::vector<Expiry> step_to(TWheel& wheel, const Tick_t to)
+{
+    std::vector<Expiry> fired;
+    while (wheel.now() < to)
+    {
+        const Tick_t tick = wheel.now() + 1;
+        wheel.advance(tick, [&](TimerId_t id, etfw::msg::MsgId_t msg_id, uint32_t missed)
+        {
+            fired.push_back({tick, id, msg_id, missed});
+        });
+    }
+    return fired;
+}
+
+TEST(TimerWheel, ExpiresAcrossLevels)
+{
+    StaticTimerWheel<16> wheel;
+    const Tick_t expiries[] = {1, 63, 64, 65, 4095, 4096, 4097, 262200, 300001};
+    for (const Tick_t expiry: expiries)
+    {
+        TimerId_t id;
+        ASSERT_EQ(wheel.arm(id, static_cast<etfw::msg::MsgId_t>(expiry), expiry).code(), Code::OK);
+        EXPECT_NE(id, TimerIdInvalid);
+    }
+    EXPECT_EQ(wheel.active(), 9);
+
+    // Each timer fires exactly at its tick, whether stepped or jumped to
+    StaticTimerWheel<16> jumped;
+    for (const Tick_t expiry: expiries)
+    {
+        TimerId_t id;
+        ASSERT_TRUE(jumped.arm(id, static_cast<etfw::msg::MsgId_t>(expiry), expiry).success());
+    }
+
+    const std::vector<Expiry> fired = step_to(wheel, 300001);
+    ASSERT_EQ(fired.size(), 9);
+    for (size_t i = 0; i < fired.size(); i++)
+    {
+        EXPECT_EQ(fired[i].At, expiries[i]);
+        EXPECT_EQ(fired[i].MsgId, expiries[i]);
+    }
+    EXPECT_EQ(wheel.active(), 0);
+    EXPECT_EQ(wheel.next_event(), TickNever);
+
+    for (const Tick_t expiry: expiries)
+    {
+        size_t count = 0;
+        jumped.advance(expiry, [&](TimerId_t, etfw::msg::MsgId_t msg_id, uint32_t)
+        {
+            EXPECT_EQ(msg_id, expiry);
+            count++;
+        });
+        EXPECT_EQ(count, 1);
+    }
+}
+
+TEST(TimerWheel, BeyondSpan)
+{
+    StaticTimerWheel<4> wheel;
+    const Tick_t far = (3 * TimerWheel::MaxSpan) + 17;
+    TimerId_t id;
+    ASSERT_TRUE(wheel.arm(id, 1, far).success());
+
+    Tick_t fired_at = 0;
+    size_t wakes = 0;
+    while (wheel.active() > 0)
+    {
+        const Tick_t next = wheel.next_event();
+        ASSERT_NE(next, TickNever);
+        wheel.advance(next, [&](TimerId_t, etfw::msg::MsgId_t, uint32_t)
+        {
+            fired_at = next;
+        });
+        wakes++;
+    }
+    EXPECT_EQ(fired_at, far);
+    // Only cascades and the expiry itself, no per-tick stepping
+    EXPECT_LT(wakes, 4 * TimerWheel::NumLevels * 2);
+}
+
+TEST(TimerWheel, CancelAndStaleHandles)
+{
+    StaticTimerWheel<2> wheel;
+    TimerId_t a, b, c;
+    ASSERT_TRUE(wheel.arm(a, 1, 10).success());
+    ASSERT_TRUE(wheel.arm(b, 2, 10).success());
+    EXPECT_EQ(wheel.arm(c, 3, 10).code(), Code::NO_TIMERS);
+
+    EXPECT_TRUE(wheel.armed(a));
+    EXPECT_EQ(wheel.cancel(a).code(), Code::OK);
+    EXPECT_FALSE(wheel.armed(a));
+    EXPECT_EQ(wheel.cancel(a).code(), Code::INVALID_TIMER);
+    EXPECT_EQ(wheel.cancel(TimerIdInvalid).code(), Code::INVALID_TIMER);
+
+    // The freed entry is reused under a new handle
+    ASSERT_TRUE(wheel.arm(c, 3, 20).success());
+    EXPECT_NE(c, a);
+    EXPECT_EQ(wheel.cancel(a).code(), Code::INVALID_TIMER);
+    EXPECT_TRUE(wheel.armed(c));
+
+    const std::vector<Expiry> fired = step_to(wheel, 30);
+    ASSERT_EQ(fired.size(), 2);
+    EXPECT_EQ(fired[0].Id, b);
+    EXPECT_EQ(fired[0].At, 10);
+    EXPECT_EQ(fired[1].Id, c);
+    EXPECT_EQ(fired[1].At, 20);
+    EXPECT_FALSE(wheel.armed(b));
+    EXPECT_EQ(wheel.cancel(b).code(), Code::INVALID_TIMER);
+}
+
+TEST(TimerWheel, Periodic)
+{
+    StaticTimerWheel<2> wheel;
+    TimerId_t id;
+    ASSERT_TRUE(wheel.arm(id, 7, 10, 10).success());
+
+    const std::vector<Expiry> fired = step_to(wheel, 30);
+    ASSERT_EQ(fired.size(), 3);
+    for (size_t i = 0; i < fired.size(); i++)
+    {
+        EXPECT_EQ(fired[i].At, 10 * (i + 1));
+        EXPECT_EQ(fired[i].Id, id);
+        EXPECT_EQ(fired[i].Missed, 0);
+    }
+
+    // Expiries at 40 and 50 are due. Fires once and reports the other missed.
+    std::vector<uint32_t> missed;
+    wheel.advance(55, [&](TimerId_t, etfw::msg::MsgId_t, uint32_t m) { missed.push_back(m); });
+    ASSERT_EQ(missed.size(), 1);
+    EXPECT_EQ(missed[0], 1);
+    EXPECT_EQ(wheel.next_event(), 60);
+
+    EXPECT_TRUE(wheel.cancel(id).success());
+    EXPECT_EQ(wheel.active(), 0);
+}
+
+TEST(TimerWheel, MatchesReferenceModel)
+{
+    constexpr size_t NumTimers = 512;
+    StaticTimerWheel<NumTimers> wheel;
+    std::map<TimerId_t, Tick_t> model;
+    std::mt19937_64 rng(1234);
+
+    for (size_t round = 0; round < 2000; round++)
+    {
+        const unsigned op = rng() % 8;
+        if (op < 5 && model.size() < NumTimers)
+        {
+            // Mostly short delays, some long enough to cascade several levels
+            const Tick_t delay = (rng() % 4 == 0) ? (rng() % 2000000) : (rng() % 300);
+            TimerId_t id;
+            ASSERT_TRUE(wheel.arm(id, 0, wheel.now() + delay).success());
+            model[id] = std::max(wheel.now() + delay, wheel.now() + 1);
+        }
+        else if (op < 6 && !model.empty())
+        {
+            auto it = model.begin();
+            std::advance(it, rng() % model.size());
+            ASSERT_TRUE(wheel.cancel(it->first).success());
+            model.erase(it);
+        }
+        else
+        {
+            const Tick_t to = wheel.now() + (rng() % 5000);
+            wheel.advance(to, [&](TimerId_t id, etfw::msg::MsgId_t, uint32_t)
+            {
+                auto it = model.find(id);
+                ASSERT_NE(it, model.end());
+                EXPECT_EQ(it->second, wheel.now());
+                model.erase(it);
+            });
+            for (const auto& entry: model)
+            {
+                ASSERT_GT(entry.second, to);
+            }
+        }
+        ASSERT_EQ(wheel.active(), model.size());
+    }
+}
+
+// ~~~~~~~~ Timer app ~~~~~~~~
+
+constexpr etfw::msg::MsgId_t OneshotId = 0x7701;
+constexpr etfw::msg::MsgId_t PeriodicId = 0x7702;
+using OneshotMsg = TimerMsg<OneshotId>;
+using PeriodicMsg = TimerMsg<PeriodicId>;
+
+using TimerCfg = TimerAppCfg<40, 64, 1000, 0>;
+using TimerApp_t = TimerApp<TimerCfg>;
+
+struct ClientCfg : public etfw::SvcCfg<41, etfw::EventSvcCfg<0, 8192>>
+{
+    static constexpr const char* NAME = "TIMER_CLIENT";
+};
+
+/// Receives timer expiries on a queued router
+class Client : public etfw::App<Client, ClientCfg>
+{
+    public:
+        using Base_t = etfw::App<Client, ClientCfg>;
+        using Pipe_t = etfw::msg::QueuedRouter<Client, 8, OneshotMsg, PeriodicMsg>;
+
+        Client():
+            Base_t(),
+            pipe_(*this),
+            sources_{&pipe_}
+        {}
+
+        Status app_init()
+        {
+            subscribe_cmd(pipe_.subscription());
+            return Status::Code::OK;
+        }
+
+        Status app_cleanup()
+        {
+            return Status::Code::OK;
+        }
+
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 1);
+        }
+
+        void receive(const OneshotMsg& msg)
+        {
+            OneshotNs = Os::Clock::now_ns();
+            OneshotTimer = msg.Timer;
+        }
+
+        void receive(const PeriodicMsg& msg)
+        {
+            Periodic++;
+            Missed += msg.Missed;
+        }
+
+        std::atomic<Os::TimeNs_t> OneshotNs{0};
+        std::atomic<TimerId_t> OneshotTimer{TimerIdInvalid};
+        std::atomic<size_t> Periodic{0};
+        std::atomic<size_t> Missed{0};
+
+    private:
+        Pipe_t pipe_;
+        etfw::msg::iEventSource* const sources_[1];
+};
+
+template <typename TPred>
+bool wait_for(TPred&& pred, const std::chrono::milliseconds timeout)
+{
+    const auto end = std::chrono::steady_clock::now() + timeout;
+    while (!pred())
+    {
+        if (std::chrono::steady_clock::now() > end)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+TEST(TimerApp, DeliversToPipes)
+{
+    static TimerApp_t timers;
+    static Client client;
+    ASSERT_TRUE(timers.init().success());
+    ASSERT_TRUE(client.init().success());
+    ASSERT_TRUE(timers.start().success());
+    ASSERT_TRUE(client.start().success());
+
+    // Armed while the timer task sleeps with nothing to do
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    constexpr Os::TimeMs_t DelayMs = 30;
+    const Os::TimeNs_t armed_ns = Os::Clock::now_ns();
+    TimerId_t oneshot;
+    ASSERT_TRUE(timers.start_oneshot(oneshot, OneshotId, DelayMs).success());
+
+    TimerId_t cancelled;
+    ASSERT_TRUE(timers.start_oneshot(cancelled, OneshotId, 10).success());
+    ASSERT_TRUE(timers.cancel(cancelled).success());
+
+    TimerId_t periodic;
+    ASSERT_TRUE(timers.start_periodic(periodic, PeriodicId, 5).success());
+
+    ASSERT_TRUE(wait_for([]() { return client.OneshotNs != 0; },
+        std::chrono::milliseconds(1000)));
+    EXPECT_EQ(client.OneshotTimer, oneshot);
+    EXPECT_GE(client.OneshotNs - armed_ns, DelayMs * Os::NsPerMs);
+
+    ASSERT_TRUE(wait_for([]() { return (client.Periodic + client.Missed) >= 20; },
+        std::chrono::milliseconds(2000)));
+    EXPECT_TRUE(timers.cancel(periodic).success());
+    EXPECT_EQ(timers.active(), 0);
+
+    ASSERT_TRUE(timers.stop().success());
+    ASSERT_TRUE(client.stop().success());
+}
+
+constexpr etfw::msg::MsgId_t RearmId = 0x7703;
+
+struct RearmCfg : public etfw::SvcCfg<43, etfw::PassiveSvcCfg>
+{
+    static constexpr const char* NAME = "TIMER_REARM";
+};
+
+/// Re-arms its timer from a synchronous pipe, on the timer app's thread
+class Rearmer : public etfw::App<Rearmer, RearmCfg>
+{
+    public:
+        using Base_t = etfw::App<Rearmer, RearmCfg>;
+        static constexpr size_t NumFires = 5;
+
+        Rearmer(TimerApp_t& timers):
+            Base_t(),
+            timers_(timers),
+            pipe_(*this)
+        {}
+
+        Status app_init()
+        {
+            subscribe_cmd(pipe_, {RearmId});
+            return Status::Code::OK;
+        }
+
+        Status app_cleanup()
+        {
+            return Status::Code::OK;
+        }
+
+        void handle(const etl::imessage& msg)
+        {
+            (void)msg;
+            if (++Fired < NumFires)
+            {
+                TimerId_t timer;
+                if (!timers_.start_oneshot(timer, RearmId, 1).success())
+                {
+                    Failed++;
+                }
+            }
+        }
+
+        std::atomic<size_t> Fired{0};
+        std::atomic<size_t> Failed{0};
+
+    private:
+        TimerApp_t& timers_;
+        etfw::msg::Pipe<Rearmer> pipe_;
+};
+
+TEST(TimerApp, HandlerRearms)
+{
+    static TimerApp_t timers;
+    static Rearmer rearmer(timers);
+    ASSERT_TRUE(timers.init().success());
+    ASSERT_TRUE(rearmer.init().success());
+    ASSERT_TRUE(timers.start().success());
+
+    TimerId_t timer;
+    ASSERT_TRUE(timers.start_oneshot(timer, RearmId, 1).success());
+    EXPECT_TRUE(wait_for([]() { return rearmer.Fired == Rearmer::NumFires; },
+        std::chrono::milliseconds(2000)));
+    EXPECT_EQ(rearmer.Failed, 0);
+    EXPECT_EQ(timers.active(), 0);
+
+    ASSERT_TRUE(timers.stop().success());
+}
+
+}
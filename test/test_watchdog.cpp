@@ -0,0 +1,317 @@
+#include "ut_framework.hpp"
+
+#include <etfw/svcs/ExecStats.hpp>
+#include <etfw/svcs/watchdog/WatchdogApp.hpp>
+#include <etfw/msg/BlockingMsgQueue.hpp>
+#include <etfw/msg/Router.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+
+using etfw::ExecStats;
+using namespace etfw::watchdog;
+
+TEST(ExecStats, BucketsAndPercentiles)
+{
+    // Buckets are ordered and each holds its own upper bound
+    size_t last = 0;
+    for (Os::TimeNs_t ns = 0; ns < 100000; ns += 7)
+    {
+        const size_t bucket = ExecStats::bucket(ns);
+        EXPECT_GE(bucket, last);
+        EXPECT_GE(ExecStats::bucket_max_ns(bucket), ns);
+        EXPECT_EQ(ExecStats::bucket(ExecStats::bucket_max_ns(bucket)), bucket);
+        last = bucket;
+    }
+    EXPECT_EQ(ExecStats::bucket(Os::TimeNsNever), ExecStats::NumBuckets - 1);
+
+    // 99 fast cycles and a slow one
+    static ExecStats stats;
+    stats.set_budget(10000, 0);
+    for (size_t i = 0; i < 99; i++)
+    {
+        stats.record(1000, 2000);
+    }
+    stats.record(1000000, 1000000);
+    EXPECT_EQ(stats.cycles(), 100);
+    EXPECT_EQ(stats.cpu_total_ns(), (99 * 1000) + 1000000);
+    EXPECT_EQ(stats.cpu_min_ns(), 1000);
+    EXPECT_EQ(stats.cpu_max_ns(), 1000000);
+    EXPECT_EQ(stats.overruns(), 1);
+
+    uint32_t hist[ExecStats::NumBuckets];
+    stats.histogram(hist);
+    const Os::TimeNs_t p50 = ExecStats::percentile_ns(hist, 50);
+    const Os::TimeNs_t p99 = ExecStats::percentile_ns(hist, 99);
+    const Os::TimeNs_t p100 = ExecStats::percentile_ns(hist, 100);
+    EXPECT_GE(p50, 1000);
+    EXPECT_LT(p50, 1250);
+    EXPECT_EQ(p99, p50);
+    EXPECT_GE(p100, 1000000);
+    EXPECT_LT(p100, 1250000);
+
+    // The window restarts when taken
+    EXPECT_EQ(stats.take_window_max_ns(), 1000000);
+    EXPECT_EQ(stats.take_window_min_ns(), 1000);
+    EXPECT_EQ(stats.take_window_max_ns(), 0);
+    EXPECT_EQ(stats.take_window_min_ns(), Os::TimeNsNever);
+
+    // Stalled only while a cycle runs past the timeout
+    stats.set_budget(0, 5 * Os::NsPerMs);
+    EXPECT_FALSE(stats.stalled(Os::Clock::now_ns()));
+    const ExecStats::Mark mark = stats.begin();
+    EXPECT_FALSE(stats.stalled(mark.WallNs + Os::NsPerMs));
+    EXPECT_TRUE(stats.stalled(mark.WallNs + (6 * Os::NsPerMs)));
+    stats.end(mark);
+    EXPECT_FALSE(stats.stalled(mark.WallNs + (6 * Os::NsPerMs)));
+    EXPECT_EQ(stats.cycles(), 101);
+}
+
+TEST(ExecStats, BlockedReceiveDoesntStall)
+{
+    static ExecStats stats;
+    stats.set_budget(0, 5 * Os::NsPerMs);
+    etfw::msg::BlockingMsgQueue<int, 4> queue;
+
+    // Another thread checks the cycle while it waits for an item
+    std::atomic<bool> stalled_while_blocked(true);
+    std::thread feeder([&]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        stalled_while_blocked = stats.stalled(Os::Clock::now_ns());
+        int item = 1;
+        queue.push(item);
+    });
+
+    const ExecStats::Mark mark = stats.begin();
+    int out = 0;
+    EXPECT_EQ(queue.drain(etl::span<int>(&out, 1), 5000), 1);
+    feeder.join();
+    EXPECT_FALSE(stalled_while_blocked);
+
+    // The stall timeout runs again from the end of the wait
+    const Os::TimeNs_t woke = Os::Clock::now_ns();
+    EXPECT_GE(stats.cycle_start_ns(), woke - Os::NsPerMs);
+    EXPECT_FALSE(stats.stalled(stats.cycle_start_ns() + Os::NsPerMs));
+    EXPECT_TRUE(stats.stalled(stats.cycle_start_ns() + (10 * Os::NsPerMs)));
+    stats.end(mark);
+    EXPECT_EQ(stats.cycle_start_ns(), 0);
+
+    // Outside a cycle, waits leave the stats alone
+    EXPECT_EQ(queue.drain(etl::span<int>(&out, 1), 1), 0);
+    EXPECT_EQ(stats.cycle_start_ns(), 0);
+}
+
+// ~~~~~~~~ Watchdog app ~~~~~~~~
+
+template <typename TPred>
+bool wait_for(TPred&& pred, const std::chrono::milliseconds timeout)
+{
+    const auto end = std::chrono::steady_clock::now() + timeout;
+    while (!pred())
+    {
+        if (std::chrono::steady_clock::now() > end)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+using WatchdogCfg = WatchdogAppCfg<60, 4, 20, 0>;
+using WatchdogApp_t = WatchdogApp<WatchdogCfg>;
+using Tlm = ExecTlm<WatchdogCfg::TLM_ID>;
+
+struct BusyCfg : public etfw::SvcCfg<61, etfw::EventSvcCfg<0, 8192>>
+{
+    static constexpr const char* NAME = "WD_BUSY";
+    static constexpr uint32_t EXEC_BUDGET_US = 200;
+};
+
+struct StuckCfg : public etfw::SvcCfg<62, etfw::EventSvcCfg<0, 8192>>
+{
+    static constexpr const char* NAME = "WD_STUCK";
+    static constexpr uint32_t EXEC_STALL_MS = 30;
+};
+
+struct MonitorCfg : public etfw::SvcCfg<63, etfw::EventSvcCfg<0, 8192>>
+{
+    static constexpr const char* NAME = "WD_MONITOR";
+};
+
+/// Burns about 1ms of CPU every 5ms
+class Busy : public etfw::App<Busy, BusyCfg>
+{
+    public:
+        using Base_t = etfw::App<Busy, BusyCfg>;
+        using Timer_t = etfw::msg::PeriodicTimer<Busy>;
+
+        Busy():
+            Base_t(),
+            timer_(*this, 5),
+            sources_{&timer_}
+        {}
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 1);
+        }
+
+        void on_timer(const Timer_t& timer)
+        {
+            const Os::TimeNs_t start = Os::Clock::thread_cpu_ns();
+            while ((Os::Clock::thread_cpu_ns() - start) < Os::NsPerMs)
+            {}
+        }
+
+    private:
+        Timer_t timer_;
+        etfw::msg::iEventSource* const sources_[1];
+};
+
+/// Blocks for 150ms in one cycle once Block is set
+class Stuck : public etfw::App<Stuck, StuckCfg>
+{
+    public:
+        using Base_t = etfw::App<Stuck, StuckCfg>;
+        using Timer_t = etfw::msg::PeriodicTimer<Stuck>;
+
+        Stuck():
+            Base_t(),
+            timer_(*this, 5),
+            sources_{&timer_}
+        {}
+
+        Status app_init() { return Status::Code::OK; }
+        Status app_cleanup() { return Status::Code::OK; }
+
+        RunState pre_run_init() override
+        {
+            Starts++;
+            return RunState::OK;
+        }
+
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 1);
+        }
+
+        void on_timer(const Timer_t& timer)
+        {
+            if (Block.exchange(false))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(150));
+            }
+        }
+
+        std::atomic<bool> Block{false};
+        std::atomic<size_t> Starts{0};
+
+    private:
+        Timer_t timer_;
+        etfw::msg::iEventSource* const sources_[1];
+};
+
+/// Keeps the latest telemetry of the busy service
+class Monitor : public etfw::App<Monitor, MonitorCfg>
+{
+    public:
+        using Base_t = etfw::App<Monitor, MonitorCfg>;
+        using Pipe_t = etfw::msg::QueuedRouter<Monitor, 8, Tlm>;
+
+        Monitor():
+            Base_t(),
+            pipe_(*this),
+            sources_{&pipe_}
+        {}
+
+        Status app_init()
+        {
+            subscribe_status(pipe_.subscription());
+            return Status::Code::OK;
+        }
+
+        Status app_cleanup() { return Status::Code::OK; }
+
+        etfw::msg::EventSources_t event_sources() override
+        {
+            return etfw::msg::EventSources_t(sources_, 1);
+        }
+
+        void receive(const Tlm& tlm)
+        {
+            if (tlm.Svc == BusyCfg::ID && tlm.Cycles > 0)
+            {
+                BusyBudgetNs = tlm.BudgetNs;
+                BusyMaxNs = tlm.CpuMaxNs;
+                BusyP99Ns = tlm.CpuP99Ns;
+                BusyPermille = tlm.CpuPermille;
+                BusyReports++;
+            }
+        }
+
+        std::atomic<Os::TimeNs_t> BusyBudgetNs{0};
+        std::atomic<Os::TimeNs_t> BusyMaxNs{0};
+        std::atomic<Os::TimeNs_t> BusyP99Ns{0};
+        std::atomic<uint32_t> BusyPermille{0};
+        std::atomic<size_t> BusyReports{0};
+
+    private:
+        Pipe_t pipe_;
+        etfw::msg::iEventSource* const sources_[1];
+};
+
+TEST(WatchdogApp, FlagsOverrunsAndRestartsStalls)
+{
+    static WatchdogApp_t watchdog;
+    static Busy busy;
+    static Stuck stuck;
+    static Monitor monitor;
+    ASSERT_TRUE(watchdog.init().success());
+    ASSERT_TRUE(busy.init().success());
+    ASSERT_TRUE(stuck.init().success());
+    ASSERT_TRUE(monitor.init().success());
+
+    EXPECT_EQ(watchdog.watch(busy).code(), WatchdogApp_t::Status::Code::OK);
+    EXPECT_EQ(watchdog.watch(stuck, WatchAction::RESTART).code(), WatchdogApp_t::Status::Code::OK);
+    EXPECT_EQ(watchdog.watch(busy).code(), WatchdogApp_t::Status::Code::ALREADY_REGISTERED);
+
+    ASSERT_TRUE(monitor.start().success());
+    ASSERT_TRUE(busy.start().success());
+    ASSERT_TRUE(stuck.start().success());
+    ASSERT_TRUE(watchdog.start().success());
+
+    // Every busy cycle is over its budget and reported
+    ASSERT_TRUE(wait_for([]() {
+            return watchdog.overruns() > 0 && monitor.BusyReports >= 2;
+        }, std::chrono::milliseconds(3000)));
+    EXPECT_EQ(monitor.BusyBudgetNs, 200 * 1000);
+    EXPECT_GE(monitor.BusyMaxNs, Os::NsPerMs);
+    EXPECT_GE(monitor.BusyP99Ns, Os::NsPerMs);
+    EXPECT_GT(monitor.BusyPermille, 0);
+    EXPECT_GT(busy.get_runner()->exec_stats().overruns(), 0);
+    EXPECT_EQ(stuck.get_runner()->exec_stats().overruns(), 0);
+
+    // A blocked cycle is a stall, and the service is restarted once it returns
+    ASSERT_EQ(stuck.Starts, 1);
+    stuck.Block = true;
+    ASSERT_TRUE(wait_for([]() { return watchdog.restarts() == 1; },
+        std::chrono::milliseconds(3000)));
+    EXPECT_EQ(watchdog.stalls(), 1);
+    EXPECT_EQ(stuck.Starts, 2);
+
+    ASSERT_TRUE(watchdog.stop().success());
+    ASSERT_TRUE(busy.stop().success());
+    ASSERT_TRUE(stuck.stop().success());
+    ASSERT_TRUE(monitor.stop().success());
+}
+
+}
@@ -0,0 +1,53 @@
+/// @file logdec.cpp
+/// @brief Turns binary log files (see BinLog) into text, one line per
+///     record, in the format AsyncLog writes: ETF_LOG_FMT after the
+///     monotonic timestamp.
+///
+///     Usage: logdec <file>...
+
+#include <etfw/svcs/log/AsyncLog.hpp>
+#include <etfw/svcs/log/BinLog.hpp>
+
+#include <cstdio>
+
+static etfw::BinLogReader Reader;
+static etfw::BinLogReader::Entry Entry;
+
+static int decode(const char* path)
+{
+    if (!Reader.open(path).success())
+    {
+        std::fprintf(stderr, "logdec: cannot open %s\n", path);
+        return 1;
+    }
+    while (Reader.next(Entry))
+    {
+        std::printf(ETF_ASYNC_LOG_FMT "\n",
+            static_cast<unsigned long long>(Entry.TimeNs / Os::NsPerSec),
+            static_cast<unsigned long long>((Entry.TimeNs % Os::NsPerSec) / 1000),
+            Entry.Caller, etfw::log_lvl_to_str(Entry.Level), Entry.Msg);
+    }
+    const bool corrupt = Reader.corrupt();
+    Reader.close();
+    if (corrupt)
+    {
+        std::fprintf(stderr, "logdec: %s: invalid block or record, stopped\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "usage: logdec <file>...\n");
+        return 2;
+    }
+    int rc = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        rc |= decode(argv[i]);
+    }
+    return rc;
+}